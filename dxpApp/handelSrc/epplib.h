@@ -55,6 +55,9 @@ extern "C" {
   XIA_EXPORT int XIA_API DxpReadBlockd(unsigned short, double *,int);
   XIA_EXPORT int XIA_API DxpReadBlocklong(unsigned short,unsigned long *,int);
   XIA_EXPORT int XIA_API DxpReadBlocklongd(unsigned short, double *,int);
+  /* Implemented in xia_epp_linux.c only */
+  XIA_EXPORT int XIA_API DxpReadBlocklongUshort(unsigned short, unsigned short *, int);
+  XIA_EXPORT int XIA_API DxpWriteBlocklongUshort(unsigned short, unsigned short *, int);
   XIA_EXPORT void XIA_API DxpSetID(unsigned short id);
   XIA_EXPORT int XIA_API DxpWritePort(unsigned short port, unsigned short data);
   XIA_EXPORT int XIA_API DxpReadPort(unsigned short port, unsigned short *data);
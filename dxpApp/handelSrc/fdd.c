@@ -49,7 +49,15 @@
 #include "xia_assert.h"
 #include "xia_file.h"
 
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
+
 FDD_STATIC void fdd__StringChomp(char *str);
+FDD_STATIC int fdd__GetFirmware(const char *filename, char *path,
+                                const char *ftype, double pt,
+                                unsigned int nother, const char **others,
+                                const char *detectorType, char newfilename[],
+                                char rawFilename[]);
 
 static char info_string[INFO_LEN],line[XIA_LINE_LEN],*token,*delim=" ,=\t\r\n";
 
@@ -119,6 +127,8 @@ FDD_EXPORT int FDD_API xiaFddInitLibrary(void)
  *    fippi
  *    dsp
  *    system
+ *
+ * The time taken is added to the "fdd" startup phase.
  */
 FDD_EXPORT int FDD_API xiaFddGetFirmware(const char *filename, char *path,
                                          const char *ftype,
@@ -127,6 +137,26 @@ FDD_EXPORT int FDD_API xiaFddGetFirmware(const char *filename, char *path,
                                          const char *detectorType,
                                          char newfilename[],
                                          char rawFilename[])
+{
+    int status;
+
+    double start = dxp_wait_now();
+
+
+    status = fdd__GetFirmware(filename, path, ftype, pt, nother, others,
+                              detectorType, newfilename, rawFilename);
+
+    dxp_stats_since("startup", "fdd", start, 0.0);
+
+    return status;
+}
+
+
+FDD_STATIC int fdd__GetFirmware(const char *filename, char *path,
+                                const char *ftype, double pt,
+                                unsigned int nother, const char **others,
+                                const char *detectorType, char newfilename[],
+                                char rawFilename[])
 /* const char *filename;     Input: name of the file that is the fdd        */
 /* const char *ftype;      Input: firmware type to retrieve           */
 /* unsigned short nother;     Input: number of elements in the array of other specifiers */
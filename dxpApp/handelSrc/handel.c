@@ -49,6 +49,8 @@
 #include "xerxes.h"
 #include "xerxes_errors.h"
 #include "xerxes_structures.h"
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
 
 #include "xia_handel.h"
 #include "xia_module.h"
@@ -113,6 +115,8 @@ HANDEL_EXPORT int HANDEL_API xiaInit(char *iniFile)
     int status;
     int nFilesOpen;
 
+    double start = dxp_wait_now();
+
     /* We need to clear and re-initialize Handel */
     status = xiaInitHandel();
 
@@ -145,6 +149,8 @@ HANDEL_EXPORT int HANDEL_API xiaInit(char *iniFile)
         return status;
     }
 
+    dxp_stats_since("startup", "init", start, 0.0);
+
     return XIA_SUCCESS;
 }
 
@@ -131,6 +131,18 @@ HANDEL_IMPORT int HANDEL_API xiaCloseLog(void);
 
 HANDEL_IMPORT int HANDEL_API xiaSetIOPriority(int pri);
 
+HANDEL_IMPORT int HANDEL_API xiaSetWaitStrategy(double spin, double initial,
+												double maximum);
+HANDEL_IMPORT int HANDEL_API xiaSetWaitTimeout(char *op, double timeout);
+HANDEL_IMPORT int HANDEL_API xiaSetMdWaitSpin(double spin);
+HANDEL_IMPORT int HANDEL_API xiaGetTimingStatistics(char *group, char *name,
+													double *stats);
+HANDEL_IMPORT int HANDEL_API xiaGetTimingPoint(int point, char *group,
+											   char *name, double *stats);
+HANDEL_IMPORT int HANDEL_API xiaResetTimingStatistics(char *group);
+HANDEL_IMPORT int HANDEL_API xiaSetLazySetup(char *file);
+HANDEL_IMPORT int HANDEL_API xiaSetWarmRestart(char *file);
+
 HANDEL_IMPORT void HANDEL_API xiaGetVersionInfo(int *rel, int *min, int *maj,
 												  char *pretty);
 
@@ -205,6 +217,15 @@ HANDEL_IMPORT int HANDEL_API xiaCloseLog();
 
 HANDEL_IMPORT int HANDEL_API xiaSetIOPriority();
 
+HANDEL_IMPORT int HANDEL_API xiaSetWaitStrategy();
+HANDEL_IMPORT int HANDEL_API xiaSetWaitTimeout();
+HANDEL_IMPORT int HANDEL_API xiaSetMdWaitSpin();
+HANDEL_IMPORT int HANDEL_API xiaGetTimingStatistics();
+HANDEL_IMPORT int HANDEL_API xiaGetTimingPoint();
+HANDEL_IMPORT int HANDEL_API xiaResetTimingStatistics();
+HANDEL_IMPORT int HANDEL_API xiaSetLazySetup();
+HANDEL_IMPORT int HANDEL_API xiaSetWarmRestart();
+
 HANDEL_IMPORT void HANDEL_API xiaGetVersionInfo();
 HANDEL_IMPORT char* HANDEL_API xiaGetErrorText();
 
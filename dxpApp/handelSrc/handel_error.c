@@ -345,6 +345,8 @@ const char* xiaGetXerxesErrorText(int errorcode)
         case DXP_NULL               : return "Parameter cannot be NULL"; break;
         case DXP_MALFORMED_FILE     : return "Malformed firmware file"; break;
         case DXP_UNKNOWN_CT         : return "Unknown control task"; break;
+        case DXP_BAD_WAIT           : return "Invalid wait strategy or operation"; break;
+        case DXP_UNKNOWN_POINT      : return "Unknown timing statistics point"; break;
 
         /* Host machine error codes 4401-4500 */
         case DXP_NOMEM             : return "Error allocating memory"; break;
@@ -53,6 +53,9 @@
 #include "handel_file.h"
 #include "handel_log.h"
 
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
+
 
 typedef int (*interfaceWrite_FP)(FILE *, Module *);
 
@@ -74,6 +77,9 @@ static int writeInterface(FILE *fp, Module *m);
 
 static char line[XIA_LINE_LEN];
 
+/* Output buffer for xiaWriteIniFile() */
+static char iniBuffer[65536];
+
 HANDEL_STATIC int HANDEL_API xiaGetLine_N(FILE *fp, char *lline, int len);
 HANDEL_STATIC int HANDEL_API xiaGetLine(FILE *fp, char *line);
 
@@ -202,6 +208,11 @@ HANDEL_STATIC int HANDEL_API xiaWriteIniFile(char *filename)
         return status;
     }
 
+    /* Use a large buffer so that the whole file is written with a few large
+     * writes rather than many small ones, which is slow on network file systems.
+     */
+    setvbuf(iniFile, iniBuffer, _IOFBF, sizeof(iniBuffer));
+
     /* Write the sections in the same order that they are read in */
     fprintf(iniFile, "[detector definitions]\n\n");
 
@@ -375,21 +386,23 @@ HANDEL_SHARED int HANDEL_API xiaReadIniFile(char *inifile)
     int status = XIA_SUCCESS;
     int numSections;
     int i;
+    int j;
+    int k;
 
     /*
      * Pointers to keep track of the xia.ini file
      */
     FILE *fp = NULL;
 
-    char tmpLine[XIA_LINE_LEN];
+    IniFile ini;
 
-    fpos_t start;
-    fpos_t end;
-    fpos_t local;
-    fpos_t local_end;
+    int start;
+    int end;
 
     char xiaini[8] = "xia.ini";
 
+    double startTime = dxp_wait_now();
+
     /* Check if an .INI file was specified */
     if (inifile == NULL) {
         inifile = xiaini;
@@ -408,13 +421,22 @@ HANDEL_SHARED int HANDEL_API xiaReadIniFile(char *inifile)
         return status;
     }
 
+    /* Read the whole file once, the sections are then loaded from memory. */
+    status = xiaParseIniFile(fp, &ini);
+
+    xia_file_close(fp);
+
+    if (status != XIA_SUCCESS) {
+        xiaFreeIniFile(&ini);
+        xiaLogError("xiaReadIniFile", "Error parsing ini file", status);
+        return status;
+    }
+
     /* Loop over all the sections as defined in sectionInfo */
-    /* XXX BUG: Should be sectionInfo / sectionInfo[0]?
-     */
     numSections = (int) (sizeof(sectionInfo) / sizeof(SectionInfo));
 
     for (i = 0; i < numSections; i++) {
-        status = xiaFindEntryLimits(fp, sectionInfo[i].section, &start, &end);
+        status = xiaFindSection(&ini, sectionInfo[i].section, &start, &end);
 
         if (status != XIA_SUCCESS) {
             sprintf(info_string, "Section missing from ini file: %s", sectionInfo[i].section);
@@ -422,98 +444,41 @@ HANDEL_SHARED int HANDEL_API xiaReadIniFile(char *inifile)
             continue;
         }
 
-        /* Here is the psuedocode for parsing in a section w/ multiple headings
-         *
-         * 1) Set local to line with START on it (this is a one shot thing)
-         * 2) Cache line pointed to by "end" (this is because we can't do direct
-         *    arithmetic comparisons with fpos_t structs). Also, actually do a
-         *    comparison between local's "line" and the end's "line". If they
-         *    match then we've reached the end of the section and are finished.
-         *    N.b.: I pray to god that a situation never somes up that would
-         *    break this comparison. In principle it shouldn't happen since
-         *    end's "line" is either EOF or a section heading.
-         * 3) Increment local until we run into END
-         * 4) Set local_end
-         * 5) xiaLoadxxxxx(local, local_end);
-         * 6) Set current to local_end and jump to step (2)
+        /* Load each START/END block in the section. The loaders are passed the
+         * lines between START and END.
          */
+        for (j = start; j < end; j++) {
+            if (ini.lines[j].type != XIA_INI_START) {
+                continue;
+            }
 
-        status = fsetpos(fp, &end);
-
-        if (status != 0) {
-            sprintf(info_string, "Error setting file position to the end of "
-                    "the current section. errno = %d, '%s'.", (int)errno,
-                    strerror(errno));
-            xiaLogError("xiaReadIniFile", info_string, XIA_SET_POS);
-            return XIA_SET_POS;
-        }
-
-        status = xiaGetLine(fp, tmpLine);
-
-        if (status != XIA_SUCCESS && status != XIA_EOF) {
-            xiaLogError("xiaReadIniFile", "Error getting end of section line "
-                        "after setting the file position.", status);
-            return status;
-        }
-
-        ASSERT(tmpLine[0] == '[');
-
-        sprintf(info_string, "Cached end string = %s", tmpLine);
-        xiaLogDebug("xiaReadIniFile", info_string);
-
-        status = fsetpos(fp, &start);
-
-        if (status != 0) {
-            sprintf(info_string, "Error setting file position to the end of "
-                    "the current section. errno = %d, '%s'.", (int)errno,
-                    strerror(errno));
-            xiaLogError("xiaReadIniFile", info_string, XIA_SET_POS);
-            return XIA_SET_POS;
-        }
-
-        status = xiaGetLine(fp, line);
-
-        if (status != XIA_SUCCESS && status != XIA_EOF) {
-            xiaLogError("xiaReadIniFile", "Error getting start of section line "
-                        "after setting the file position.", status);
-            return status;
-        }
-
-        while(!STREQ(line, tmpLine)) {
-            status = fgetpos(fp, &local);
-
-            if (strncmp(line, "START", 5) == 0) {
-                do {
-                    status = fgetpos(fp, &local_end);
-
-                    status = xiaGetLine(fp, line);
-
-                    sprintf(info_string, "Inside START/END bracket: %s", line);
-                    xiaLogDebug("xiaReadIniFile", info_string);
-
-                } while (strncmp(line, "END", 3) != 0);
-
-                status = sectionInfo[i].function_ptr(fp, &local, &local_end);
+            for (k = j + 1; k < end && ini.lines[k].type != XIA_INI_END; k++) {
+                /* Do nothing */
+            }
 
-                if (status != XIA_SUCCESS) {
-                    xia_file_close(fp);
-                    xiaLogError("xiaReadIniFile", "Error loading information from ini file", status);
-                    return status;
-                }
+            if (k == end) {
+                xiaFreeIniFile(&ini);
+                sprintf(info_string, "Missing END in section %s", sectionInfo[i].section);
+                xiaLogError("xiaReadIniFile", info_string, XIA_FORMAT_ERROR);
+                return XIA_FORMAT_ERROR;
             }
 
-            status = xiaGetLine(fp, line);
+            status = sectionInfo[i].function_ptr(&ini, j + 1, k);
 
-            if (status == XIA_EOF) {
-                break;
+            if (status != XIA_SUCCESS) {
+                xiaFreeIniFile(&ini);
+                xiaLogError("xiaReadIniFile", "Error loading information from ini file", status);
+                return status;
             }
 
-            sprintf(info_string, "Looking for START: %s", line);
-            xiaLogDebug("xiaReadIniFile", info_string);
+            j = k;
         }
     }
 
-    xia_file_close(fp);
+    xiaFreeIniFile(&ini);
+
+    dxp_stats_since("startup", "ini_file", startTime, 0.0);
+
     xiaLogInfo("xiaReadIniFile", "Successfully read ini file.");
 
     return XIA_SUCCESS;
@@ -683,86 +648,248 @@ HANDEL_STATIC int HANDEL_API xiaGetLine_N(FILE *fp, char *lline, int llen)
 }
 
 /*
- * Searches thru the .ini file and finds the start and end of a
- * specific section of the .ini file starting at [section] and ending at the
- * next [].
+ * Finds the lines of a specific section of the parsed .ini file, starting
+ * after [section] and ending at the next [] or the end of the file. As
+ * always, a heading matches if its name is a prefix of section.
  */
-HANDEL_STATIC int HANDEL_API xiaFindEntryLimits(FILE *fp, const char *section, fpos_t *start, fpos_t *end)
+HANDEL_STATIC int HANDEL_API xiaFindSection(IniFile *ini, const char *section, int *start, int *end)
 {
-    int status = XIA_SUCCESS;
-    unsigned int j;
+    int i;
 
-    boolean_t isStartFound = FALSE_;
 
-    char *cstatus;
+    for (i = 0; i < ini->numLines; i++)
+    {
+        if (ini->lines[i].type == XIA_INI_SECTION &&
+            strncmp(ini->lines[i].name, section,
+                    strlen(ini->lines[i].name)) == 0)
+        {
+            break;
+        }
+    }
 
-    /* Zero the start and end variables */
-    /*	*start=*end=0; */
+    if (i == ini->numLines)
+    {
+        sprintf(info_string, "Unable to find section %s", section);
+        /* This isn't an error since the user has the option of specifying the missing
+         * information using the dynamic configuration routines.
+         */
+        xiaLogWarning("xiaFindSection", info_string);
+        return XIA_NOSECTION;
+    }
 
-    /* First rewind the file to the beginning */
-    rewind(fp);
+    *start = ++i;
 
-    /* Now fine the match to the section entry */
-    do {
-        do {
-            cstatus = handel_md_fgets(line, XIA_LINE_LEN, fp);
+    while (i < ini->numLines && ini->lines[i].type != XIA_INI_SECTION)
+    {
+        i++;
+    }
+
+    *end = i;
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Copies str into memory allocated with handel_md_alloc().
+ */
+static char *xiaIniStrdup(const char *str)
+{
+    size_t len = strlen(str) + 1;
 
-        } while ((line[0]!='[') &&
-                 (cstatus!=NULL));
+    char *copy = (char *)handel_md_alloc(len);
 
-        if (cstatus == NULL)
+    if (copy != NULL)
+    {
+        strcpy(copy, str);
+    }
+
+    return copy;
+}
+
+
+/*
+ * Reads fp in a single pass and splits it into lines of type section
+ * heading, START, END, comment or name = value entry, so that the
+ * sections can be loaded without re-reading the file.
+ */
+HANDEL_STATIC int HANDEL_API xiaParseIniFile(FILE *fp, IniFile *ini)
+{
+    int status;
+    int maxLines = 0;
+
+    size_t j;
+
+    IniLine *lines = NULL;
+    IniLine *cur   = NULL;
+
+
+    ini->lines    = NULL;
+    ini->numLines = 0;
+
+    while ((status = xiaGetLine(fp, line)) == XIA_SUCCESS)
+    {
+        if (ini->numLines == maxLines)
         {
-            status = XIA_NOSECTION;
-            sprintf(info_string,"Unable to find section %s",section);
-            /* This isn't an error since the user has the option of specifying the missing
-             * information using the dynamic configuration routines.
-             */
-            xiaLogWarning("xiaFindEntryLimits", info_string);
-            return status;
+            maxLines = maxLines ? 2 * maxLines : 256;
+            lines = (IniLine *)handel_md_alloc(maxLines * sizeof(IniLine));
+
+            if (lines == NULL)
+            {
+                sprintf(info_string, "Error allocating %zu bytes for the .ini file lines",
+                        maxLines * sizeof(IniLine));
+                xiaLogError("xiaParseIniFile", info_string, XIA_NOMEM);
+                return XIA_NOMEM;
+            }
+
+            if (ini->lines != NULL)
+            {
+                memcpy(lines, ini->lines, ini->numLines * sizeof(IniLine));
+                handel_md_free(ini->lines);
+            }
+
+            ini->lines = lines;
         }
 
-        /* Find the terminating ] to this section */
-        for (j = 1; j < (unsigned int)strlen(line) + 1; j++)
+        cur = &(ini->lines[ini->numLines]);
+        cur->name  = NULL;
+        cur->value = NULL;
+        cur->text  = NULL;
+
+        if (line[0] == '[')
         {
-            if (line[j]==']')
+            /* Find the terminating ] to this section */
+            for (j = 1; line[j] != '\0' && line[j] != ']'; j++)
             {
-                break;
+                /* Do nothing */
+            }
+
+            if (line[j] != ']')
+            {
+                sprintf(info_string,"Syntax error in Init file, no terminating ] found");
+                xiaLogError("xiaParseIniFile", info_string, XIA_FORMAT_ERROR);
+                return XIA_FORMAT_ERROR;
+            }
+
+            line[j] = '\0';
+            cur->type = XIA_INI_SECTION;
+            cur->name = xiaIniStrdup(line + 1);
+
+        } else if (strncmp(line, "START", 5) == 0) {
+
+            cur->type = XIA_INI_START;
+
+        } else if (strncmp(line, "END", 3) == 0) {
+
+            cur->type = XIA_INI_END;
+
+        } else if (line[0] == '*') {
+
+            cur->type = XIA_INI_COMMENT;
+
+        } else {
+
+            /* The name and value are split out when the entry is first
+             * looked up, so that lines the loaders never read are not
+             * checked, as when the file was read line by line.
+             */
+            cur->type = XIA_INI_ENTRY;
+            cur->text = xiaIniStrdup(line);
+
+            if (cur->text == NULL)
+            {
+                ini->numLines++;
+                xiaLogError("xiaParseIniFile", "Error allocating memory for an "
+                            ".ini file entry", XIA_NOMEM);
+                return XIA_NOMEM;
             }
         }
-        /* Did we not find the terminating ]? */
-        if (j == (unsigned int)strlen(line))
+
+        ini->numLines++;
+    }
+
+    if (status != XIA_EOF)
+    {
+        return status;
+    }
+
+    sprintf(info_string, "Parsed %d lines from the .ini file", ini->numLines);
+    xiaLogDebug("xiaParseIniFile", info_string);
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Frees the memory allocated by xiaParseIniFile().
+ */
+HANDEL_STATIC void HANDEL_API xiaFreeIniFile(IniFile *ini)
+{
+    int i;
+
+
+    for (i = 0; i < ini->numLines; i++)
+    {
+        if (ini->lines[i].name != NULL)
         {
-            status = XIA_FORMAT_ERROR;
-            sprintf(info_string,"Syntax error in Init file, no terminating ] found");
-            xiaLogError("xiaFindEntryLimits", info_string, status);
-            return status;
+            handel_md_free(ini->lines[i].name);
         }
 
-        if (strncmp(line + 1, section, j - 1) == 0)
+        if (ini->lines[i].value != NULL)
         {
-            /* Recorcd the starting position) */
-            fgetpos(fp, start);
+            handel_md_free(ini->lines[i].value);
+        }
 
-            isStartFound = TRUE_;
+        if (ini->lines[i].text != NULL)
+        {
+            handel_md_free(ini->lines[i].text);
         }
-        /* Else look for the next section entry */
-    } while (!isStartFound);
+    }
 
-    do
+    if (ini->lines != NULL)
     {
-        /* Get the current file position before the next read.  If the file
-         * ends or we find a '[' then we are done and want to sent the ending
-         * position to the location of the previous read
-         */
-        status = fgetpos(fp, end);
+        handel_md_free(ini->lines);
+    }
+
+    ini->lines    = NULL;
+    ini->numLines = 0;
+}
+
+
+/*
+ * Splits an XIA_INI_ENTRY line into its name and value, if that has not
+ * been done already.
+ */
+HANDEL_STATIC int HANDEL_API xiaParseIniEntry(IniLine *iniLine)
+{
+    int status;
+
+    char tmpName[XIA_LINE_LEN];
+    char tmpValue[XIA_LINE_LEN];
+
+
+    ASSERT(iniLine->type == XIA_INI_ENTRY);
+
+    if (iniLine->name != NULL)
+    {
+        return XIA_SUCCESS;
+    }
 
-        cstatus = handel_md_fgets(line, XIA_LINE_LEN, fp);
+    status = xiaGetLineData(iniLine->text, tmpName, tmpValue);
 
-    } while ((line[0] != '[') &&
-             (cstatus != NULL));
+    if (status != XIA_SUCCESS)
+    {
+        return status;
+    }
 
-    if (!cstatus) {
-        ASSERT(feof(fp));
+    iniLine->name  = xiaIniStrdup(tmpName);
+    iniLine->value = xiaIniStrdup(tmpValue);
+
+    if (iniLine->name == NULL || iniLine->value == NULL)
+    {
+        xiaLogError("xiaParseIniEntry", "Error allocating memory for an "
+                    ".ini file entry", XIA_NOMEM);
+        return XIA_NOMEM;
     }
 
     return XIA_SUCCESS;
@@ -770,11 +897,11 @@ HANDEL_STATIC int HANDEL_API xiaFindEntryLimits(FILE *fp, const char *section, f
 
 
 /*
- * Parses data in from fp (and bounded by start & end) as
+ * Parses the entries of ini (between lines start & end) as
  * detector information. If it fails, then it fails hard and the user needs
  * to fix their inifile.
  */
-HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
+HANDEL_STATIC int xiaLoadDetector(IniFile *ini, int start, int end)
 {
     int status;
 
@@ -795,7 +922,7 @@ HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
      * 3) rest of the detector information
      */
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(ini, start, end, "alias", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -816,7 +943,7 @@ HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "number_of_channels", value);
+    status = xiaFileRA(ini, start, end, "number_of_channels", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -838,7 +965,7 @@ HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "type", value);
+    status = xiaFileRA(ini, start, end, "type", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -856,7 +983,7 @@ HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "type_value", value);
+    status = xiaFileRA(ini, start, end, "type_value", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -879,7 +1006,7 @@ HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
     for (i = 0; i < numChans; i++)
     {
         sprintf(name, "channel%hu_gain", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(ini, start, end, name, value);
 
         if (status == XIA_FILE_RA)
         {
@@ -910,7 +1037,7 @@ HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
         }
 
         sprintf(name, "channel%hu_polarity", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(ini, start, end, name, value);
 
         if (status == XIA_FILE_RA)
         {
@@ -946,11 +1073,11 @@ HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end)
 
 
 /*
- * Parses data in from fp (and bounded by start & end) as
+ * Parses the entries of ini (between lines start & end) as
  * module information. If it fails, then it fails hard and the user needs
  * to fix their inifile.
  */
-HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
+HANDEL_STATIC int xiaLoadModule(IniFile *ini, int start, int end)
 {
     int status;
     int chanAlias;
@@ -980,7 +1107,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
     char firmAlias[MAXALIAS_LEN];
     char defAlias[MAXALIAS_LEN];
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(ini, start, end, "alias", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -1001,7 +1128,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "module_type", value);
+    status = xiaFileRA(ini, start, end, "module_type", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -1023,7 +1150,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
         return status;
     }
 
-    status = xiaFileRA(fp, start, end, "number_of_channels", value);
+    status = xiaFileRA(ini, start, end, "number_of_channels", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -1046,7 +1173,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
     }
 
     /* Deal with interface here */
-    status = xiaFileRA(fp, start, end, "interface", value);
+    status = xiaFileRA(ini, start, end, "interface", value);
 
     sscanf(value, "%s", interface);
 
@@ -1071,7 +1198,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "scsibus_number", value);
+        status = xiaFileRA(ini, start, end, "scsibus_number", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1093,7 +1220,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "crate_number", value);
+        status = xiaFileRA(ini, start, end, "crate_number", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1115,7 +1242,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "slot", value);
+        status = xiaFileRA(ini, start, end, "slot", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1140,7 +1267,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
     } else if ((STREQ(interface, "epp")) ||
                (STREQ(interface, "genericEPP")))
     {
-        status = xiaFileRA(fp, start, end, "epp_address", value);
+        status = xiaFileRA(ini, start, end, "epp_address", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1162,7 +1289,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "daisy_chain_id", value);
+        status = xiaFileRA(ini, start, end, "daisy_chain_id", value);
 
         /* This is an extremely optional setting, so we really only want to do
          * anything if the value actually shows up in the section.
@@ -1195,7 +1322,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "device_number", value);
+        status = xiaFileRA(ini, start, end, "device_number", value);
 
         if (status != XIA_SUCCESS) {
 
@@ -1228,7 +1355,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "device_number", value);
+        status = xiaFileRA(ini, start, end, "device_number", value);
 
         if (status != XIA_SUCCESS) {
 
@@ -1252,7 +1379,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
 
     } else if (STREQ(interface, "pxi")) {
 
-        status = xiaFileRA(fp, start, end, "pci_slot", value);
+        status = xiaFileRA(ini, start, end, "pci_slot", value);
 
         if (status != XIA_SUCCESS) {
             xiaLogError("xiaLoadModule", "Unable to load 'pci_slot'", status);
@@ -1274,7 +1401,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "pci_bus", value);
+        status = xiaFileRA(ini, start, end, "pci_bus", value);
 
         if (status != XIA_SUCCESS) {
             xiaLogError("xiaLoadModule", "Unable to load 'pci_bus'", status);
@@ -1298,7 +1425,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
 
     } else if (STREQ(interface, "serial")) {
 
-        status = xiaFileRA(fp, start, end, "com_port", value);
+        status = xiaFileRA(ini, start, end, "com_port", value);
 
         if (status == XIA_SUCCESS) {
             sscanf(value, "%u", &comPort);
@@ -1315,7 +1442,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             }
         }
         else {
-            status = xiaFileRA(fp, start, end, "device_file", value);
+            status = xiaFileRA(ini, start, end, "device_file", value);
 
             if (status != XIA_SUCCESS) {
                 xiaLogError("xiaLoadModule", "Unable to load COM port or device_file", status);
@@ -1335,7 +1462,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
             }
         }
 
-        status = xiaFileRA(fp, start, end, "baud_rate", value);
+        status = xiaFileRA(ini, start, end, "baud_rate", value);
 
         if (status != XIA_SUCCESS) {
             xiaLogError("xiaLoadModule", "Unable to load baud rate", status);
@@ -1365,7 +1492,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
 
     for (i = 0; i < numChans; i++) {
         sprintf(name, "channel%u_alias", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(ini, start, end, name, value);
 
         if (status != XIA_SUCCESS) {
             sprintf(info_string, "Unable to load %s from %s", name, alias);
@@ -1387,7 +1514,7 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
         }
 
         sprintf(name, "channel%u_detector", i);
-        status = xiaFileRA(fp, start, end, name, value);
+        status = xiaFileRA(ini, start, end, name, value);
 
         if (status == XIA_FILE_RA) {
             sprintf(info_string, "Current configuration file missing %s", name);
@@ -1419,14 +1546,14 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
      * and defaults. Check for *_all first and if that isn't found then
      * try and find ones for individual channels.
      */
-    status = xiaFileRA(fp, start, end, "firmware_set_all", value);
+    status = xiaFileRA(ini, start, end, "firmware_set_all", value);
 
     if (status != XIA_SUCCESS)
     {
         for (i = 0; i < numChans; i++)
         {
             sprintf(name, "firmware_set_chan%u", i);
-            status = xiaFileRA(fp, start, end, name, value);
+            status = xiaFileRA(ini, start, end, name, value);
 
             if (status == XIA_FILE_RA)
             {
@@ -1471,14 +1598,14 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
         }
     }
 
-    status = xiaFileRA(fp, start, end, "default_all", value);
+    status = xiaFileRA(ini, start, end, "default_all", value);
 
     if (status != XIA_SUCCESS)
     {
         for (i = 0; i < numChans; i++)
         {
             sprintf(name, "default_chan%u", i);
-            status = xiaFileRA(fp, start, end, name, value);
+            status = xiaFileRA(ini, start, end, name, value);
 
             if (status == XIA_FILE_RA)
             {
@@ -1529,11 +1656,11 @@ HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end)
 
 
 /*
- * Parses data in from fp (and bounded by start & end) as
+ * Parses the entries of ini (between lines start & end) as
  * firmware information. If it fails, then it fails hard and the user needs
  * to fix their inifile.
  */
-HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
+HANDEL_STATIC int xiaLoadFirmware(IniFile *ini, int start, int end)
 {
     int status;
 
@@ -1550,7 +1677,7 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
      */
     char keyword[10];
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(ini, start, end, "alias", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -1572,7 +1699,7 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
     }
 
     /* Check for an MMU first since we'll be exiting if we find a filename */
-    status = xiaFileRA(fp, start, end, "mmu", value);
+    status = xiaFileRA(ini, start, end, "mmu", value);
 
     if (status == XIA_SUCCESS)
     {
@@ -1591,7 +1718,7 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
     }
 
     /* If we find a filename, then we are done and can return */
-    status = xiaFileRA(fp, start, end, "filename", value);
+    status = xiaFileRA(ini, start, end, "filename", value);
 
     if (status == XIA_SUCCESS)
     {
@@ -1608,7 +1735,7 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
             return status;
         }
 
-        status = xiaFileRA(fp, start, end, "fdd_tmp_path", value);
+        status = xiaFileRA(ini, start, end, "fdd_tmp_path", value);
 
         if (status == XIA_SUCCESS) {
             strcpy(path, value);
@@ -1625,7 +1752,7 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
         /* Check for keywords, if any...no need to really warn since the most
          * important "keywords" are generated by Handel.
          */
-        status = xiaFileRA(fp, start, end, "num_keywords", value);
+        status = xiaFileRA(ini, start, end, "num_keywords", value);
 
         if (status == XIA_SUCCESS)
         {
@@ -1636,7 +1763,7 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
             for (i = 0; i < numKeywords; i++)
             {
                 sprintf(keyword, "keyword%hu", i);
-                status = xiaFileRA(fp, start, end, keyword, value);
+                status = xiaFileRA(ini, start, end, keyword, value);
 
                 if (status != XIA_SUCCESS)
                 {
@@ -1664,7 +1791,7 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
     /* Need to be a little careful here about how we parse in the PTRR chunks.
      * Start slowly by getting the number of PTRRs first.
      */
-    status = xiaReadPTRRs(fp, start, end, alias);
+    status = xiaReadPTRRs(ini, start, end, alias);
 
     if (status != XIA_SUCCESS)
     {
@@ -1680,23 +1807,22 @@ HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end)
 /*
  * Parses in the information specified in the defaults definitions.
  */
-HANDEL_STATIC int xiaLoadDefaults(FILE *fp, fpos_t *start, fpos_t *end)
+HANDEL_STATIC int xiaLoadDefaults(IniFile *ini, int start, int end)
 {
     int status;
 
+    int i;
+    int dataStart;
+
     char value[MAXITEM_LEN];
     char alias[MAXALIAS_LEN];
-    char tmpName[MAXITEM_LEN];
-    char tmpValue[MAXITEM_LEN];
-    char endLine[XIA_LINE_LEN];
-    char currentLine[XIA_LINE_LEN];
 
-    double defValue;
+    char *tmpName;
 
-    fpos_t dataStart;
+    double defValue;
 
 
-    status = xiaFileRA(fp, start, end, "alias", value);
+    status = xiaFileRA(ini, start, end, "alias", value);
 
     if (status != XIA_SUCCESS)
     {
@@ -1717,30 +1843,27 @@ HANDEL_STATIC int xiaLoadDefaults(FILE *fp, fpos_t *start, fpos_t *end)
         return status;
     }
 
-    /* Want a position after the alias line so that we can just read in line-
-     * by-line until we reach endLine
+    /* Want a position after the alias line so that we can just read in
+     * entry-by-entry until we reach the end
      */
-    xiaSetPosOnNext(fp, start, end, "alias", &dataStart, TRUE_);
+    xiaSetPosOnNext(ini, start, end, "alias", &dataStart, TRUE_);
 
-    fsetpos(fp, end);
-    status = xiaGetLine(fp, endLine);
-
-    fsetpos(fp, &dataStart);
-    status = xiaGetLine(fp, currentLine);
-
-    while (!STREQ(currentLine, endLine))
+    for (i = dataStart; i < end; i++)
     {
-        status = xiaGetLineData(currentLine, tmpName, tmpValue);
-        if (status != XIA_SUCCESS)
+        if (ini->lines[i].type == XIA_INI_ENTRY)
         {
-            sprintf(info_string, "Error getting data for entry %s", tmpName);
-            xiaLogError("xiaLoadDefaults", info_string, status);
-            return status;
-        }
+            status = xiaParseIniEntry(&(ini->lines[i]));
 
-        if (!STREQ(tmpName, "COMMENT"))
-        {
-            sscanf(tmpValue, "%lf", &defValue);
+            if (status != XIA_SUCCESS)
+            {
+                sprintf(info_string, "Error getting data for entry %s",
+                        ini->lines[i].text);
+                xiaLogError("xiaLoadDefaults", info_string, status);
+                return status;
+            }
+
+            tmpName = ini->lines[i].name;
+            sscanf(ini->lines[i].value, "%lf", &defValue);
 
             status = xiaAddDefaultItem(alias, tmpName, (void *)&defValue);
 
@@ -1755,8 +1878,6 @@ HANDEL_STATIC int xiaLoadDefaults(FILE *fp, fpos_t *start, fpos_t *end)
             sprintf(info_string, "Added %s (value = %.3f) to alias %s", tmpName, defValue, alias);
             xiaLogDebug("xiaLoadDefaults", info_string);
         }
-
-        status = xiaGetLine(fp, currentLine);
     }
 
     return XIA_SUCCESS;
@@ -1770,7 +1891,7 @@ HANDEL_STATIC int xiaLoadDefaults(FILE *fp, fpos_t *start, fpos_t *end)
  *
  * (*) -- Actually, it will read in the number specified by number_of_ptrrs.
  */
-HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end, char *alias)
+HANDEL_STATIC int HANDEL_API xiaReadPTRRs(IniFile *ini, int start, int end, char *alias)
 {
     int status;
 
@@ -1786,9 +1907,9 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
     char filterName[14];
     char value[MAXITEM_LEN];
 
-    fpos_t newStart;
-    fpos_t newEnd;
-    fpos_t lookAheadStart;
+    int newStart;
+    int newEnd;
+    int lookAheadStart;
 
     boolean_t isLast = FALSE_;
 
@@ -1796,14 +1917,14 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
     xiaLogDebug("xiaReadPTRRs", "Starting parse of PTRRs");
 
     /* This assumes that there is at least one PTRR for a specified alias */
-    newEnd = *start;
+    newEnd = start;
     while (!isLast)
     {
-        xiaSetPosOnNext(fp, &newEnd, end, "ptrr", &lookAheadStart, TRUE_);
-        xiaSetPosOnNext(fp, &newEnd, end, "ptrr", &newStart, FALSE_);
+        xiaSetPosOnNext(ini, newEnd, end, "ptrr", &lookAheadStart, TRUE_);
+        xiaSetPosOnNext(ini, newEnd, end, "ptrr", &newStart, FALSE_);
 
         /* Find the end here: either the END or another ptrr */
-        status = xiaSetPosOnNext(fp, &lookAheadStart, end, "ptrr", &newEnd, FALSE_);
+        status = xiaSetPosOnNext(ini, lookAheadStart, end, "ptrr", &newEnd, FALSE_);
 
         if (status == XIA_END)
         {
@@ -1811,7 +1932,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
         }
 
         /* Do the actual actions here */
-        status = xiaFileRA(fp, &newStart, &newEnd, "ptrr", value);
+        status = xiaFileRA(ini, newStart, newEnd, "ptrr", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1833,7 +1954,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "min_peaking_time", value);
+        status = xiaFileRA(ini, newStart, newEnd, "min_peaking_time", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1853,7 +1974,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "max_peaking_time", value);
+        status = xiaFileRA(ini, newStart, newEnd, "max_peaking_time", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1873,7 +1994,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "fippi", value);
+        status = xiaFileRA(ini, newStart, newEnd, "fippi", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1891,7 +2012,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "dsp", value);
+        status = xiaFileRA(ini, newStart, newEnd, "dsp", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1910,7 +2031,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
         }
 
         /* Check for the quite optional "user_fippi"... */
-        status = xiaFileRA(fp, &newStart, &newEnd, "user_fippi", value);
+        status = xiaFileRA(ini, newStart, newEnd, "user_fippi", value);
 
         if (status == XIA_SUCCESS)
         {
@@ -1934,7 +2055,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
             return status;
         }
 
-        status = xiaFileRA(fp, &newStart, &newEnd, "num_filter", value);
+        status = xiaFileRA(ini, newStart, newEnd, "num_filter", value);
 
         if (status != XIA_SUCCESS)
         {
@@ -1951,7 +2072,7 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
         for (i = 0; i < numFilter; i++)
         {
             sprintf(filterName, "filter_info%hu", i);
-            status = xiaFileRA(fp, &newStart, &newEnd, filterName, value);
+            status = xiaFileRA(ini, newStart, newEnd, filterName, value);
 
             if (status != XIA_SUCCESS)
             {
@@ -1982,40 +2103,25 @@ HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end,
 
 
 /*
- * This routine searches between start and end for name. If it finds a name,
- * it sets newPos to that location. If not, it returns a value of XIA_END
- * and sets newPos to end. There are a couple of important caveats here:
- * You can't use fpos_t pointers in direct arithmetic comparisons. They just
- * don't work that way. Instead, I set the file to the position and then read
- * a line from the file. This line serves as the "unique" identifier from
- * which all future comparisons are done. There is a finite probability that
- * the same string may appear elsewhere in the file. Hopefully the same string
- * won't appear twice between start and end.
+ * This routine searches the entries between start and end for name. If it
+ * finds name, it sets newPos to the index of that line, or the line after it
+ * if after is true. If not, it returns a value of XIA_END and sets newPos
+ * to end.
  */
-HANDEL_STATIC int HANDEL_API xiaSetPosOnNext(FILE *fp, fpos_t *start, fpos_t *end, char *name, fpos_t *newPos, boolean_t after)
+HANDEL_STATIC int HANDEL_API xiaSetPosOnNext(IniFile *ini, int start, int end, char *name, int *newPos, boolean_t after)
 {
     int status;
+    int i;
 
-    char endLine[XIA_LINE_LEN];
-    char currentLine[XIA_LINE_LEN];
-    char tmpValue[XIA_LINE_LEN];
-    char tmpName[XIA_LINE_LEN];
-
-    fsetpos(fp, end);
-    status = xiaGetLine(fp, endLine);
-
-    fsetpos(fp, start);
-    fgetpos(fp, newPos);
-    status = xiaGetLine(fp, currentLine);
-
-    sprintf(info_string, "endLine: %s", endLine);
-    xiaLogDebug("xiaSetPosOnNext", info_string);
-    sprintf(info_string, "startLine: %s", currentLine);
-    xiaLogDebug("xiaSetPosOnNext", info_string);
 
-    while (!STREQ(currentLine, endLine))
+    for (i = start; i < end; i++)
     {
-        status = xiaGetLineData(currentLine, tmpName, tmpValue);
+        if (ini->lines[i].type != XIA_INI_ENTRY)
+        {
+            continue;
+        }
+
+        status = xiaParseIniEntry(&(ini->lines[i]));
 
         if (status != XIA_SUCCESS)
         {
@@ -2024,28 +2130,20 @@ HANDEL_STATIC int HANDEL_API xiaSetPosOnNext(FILE *fp, fpos_t *start, fpos_t *en
             return status;
         }
 
-
-        if (STREQ(name, tmpName))
+        if (STREQ(name, ini->lines[i].name))
         {
-            if (after)
-            {
-                fgetpos(fp, newPos);
-            }
+            *newPos = after ? i + 1 : i;
 
-            fsetpos(fp, newPos);
-            status = xiaGetLine(fp, currentLine);
-            sprintf(info_string, "newPos set to line: %s", currentLine);
+            sprintf(info_string, "newPos set to line %d", *newPos);
             xiaLogDebug("xiaSetPosOnNext", info_string);
 
             return XIA_SUCCESS;
         }
-
-        fgetpos(fp, newPos);
-
-        status = xiaGetLine(fp, currentLine);
     }
 
-    /* Okay, we must have made it to the end of the file */
+    /* Okay, we must have made it to the end of the block */
+    *newPos = end;
+
     return XIA_END;
 }
 
@@ -2053,30 +2151,23 @@ HANDEL_STATIC int HANDEL_API xiaSetPosOnNext(FILE *fp, fpos_t *start, fpos_t *en
 /*
  *
  * This routine will attempt to find the value from the specified name-value
- * pair. Returns XIA_FILE_RA if it couldn't find anything. It calls
- * xiaGetLine() until the name is matched or the end condition is satisfied.
+ * pair. Returns XIA_FILE_RA if it couldn't find anything between the lines
+ * start and end.
  */
-HANDEL_STATIC int HANDEL_API xiaFileRA(FILE *fp, fpos_t *start, fpos_t *end, char *name, char *value)
+HANDEL_STATIC int HANDEL_API xiaFileRA(IniFile *ini, int start, int end, char *name, char *value)
 {
     int status;
+    int i;
 
-    /* Use this to hold the "value" of value until we're sure that this is the
-     * right name and we can return.
-     */
-    char tmpValue[XIA_LINE_LEN];
-    char tmpName[XIA_LINE_LEN];
-    char endLine[XIA_LINE_LEN];
-
-
-    fsetpos(fp, end);
-    status = xiaGetLine(fp, endLine);
-
-    fsetpos(fp, start);
-    status = xiaGetLine(fp, line);
 
-    while (!STREQ(line, endLine))
+    for (i = start; i < end; i++)
     {
-        status = xiaGetLineData(line, tmpName, tmpValue);
+        if (ini->lines[i].type != XIA_INI_ENTRY)
+        {
+            continue;
+        }
+
+        status = xiaParseIniEntry(&(ini->lines[i]));
 
         if (status != XIA_SUCCESS)
         {
@@ -2085,14 +2176,12 @@ HANDEL_STATIC int HANDEL_API xiaFileRA(FILE *fp, fpos_t *start, fpos_t *end, cha
             return status;
         }
 
-        if (STREQ(name, tmpName))
+        if (STREQ(name, ini->lines[i].name))
         {
-            strcpy(value, tmpValue);
+            strcpy(value, ini->lines[i].value);
 
             return XIA_SUCCESS;
         }
-
-        status = xiaGetLine(fp, line);
     }
 
     return XIA_FILE_RA;
@@ -41,6 +41,36 @@
 #include <stdio.h>
 
 
+/* Types of the lines in a parsed .ini file */
+#define XIA_INI_SECTION  0
+#define XIA_INI_START    1
+#define XIA_INI_END      2
+#define XIA_INI_COMMENT  3
+#define XIA_INI_ENTRY    4
+
+/* A single non-blank line of an .ini file. name is the section heading
+ * for XIA_INI_SECTION. For XIA_INI_ENTRY text is the line as read, and
+ * name/value are only set once the line has been split by
+ * xiaParseIniEntry(), so lines that are never looked up are not parsed.
+ */
+typedef struct
+{
+    int type;
+    char *name;
+    char *value;
+    char *text;
+
+} IniLine;
+
+/* The .ini file as read in by xiaParseIniFile() */
+typedef struct
+{
+    IniLine *lines;
+    int numLines;
+
+} IniFile;
+
+
 /* This structure exists so that we can re-use the
  * section of the code that parses in the sections
  * of the ini files
@@ -48,7 +78,7 @@
 typedef struct
 {
     /* Pointer to the proper xiaLoadRoutine */
-    int (*function_ptr)(FILE *, fpos_t *, fpos_t *);
+    int (*function_ptr)(IniFile *, int, int);
 
     /* Section heading name: the part in brackets */
     char *section;
@@ -58,21 +88,24 @@ typedef struct
 
 HANDEL_STATIC int HANDEL_API xiaWriteIniFile(char *filename);
 
-HANDEL_STATIC int HANDEL_API xiaFindEntryLimits(FILE *fp, const char *section,
-						fpos_t *start, fpos_t *end);
+HANDEL_STATIC int HANDEL_API xiaParseIniFile(FILE *fp, IniFile *ini);
+HANDEL_STATIC void HANDEL_API xiaFreeIniFile(IniFile *ini);
+HANDEL_STATIC int HANDEL_API xiaParseIniEntry(IniLine *iniLine);
+HANDEL_STATIC int HANDEL_API xiaFindSection(IniFile *ini, const char *section,
+					    int *start, int *end);
 HANDEL_STATIC int HANDEL_API xiaGetLine(FILE *fp, char *line);
 HANDEL_STATIC int HANDEL_API xiaGetLineData(char *line, char *name, char *value);
-HANDEL_STATIC int HANDEL_API xiaFileRA(FILE *fp, fpos_t *start, fpos_t *end, char *name,
+HANDEL_STATIC int HANDEL_API xiaFileRA(IniFile *ini, int start, int end, char *name,
 				       char *value);
-HANDEL_STATIC int HANDEL_API xiaSetPosOnNext(FILE *fp, fpos_t *start, fpos_t *end,
-					     char *name, fpos_t *newPos, boolean_t after);
+HANDEL_STATIC int HANDEL_API xiaSetPosOnNext(IniFile *ini, int start, int end,
+					     char *name, int *newPos, boolean_t after);
 
-HANDEL_STATIC int xiaLoadDetector(FILE *fp, fpos_t *start, fpos_t *end);
-HANDEL_STATIC int xiaLoadModule(FILE *fp, fpos_t *start, fpos_t *end);
-HANDEL_STATIC int xiaLoadFirmware(FILE *fp, fpos_t *start, fpos_t *end);
-HANDEL_STATIC int xiaLoadDefaults(FILE *fp, fpos_t *start, fpos_t *end);
+HANDEL_STATIC int xiaLoadDetector(IniFile *ini, int start, int end);
+HANDEL_STATIC int xiaLoadModule(IniFile *ini, int start, int end);
+HANDEL_STATIC int xiaLoadFirmware(IniFile *ini, int start, int end);
+HANDEL_STATIC int xiaLoadDefaults(IniFile *ini, int start, int end);
 
-HANDEL_STATIC int HANDEL_API xiaReadPTRRs(FILE *fp, fpos_t *start, fpos_t *end, char *alias);
+HANDEL_STATIC int HANDEL_API xiaReadPTRRs(IniFile *ini, int start, int end, char *alias);
 
 
 #endif /* HANDEL_FILE_H */
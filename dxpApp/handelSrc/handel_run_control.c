@@ -48,6 +48,9 @@
 #include "handel_errors.h"
 #include "handel_log.h"
 
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
+
 
 /*
  * Starts a run on the specified detChan or detChan set. If resume is
@@ -358,6 +361,10 @@ HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char *name, void *value)
 
     Module *m = NULL;
 
+    double start;
+
+    int previous;
+
 
     elemType = xiaGetElemType((unsigned int)detChan);
 
@@ -392,7 +399,11 @@ HANDEL_EXPORT int HANDEL_API xiaGetRunData(int detChan, char *name, void *value)
          */
         ASSERT(m != NULL);
 
-        status = localFuncs.getRunData(detChan, name, value, defaults, m);
+        start    = dxp_wait_now();
+        previous = dxp_wait_set_subsystem(XERXES_WAIT_SUB_RUN_DATA);
+        status   = localFuncs.getRunData(detChan, name, value, defaults, m);
+        dxp_wait_set_subsystem(previous);
+        dxp_stats_since("xiaGetRunData", name, start, 0.0);
 
         if (status != XIA_SUCCESS)
         {
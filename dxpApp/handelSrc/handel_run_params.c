@@ -51,6 +51,9 @@
 #include "handel_errors.h"
 #include "handel_log.h"
 
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
+
 
 HANDEL_STATIC boolean_t HANDEL_API xiaIsUpperCase(char *string);
 
@@ -103,6 +106,10 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char *name, vo
 
     PSLFuncs localFuncs;
 
+    double start;
+
+    int previous;
+
 
     /* See Bug ID #66. Protect
      * against malformed name
@@ -212,10 +219,15 @@ HANDEL_EXPORT int HANDEL_API xiaSetAcquisitionValues(int detChan, char *name, vo
             }
         }
 
-        status = localFuncs.setAcquisitionValues(detChan, name, value, defaults,
-                                                 firmwareSet, currentFirmware,
-                                                 detectorType, detector,
-                                                 detector_chan, module, modChan);
+        start    = dxp_wait_now();
+        previous = dxp_wait_set_subsystem(XERXES_WAIT_SUB_ACQ_VALUES);
+        status   = localFuncs.setAcquisitionValues(detChan, name, value, defaults,
+                                                   firmwareSet, currentFirmware,
+                                                   detectorType, detector,
+                                                   detector_chan, module, modChan);
+        dxp_wait_set_subsystem(previous);
+        /* Timed by function only, the SCA names alone would fill the table */
+        dxp_stats_since("xiaSetAcquisitionValues", NULL, start, 0.0);
 
         if (status != XIA_SUCCESS) {
             sprintf(info_string, "Unable to set '%s' to %0.3f for detChan %d.",
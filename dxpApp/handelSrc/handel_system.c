@@ -48,6 +48,8 @@
 
 #include "xerxes.h"
 #include "xerxes_errors.h"
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
 
 
 /* Constants */
@@ -86,6 +88,9 @@ HANDEL_EXPORT int HANDEL_API xiaStartSystem(void)
 
     int status;
 
+    double start       = dxp_wait_now();
+    double phaseStart  = start;
+
     DetChanElement *current = NULL;
     xiaLogInfo("xiaStartSystem", "Starting system...");
 
@@ -148,7 +153,11 @@ HANDEL_EXPORT int HANDEL_API xiaStartSystem(void)
         current = getListNext(current);
     }
 
+    dxp_stats_since("startup", "validate", phaseStart, 0.0);
+
+    phaseStart = dxp_wait_now();
     status = xiaBuildXerxesConfig();
+    dxp_stats_since("startup", "xerxes_config", phaseStart, 0.0);
 
     if (status != XIA_SUCCESS) {
         xiaLogError("xiaStartSystem", "Error configuring Xerxes.", status);
@@ -163,7 +172,11 @@ HANDEL_EXPORT int HANDEL_API xiaStartSystem(void)
         return status;
     }
 
-    xiaLogInfo("xiaStartSystem", "System started successfully.");
+    dxp_stats_since("startup", "start_system", start, 0.0);
+
+    sprintf(info_string, "System started successfully in %.3f s.",
+            dxp_wait_now() - start);
+    xiaLogInfo("xiaStartSystem", info_string);
     return XIA_SUCCESS;
 }
 
@@ -889,6 +902,10 @@ HANDEL_EXPORT int HANDEL_API xiaBoardOperation(int detChan, char *name, void *va
 
     PSLFuncs localFuncs;
 
+    double start;
+
+    int previous;
+
 
     if (name == NULL) {
         xiaLogError("xiaBoardOperation", "'name' can not be NULL", XIA_NULL_NAME);
@@ -929,7 +946,11 @@ HANDEL_EXPORT int HANDEL_API xiaBoardOperation(int detChan, char *name, void *va
             return status;
         }
 
-        status = localFuncs.boardOperation(detChan, name, value, defs);
+        start    = dxp_wait_now();
+        previous = dxp_wait_set_subsystem(XERXES_WAIT_SUB_BOARD_OP);
+        status   = localFuncs.boardOperation(detChan, name, value, defs);
+        dxp_wait_set_subsystem(previous);
+        dxp_stats_since("xiaBoardOperation", name, start, 0.0);
         if (status != XIA_SUCCESS)
         {
             sprintf(info_string,
@@ -1100,6 +1121,189 @@ HANDEL_EXPORT int HANDEL_API xiaSetIOPriority(int pri)
 }
 
 
+/*
+ * Sets how Handel waits for the hardware to finish a control task (BUSY,
+ * apply, FPGA download and DSP boot). The condition is polled without
+ * sleeping for spin seconds, then with a sleep that starts at initial
+ * seconds and doubles up to maximum seconds.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetWaitStrategy(double spin, double initial,
+                                                double maximum)
+{
+    int status;
+
+
+    status = dxp_set_wait_strategy(&spin, &initial, &maximum);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error setting wait strategy: spin = %f, "
+                "initial = %f, maximum = %f", spin, initial, maximum);
+        xiaLogError("xiaSetWaitStrategy", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Overrides the timeout, in seconds, used by the hardware for the wait
+ * operation op: "busy", "apply", "fpga" or "dsp_boot". A timeout of 0
+ * restores the default.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetWaitTimeout(char *op, double timeout)
+{
+    int status;
+
+
+    if (op == NULL) {
+        xiaLogError("xiaSetWaitTimeout", "'op' may not be NULL", XIA_NULL_NAME);
+        return XIA_NULL_NAME;
+    }
+
+    status = dxp_set_wait_timeout(op, &timeout);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error setting timeout for wait operation '%s' "
+                "to %f", op, timeout);
+        xiaLogError("xiaSetWaitTimeout", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Sets how many seconds at the end of each wait in the MD layer are spun
+ * rather than slept. Spinning makes short waits more precise at the cost of
+ * CPU time. The default of 0 always sleeps.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetMdWaitSpin(double spin)
+{
+    int status;
+
+
+    status = dxp_set_md_wait_spin(&spin);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error setting MD wait spin to %f", spin);
+        xiaLogError("xiaSetMdWaitSpin", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Returns the timing statistics of the point for group and name. The groups
+ * are "wait" for the polled waits by operation ("busy", "apply", "fpga" or
+ * "dsp_boot"), "md_wait" for the time each MD wait took longer than requested
+ * by subsystem, "startup" for the startup phases ("init", "ini_file",
+ * "start_system", ...), and the Handel call or MD transfer, e.g.
+ * "xiaGetRunData" or "md_usb2", for their latency by run data name or
+ * direction. stats must have room for XERXES_NUM_STATS values, indexed by the
+ * XERXES_STAT_ constants in xerxes_generic.h. Times are in seconds. Returns
+ * DXP_UNKNOWN_POINT if nothing has been recorded for the point.
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetTimingStatistics(char *group, char *name,
+                                                    double *stats)
+{
+    if (group == NULL || name == NULL) {
+        xiaLogError("xiaGetTimingStatistics", "'group' and 'name' may not be "
+                    "NULL", XIA_NULL_NAME);
+        return XIA_NULL_NAME;
+    }
+
+    if (stats == NULL) {
+        xiaLogError("xiaGetTimingStatistics", "'stats' may not be NULL",
+                    XIA_NULL_VALUE);
+        return XIA_NULL_VALUE;
+    }
+
+    /* Points are only added when they are first recorded, so an unknown
+     * point is not logged as an error.
+     */
+    return dxp_get_stats(group, name, stats);
+}
+
+
+/*
+ * Returns the group and name of a timing statistics point and its
+ * statistics, see xiaGetTimingStatistics(). Points are numbered from 0 in
+ * the order they were first used and DXP_UNKNOWN_POINT is returned after the
+ * last one. group and name must have room for XERXES_STATS_NAME_LEN
+ * characters. If the point table fills up, the records that do not fit are
+ * counted by the last point, "stats" "dropped".
+ */
+HANDEL_EXPORT int HANDEL_API xiaGetTimingPoint(int point, char *group,
+                                               char *name, double *stats)
+{
+    if (group == NULL || name == NULL) {
+        xiaLogError("xiaGetTimingPoint", "'group' and 'name' may not be "
+                    "NULL", XIA_NULL_NAME);
+        return XIA_NULL_NAME;
+    }
+
+    if (stats == NULL) {
+        xiaLogError("xiaGetTimingPoint", "'stats' may not be NULL",
+                    XIA_NULL_VALUE);
+        return XIA_NULL_VALUE;
+    }
+
+    /* Running off the end of the points is how callers find the last one,
+     * so it is not logged as an error.
+     */
+    return dxp_get_stats_point(&point, group, name, stats);
+}
+
+
+/*
+ * Clears the timing statistics of group, or of all groups if group is NULL
+ * or "".
+ */
+HANDEL_EXPORT int HANDEL_API xiaResetTimingStatistics(char *group)
+{
+    int status;
+
+
+    status = dxp_reset_stats(group);
+
+    if (status != DXP_SUCCESS) {
+        xiaLogError("xiaResetTimingStatistics", "Error resetting timing "
+                    "statistics", status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Enables warm restarts. The firmware downloaded to each module is recorded
+ * in 'file' and on the next xiaStartSystem() modules that are still running
+ * that firmware are not downloaded again. Pass NULL or "" to always
+ * download. Must be called before xiaStartSystem().
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetWarmRestart(char *file)
+{
+    int status;
+
+
+    status = dxp_set_warm_restart(file);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error setting the firmware manifest to '%s'",
+                file);
+        xiaLogError("xiaSetWarmRestart", info_string, status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
 /*
  * Parses in a memory string of the format defined for xiaMemoryOperation().
  */
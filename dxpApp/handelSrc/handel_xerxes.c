@@ -40,6 +40,8 @@
 
 #include "xerxes.h"
 #include "xerxes_errors.h"
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
 
 #include "xia_handel.h"
 #include "xia_system.h"
@@ -52,6 +54,7 @@
 #include "handel_log.h"
 
 #include "fdd.h"
+#include "xia_file.h"
 
 
 HANDEL_STATIC int xia__GetSystemFPGAName(Module *module, char *detType,
@@ -106,6 +109,38 @@ HANDEL_STATIC int xia__GetDetStringFromDetChan(int detChan, Module *m,
 HANDEL_STATIC int xia__SetupSingleChan(Module *module, unsigned int detChan,
                                        PSLFuncs *localFuncs);
 
+HANDEL_STATIC unsigned long xia__SetupHash(Module *module, unsigned int modChan);
+HANDEL_STATIC boolean_t xia__IsSetupCurrent(Module *module, unsigned int modChan,
+                                            PSLFuncs *localFuncs);
+HANDEL_STATIC int xia__SaveSetupSnapshot(Module *module, unsigned int modChan,
+                                         PSLFuncs *localFuncs);
+HANDEL_STATIC int xia__ReadSetupSnapshots(void);
+HANDEL_STATIC int xia__WriteSetupSnapshots(void);
+HANDEL_STATIC void xia__FreeSetupSnapshots(void);
+
+
+/*
+ * The DSP parameters of a channel as they were after the last complete
+ * setup, used by the lazy setup mode. See xiaSetLazySetup().
+ */
+typedef struct _SetupSnapshot {
+    char *modAlias;
+    unsigned int modChan;
+
+    /* Hash of the configuration that the channel was set up with */
+    unsigned long hash;
+
+    unsigned short numParams;
+    unsigned short *values;
+
+    struct _SetupSnapshot *next;
+} SetupSnapshot;
+
+/* File that the snapshots are kept in, NULL if lazy setup is disabled. */
+static char *lazySetupFile = NULL;
+
+static SetupSnapshot *setupSnapshots = NULL;
+
 
 /*
  * This routine calls XerXes routines in order to build a proper XerXes
@@ -252,6 +287,49 @@ HANDEL_SHARED int HANDEL_API xiaBuildXerxesConfig(void)
 }
 
 
+/*
+ * Enables the lazy setup mode if file is not NULL or empty.
+ *
+ * In this mode xiaStartSystem() saves the DSP parameters of each channel
+ * to file after the module setup. The next time the system is started,
+ * every channel is still set up, but the module setup (the apply on the
+ * xMAP, Mercury and STJ) is skipped if, for every channel in the module,
+ * the configuration is unchanged and the DSP parameters read from the
+ * hardware match the saved values both before and after the channel
+ * setup. This is intended for restarts where the firmware is still loaded.
+ */
+HANDEL_EXPORT int HANDEL_API xiaSetLazySetup(char *file)
+{
+    if (lazySetupFile != NULL) {
+        handel_md_free(lazySetupFile);
+        lazySetupFile = NULL;
+    }
+
+    xia__FreeSetupSnapshots();
+
+    if (file == NULL || strlen(file) == 0) {
+        xiaLogInfo("xiaSetLazySetup", "Lazy setup disabled");
+        return XIA_SUCCESS;
+    }
+
+    lazySetupFile = handel_md_alloc(strlen(file) + 1);
+
+    if (lazySetupFile == NULL) {
+        sprintf(info_string, "Unable to allocate %zu bytes for 'lazySetupFile'",
+                strlen(file) + 1);
+        xiaLogError("xiaSetLazySetup", info_string, XIA_NOMEM);
+        return XIA_NOMEM;
+    }
+
+    strcpy(lazySetupFile, file);
+
+    sprintf(info_string, "Lazy setup enabled using '%s'", lazySetupFile);
+    xiaLogInfo("xiaSetLazySetup", info_string);
+
+    return XIA_SUCCESS;
+}
+
+
 /*
  * Essentially a wrapper around dxp_user_setup().
  */
@@ -262,8 +340,14 @@ HANDEL_SHARED int HANDEL_API xiaUserSetup(void)
 
     unsigned int i;
     int detChanInModule;
+    int nActive;
+    int nCurrent;
 
-    DetChanElement *chan = NULL;
+    boolean_t wasCurrent;
+
+    double start;
+
+    int previous;
 
     Module *module = NULL;
 
@@ -279,6 +363,16 @@ HANDEL_SHARED int HANDEL_API xiaUserSetup(void)
         return status;
     }
 
+    if (lazySetupFile != NULL) {
+        status = xia__ReadSetupSnapshots();
+
+        if (status != XIA_SUCCESS) {
+            sprintf(info_string, "Unable to read the setup snapshots from '%s', "
+                    "all channels will be set up.", lazySetupFile);
+            xiaLogWarning("xiaUserSetup", info_string);
+        }
+    }
+
     module = xiaGetModuleHead();
     ASSERT(module);
 
@@ -300,25 +394,51 @@ HANDEL_SHARED int HANDEL_API xiaUserSetup(void)
             return status;
         }
 
-        /* Loop on channels in the module now. */
-        chan = xiaGetDetChanHead();
+        /* Loop on channels in the module now. The module's detChan map is
+         * used directly, disabled channels are -1.
+         */
+        nActive  = 0;
+        nCurrent = 0;
 
-        while (chan != NULL) {
+        for (i = 0; i < module->number_of_channels; i++) {
+            if (module->channels[i] < 0) {
+                continue;
+            }
 
-            if (xiaGetElemType(chan->detChan) == SINGLE
-                    && STREQ(chan->data.modAlias, module->alias)) {
+            nActive++;
 
-                status = xia__SetupSingleChan(module, chan->detChan, &localFuncs);
+            /* The channel setup always runs, since it also rebuilds the
+             * PSL state in Handel, e.g. the SCA limits. Only the module
+             * setup is skipped in lazy setup mode.
+             */
+            wasCurrent = (boolean_t)(lazySetupFile != NULL &&
+                                     xia__IsSetupCurrent(module, i, &localFuncs));
 
-                if (status != XIA_SUCCESS) {
-                    sprintf(info_string, "Unable to set up channel %u for "
-                            "module alias %s.", chan->detChan, module->alias);
-                    xiaLogError("xiaUserSetup", info_string, status);
-                    return status;
-                }
+            start = dxp_wait_now();
+            previous = dxp_wait_set_subsystem(XERXES_WAIT_SUB_SETUP);
+            status = xia__SetupSingleChan(module,
+                                          (unsigned int)module->channels[i],
+                                          &localFuncs);
+            dxp_wait_set_subsystem(previous);
+            dxp_stats_since("startup", "channel_setup", start, 0.0);
+
+            if (status != XIA_SUCCESS) {
+                sprintf(info_string, "Unable to set up channel %d for "
+                        "module alias %s.", module->channels[i], module->alias);
+                xiaLogError("xiaUserSetup", info_string, status);
+                return status;
             }
 
-            chan = getListNext(chan);
+            /* The DSP parameters matched the snapshot before the setup, so
+             * the DSP has not been reset since it was last applied, and
+             * still match it after, so the setup did not change them.
+             */
+            if (wasCurrent && xia__IsSetupCurrent(module, i, &localFuncs)) {
+                sprintf(info_string, "Channel %u of module %s is unchanged "
+                        "since the last setup.", i, module->alias);
+                xiaLogDebug("xiaUserSetup", info_string);
+                nCurrent++;
+            }
         }
 
         /* Module level setup function, need a detChan for the user functions
@@ -334,11 +454,19 @@ HANDEL_SHARED int HANDEL_API xiaUserSetup(void)
             sprintf(info_string, "Skipping module setup for %s, module is disabled",
                     module->alias);
             xiaLogDebug("xiaUserSetup", info_string);
+        } else if (nCurrent == nActive) {
+            sprintf(info_string, "Skipping module setup for %s, the DSP "
+                    "parameters of all channels are unchanged", module->alias);
+            xiaLogInfo("xiaUserSetup", info_string);
         } else {
             detChanInModule = module->channels[i];
 
             defaults = xiaGetDefaultFromDetChan(detChanInModule);
+            start = dxp_wait_now();
+            previous = dxp_wait_set_subsystem(XERXES_WAIT_SUB_SETUP);
             status = localFuncs.moduleSetup(detChanInModule, defaults, module);
+            dxp_wait_set_subsystem(previous);
+            dxp_stats_since("startup", "module_setup", start, 0.0);
 
             if (status != XIA_SUCCESS) {
                 sprintf(info_string, "Unable to do module setup for module %s.",
@@ -346,15 +474,388 @@ HANDEL_SHARED int HANDEL_API xiaUserSetup(void)
                 xiaLogError("xiaUserSetup", info_string, status);
                 return status;
             }
+
+            /* The module setup can change the DSP parameters of any channel
+             * in the module, so all of them are saved afterwards.
+             */
+            for (i = 0; lazySetupFile != NULL && i < module->number_of_channels; i++) {
+                if (module->channels[i] < 0) {
+                    continue;
+                }
+
+                status = xia__SaveSetupSnapshot(module, i, &localFuncs);
+
+                if (status != XIA_SUCCESS) {
+                    sprintf(info_string, "Unable to save the setup snapshot for "
+                            "channel %u of module %s.", i, module->alias);
+                    xiaLogWarning("xiaUserSetup", info_string);
+                }
+            }
         }
 
         module = getListNext(module);
     }
 
+    if (lazySetupFile != NULL) {
+        status = xia__WriteSetupSnapshots();
+
+        if (status != XIA_SUCCESS) {
+            sprintf(info_string, "Unable to write the setup snapshots to '%s'",
+                    lazySetupFile);
+            xiaLogWarning("xiaUserSetup", info_string);
+        }
+    }
+
     return XIA_SUCCESS;
 }
 
 
+/*
+ * Returns a hash of the configuration that channel modChan of module is set
+ * up with: the firmware set, the detector and the acquisition values.
+ */
+HANDEL_STATIC unsigned long xia__SetupHash(Module *module, unsigned int modChan)
+{
+    unsigned long hash = DXP_HASH_INIT;
+
+    int detector_chan;
+
+    char *firmAlias;
+    char *detAlias;
+
+    Detector *detector = NULL;
+
+    XiaDefaults *defaults = NULL;
+    XiaDaqEntry *entry = NULL;
+
+    firmAlias     = module->firmware[modChan];
+    detAlias      = module->detector[modChan];
+    detector_chan = module->detector_chan[modChan];
+    detector      = xiaFindDetector(detAlias);
+    defaults      = xiaGetDefaultFromDetChan((unsigned int)module->channels[modChan]);
+
+    hash = dxp_hash_bytes(hash, firmAlias, strlen(firmAlias));
+    hash = dxp_hash_bytes(hash, detAlias, strlen(detAlias));
+    hash = dxp_hash_bytes(hash, &detector_chan, sizeof(detector_chan));
+
+    if (detector != NULL) {
+        hash = dxp_hash_bytes(hash, &detector->type, sizeof(detector->type));
+        hash = dxp_hash_bytes(hash, &detector->polarity[detector_chan],
+                              sizeof(unsigned short));
+        hash = dxp_hash_bytes(hash, &detector->gain[detector_chan],
+                              sizeof(double));
+        hash = dxp_hash_bytes(hash, &detector->typeValue[detector_chan],
+                              sizeof(double));
+    }
+
+    if (defaults != NULL) {
+        for (entry = defaults->entry; entry != NULL; entry = entry->next) {
+            hash = dxp_hash_bytes(hash, entry->name, strlen(entry->name));
+            hash = dxp_hash_bytes(hash, &entry->data, sizeof(entry->data));
+        }
+    }
+
+    return hash;
+}
+
+
+/*
+ * Returns the snapshot of channel modChan of the module with alias modAlias,
+ * or NULL if there isn't one.
+ */
+HANDEL_STATIC SetupSnapshot *xia__FindSetupSnapshot(char *modAlias,
+                                                    unsigned int modChan)
+{
+    SetupSnapshot *s = NULL;
+
+
+    for (s = setupSnapshots; s != NULL; s = s->next) {
+        if (s->modChan == modChan && STREQ(s->modAlias, modAlias)) {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Returns TRUE_ if channel modChan of module has a snapshot with the same
+ * configuration and the DSP parameters read from the hardware match it.
+ */
+HANDEL_STATIC boolean_t xia__IsSetupCurrent(Module *module, unsigned int modChan,
+                                            PSLFuncs *localFuncs)
+{
+    int status;
+    int detChan = module->channels[modChan];
+
+    unsigned short numParams;
+
+    unsigned short *values = NULL;
+
+    boolean_t isCurrent;
+
+    SetupSnapshot *s = NULL;
+
+
+    s = xia__FindSetupSnapshot(module->alias, modChan);
+
+    if (s == NULL || s->hash != xia__SetupHash(module, modChan)) {
+        return FALSE_;
+    }
+
+    status = localFuncs->getNumParams(detChan, &numParams);
+
+    if (status != XIA_SUCCESS || numParams != s->numParams) {
+        return FALSE_;
+    }
+
+    values = handel_md_alloc(numParams * sizeof(unsigned short));
+
+    if (values == NULL) {
+        return FALSE_;
+    }
+
+    status = localFuncs->getParamData(detChan, "values", (void *)values);
+
+    isCurrent = (boolean_t)(status == XIA_SUCCESS &&
+                            memcmp(values, s->values,
+                                   numParams * sizeof(unsigned short)) == 0);
+
+    handel_md_free(values);
+
+    return isCurrent;
+}
+
+
+/*
+ * Reads the DSP parameters of channel modChan of module from the hardware
+ * and saves them, with the configuration hash, as the channel's snapshot.
+ */
+HANDEL_STATIC int xia__SaveSetupSnapshot(Module *module, unsigned int modChan,
+                                         PSLFuncs *localFuncs)
+{
+    int status;
+    int detChan = module->channels[modChan];
+
+    unsigned short numParams;
+
+    SetupSnapshot *s = NULL;
+
+
+    status = localFuncs->getNumParams(detChan, &numParams);
+
+    if (status != XIA_SUCCESS) {
+        return status;
+    }
+
+    s = xia__FindSetupSnapshot(module->alias, modChan);
+
+    if (s == NULL) {
+        s = handel_md_alloc(sizeof(SetupSnapshot));
+
+        if (s == NULL) {
+            return XIA_NOMEM;
+        }
+
+        s->modAlias = handel_md_alloc(strlen(module->alias) + 1);
+
+        if (s->modAlias == NULL) {
+            handel_md_free(s);
+            return XIA_NOMEM;
+        }
+
+        strcpy(s->modAlias, module->alias);
+        s->modChan   = modChan;
+        s->numParams = 0;
+        s->values    = NULL;
+        s->next      = setupSnapshots;
+        setupSnapshots = s;
+    }
+
+    if (s->numParams != numParams) {
+        if (s->values != NULL) {
+            handel_md_free(s->values);
+        }
+
+        s->numParams = 0;
+        s->values = handel_md_alloc(numParams * sizeof(unsigned short));
+
+        if (s->values == NULL) {
+            return XIA_NOMEM;
+        }
+
+        s->numParams = numParams;
+    }
+
+    s->hash = xia__SetupHash(module, modChan);
+
+    status = localFuncs->getParamData(detChan, "values", (void *)s->values);
+
+    if (status != XIA_SUCCESS) {
+        /* Make sure that a partial read never matches */
+        s->hash = 0;
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Reads the setup snapshots from the lazy setup file. Each line of the file
+ * is: module alias, module channel, hash, number of parameters and the
+ * parameter values. A missing file is not an error.
+ */
+HANDEL_STATIC int xia__ReadSetupSnapshots(void)
+{
+    int status = XIA_SUCCESS;
+
+    unsigned int i;
+    unsigned int modChan;
+    unsigned int numParams;
+
+    unsigned long hash;
+
+    char modAlias[MAXALIAS_LEN];
+
+    FILE *fp = NULL;
+
+    SetupSnapshot *s = NULL;
+
+
+    xia__FreeSetupSnapshots();
+
+    fp = xia_file_open(lazySetupFile, "r");
+
+    if (fp == NULL) {
+        sprintf(info_string, "No setup snapshots in '%s'", lazySetupFile);
+        xiaLogInfo("xia__ReadSetupSnapshots", info_string);
+        return XIA_SUCCESS;
+    }
+
+    while (fscanf(fp, "%199s %u %lx %u", modAlias, &modChan, &hash,
+                  &numParams) == 4) {
+        if (numParams == 0 || numParams > USHRT_MAX) {
+            status = XIA_FORMAT_ERROR;
+            break;
+        }
+
+        s = handel_md_alloc(sizeof(SetupSnapshot));
+
+        if (s == NULL) {
+            status = XIA_NOMEM;
+            break;
+        }
+
+        s->modAlias  = handel_md_alloc(strlen(modAlias) + 1);
+        s->values    = handel_md_alloc(numParams * sizeof(unsigned short));
+        s->modChan   = modChan;
+        s->hash      = hash;
+        s->numParams = (unsigned short)numParams;
+        s->next      = setupSnapshots;
+        setupSnapshots = s;
+
+        if (s->modAlias == NULL || s->values == NULL) {
+            status = XIA_NOMEM;
+            break;
+        }
+
+        strcpy(s->modAlias, modAlias);
+
+        for (i = 0; i < numParams; i++) {
+            if (fscanf(fp, "%hx", &s->values[i]) != 1) {
+                status = XIA_FORMAT_ERROR;
+                break;
+            }
+        }
+
+        if (status != XIA_SUCCESS) {
+            break;
+        }
+    }
+
+    xia_file_close(fp);
+
+    if (status != XIA_SUCCESS) {
+        xia__FreeSetupSnapshots();
+        xiaLogError("xia__ReadSetupSnapshots", "Error reading setup snapshots",
+                    status);
+        return status;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Writes the setup snapshots to the lazy setup file.
+ */
+HANDEL_STATIC int xia__WriteSetupSnapshots(void)
+{
+    int status = XIA_SUCCESS;
+
+    unsigned int i;
+
+    FILE *fp = NULL;
+
+    SetupSnapshot *s = NULL;
+
+
+    fp = xia_file_open(lazySetupFile, "w");
+
+    if (fp == NULL) {
+        sprintf(info_string, "Could not open '%s'", lazySetupFile);
+        xiaLogError("xia__WriteSetupSnapshots", info_string, XIA_OPEN_FILE);
+        return XIA_OPEN_FILE;
+    }
+
+    for (s = setupSnapshots; s != NULL; s = s->next) {
+        fprintf(fp, "%s %u %lx %u", s->modAlias, s->modChan, s->hash,
+                (unsigned int)s->numParams);
+
+        for (i = 0; i < s->numParams; i++) {
+            fprintf(fp, " %x", (unsigned int)s->values[i]);
+        }
+
+        fprintf(fp, "\n");
+    }
+
+    if (ferror(fp)) {
+        status = XIA_OPEN_FILE;
+    }
+
+    xia_file_close(fp);
+
+    return status;
+}
+
+
+/*
+ * Frees all of the setup snapshots.
+ */
+HANDEL_STATIC void xia__FreeSetupSnapshots(void)
+{
+    SetupSnapshot *s = NULL;
+
+
+    while (setupSnapshots != NULL) {
+        s = setupSnapshots;
+        setupSnapshots = s->next;
+
+        if (s->modAlias != NULL) {
+            handel_md_free(s->modAlias);
+        }
+
+        if (s->values != NULL) {
+            handel_md_free(s->values);
+        }
+
+        handel_md_free(s);
+    }
+}
+
+
 /*
  * Set up a single channel in given module
  */
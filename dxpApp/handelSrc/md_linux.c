@@ -43,7 +43,8 @@
 
 /* System include files */
 
-#define _XOPEN_SOURCE 500
+/* 600 for clock_nanosleep() */
+#define _XOPEN_SOURCE 600
 #include <ctype.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -52,10 +53,12 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
+#include <endian.h>
 
 #ifndef EXCLUDE_SERIAL
-#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #endif
 
@@ -80,6 +83,43 @@ static char ERROR_STRING[132];
 /* maximum number of words able to transfer in a single call to dxp_md_io() */
 static unsigned int maxblk=0;
 
+/* The maxblk of each device, kept per interface since camChan numbering
+ * restarts for every interface. A device starts out with the global maxblk
+ * (which the XIA_MD_MAXBLK environment variable presets) when it is opened and
+ * the device library may then tune it for the bus the device sits on.
+ */
+enum {
+    MD_MAXBLK_EPP,
+    MD_MAXBLK_USB,
+    MD_MAXBLK_USB2,
+    MD_MAXBLK_NUM_IFACES
+};
+
+static unsigned int chanMaxblk[MD_MAXBLK_NUM_IFACES][MAXMOD];
+
+static int dxp_md_get_iface_maxblk(int iface, int *camChan);
+static int dxp_md_set_iface_maxblk(int iface, int *camChan,
+                                   unsigned int *blksiz);
+
+/* Xerxes passes these in Xia_Io_Functions so that transfers and waits can be
+ * timed without the MD layer calling into Xerxes. Times are taken from
+ * dxp_md_now().
+ */
+static DXP_MD_RECORD_TIME md_record_time = NULL;
+static DXP_MD_RECORD_WAIT md_record_wait = NULL;
+
+static double dxp_md_now(void);
+static void dxp_md_record_since(char *group, char *name, double start,
+                                double amount);
+
+/* dxp_md_wait() sleeps until this many seconds before the end of the wait and
+ * spins for the rest, so shorter waits are not lost to the timer slack of the
+ * scheduler. Waits shorter than this are spun completely. The default of 0
+ * always sleeps; it is preset by the XIA_MD_WAIT_SPIN environment variable
+ * and changed with dxp_md_set_wait_spin().
+ */
+static double md_wait_spin = 0.0;
+
 
 #ifndef EXCLUDE_EPP
 /* EPP definitions */
@@ -129,6 +169,14 @@ static HANDLE usb2Handles[MAXMOD];
 /* The cached target address for the next operation. */
 static unsigned long usb2AddrCache[MAXMOD];
 
+/* The USB2 driver transfers the 16-bit words low byte first, which is the
+ * memory layout of the caller's buffer on little-endian hosts, so there the
+ * data is transferred in place instead of through a converted copy.
+ */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define MD_USB2_IN_PLACE
+#endif
+
 #endif /* EXCLUDE_USB2 */
 
 
@@ -136,15 +184,40 @@ static unsigned long usb2AddrCache[MAXMOD];
 
 #define HEADER_SIZE 4
 
+/* Size of the per-port receive buffer. */
+#define SERIAL_RX_SIZE 4096
+
+/* Time to wait for the next bytes when the caller doesn't specify it. */
+#define SERIAL_TIMEOUT_MS 1000
+
+/* An open serial port. Incoming bytes are read from the driver in blocks
+ * of up to SERIAL_RX_SIZE and handed out from rx, so a response costs a
+ * few read() calls instead of one per byte.
+ */
+typedef struct _Serial_Port {
+    int fd;
+
+    byte_t rx[SERIAL_RX_SIZE];
+    unsigned int rxPos;
+    unsigned int rxLen;
+
+    /* Reusable buffer for outgoing bytes, grown as needed. */
+    byte_t *tx;
+    unsigned int txSize;
+
+} Serial_Port;
+
 /* variables to store the IO channel information */
 static char *serialName[MAXMOD];
-static HANDLE serialHandles[MAXMOD];
+static Serial_Port *serialPorts[MAXMOD];
 static unsigned int numSerial = 0;
 
 /* Serial port globals */
-static int dxp_md_serial_read_header(int fd, unsigned short *bytes,
+static int dxp_md_serial_fill(Serial_Port *port, int timeout);
+static int dxp_md_serial_read_header(Serial_Port *port, int timeout,
+                                     unsigned short *bytes,
                                      unsigned short *buf);
-static int dxp_md_serial_read_data(int fd,
+static int dxp_md_serial_read_data(Serial_Port *port, int timeout,
                                    unsigned long size, unsigned short *buf);
 
 #endif /* EXCLUDE_SERIAL */
@@ -246,16 +319,44 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_io(Xia_Io_Functions* funcs, char* type)
 {
     unsigned int i;
 
+    char *blksiz;
+    char *spin;
+
     for (i = 0; i < strlen(type); i++) {
 
         type[i]= (char)tolower(type[i]);
     }
 
+    spin = getenv("XIA_MD_WAIT_SPIN");
+
+    if (spin != NULL && strtod(spin, NULL) > 0.0) {
+        md_wait_spin = strtod(spin, NULL);
+    }
+
+    md_record_time = funcs->dxp_md_record_time;
+    md_record_wait = funcs->dxp_md_record_wait;
+
+    /* A fixed block size from the environment applies to every device that
+     * is opened afterwards and keeps the device libraries from tuning it.
+     */
+    blksiz = getenv("XIA_MD_MAXBLK");
+
+    if (blksiz != NULL) {
+        maxblk = (unsigned int)strtoul(blksiz, NULL, 0);
+    }
+
+    /* Interfaces without per-device block sizes share the global one. */
+    funcs->dxp_md_get_chan_maxblk = dxp_md_get_chan_maxblk;
+    funcs->dxp_md_set_chan_maxblk = dxp_md_set_chan_maxblk;
+    funcs->dxp_md_set_wait_spin   = dxp_md_set_wait_spin;
+
 
 #ifndef EXCLUDE_EPP
     if (STREQ(type, "epp")) {
         funcs->dxp_md_io         = dxp_md_epp_io;
         funcs->dxp_md_initialize = dxp_md_epp_initialize;
+        funcs->dxp_md_get_chan_maxblk = dxp_md_epp_get_maxblk;
+        funcs->dxp_md_set_chan_maxblk = dxp_md_epp_set_maxblk;
         funcs->dxp_md_open       = dxp_md_epp_open;
         funcs->dxp_md_close      = dxp_md_epp_close;
     }
@@ -268,6 +369,8 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_io(Xia_Io_Functions* funcs, char* type)
         funcs->dxp_md_initialize    = dxp_md_usb_initialize;
         funcs->dxp_md_open          = dxp_md_usb_open;
         funcs->dxp_md_close         = dxp_md_usb_close;
+        funcs->dxp_md_get_chan_maxblk = dxp_md_usb_get_maxblk;
+        funcs->dxp_md_set_chan_maxblk = dxp_md_usb_set_maxblk;
     }
 #endif /* EXCLUDE_USB */
 
@@ -300,6 +403,8 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_io(Xia_Io_Functions* funcs, char* type)
         funcs->dxp_md_initialize    = dxp_md_usb2_initialize;
         funcs->dxp_md_open          = dxp_md_usb2_open;
         funcs->dxp_md_close         = dxp_md_usb2_close;
+        funcs->dxp_md_get_chan_maxblk = dxp_md_usb2_get_maxblk;
+        funcs->dxp_md_set_chan_maxblk = dxp_md_usb2_set_maxblk;
     }
 #endif /* EXCLUDE_USB2 */
 
@@ -465,6 +570,8 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_epp_open(char* ioname, int* camChan)
     *camChan = numEPP++;
     numMod++;
 
+    chanMaxblk[MD_MAXBLK_EPP][*camChan] = maxblk;
+
     return status;
 }
 
@@ -487,12 +594,11 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_epp_io(int* camChan, unsigned int* function,
     int rstat = 0;
     int status;
 
-    int i;
-
     unsigned short *us_data = (unsigned short *)data;
 
     int ullength = (int) *length/2;
-    unsigned long *temp = NULL;
+
+    double start;
 
     if ((currentID != eppID[*camChan]) && (eppID[*camChan] != -1))
     {
@@ -507,6 +613,7 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_epp_io(int* camChan, unsigned int* function,
 
     /* Data*/
     if (*address==0) {
+        start = dxp_md_now();
         /* Perform short reads and writes if not in program address space */
         if (next_addr>=0x4000) {
             if (*length>1) {
@@ -523,34 +630,17 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_epp_io(int* camChan, unsigned int* function,
                 }
             }
         } else {
-            /* Perform long reads and writes if in program address space (24-bit) */
-            /* Allocate memory */
-            temp = (unsigned long *)dxp_md_alloc(sizeof(unsigned long) * ullength);
-
-            if (!temp) {
-                sprintf(ERROR_STRING, "Unable to allocate %zu bytes for temp",
-                        sizeof(unsigned long) * ullength);
-                dxp_md_log_error("dxp_md_epp_io", ERROR_STRING, DXP_NOMEM);
-                return DXP_NOMEM;
-            }
-
+            /* Perform long reads and writes if in program address space (24-bit).
+             * The EPPLIB routines transfer the word pairs directly to and from
+             * the caller's buffer in the order Handel uses. */
             if (*function == MD_IO_READ) {
-                rstat = DxpReadBlocklong(next_addr, temp, ullength);
-                /* reverse the byte order for the EPPLIB library */
-                for (i = 0; i < ullength; i++) {
-                    us_data[2*i] = (unsigned short) (temp[i]&0xFFFF);
-                    us_data[2*i+1] = (unsigned short) ((temp[i]>>16)&0xFFFF);
-                }
+                rstat = DxpReadBlocklongUshort(next_addr, us_data, ullength);
             } else {
-                /* reverse the byte order for the EPPLIB library */
-                for (i=0; i < ullength; i++) {
-                    temp[i] = ((us_data[2*i]<<16) + us_data[2*i+1]);
-                }
-                rstat = DxpWriteBlocklong(next_addr, temp, ullength);
+                rstat = DxpWriteBlocklongUshort(next_addr, us_data, ullength);
             }
-            /* Free the memory */
-            dxp_md_free(temp);
         }
+        dxp_md_record_since("md_epp", (*function == MD_IO_READ) ? "read" : "write",
+                            start, (double)(*length * 2));
         /* Address port*/
     } else if (*address==1) {
         next_addr = *us_data;
@@ -682,6 +772,8 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_usb_open(char* ioname, int* camChan)
     *camChan = numUSB++;
     numMod++;
 
+    chanMaxblk[MD_MAXBLK_USB][*camChan] = maxblk;
+
     return status;
 }
 
@@ -705,14 +797,19 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_usb_io(int* camChan, unsigned int* function,
     int status;
     unsigned short *us_data = (unsigned short *)data;
 
+    double start;
+
     if (*address == 0)
     {
+        start = dxp_md_now();
         if (*function == MD_IO_READ)
         {
             rstat = xia_usb_read(usb_addr, (long) *length, usbName[*camChan], us_data);
         } else {
             rstat = xia_usb_write(usb_addr, (long) *length, usbName[*camChan], us_data);
         }
+        dxp_md_record_since("md_usb", (*function == MD_IO_READ) ? "read" : "write",
+                            start, (double)(*length * 2));
     } else if (*address ==1) {
         usb_addr = (long) us_data[0];
     }
@@ -765,7 +862,8 @@ XIA_MD_STATIC int dxp_md_serial_initialize(unsigned int *maxMod,
     numSerial = 0;
 
     for (i = 0; i < MAXMOD; i++) {
-        serialName[i] = NULL;
+        serialName[i]  = NULL;
+        serialPorts[i] = NULL;
     }
 
     return DXP_SUCCESS;
@@ -795,8 +893,11 @@ int dxp_md_serial_set_interface_attribs(int fd, int speed)
     tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
     tty.c_oflag &= ~OPOST;
 
-    tty.c_cc[VMIN] = 0;   /* Don't block if no bytes ever come */
-    tty.c_cc[VTIME] = 10; /* Deciseconds to wait for the first byte */
+    /* read() returns whatever is available without blocking. The timeouts
+     * are handled with poll() in dxp_md_serial_fill().
+     */
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
 
     if (tcsetattr(fd, TCSANOW, &tty) != 0) {
         printf("Error from tcsetattr: %s\n", strerror(errno));
@@ -896,7 +997,20 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_open(char* ioname, int* camChan)
         return DXP_MDINITIALIZE;
     }
 
-    serialHandles[*camChan] = fd;
+    ASSERT(serialPorts[*camChan] == NULL);
+
+    serialPorts[*camChan] = dxp_md_alloc(sizeof(Serial_Port));
+
+    if (serialPorts[*camChan] == NULL) {
+        close(fd);
+        sprintf(ERROR_STRING, "Unable to allocate %zu bytes for serialPorts[%d]",
+                sizeof(Serial_Port), *camChan);
+        dxp_md_log_error("dxp_md_serial_open", ERROR_STRING, DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    memset(serialPorts[*camChan], 0, sizeof(Serial_Port));
+    serialPorts[*camChan]->fd = fd;
 
     ASSERT(serialName[*camChan] == NULL);
 
@@ -930,20 +1044,28 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int *camChan,
                                               unsigned int *length)
 {
     int status;
+    int timeout = SERIAL_TIMEOUT_MS;
     unsigned int i;
+    unsigned int written;
 
     unsigned short n_bytes = 0;
 
     unsigned short *us_data = (unsigned short *)data;
 
-    byte_t *buf    = NULL;
+    byte_t *buf = NULL;
 
-    int fd = serialHandles[*camChan];
+    Serial_Port *port = serialPorts[*camChan];
+    int fd = port->fd;
 
-    UNUSED(wait_in_ms);
+    double start = dxp_md_now();
+
+
+    if (wait_in_ms != NULL && *wait_in_ms > 0) {
+        timeout = (int)*wait_in_ms;
+    }
 
     if (*function == MD_IO_READ) {
-        status = dxp_md_serial_read_header(fd, &n_bytes, us_data);
+        status = dxp_md_serial_read_header(port, timeout, &n_bytes, us_data);
 
         if (status != DXP_SUCCESS) {
             dxp_md_log_error("dxp_md_serial_io", "Error reading header", status);
@@ -955,19 +1077,26 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int *camChan,
          */
         if (n_bytes + HEADER_SIZE > *length) {
             tcflush(fd, TCIOFLUSH);
+            port->rxPos = port->rxLen = 0;
             sprintf(ERROR_STRING, "Header reports ndata=%hu, larger than "
                     "requested length %u-%d.", n_bytes, *length, HEADER_SIZE);
             dxp_md_log_error("dxp_md_serial_io", ERROR_STRING, DXP_MDSIZE);
             return DXP_MDSIZE;
         }
 
-        status = dxp_md_serial_read_data(fd, n_bytes, us_data + HEADER_SIZE);
+        status = dxp_md_serial_read_data(port, timeout, n_bytes,
+                                         us_data + HEADER_SIZE);
 
         if (status != DXP_SUCCESS) {
             dxp_md_log_error("dxp_md_serial_io", "Error reading data", status);
             return status;
         }
+
+        dxp_md_record_since("md_serial", "read", start, (double)(n_bytes + HEADER_SIZE));
     } else if (*function == MD_IO_WRITE) {
+        /* A new command starts a new exchange, so anything left over from
+         * the last one is stale.
+         */
         status = tcflush(fd, TCIOFLUSH);
         if (status != 0) {
             sprintf(ERROR_STRING, "Error flushing fd=%d, driver reports %s",
@@ -976,34 +1105,49 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int *camChan,
             return DXP_MDIO;
         }
 
-        buf = (byte_t *)dxp_md_alloc(*length * sizeof(byte_t));
+        port->rxPos = port->rxLen = 0;
 
-        if (buf == NULL) {
-            status = DXP_NOMEM;
-            sprintf(ERROR_STRING, "Error allocating %u bytes for buf",
-                    *length);
-            dxp_md_log_error("dxp_md_serial_io", ERROR_STRING, status);
-            return status;
+        if (*length > port->txSize) {
+            buf = (byte_t *)dxp_md_alloc(*length * sizeof(byte_t));
+
+            if (buf == NULL) {
+                status = DXP_NOMEM;
+                sprintf(ERROR_STRING, "Error allocating %u bytes for buf",
+                        *length);
+                dxp_md_log_error("dxp_md_serial_io", ERROR_STRING, status);
+                return status;
+            }
+
+            if (port->tx != NULL) {
+                dxp_md_free(port->tx);
+            }
+
+            port->tx     = buf;
+            port->txSize = *length;
         }
 
+        buf = port->tx;
+
         for (i = 0; i < *length; i++) {
             buf[i] = (byte_t)us_data[i];
         }
 
-        int wlen = write(fd, buf, *length);
+        for (written = 0; written < *length; ) {
+            int wlen = write(fd, buf + written, *length - written);
 
-        if (wlen != *length) {
-            dxp_md_free((void *)buf);
-            buf = NULL;
+            if (wlen < 0 && errno == EINTR) {
+                continue;
+            }
 
-            sprintf(ERROR_STRING, "Error writing %u bytes to fd %d"
-                    "driver reported status %d", *length, fd, wlen);
-            dxp_md_log_error("dxp_md_serial_io", ERROR_STRING, DXP_MDIO);
-            return DXP_MDIO;
-        }
+            if (wlen <= 0) {
+                sprintf(ERROR_STRING, "Error writing %u bytes to fd %d"
+                        "driver reported status %d", *length - written, fd, wlen);
+                dxp_md_log_error("dxp_md_serial_io", ERROR_STRING, DXP_MDIO);
+                return DXP_MDIO;
+            }
 
-        dxp_md_free((void *)buf);
-        buf = NULL;
+            written += (unsigned int)wlen;
+        }
 
         status = tcdrain(fd);
         if (status != 0) {
@@ -1013,6 +1157,7 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int *camChan,
             return DXP_MDIO;
         }
 
+        dxp_md_record_since("md_serial", "write", start, (double)*length);
     } else if (*function == MD_IO_OPEN) {
         /* Do nothing */
     } else if (*function == MD_IO_CLOSE) {
@@ -1027,6 +1172,60 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int *camChan,
     return DXP_SUCCESS;
 }
 
+/*
+ * Refills the receive buffer of an empty port with whatever the driver has,
+ * waiting up to timeout ms for the first byte to arrive.
+ */
+static int dxp_md_serial_fill(Serial_Port *port, int timeout)
+{
+    int status;
+    int rlen;
+
+    struct pollfd pfd;
+
+
+    ASSERT(port != NULL);
+    ASSERT(port->rxPos == port->rxLen);
+
+    pfd.fd     = port->fd;
+    pfd.events = POLLIN;
+
+    do {
+        pfd.revents = 0;
+        status = poll(&pfd, 1, timeout);
+    } while (status < 0 && errno == EINTR);
+
+    if (status == 0) {
+        sprintf(ERROR_STRING, "Timeout after %d ms waiting for data from fd=%d",
+                timeout, port->fd);
+        dxp_md_log_error("dxp_md_serial_fill", ERROR_STRING, DXP_MDIO);
+        return DXP_MDIO;
+    }
+
+    if (status < 0) {
+        sprintf(ERROR_STRING, "Error polling fd=%d, driver reports %s",
+                port->fd, strerror(errno));
+        dxp_md_log_error("dxp_md_serial_fill", ERROR_STRING, DXP_MDIO);
+        return DXP_MDIO;
+    }
+
+    do {
+        rlen = read(port->fd, port->rx, SERIAL_RX_SIZE);
+    } while (rlen < 0 && errno == EINTR);
+
+    if (rlen <= 0) {
+        sprintf(ERROR_STRING, "Error reading from fd=%d: returned = %d",
+                port->fd, rlen);
+        dxp_md_log_error("dxp_md_serial_fill", ERROR_STRING, DXP_MDIO);
+        return DXP_MDIO;
+    }
+
+    port->rxPos = 0;
+    port->rxLen = (unsigned int)rlen;
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Reads the header of the returned packet
  *
@@ -1034,14 +1233,15 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_io(int *camChan,
  * specified buffer. Also calculates the number of bytes remaining
  * in the packet including the XOR checksum.
  */
-static int dxp_md_serial_read_header(int fd, unsigned short *bytes,
+static int dxp_md_serial_read_header(Serial_Port *port, int timeout,
+                                     unsigned short *bytes,
                                      unsigned short *buf)
 {
     int i;
+    int status;
 
     byte_t lo;
     byte_t hi;
-    byte_t b;
 
     byte_t header[HEADER_SIZE];
 
@@ -1050,16 +1250,19 @@ static int dxp_md_serial_read_header(int fd, unsigned short *bytes,
     ASSERT(buf != NULL);
 
     for (i = 0; i < HEADER_SIZE; i++) {
-        int rlen = read(fd, &b, 1);
-
-        if (rlen != 1) {
-            sprintf(ERROR_STRING, "Error reading header from fd=%d: actual = %d, "
-                    "expected = %d", fd, rlen, 1);
-            dxp_md_log_error("dxp_md_serial_read_header", ERROR_STRING, DXP_MDIO);
-            return DXP_MDIO;
+        if (port->rxPos == port->rxLen) {
+            status = dxp_md_serial_fill(port, timeout);
+
+            if (status != DXP_SUCCESS) {
+                sprintf(ERROR_STRING, "Error reading header from fd=%d: "
+                        "received %d of %d bytes", port->fd, i, HEADER_SIZE);
+                dxp_md_log_error("dxp_md_serial_read_header", ERROR_STRING,
+                                 status);
+                return status;
+            }
         }
 
-        header[i] = b;
+        header[i] = port->rx[port->rxPos++];
     }
 
     lo = header[2];
@@ -1094,56 +1297,39 @@ static int dxp_md_serial_read_header(int fd, unsigned short *bytes,
  * Reads the specified number of bytes from the port and copies them to
  *  the buffer.
  */
-static int dxp_md_serial_read_data(int fd,
+static int dxp_md_serial_read_data(Serial_Port *port, int timeout,
                                    unsigned long size, unsigned short *buf)
 {
-    byte_t *b = NULL;
-    int timeToStall = 5;
-    int totalRead;
-    unsigned long i;
-
-    ASSERT(buf != NULL);
+    int status;
 
-    b = (byte_t *)dxp_md_alloc(size * sizeof(byte_t));
+    unsigned long totalRead = 0;
 
-    if (b == NULL) {
-        sprintf(ERROR_STRING, "Error allocating %lu bytes for 'b'", size);
-        dxp_md_log_error("dxp_md_serial_read_data", ERROR_STRING, DXP_NOMEM);
-        return DXP_NOMEM;
-    }
 
-    /* VMIN limits read size to 255. We just loop until it we get all the
-     * requested data or stall after several failures.
-     */
-    for (totalRead = 0; totalRead < size; ) {
-        int remaining = size - totalRead;
+    ASSERT(buf != NULL);
 
-        int rlen = read(fd, b + totalRead, remaining);
-        if (rlen <= 0) {
-            if (timeToStall-- > 0)
-                continue;
+    while (totalRead < size) {
+        if (port->rxPos == port->rxLen) {
+            status = dxp_md_serial_fill(port, timeout);
 
-            dxp_md_free(b);
-            sprintf(ERROR_STRING, "Error reading data from fd=%d: "
-                    "requested = %d, returned = %d", fd, remaining, rlen);
-            dxp_md_log_error("dxp_md_serial_read_data", ERROR_STRING, DXP_MDIO);
+            if (status != DXP_SUCCESS) {
+                sprintf(ERROR_STRING, "Error reading data from fd=%d: "
+                        "received %lu of %lu bytes", port->fd, totalRead, size);
+                dxp_md_log_error("dxp_md_serial_read_data", ERROR_STRING,
+                                 status);
 
-            /* The Windows driver closes the port and reinitializes it on failure
-             * here. Do we need it?
-             */
+                /* The Windows driver closes the port and reinitializes it on
+                 * failure here. Do we need it?
+                 */
 
-            return DXP_MDIO;
+                return status;
+            }
         }
 
-        totalRead += rlen;
-    }
-
-    for (i = 0; i < size; i++) {
-        buf[i] = (unsigned short)b[i];
+        while (port->rxPos < port->rxLen && totalRead < size) {
+            buf[totalRead++] = (unsigned short)port->rx[port->rxPos++];
+        }
     }
 
-    dxp_md_free(b);
-
     return DXP_SUCCESS;
 }
 
@@ -1160,13 +1346,20 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_close(int *camChan)
     dxp_md_log_debug("dxp_md_serial_close", ERROR_STRING);
 
     if (serialName[*camChan] != NULL) {
-        int fd = serialHandles[*camChan];
+        Serial_Port *port = serialPorts[*camChan];
 
         sprintf(ERROR_STRING, "Preparing to close camChan %d, device %s, fd %d",
-                *camChan, serialName[*camChan], fd);
+                *camChan, serialName[*camChan], port->fd);
         dxp_md_log_debug("dxp_md_serial_close", ERROR_STRING);
 
-        close(fd);
+        close(port->fd);
+
+        if (port->tx != NULL) {
+            dxp_md_free(port->tx);
+        }
+
+        dxp_md_free(port);
+        serialPorts[*camChan] = NULL;
 
         dxp_md_free(serialName[*camChan]);
         serialName[*camChan] = NULL;
@@ -1253,6 +1446,8 @@ XIA_MD_STATIC int  dxp_md_usb2_open(char *ioname, int *camChan)
 
     usb2AddrCache[*camChan] = MD_INVALID_ADDR;
 
+    chanMaxblk[MD_MAXBLK_USB2][*camChan] = maxblk;
+
     numMod++;
 
     return DXP_SUCCESS;
@@ -1272,7 +1467,9 @@ XIA_MD_STATIC int  dxp_md_usb2_io(int *camChan, unsigned int *function,
 {
     int status;
 
+#ifndef MD_USB2_IN_PLACE
     unsigned int i;
+#endif /* MD_USB2_IN_PLACE */
 
     unsigned long cache_addr;
 
@@ -1283,6 +1480,8 @@ XIA_MD_STATIC int  dxp_md_usb2_io(int *camChan, unsigned int *function,
     unsigned long n_bytes = 0;
     unsigned long n_bytes_read = 0;
 
+    double start;
+
 
     ASSERT(addr != NULL);
     ASSERT(function != NULL);
@@ -1315,6 +1514,9 @@ XIA_MD_STATIC int  dxp_md_usb2_io(int *camChan, unsigned int *function,
         switch (*function) {
         case MD_IO_READ:
 
+#ifdef MD_USB2_IN_PLACE
+            byte_buf = (byte_t *)buf;
+#else
             /* The data comes from the calling routine as an unsigned short, so
              * we need to convert it to a byte array for the USB2 driver.
              */
@@ -1326,17 +1528,16 @@ XIA_MD_STATIC int  dxp_md_usb2_io(int *camChan, unsigned int *function,
                 dxp_md_log_error("dxp_md_usb2_io", ERROR_STRING, DXP_NOMEM);
                 return DXP_NOMEM;
             }
+#endif /* MD_USB2_IN_PLACE */
 
-
-            /* Initialize buffer to a fixed pattern to identify source of read
-             * errors in case the buffer is not filled completely
-             */
-            memset(byte_buf, 0xAB, n_bytes);
-
+            start  = dxp_md_now();
             status = xia_usb2_readn(usb2Handles[*camChan], cache_addr, n_bytes,
                                     byte_buf, &n_bytes_read);
+            dxp_md_record_since("md_usb2", "read", start, (double)n_bytes_read);
             if (status != 0) {
+#ifndef MD_USB2_IN_PLACE
                 dxp_md_free(byte_buf);
+#endif /* MD_USB2_IN_PLACE */
                 sprintf(ERROR_STRING, "Error reading %lu bytes from %#lx for "
                         "camChan %d, driver reports %d",
                         n_bytes, cache_addr, *camChan, status);
@@ -1354,16 +1555,28 @@ XIA_MD_STATIC int  dxp_md_usb2_io(int *camChan, unsigned int *function,
                 return DXP_MDIO;
             }
 
+            /* Fill the byte that is missing from an odd-length response with
+             * a fixed pattern to identify it.
+             */
+            if (n_bytes_read != n_bytes) {
+                byte_buf[n_bytes - 1] = 0xAB;
+            }
+
+#ifndef MD_USB2_IN_PLACE
             for (i = 0; i < *len; i++) {
                 buf[i] = (unsigned short)(byte_buf[i * 2] |
                                           (byte_buf[(i * 2) + 1] << 8));
             }
 
             dxp_md_free(byte_buf);
+#endif /* MD_USB2_IN_PLACE */
 
             break;
 
         case MD_IO_WRITE:
+#ifdef MD_USB2_IN_PLACE
+            byte_buf = (byte_t *)buf;
+#else
             /* The data comes from the calling routine as an unsigned short, so
              * we need to convert it to a byte array for the USB2 driver.
              */
@@ -1380,11 +1593,16 @@ XIA_MD_STATIC int  dxp_md_usb2_io(int *camChan, unsigned int *function,
                 byte_buf[i * 2]       = (byte_t)(buf[i] & 0xFF);
                 byte_buf[(i * 2) + 1] = (byte_t)((buf[i] >> 8) & 0xFF);
             }
+#endif /* MD_USB2_IN_PLACE */
 
+            start  = dxp_md_now();
             status = xia_usb2_write(usb2Handles[*camChan], cache_addr, n_bytes,
                                     byte_buf);
+            dxp_md_record_since("md_usb2", "write", start, (double)n_bytes);
 
+#ifndef MD_USB2_IN_PLACE
             dxp_md_free(byte_buf);
+#endif /* MD_USB2_IN_PLACE */
 
             if (status != XIA_USB2_SUCCESS) {
                 sprintf(ERROR_STRING, "Error writing %lu bytes to %#lx for "
@@ -1499,6 +1717,151 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk(unsigned int* blksiz)
 
 }
 
+/*
+ * Per-device versions of dxp_md_get_maxblk() and dxp_md_set_maxblk() for
+ * interfaces that do not keep a block size for each device.
+ */
+XIA_MD_STATIC int XIA_MD_API dxp_md_get_chan_maxblk(int *camChan)
+{
+    UNUSED(camChan);
+
+    return dxp_md_get_maxblk();
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_chan_maxblk(int *camChan,
+                                                    unsigned int *blksiz)
+{
+    UNUSED(camChan);
+
+    return dxp_md_set_maxblk(blksiz);
+}
+
+/*
+ * Returns the block size of the device camChan on the interface iface.
+ */
+static int dxp_md_get_iface_maxblk(int iface, int *camChan)
+{
+    ASSERT(camChan != NULL);
+
+
+    if ((*camChan < 0) || ((unsigned int)*camChan >= MAXMOD)) {
+        return (int)maxblk;
+    }
+
+    return (int)chanMaxblk[iface][*camChan];
+}
+
+/*
+ * Sets the block size of the device camChan on the interface iface. Unlike
+ * the global maxblk, a block size of 0 is accepted and means that transfers to
+ * this device are never split.
+ */
+static int dxp_md_set_iface_maxblk(int iface, int *camChan,
+                                   unsigned int *blksiz)
+{
+    ASSERT(camChan != NULL);
+    ASSERT(blksiz != NULL);
+
+
+    if ((*camChan < 0) || ((unsigned int)*camChan >= MAXMOD)) {
+        sprintf(ERROR_STRING, "camChan %d is out of range", *camChan);
+        dxp_md_log_error("dxp_md_set_iface_maxblk", ERROR_STRING,
+                         DXP_BADCHANNEL);
+        return DXP_BADCHANNEL;
+    }
+
+    chanMaxblk[iface][*camChan] = *blksiz;
+
+    sprintf(ERROR_STRING, "Block size for camChan %d on interface %d set to "
+            "%u words", *camChan, iface, *blksiz);
+    dxp_md_log_debug("dxp_md_set_iface_maxblk", ERROR_STRING);
+
+    return DXP_SUCCESS;
+}
+
+#ifndef EXCLUDE_EPP
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_get_maxblk(int *camChan)
+{
+    return dxp_md_get_iface_maxblk(MD_MAXBLK_EPP, camChan);
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz)
+{
+    return dxp_md_set_iface_maxblk(MD_MAXBLK_EPP, camChan, blksiz);
+}
+#endif /* EXCLUDE_EPP */
+
+#ifndef EXCLUDE_USB
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_get_maxblk(int *camChan)
+{
+    return dxp_md_get_iface_maxblk(MD_MAXBLK_USB, camChan);
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz)
+{
+    return dxp_md_set_iface_maxblk(MD_MAXBLK_USB, camChan, blksiz);
+}
+#endif /* EXCLUDE_USB */
+
+#ifndef EXCLUDE_USB2
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_get_maxblk(int *camChan)
+{
+    return dxp_md_get_iface_maxblk(MD_MAXBLK_USB2, camChan);
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_set_maxblk(int *camChan,
+                                                    unsigned int *blksiz)
+{
+    return dxp_md_set_iface_maxblk(MD_MAXBLK_USB2, camChan, blksiz);
+}
+#endif /* EXCLUDE_USB2 */
+
+/*
+ * Returns a monotonic time in seconds. Only differences between two calls
+ * are meaningful.
+ */
+static double dxp_md_now(void)
+{
+    struct timespec ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+/*
+ * Passes the time since start, as returned by dxp_md_now(), to Xerxes.
+ */
+static void dxp_md_record_since(char *group, char *name, double start,
+                                double amount)
+{
+    if (md_record_time != NULL) {
+        md_record_time(group, name, dxp_md_now() - start, amount);
+    }
+}
+
+/*
+ * Sets how many seconds at the end of each dxp_md_wait() are spun rather
+ * than slept. 0 always sleeps.
+ */
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_wait_spin(double *spin)
+{
+    ASSERT(spin != NULL);
+
+
+    if (*spin < 0.0) {
+        sprintf(ERROR_STRING, "Wait spin %f may not be negative", *spin);
+        dxp_md_log_error("dxp_md_set_wait_spin", ERROR_STRING, DXP_BAD_WAIT);
+        return DXP_BAD_WAIT;
+    }
+
+    md_wait_spin = *spin;
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Routine to wait a specified time in seconds.  This allows the user to call
  * routines that are as precise as required for the purpose at hand.
@@ -1506,9 +1869,37 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk(unsigned int* blksiz)
 XIA_MD_STATIC int XIA_MD_API dxp_md_wait(float* time)
 /* float *time;							Input: Time to wait in seconds	*/
 {
-    DWORD wait = (DWORD)(1000.0 * (*time));
+    double wait  = (double)*time;
+    double start = dxp_md_now();
+    double end;
 
-    Sleep(wait);
+    struct timespec ts;
+
+
+    if (wait <= 0.0) {
+        return DXP_SUCCESS;
+    }
+
+    /* dxp_md_now() uses CLOCK_MONOTONIC, so the deadline can be passed to
+     * clock_nanosleep() directly and is not stretched by signals.
+     */
+    if (wait > md_wait_spin) {
+        end = start + wait - md_wait_spin;
+        ts.tv_sec  = (time_t)end;
+        ts.tv_nsec = (long)((end - (double)ts.tv_sec) * 1.0e9);
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+
+    end = start + wait;
+
+    while (dxp_md_now() < end)
+        ;
+
+    if (md_record_wait != NULL) {
+        md_record_wait(wait, dxp_md_now() - start);
+    }
 
     return DXP_SUCCESS;
 }
@@ -112,8 +112,27 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_close(int *camChan);
 #endif /* EXCLUDE_PLX */
 
 XIA_MD_STATIC int XIA_MD_API dxp_md_wait(float *);
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_wait_spin(double *spin);
 XIA_MD_STATIC int XIA_MD_API dxp_md_get_maxblk(void);
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk(unsigned int *);
+XIA_MD_STATIC int XIA_MD_API dxp_md_get_chan_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_chan_maxblk(int *camChan,
+                                                    unsigned int *blksiz);
+#ifndef EXCLUDE_EPP
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_get_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz);
+#endif /* EXCLUDE_EPP */
+#ifndef EXCLUDE_USB
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_get_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz);
+#endif /* EXCLUDE_USB */
+#ifndef EXCLUDE_USB2
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_get_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_set_maxblk(int *camChan,
+                                                    unsigned int *blksiz);
+#endif /* EXCLUDE_USB2 */
 XIA_MD_STATIC int XIA_MD_API dxp_md_puts(char *);
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_priority(int *priority);
 XIA_MD_STATIC char * dxp_md_fgets(char *s, int length, FILE *stream);
@@ -135,6 +154,8 @@ XIA_MD_IMPORT int XIA_MD_API DxpReadBlock(unsigned short, unsigned short *,int);
 XIA_MD_IMPORT int XIA_MD_API DxpReadBlockd(unsigned short, double *,int);
 XIA_MD_IMPORT int XIA_MD_API DxpReadBlocklong(unsigned short,unsigned long *,int);
 XIA_MD_IMPORT int XIA_MD_API DxpReadBlocklongd(unsigned short, double *,int);
+XIA_MD_IMPORT int XIA_MD_API DxpReadBlocklongUshort(unsigned short, unsigned short *, int);
+XIA_MD_IMPORT int XIA_MD_API DxpWriteBlocklongUshort(unsigned short, unsigned short *, int);
 XIA_MD_IMPORT void XIA_MD_API DxpSetID(unsigned short id);
 XIA_MD_IMPORT int XIA_MD_API DxpWritePort(unsigned short port, unsigned short data);
 XIA_MD_IMPORT int XIA_MD_API DxpReadPort(unsigned short port, unsigned short *data);
@@ -190,8 +211,23 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_serial_close();
 
 
 XIA_MD_STATIC int XIA_MD_API dxp_md_wait();
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_wait_spin();
 XIA_MD_STATIC int XIA_MD_API dxp_md_get_maxblk();
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk();
+XIA_MD_STATIC int XIA_MD_API dxp_md_get_chan_maxblk();
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_chan_maxblk();
+#ifndef EXCLUDE_EPP
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_get_maxblk();
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_set_maxblk();
+#endif /* EXCLUDE_EPP */
+#ifndef EXCLUDE_USB
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_get_maxblk();
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_set_maxblk();
+#endif /* EXCLUDE_USB */
+#ifndef EXCLUDE_USB2
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_get_maxblk();
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_set_maxblk();
+#endif /* EXCLUDE_USB2 */
 XIA_MD_STATIC void XIA_MD_API *dxp_md_alloc();
 XIA_MD_STATIC void XIA_MD_API dxp_md_free();
 XIA_MD_STATIC int XIA_MD_API dxp_md_puts();
@@ -209,6 +245,8 @@ XIA_MD_IMPORT int XIA_MD_API DxpReadBlock();
 XIA_MD_IMPORT int XIA_MD_API DxpReadBlockd();
 XIA_MD_IMPORT int XIA_MD_API DxpReadBlocklong();
 XIA_MD_IMPORT int XIA_MD_API DxpReadBlocklongd();
+XIA_MD_IMPORT int XIA_MD_API DxpReadBlocklongUshort();
+XIA_MD_IMPORT int XIA_MD_API DxpWriteBlocklongUshort();
 XIA_MD_IMPORT void XIA_MD_API DxpSetID();
 XIA_MD_IMPORT int XIA_MD_API DxpWritePort();
 XIA_MD_IMPORT int XIA_MD_API DxpReadPort();
@@ -67,6 +67,24 @@ static char ERROR_STRING[XIA_LINE_LEN];
 
 static unsigned int MAXBLK=0;
 
+/* The maxblk of each device, kept per interface since camChan numbering
+ * restarts for every interface. A device starts out with the global MAXBLK
+ * when it is opened and the device library may then tune it for the bus the
+ * device sits on.
+ */
+enum {
+    MD_MAXBLK_EPP,
+    MD_MAXBLK_USB,
+    MD_MAXBLK_USB2,
+    MD_MAXBLK_NUM_IFACES
+};
+
+static unsigned int chanMaxblk[MD_MAXBLK_NUM_IFACES][MAXMOD];
+
+static int dxp_md_get_iface_maxblk(int iface, int *camChan);
+static int dxp_md_set_iface_maxblk(int iface, int *camChan,
+                                   unsigned int *blksiz);
+
 /* Globals that don't depend on the communication protocol. */
 static char * TMP_PATH = NULL;
 static char * PATH_SEP = "\\";
@@ -215,6 +233,10 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_io(Xia_Io_Functions* funcs, char* type)
         type[i]= (char)tolower((int)type[i]);
     }
 
+    /* Interfaces without per-device block sizes share the global one. */
+    funcs->dxp_md_get_chan_maxblk = dxp_md_get_chan_maxblk;
+    funcs->dxp_md_set_chan_maxblk = dxp_md_set_chan_maxblk;
+
 #ifndef EXCLUDE_EPP
     if (STREQ(type, "epp")) {
 
@@ -222,6 +244,8 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_io(Xia_Io_Functions* funcs, char* type)
         funcs->dxp_md_initialize = dxp_md_epp_initialize;
         funcs->dxp_md_open       = dxp_md_epp_open;
         funcs->dxp_md_close      = dxp_md_epp_close;
+        funcs->dxp_md_get_chan_maxblk = dxp_md_epp_get_maxblk;
+        funcs->dxp_md_set_chan_maxblk = dxp_md_epp_set_maxblk;
     }
 #endif /* EXCLUDE_EPP */
 
@@ -232,6 +256,8 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_io(Xia_Io_Functions* funcs, char* type)
         funcs->dxp_md_initialize    = dxp_md_usb_initialize;
         funcs->dxp_md_open          = dxp_md_usb_open;
         funcs->dxp_md_close         = dxp_md_usb_close;
+        funcs->dxp_md_get_chan_maxblk = dxp_md_usb_get_maxblk;
+        funcs->dxp_md_set_chan_maxblk = dxp_md_usb_set_maxblk;
     }
 #endif /* EXCLUDE_USB */
 
@@ -264,6 +290,8 @@ XIA_MD_EXPORT int XIA_MD_API dxp_md_init_io(Xia_Io_Functions* funcs, char* type)
         funcs->dxp_md_initialize    = dxp_md_usb2_initialize;
         funcs->dxp_md_open          = dxp_md_usb2_open;
         funcs->dxp_md_close         = dxp_md_usb2_close;
+        funcs->dxp_md_get_chan_maxblk = dxp_md_usb2_get_maxblk;
+        funcs->dxp_md_set_chan_maxblk = dxp_md_usb2_set_maxblk;
     }
 #endif /* EXCLUDE_USB2 */
 
@@ -403,6 +431,8 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_epp_open(char* ioname, int* camChan)
     *camChan = numEPP++;
     numMod++;
 
+    chanMaxblk[MD_MAXBLK_EPP][*camChan] = MAXBLK;
+
     return status;
 }
 
@@ -613,6 +643,8 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_usb_open(char* ioname, int* camChan)
     *camChan = numUSB++;
     numMod++;
 
+    chanMaxblk[MD_MAXBLK_USB][*camChan] = MAXBLK;
+
     return status;
 }
 
@@ -1171,6 +1203,107 @@ XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk(unsigned int* blksiz)
 
 }
 
+/*
+ * Per-device versions of dxp_md_get_maxblk() and dxp_md_set_maxblk() for
+ * interfaces that do not keep a block size for each device.
+ */
+XIA_MD_STATIC int XIA_MD_API dxp_md_get_chan_maxblk(int *camChan)
+{
+    UNUSED(camChan);
+
+    return dxp_md_get_maxblk();
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_chan_maxblk(int *camChan,
+                                                    unsigned int *blksiz)
+{
+    UNUSED(camChan);
+
+    return dxp_md_set_maxblk(blksiz);
+}
+
+/*
+ * Returns the block size of the device camChan on the interface iface.
+ */
+static int dxp_md_get_iface_maxblk(int iface, int *camChan)
+{
+    ASSERT(camChan != NULL);
+
+
+    if ((*camChan < 0) || ((unsigned int)*camChan >= MAXMOD)) {
+        return (int)MAXBLK;
+    }
+
+    return (int)chanMaxblk[iface][*camChan];
+}
+
+/*
+ * Sets the block size of the device camChan on the interface iface. Unlike
+ * the global MAXBLK, a block size of 0 is accepted and means that transfers to
+ * this device are never split.
+ */
+static int dxp_md_set_iface_maxblk(int iface, int *camChan,
+                                   unsigned int *blksiz)
+{
+    ASSERT(camChan != NULL);
+    ASSERT(blksiz != NULL);
+
+
+    if ((*camChan < 0) || ((unsigned int)*camChan >= MAXMOD)) {
+        sprintf(ERROR_STRING, "camChan %d is out of range", *camChan);
+        dxp_md_log_error("dxp_md_set_iface_maxblk", ERROR_STRING,
+                         DXP_BADCHANNEL);
+        return DXP_BADCHANNEL;
+    }
+
+    chanMaxblk[iface][*camChan] = *blksiz;
+
+    sprintf(ERROR_STRING, "Block size for camChan %d on interface %d set to "
+            "%u words", *camChan, iface, *blksiz);
+    dxp_md_log_debug("dxp_md_set_iface_maxblk", ERROR_STRING);
+
+    return DXP_SUCCESS;
+}
+
+#ifndef EXCLUDE_EPP
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_get_maxblk(int *camChan)
+{
+    return dxp_md_get_iface_maxblk(MD_MAXBLK_EPP, camChan);
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz)
+{
+    return dxp_md_set_iface_maxblk(MD_MAXBLK_EPP, camChan, blksiz);
+}
+#endif /* EXCLUDE_EPP */
+
+#ifndef EXCLUDE_USB
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_get_maxblk(int *camChan)
+{
+    return dxp_md_get_iface_maxblk(MD_MAXBLK_USB, camChan);
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz)
+{
+    return dxp_md_set_iface_maxblk(MD_MAXBLK_USB, camChan, blksiz);
+}
+#endif /* EXCLUDE_USB */
+
+#ifndef EXCLUDE_USB2
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_get_maxblk(int *camChan)
+{
+    return dxp_md_get_iface_maxblk(MD_MAXBLK_USB2, camChan);
+}
+
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_set_maxblk(int *camChan,
+                                                    unsigned int *blksiz)
+{
+    return dxp_md_set_iface_maxblk(MD_MAXBLK_USB2, camChan, blksiz);
+}
+#endif /* EXCLUDE_USB2 */
+
 /*
  * Routine to wait a specified time in seconds.  This allows the user to call
  * routines that are as precise as required for the purpose at hand.
@@ -1708,6 +1841,8 @@ XIA_MD_STATIC int  dxp_md_usb2_open(char *ioname, int *camChan)
 
     usb2AddrCache[*camChan] = MD_INVALID_ADDR;
 
+    chanMaxblk[MD_MAXBLK_USB2][*camChan] = MAXBLK;
+
     numMod++;
 
     return DXP_SUCCESS;
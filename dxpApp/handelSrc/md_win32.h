@@ -103,6 +103,24 @@ XIA_MD_STATIC int dxp_md_plx_close(int *camChan);
 XIA_MD_STATIC int XIA_MD_API dxp_md_wait(float *);
 XIA_MD_STATIC int XIA_MD_API dxp_md_get_maxblk(void);
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_maxblk(unsigned int *);
+XIA_MD_STATIC int XIA_MD_API dxp_md_get_chan_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_set_chan_maxblk(int *camChan,
+                                                    unsigned int *blksiz);
+#ifndef EXCLUDE_EPP
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_get_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_epp_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz);
+#endif /* EXCLUDE_EPP */
+#ifndef EXCLUDE_USB
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_get_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb_set_maxblk(int *camChan,
+                                                   unsigned int *blksiz);
+#endif /* EXCLUDE_USB */
+#ifndef EXCLUDE_USB2
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_get_maxblk(int *camChan);
+XIA_MD_STATIC int XIA_MD_API dxp_md_usb2_set_maxblk(int *camChan,
+                                                    unsigned int *blksiz);
+#endif /* EXCLUDE_USB2 */
 XIA_MD_STATIC int XIA_MD_API dxp_md_puts(char *);
 XIA_MD_STATIC int XIA_MD_API dxp_md_set_priority(int *priority);
 XIA_MD_STATIC char * dxp_md_fgets(char *s, int length, FILE *stream);
@@ -35,6 +35,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <ctype.h>
 
 #include "mercury.h"
@@ -46,6 +47,19 @@
 
 #include "xerxes_errors.h"
 #include "xerxes_generic.h"
+#include "xerxes_wait.h"
+
+/* State passed to the dxp_wait_until() conditions. */
+typedef struct _Mercury_Wait {
+    int ioChan;
+    int modChan;
+    Board *board;
+
+    /* Value to wait for and the last value read from the hardware. */
+    unsigned long desired;
+    unsigned long value;
+
+} Mercury_Wait_t;
 
 static char info_string[INFO_LEN];
 
@@ -59,6 +73,9 @@ static int dxp__write_block(int *ioChan, unsigned long addr, unsigned long n,
                             unsigned long *data);
 static int dxp__read_block(int *ioChan, unsigned long addr, unsigned long n,
                            unsigned long *data);
+static int dxp__read_packed_buffer(int *ioChan, unsigned long addr,
+                                   unsigned long len, unsigned long *data);
+static int dxp__tune_maxblk(int *ioChan);
 static int dxp__get_mca_chan_addr(int ioChan, int modChan, Board *board,
                                   unsigned long *addr);
 
@@ -98,6 +115,10 @@ static int dxp__wait_for_busy(int ioChan, int modChan, parameter_t desired,
 static int dxp__wait_for_active(int ioChan, int modChan, double timeout,
                                 Board *board);
 static int dxp__run_enable_active(int ioChan, int *active);
+static int dxp__busy_done(void *ctx, boolean_t *done);
+static int dxp__cfg_status_done(void *ctx, boolean_t *done);
+static int dxp__dsp_active_done(void *ctx, boolean_t *done);
+static int dxp__apply_done(void *ctx, boolean_t *done);
 static double dxp__unsigned64_to_double(unsigned long *u64);
 static double dxp__get_clock_tick(void);
 static int dxp__put_dsp_to_sleep(int ioChan, int modChan, Board *b);
@@ -199,6 +220,7 @@ XERXES_EXPORT int dxp_init_mercury(Functions* funcs)
 
     funcs->dxp_get_symbol_by_index = dxp_get_symbol_by_index;
     funcs->dxp_get_num_params = dxp_get_num_params;
+    funcs->dxp_get_firmware_id = dxp_get_firmware_id;
 
     return DXP_SUCCESS;
 }
@@ -244,8 +266,8 @@ static int dxp_init_driver(Interface* iface)
 
 
     mercury_md_io         = iface->funcs->dxp_md_io;
-    mercury_md_set_maxblk = iface->funcs->dxp_md_set_maxblk;
-    mercury_md_get_maxblk = iface->funcs->dxp_md_get_maxblk;
+    mercury_md_set_maxblk = iface->funcs->dxp_md_set_chan_maxblk;
+    mercury_md_get_maxblk = iface->funcs->dxp_md_get_chan_maxblk;
 
     return DXP_SUCCESS;
 }
@@ -458,6 +480,15 @@ static int dxp_download_dspconfig(int* ioChan, int* modChan, Board *board)
         return status;
     }
 
+    status = dxp__tune_maxblk(ioChan);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error tuning the block size for ioChan = %d",
+                *ioChan);
+        dxp_log_error("dxp_download_dspconfig", info_string, status);
+        return status;
+    }
+
     return DXP_SUCCESS;
 }
 
@@ -1645,6 +1676,17 @@ XERXES_STATIC int dxp_read_mem(int *ioChan, int *modChan, Board *board,
             return status;
         }
 
+    } else if (STREQ(name, "burst_map_packed")) {
+
+        status = dxp__read_packed_buffer(ioChan, addr, *offset, data);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error reading packed memory buffer for "
+                    "ioChan = %d", *ioChan);
+            dxp_log_error("dxp_read_mem", info_string, status);
+            return status;
+        }
+
     } else if (STREQ(name, "data")) {
 
         addr += DXP_DSP_DATA_MEM_ADDR;
@@ -1919,6 +1961,115 @@ static int dxp_get_num_params(int modChan, Board *b, unsigned short *n_params)
     return DXP_SUCCESS;
 }
 
+/*
+ * Reports if the module is still configured from a previous session: XDONE
+ * is set for the System FPGA and the FiPPI, the DSP is active and no run is
+ * in progress. The FiPPI image cannot be read back, so the FiPPI is
+ * identified by the DECIMATION the DSP reads from it. The identity returned
+ * in id is the CODEREV and CODEVAR of the running DSP code, DECIMATION and
+ * the System FPGA version register.
+ */
+XERXES_STATIC int dxp_get_firmware_id(int *ioChan, Board *board,
+                                      boolean_t *loaded, unsigned long *id)
+{
+    int status;
+    int i;
+    int modChan = 0;
+
+    unsigned long cfg = 0;
+    unsigned long csr = 0;
+
+    double value = 0.0;
+
+
+    ASSERT(ioChan != NULL);
+    ASSERT(board != NULL);
+    ASSERT(loaded != NULL);
+    ASSERT(id != NULL);
+
+
+    *loaded = FALSE_;
+
+    for (i = 0; i < DXP_FIRMWARE_ID_LEN; i++) {
+        id[i] = 0;
+    }
+
+    status = dxp__read_global_register(*ioChan, DXP_CPLD_CFG_STATUS, &cfg);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading the CPLD "
+                      "status register", status);
+        return status;
+    }
+
+    for (i = 0; i < MERCURY_NUM_TARGETS; i++) {
+        if (!(cfg & MERCURY_CFG_STATUS[i][MERCURY_XDONE])) {
+            sprintf(info_string, "FPGA target %d is not configured on module %d",
+                    i, board->mod);
+            dxp_log_debug("dxp_get_firmware_id", info_string);
+            return DXP_SUCCESS;
+        }
+    }
+
+    status = dxp__read_global_register(*ioChan, DXP_SYS_REG_CSR, &csr);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading the CSR", status);
+        return status;
+    }
+
+    if (!(csr & (1 << DXP_CSR_DSP_ACT_BIT)) ||
+        (csr & (1 << DXP_CSR_RUN_ACT_BIT))) {
+        sprintf(info_string, "The DSP on module %d is not idle (CSR = %#lx)",
+                board->mod, csr);
+        dxp_log_debug("dxp_get_firmware_id", info_string);
+        return DXP_SUCCESS;
+    }
+
+    if (board->system_dsp == NULL) {
+        return DXP_SUCCESS;
+    }
+
+    status = dxp_read_dspsymbol(ioChan, &modChan, "CODEREV", board, &value);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading CODEREV", status);
+        return status;
+    }
+
+    id[0] = (unsigned long)value;
+
+    status = dxp_read_dspsymbol(ioChan, &modChan, "CODEVAR", board, &value);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading CODEVAR", status);
+        return status;
+    }
+
+    id[1] = (unsigned long)value;
+
+    status = dxp_read_dspsymbol(ioChan, &modChan, "DECIMATION", board, &value);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading DECIMATION", status);
+        return status;
+    }
+
+    id[2] = (unsigned long)value;
+
+    status = dxp_read_reg(ioChan, &modChan, "SVR", &(id[3]));
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading the SVR", status);
+        return status;
+    }
+
+    *loaded = TRUE_;
+
+    return DXP_SUCCESS;
+}
+
+
 /*
  * Writes a single 32-bit value to the device.
  */
@@ -2205,16 +2356,18 @@ static int dxp__download_fpga(int ioChan, unsigned long target,
     unsigned int i;
     unsigned long j;
 
-    unsigned int n_polls = 0;
-    float wait = .05f;
-    boolean_t asserted;
-
     unsigned long *cfg_data = NULL;
 
     float cpld_ctrl_wait = 0.001f;
     float sys_done_wait  = 3.0f;
 
     unsigned long cpld_status = 0;
+    unsigned long init_mask   = 0;
+    unsigned long xdone_mask  = 0;
+
+    float settle = XERXES_WAIT_FPGA_SETTLE;
+
+    Mercury_Wait_t w;
 
     ASSERT(fpga != NULL);
 
@@ -2227,20 +2380,35 @@ static int dxp__download_fpga(int ioChan, unsigned long target,
         return status;
     }
 
-    /* Since the sleep granularity is typically 1 millisecond, there is no need
-     * to try and create a timeout loop. We will simply wait 1 millisecond and
-     * check the result.
+    for (j = 0; j < MERCURY_NUM_TARGETS; j++) {
+        if (target & (1 << j)) {
+            init_mask  |= MERCURY_CFG_STATUS[j][MERCURY_INIT];
+            xdone_mask |= MERCURY_CFG_STATUS[j][MERCURY_XDONE];
+        }
+    }
+
+    /* Poll until INIT* is asserted for every target or the allowed time
+     * has passed. A timeout is reported per target by the check below. The
+     * lines are not valid until the Control Register write has settled, so
+     * they are not sampled before that.
      */
-    mercury_md_wait(&cpld_ctrl_wait);
+    mercury_md_wait(&settle);
 
-    status = dxp__read_global_register(ioChan, DXP_CPLD_CFG_STATUS, &cpld_status);
+    w.ioChan  = ioChan;
+    w.desired = init_mask;
+    w.value   = 0;
 
-    if (status != DXP_SUCCESS) {
+    status = dxp_wait_until(XERXES_WAIT_FPGA, (double)cpld_ctrl_wait,
+                            dxp__cfg_status_done, &w, NULL);
+
+    if (status != DXP_SUCCESS && status != DXP_TIMEOUT) {
         sprintf(info_string, "Error reading Status Register for channel %d", ioChan);
         dxp_log_error("dxp__download_fpga", info_string, status);
         return status;
     }
 
+    cpld_status = w.value;
+
     /* Since the target could potentially be more then one FPGA, we must check
      * the INIT* line for each FPGA that is targeted.
      */
@@ -2291,35 +2459,44 @@ static int dxp__download_fpga(int ioChan, unsigned long target,
         return status;
     }
 
-    n_polls = (unsigned int)ROUND(sys_done_wait / wait);
+    w.desired = xdone_mask;
+    w.value   = 0;
 
-    for (i = 0; i < n_polls; i++) {
-        mercury_md_wait(&wait);
-        status = dxp__read_global_register(ioChan, DXP_CPLD_CFG_STATUS, &cpld_status);
+    mercury_md_wait(&settle);
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading Status Register for channel %d", ioChan);
-            dxp_log_error("dxp_download_fpga", info_string, status);
-            return status;
-        }
+    status = dxp_wait_until(XERXES_WAIT_FPGA, (double)sys_done_wait,
+                            dxp__cfg_status_done, &w, NULL);
 
-        asserted = TRUE_;
-        for (j = 0; j < MERCURY_NUM_TARGETS; j++) {
-            if (target & (1 << j)) {
-                if (! (cpld_status & MERCURY_CFG_STATUS[j][MERCURY_XDONE])) {
-                    asserted = FALSE_;
-                }
-            }
-        }
+    if (status == DXP_TIMEOUT) {
+        sprintf(info_string, "XDONE line never asserted for after "
+                "waiting %f seconds", sys_done_wait);
+        dxp_log_error("dxp__download_fpga", info_string, DXP_FPGA_TIMEOUT);
+        return DXP_FPGA_TIMEOUT;
+    }
 
-        if (asserted)
-            return DXP_SUCCESS;
+    /* INIT* can de-assert if there is a CRC error after the last FPGA bit has
+     * been clocked in, which may be after XDONE was first seen. Read the
+     * Status Register again once the lines have settled.
+     */
+    if (status == DXP_SUCCESS) {
+        mercury_md_wait(&settle);
+        status = dxp__read_global_register(ioChan, DXP_CPLD_CFG_STATUS, &cpld_status);
     }
 
-    sprintf(info_string, "XDONE line never asserted for after "
-            "waiting %f seconds", sys_done_wait);
-    dxp_log_error("dxp__download_fpga", info_string, DXP_FPGA_TIMEOUT);
-    return DXP_FPGA_TIMEOUT;
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading Status Register for channel %d", ioChan);
+        dxp_log_error("dxp_download_fpga", info_string, status);
+        return status;
+    }
+
+    if ((cpld_status & init_mask) != init_mask) {
+        sprintf(info_string, "CRC error after downloading FPGA target %#lx for "
+                "ioChan = %d, status register %#lx", target, ioChan, cpld_status);
+        dxp_log_error("dxp__download_fpga", info_string, DXP_FPGA_CRC);
+        return DXP_FPGA_CRC;
+    }
+
+    return DXP_SUCCESS;
 
 }
 
@@ -2637,42 +2814,37 @@ static int dxp__wait_for_active(int ioChan, int modChan, double timeout,
 {
 
     int status;
-    int n_polls = 0;
-    int i;
 
-    float wait = .01f;
-    unsigned long csr = 0;
+    double elapsed = 0.0;
+
+    Mercury_Wait_t w;
 
     UNUSED(modChan);
     UNUSED(board);
 
 
-    n_polls = (int)ROUND(timeout / wait);
-
-    for (i = 0; i < n_polls; i++) {
+    w.ioChan = ioChan;
 
-        status = dxp__read_global_register(ioChan, DXP_SYS_REG_CSR, &csr);
+    status = dxp_wait_until(XERXES_WAIT_DSP_BOOT, timeout,
+                            dxp__dsp_active_done, &w, &elapsed);
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading CSR for ioChan = %d", ioChan);
-            dxp_log_error("dxp_wait_for_active", info_string, status);
-            return status;
-        }
-
-        /* Stop waiting if DSP is active. */
-        if ((csr & (0x1 << DXP_CSR_DSP_ACT_BIT))) {
-            sprintf(info_string, "Polls for waiting for DSP Active = %d", i);
-            dxp_log_info("dxp_wait_for_active", info_string);
-            return DXP_SUCCESS;
-        }
+    if (status == DXP_TIMEOUT) {
+        sprintf(info_string, "Timeout waiting for DSP Active to be set "
+                "after %0.3f s", elapsed);
+        dxp_log_error("dxp_wait_for_active", info_string, DXP_TIMEOUT);
+        return DXP_TIMEOUT;
+    }
 
-        mercury_md_wait(&wait);
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading CSR for ioChan = %d", ioChan);
+        dxp_log_error("dxp_wait_for_active", info_string, status);
+        return status;
     }
 
-    sprintf(info_string, "Timeout waiting for DSP Active to be set "
-            "after %d pools", n_polls);
-    dxp_log_error("dxp_wait_for_active", info_string, DXP_TIMEOUT);
-    return DXP_TIMEOUT;
+    sprintf(info_string, "Waited %0.6f s for DSP Active", elapsed);
+    dxp_log_info("dxp_wait_for_active", info_string);
+
+    return DXP_SUCCESS;
 }
 
 
@@ -2686,41 +2858,39 @@ static int dxp__wait_for_busy(int ioChan, int modChan, parameter_t desired,
                               double timeout, Board *board)
 {
     int status;
-    int n_polls = 0;
-    int i;
 
-    float wait = .01f;
-
-    double BUSY = 0;
+    double elapsed = 0.0;
     double RUNERROR = 0;
 
-    ASSERT(board != NULL);
+    Mercury_Wait_t w;
 
+    ASSERT(board != NULL);
 
-    n_polls = (int)ROUND(timeout / wait);
-
-    for (i = 0; i < n_polls; i++) {
 
-        status = dxp_read_dspsymbol(&ioChan, &modChan, "BUSY", board, &BUSY);
+    w.ioChan  = ioChan;
+    w.modChan = modChan;
+    w.board   = board;
+    w.desired = (unsigned long)desired;
+    w.value   = 0;
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading BUSY during poll iteration %d while "
-                    "waiting for BUSY to go to %hu on ioChan = %d", i, desired, ioChan);
-            dxp_log_error("dxp_wait_for_busy", info_string, status);
-            return status;
-        }
+    status = dxp_wait_until(XERXES_WAIT_BUSY, timeout, dxp__busy_done, &w,
+                            &elapsed);
 
-        if (BUSY == (double)desired) {
-            sprintf(info_string, "Polls for waiting for DSP BUSY = %d", i);
-            dxp_log_info("dxp__wait_for_busy", info_string);
-            return DXP_SUCCESS;
-        }
+    if (status == DXP_SUCCESS) {
+        sprintf(info_string, "Waited %0.6f s for DSP BUSY", elapsed);
+        dxp_log_info("dxp__wait_for_busy", info_string);
+        return DXP_SUCCESS;
+    }
 
-        mercury_md_wait(&wait);
+    if (status != DXP_TIMEOUT) {
+        sprintf(info_string, "Error reading BUSY while waiting for BUSY to go "
+                "to %hu on ioChan = %d", desired, ioChan);
+        dxp_log_error("dxp_wait_for_busy", info_string, status);
+        return status;
     }
 
     sprintf(info_string, "Timeout waiting for BUSY to go to %hu (current = "
-            "%0.0f) on ioChan = %d", desired, BUSY, ioChan);
+            "%lu) on ioChan = %d", desired, w.value, ioChan);
     dxp_log_error("dxp_wait_for_busy", info_string, DXP_TIMEOUT);
 
     /* DEBUG read out RUNERROR and print it for debugging purpose */
@@ -2734,6 +2904,101 @@ static int dxp__wait_for_busy(int ioChan, int modChan, parameter_t desired,
 }
 
 
+/*
+ * dxp_wait_until() condition: BUSY has reached the desired value.
+ */
+static int dxp__busy_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    double BUSY = 0;
+
+    Mercury_Wait_t *w = (Mercury_Wait_t *)ctx;
+
+
+    status = dxp_read_dspsymbol(&w->ioChan, &w->modChan, "BUSY", w->board,
+                                &BUSY);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    w->value = (unsigned long)BUSY;
+    *done = (boolean_t)(w->value == w->desired);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: all of the desired bits are set in the CPLD
+ * configuration status register.
+ */
+static int dxp__cfg_status_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    Mercury_Wait_t *w = (Mercury_Wait_t *)ctx;
+
+
+    status = dxp__read_global_register(w->ioChan, DXP_CPLD_CFG_STATUS,
+                                       &w->value);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)((w->value & w->desired) == w->desired);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: the DSP Active bit is set in the CSR.
+ */
+static int dxp__dsp_active_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    Mercury_Wait_t *w = (Mercury_Wait_t *)ctx;
+
+
+    status = dxp__read_global_register(w->ioChan, DXP_SYS_REG_CSR, &w->value);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)((w->value & (0x1 << DXP_CSR_DSP_ACT_BIT)) != 0);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: the apply run has cleared run enable.
+ */
+static int dxp__apply_done(void *ctx, boolean_t *done)
+{
+    int status;
+    int active;
+
+    Mercury_Wait_t *w = (Mercury_Wait_t *)ctx;
+
+
+    status = dxp__run_enable_active(w->ioChan, &active);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)(!active);
+
+    return DXP_SUCCESS;
+}
+
+
 /*
  * Gets the relative address in the DSP data memory of a global
  * DSP parameter. This routine does not verify that the parameter is global
@@ -2896,67 +3161,226 @@ static int dxp__read_block(int *ioChan, unsigned long addr, unsigned long n,
                            unsigned long *data)
 {
     int status;
+    int maxblk;
 
     unsigned int f;
     unsigned int len;
 
     unsigned long a;
     unsigned long i;
+    unsigned long chunk;
+    unsigned long chunk_addr;
 
-    unsigned short *buf = NULL;
+    unsigned short pair[2];
+
+    /* The MD layer expects an array of 16-bit words. Each 32-bit word takes
+     * two of them, which fit in the unsigned long it ends up in, so the
+     * 16-bit words are read straight into data and expanded in place below.
+     */
+    unsigned short *buf = (unsigned short *)data;
 
 
     ASSERT(ioChan != NULL);
     ASSERT(data != NULL);
+    ASSERT(sizeof(unsigned long) >= 2 * sizeof(unsigned short));
 
 
-    /* Write the address to the cache. */
-    a   = DXP_A_ADDR;
-    f   = DXP_F_IGNORE;
-    len = 0;
+    /* Large reads are split into transfers of at most maxblk 16-bit words,
+     * since that is the size this device's bus moves data fastest in.
+     */
+    maxblk = mercury_md_get_maxblk(ioChan);
+    chunk  = (maxblk > 1) ? (unsigned long)maxblk / 2 : n;
 
-    status = mercury_md_io(ioChan, &f, &a, &addr, &len);
+    for (i = 0; i < n; i += chunk) {
+        if (chunk > n - i) {
+            chunk = n - i;
+        }
+
+        /* Write the address to the cache. */
+        a   = DXP_A_ADDR;
+        f   = DXP_F_IGNORE;
+        len = 0;
+        chunk_addr = addr + i;
+
+        status = mercury_md_io(ioChan, &f, &a, &chunk_addr, &len);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error setting read address to %#lx for "
+                    "ioChan = %d", chunk_addr, *ioChan);
+            dxp_log_error("dxp__read_block", info_string, status);
+            return status;
+        }
+
+        a   = DXP_A_IO;
+        f   = DXP_F_READ;
+        len = (unsigned int)(chunk * 2);
+
+        status = mercury_md_io(ioChan, &f, &a, &buf[i * 2], &len);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error reading %u words of block data from "
+                    "address %#lx for ioChan = %d", len, chunk_addr, *ioChan);
+            dxp_log_error("dxp__read_block", info_string, status);
+            return status;
+        }
+    }
+
+    /* DEBUG Print out all USB read and write addresses when in doubt
+    sprintf(info_string, "Read block of %u words from address %#X", n, addr);
+    dxp_log_debug("dxp__read_block", info_string); */
+
+    /* Expand from the end, so that no 16-bit word is overwritten before it
+     * has been used. The words are copied out with memcpy() since they share
+     * their storage with data.
+     */
+    for (i = n; i-- > 0; ) {
+        memcpy(pair, &buf[i * 2], sizeof(pair));
+        data[i] = ((unsigned long)pair[1] << 16) | pair[0];
+    }
+
+    return DXP_SUCCESS;
+}
+
+/*
+ * Reads a mapping buffer through one of the packed windows and unpacks it.
+ *
+ * len is the number of 16-bit buffer words. Each 32-bit word read carries
+ * two of them, the first in the low half, so only half as many bytes cross
+ * the USB. On return data holds one buffer word per element, the same as a
+ * "burst_map" read.
+ */
+static int dxp__read_packed_buffer(int *ioChan, unsigned long addr,
+                                   unsigned long len, unsigned long *data)
+{
+    int status;
+
+    unsigned long i;
+    unsigned long n_packed = (len + 1) / 2;
+    unsigned long packed;
+
+
+    ASSERT(ioChan != NULL);
+    ASSERT(data != NULL);
+
+
+    status = dxp__read_block(ioChan, addr, n_packed, data);
 
     if (status != DXP_SUCCESS) {
-        sprintf(info_string, "Error setting read address to %#lx for ioChan = %d",
-                addr, *ioChan);
-        dxp_log_error("dxp__read_block", info_string, status);
+        sprintf(info_string, "Error reading packed buffer (addr = %#lx, "
+                "len = %lu) for ioChan = %d", addr, len, *ioChan);
+        dxp_log_error("dxp__read_packed_buffer", info_string, status);
         return status;
     }
 
-    a   = DXP_A_IO;
-    f   = DXP_F_READ;
-    len = (unsigned int)(n * 2);
+    /* Unpack in place from the end, so that no packed word is overwritten
+     * before it has been unpacked.
+     */
+    for (i = n_packed; i-- > 0; ) {
+        packed = data[i];
 
-    /* The MD layer expects an array of 16-bit words. */
-    buf = mercury_md_alloc(len * sizeof(unsigned short));
+        if ((2 * i + 1) < len) {
+            data[2 * i + 1] = (packed >> 16) & 0xFFFF;
+        }
 
-    if (buf == NULL) {
-        sprintf(info_string, "Unable to allocate %zu bytes for 'buf'",
-                len * sizeof(unsigned short));
-        dxp_log_error("dxp__read_block", info_string, status);
-        return status;
+        data[2 * i] = packed & 0xFFFF;
     }
 
-    status = mercury_md_io(ioChan, &f, &a, buf, &len);
+    return DXP_SUCCESS;
+}
 
-    if (status != DXP_SUCCESS) {
-        mercury_md_free(buf);
-        sprintf(info_string, "Error reading %u words of block data from address "
-                "%#lx for ioChan = %d", len, addr, *ioChan);
-        dxp_log_error("dxp__read_block", info_string, status);
-        return status;
+/*
+ * Picks the maximum transfer size for ioChan by timing reads of the external
+ * memory with each of MERCURY_MAXBLK_SIZES and keeping the fastest. A block
+ * size that was already configured, e.g. with XIA_MD_MAXBLK, is left alone.
+ */
+static int dxp__tune_maxblk(int *ioChan)
+{
+    int status;
+    int i;
+    int j;
+
+    unsigned int maxblk;
+    unsigned int best = 0;
+
+    unsigned long n;
+
+    unsigned long *data = NULL;
+
+    double start;
+    double elapsed;
+    double fastest;
+    double rate;
+    double best_rate = 0.0;
+
+
+    ASSERT(ioChan != NULL);
+
+
+    if (mercury_md_get_maxblk(ioChan) > 0) {
+        sprintf(info_string, "Keeping the block size of %d words for "
+                "ioChan = %d", mercury_md_get_maxblk(ioChan), *ioChan);
+        dxp_log_info("dxp__tune_maxblk", info_string);
+        return DXP_SUCCESS;
     }
 
-    /* DEBUG Print out all USB read and write addresses when in doubt
-    sprintf(info_string, "Read block of %u words from address %#X", n, addr);
-    dxp_log_debug("dxp__read_block", info_string); */
+    n = MERCURY_MAXBLK_SIZES[N_ELEMS(MERCURY_MAXBLK_SIZES) - 1] / 2;
 
-    for (i = 0; i < n; i++) {
-        data[i] = ((unsigned long)buf[(i * 2) + 1] << 16) | buf[i * 2];
+    data = mercury_md_alloc(n * sizeof(unsigned long));
+
+    if (data == NULL) {
+        sprintf(info_string, "Unable to allocate %zu bytes for 'data'",
+                n * sizeof(unsigned long));
+        dxp_log_error("dxp__tune_maxblk", info_string, DXP_NOMEM);
+        return DXP_NOMEM;
     }
 
-    mercury_md_free(buf);
+    for (i = 0; i < (int)N_ELEMS(MERCURY_MAXBLK_SIZES); i++) {
+        maxblk = MERCURY_MAXBLK_SIZES[i];
+        mercury_md_set_maxblk(ioChan, &maxblk);
+
+        fastest = 0.0;
+
+        for (j = 0; j < MERCURY_MAXBLK_TUNE_REPEAT; j++) {
+            start  = dxp_wait_now();
+            status = dxp__read_block(ioChan, DXP_DSP_EXT_MEM_ADDR, n, data);
+            elapsed = dxp_wait_now() - start;
+
+            if (status != DXP_SUCCESS) {
+                mercury_md_free(data);
+                maxblk = 0;
+                mercury_md_set_maxblk(ioChan, &maxblk);
+                sprintf(info_string, "Error reading the external memory with a "
+                        "block size of %u words for ioChan = %d",
+                        MERCURY_MAXBLK_SIZES[i], *ioChan);
+                dxp_log_error("dxp__tune_maxblk", info_string, status);
+                return status;
+            }
+
+            if ((j == 0) || (elapsed < fastest)) {
+                fastest = elapsed;
+            }
+        }
+
+        rate = (fastest > 0.0) ? (double)(n * 4) / fastest / 1.0e6 : 0.0;
+
+        sprintf(info_string, "Block size of %u words reads at %.2f MB/s for "
+                "ioChan = %d", MERCURY_MAXBLK_SIZES[i], rate, *ioChan);
+        dxp_log_debug("dxp__tune_maxblk", info_string);
+
+        if (rate > best_rate) {
+            best_rate = rate;
+            best      = MERCURY_MAXBLK_SIZES[i];
+        }
+    }
+
+    mercury_md_free(data);
+
+    mercury_md_set_maxblk(ioChan, &best);
+
+    sprintf(info_string, "Tuned the block size for ioChan = %d to %u words "
+            "(%.2f MB/s)", *ioChan, best, best_rate);
+    dxp_log_info("dxp__tune_maxblk", info_string);
+
     return DXP_SUCCESS;
 }
 
@@ -3017,10 +3441,7 @@ static int dxp__do_trace(int ioChan, int modChan, Board *board)
 static int dxp__do_apply(int ioChan, int modChan, Board *board)
 {
     int status;
-    int active;
     int id = 0;
-    int n_polls;
-    int i;
 
     unsigned short ignored = 0;
 
@@ -3034,8 +3455,9 @@ static int dxp__do_apply(int ioChan, int modChan, Board *board)
     double specialrun = 0.0;
     double errinfo    = 0.0;
     double timeout    = 1.0;
+    double elapsed    = 0.0;
 
-    float poll_interval = 0.1f;
+    Mercury_Wait_t w;
 
 
     ASSERT(board != NULL);
@@ -3102,40 +3524,29 @@ static int dxp__do_apply(int ioChan, int modChan, Board *board)
     sprintf(info_string, "Started run id = %d on ioChan = %d", id, ioChan);
     dxp_log_debug("dxp__do_apply", info_string);
 
-    /* We have an approximate timeout here since we don't include the
-     * time it takes to call dxp__run_enable_active() in the calculation.
-     */
-    n_polls = (int)ROUND(timeout / (double)poll_interval);
-
-    sprintf(info_string, "n_polls = %d, timeout = %0.1f, poll_interval = %0.1f",
-            n_polls, timeout, poll_interval);
-    dxp_log_debug("dxp__do_apply", info_string);
+    w.ioChan = ioChan;
 
-    for (i = 0; i < n_polls; i++) {
-        status = dxp__run_enable_active(ioChan, &active);
+    status = dxp_wait_until(XERXES_WAIT_APPLY, timeout, dxp__apply_done, &w,
+                            &elapsed);
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading run enable for ioChan = %d", ioChan);
-            dxp_log_error("dxp__do_apply", info_string, status);
-            return status;
-        }
-
-        if (!active) {
-            /* The apply is complete. */
-            break;
-        }
-
-        mercury_md_wait(&poll_interval);
-    }
-
-    if (i == n_polls) {
+    if (status == DXP_TIMEOUT) {
         status = dxp_end_run(&ioChan, &modChan, board);
         sprintf(info_string, "Timeout waiting %0.1f second(s) for the apply run "
-                "to complete on ioChan = %d", timeout, ioChan);
+                "to complete on ioChan = %d", elapsed, ioChan);
         dxp_log_error("dxp__do_apply", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
 
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading run enable for ioChan = %d", ioChan);
+        dxp_log_error("dxp__do_apply", info_string, status);
+        return status;
+    }
+
+    sprintf(info_string, "Apply run completed in %0.6f s on ioChan = %d",
+            elapsed, ioChan);
+    dxp_log_debug("dxp__do_apply", info_string);
+
     status = dxp_read_dspsymbol(&ioChan, &modChan, "ERRINFO", board, &errinfo);
 
     if (status != DXP_SUCCESS) {
@@ -406,6 +406,10 @@ PSL_STATIC int psl__SetListModeVariant(int detChan, int modChan, char *name,
                                 void *value, char *detType,
                                 XiaDefaults *defs, Module *m,
                                 Detector *det, FirmwareSet *fs);
+PSL_STATIC int psl__SetWordPacking(int detChan, int modChan, char *name,
+                                   void *value, char *detType,
+                                   XiaDefaults *defs, Module *m,
+                                   Detector *det, FirmwareSet *fs);
 PSL_STATIC int psl__SetTriggerOutput(int detChan, int modChan, char *name,
                                      void *value, char *detType,
                                      XiaDefaults *defs, Module *m,
@@ -789,6 +793,10 @@ static AcquisitionValue_t ACQ_VALUES[] =
     {   "list_mode_variant",        TRUE_, FALSE_, MERCURY_UPDATE_MAPPING, 0.0,
        psl__SetListModeVariant,     NULL, NULL
     },
+
+    {   "word_packing",             TRUE_, FALSE_, MERCURY_UPDATE_NEVER, 0.0,
+        psl__SetWordPacking,        NULL, NULL
+    },
 };
 
 
@@ -7411,6 +7419,8 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long *data,
     unsigned long len  = 0;
     unsigned long base = 0;
 
+    double wordPacking = 0.0;
+
     boolean_t isMCAOrSCA;
     boolean_t isList;
 
@@ -7443,15 +7453,27 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long *data,
         return XIA_NO_MAPPING;
     }
 
-    /* Use "no word packing". Once packing support is included, we can update
-     * the memory base here. (See DXP-Mercury Memory Map document for detail)
+    status = pslGetDefault("word_packing", (void *)&wordPacking, defs);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting word packing setting for detChan %d",
+                detChan);
+        pslLogError("psl__GetBuffer", info_string, status);
+        return status;
+    }
+
+    /* With word packing the buffer is read through the packed window, which
+     * returns two 16-bit words in every 32-bit word and so halves the data
+     * sent over the USB. (See DXP-Mercury Memory Map document for detail)
      */
     switch (buf) {
     case 'a':
-        base = 0x4000000;
+        base = (wordPacking == 1.0) ? MERCURY_BUF_A_PACKED_MEMORY :
+               MERCURY_BUF_A_MEMORY;
         break;
     case 'b':
-        base = 0x6000000;
+        base = (wordPacking == 1.0) ? MERCURY_BUF_B_PACKED_MEMORY :
+               MERCURY_BUF_B_MEMORY;
         break;
     default:
         FAIL();
@@ -7481,7 +7503,8 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long *data,
         }
     }
 
-    sprintf(memoryStr, "burst_map:%#lx:%lu", base, len);
+    sprintf(memoryStr, "%s:%#lx:%lu",
+            (wordPacking == 1.0) ? "burst_map_packed" : "burst_map", base, len);
 
     status = dxp_read_memory(&detChan, memoryStr, data);
 
@@ -10301,3 +10324,41 @@ PSL_STATIC int psl__SetListModeVariant(int detChan, int modChan, char *name,
 }
 
 
+/*
+ * Selects whether the mapping buffers are read with word packing, i.e.
+ * two 16-bit buffer words per 32-bit word instead of one. This only
+ * changes how the host reads the buffers, so nothing is written to the
+ * hardware here.
+ */
+PSL_STATIC int psl__SetWordPacking(int detChan, int modChan, char *name,
+                                   void *value, char *detType,
+                                   XiaDefaults *defs, Module *m,
+                                   Detector *det, FirmwareSet *fs)
+{
+    double packing;
+
+    UNUSED(modChan);
+    UNUSED(name);
+    UNUSED(detType);
+    UNUSED(defs);
+    UNUSED(m);
+    UNUSED(det);
+    UNUSED(fs);
+
+
+    ASSERT(value);
+
+
+    packing = *((double *)value);
+
+    if (packing != 0.0 && packing != 1.0) {
+        sprintf(info_string, "Word packing must be 0 or 1, not %0.1f, for "
+                "detChan %d.", packing, detChan);
+        pslLogError("psl__SetWordPacking", info_string, XIA_BAD_VALUE);
+        return XIA_BAD_VALUE;
+    }
+
+    return XIA_SUCCESS;
+}
+
+
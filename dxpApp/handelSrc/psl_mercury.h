@@ -93,6 +93,14 @@ static unsigned long MERCURY_STATS_CHAN_OFFSET[] = {
 /* Mapping buffer block offsets */
 #define MERCURY_BUFFER_BLOCK_SIZE  256
 
+/* Mapping buffers. The packed windows return two 16-bit buffer words in
+ * each 32-bit word, the first in the low half.
+ */
+#define MERCURY_BUF_A_MEMORY        0x4000000
+#define MERCURY_BUF_B_MEMORY        0x6000000
+#define MERCURY_BUF_A_PACKED_MEMORY 0x5000000
+#define MERCURY_BUF_B_PACKED_MEMORY 0x7000000
+
 /* System FPGA variant register bit offset */
 #define MERCURY_VAR_DAQ_MODE 0
 
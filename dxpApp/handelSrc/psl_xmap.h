@@ -80,6 +80,14 @@
 #define XMAP_SCA_PIXEL_BLOCK_HEADER_SIZE 64
 #define XMAP_32_EXT_MEMORY 0x3000000
 
+/* Mapping buffers. The packed windows return two 16-bit buffer words in
+ * each 32-bit transfer, the first in the low half.
+ */
+#define XMAP_BUF_A_MEMORY        0x4000000
+#define XMAP_BUF_B_MEMORY        0x6000000
+#define XMAP_BUF_A_PACKED_MEMORY 0x5000000
+#define XMAP_BUF_B_PACKED_MEMORY 0x7000000
+
 static unsigned long XMAP_STATS_CHAN_OFFSET[] = {
   0x000000,
   0x000040,
@@ -132,6 +140,20 @@ enum master {
 
 char* mastertype[] = { "gate_master", "sync_master",
                             "lbus_master", "none_master" };
+
+/* Location of the baseline histograms of the channels of a module in DSP
+ * data memory. len is the longest of the histograms, which is the stride
+ * of the channels in a "module_baseline" read. isContiguous is set if the
+ * histograms are back-to-back.
+ */
+typedef struct _Baseline_Layout {
+    Module *m;
+    unsigned long generation;
+    parameter_t BASESTART[4];
+    parameter_t BASELEN[4];
+    unsigned long len;
+    boolean_t isContiguous;
+} Baseline_Layout;
 /*
  * Macros
  */
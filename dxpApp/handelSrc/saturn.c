@@ -49,6 +49,7 @@
 #include "xia_common.h"
 #include "xia_assert.h"
 #include "xia_file.h"
+#include "xerxes_wait.h"
 
 
 static char info_string[INFO_LEN];
@@ -62,8 +63,8 @@ static unsigned short startp=START_PARAMS;
  * Pointer to utility functions
  */
 static DXP_MD_IO saturn_md_io;
-static DXP_MD_SET_MAXBLK saturn_md_set_maxblk;
-static DXP_MD_GET_MAXBLK saturn_md_get_maxblk;
+static DXP_MD_SET_CHAN_MAXBLK saturn_md_set_maxblk;
+static DXP_MD_GET_CHAN_MAXBLK saturn_md_get_maxblk;
 /*
  * Define the utility routines used throughout this library
  */
@@ -87,7 +88,22 @@ XERXES_STATIC int dxp_read_data_memory(int *ioChan, int *modChan,
                                        unsigned long *data);
 XERXES_STATIC int dxp_write_external_memory(int *ioChan, int *modChan, Board *board,
                                             unsigned long base, unsigned long offset, unsigned long *data);
-XERXES_STATIC int dxp_wait_for_busy(int *ioChan, int *modChan, Board *board, int n_timeout, double busy, float wait);
+XERXES_STATIC int dxp_wait_for_busy(int *ioChan, int *modChan, Board *board, double timeout, double busy);
+static int dxp_busy_done(void *ctx, boolean_t *done);
+static int dxp_xdone_done(void *ctx, boolean_t *done);
+
+/* State passed to the dxp_wait_until() conditions. */
+typedef struct Saturn_Wait
+{
+    int *ioChan;
+    int *modChan;
+    Board *board;
+
+    /* Value to wait for and the last value read from the hardware. */
+    double desired;
+    double value;
+}
+Saturn_Wait_t;
 
 
 typedef int (*memory_func_t)(int*, int *, Board *, unsigned long, unsigned long, unsigned long *);
@@ -183,8 +199,8 @@ static int dxp_init_driver(Interface* iface)
 
     /* Assign all the static vars here to point at the proper library routines */
     saturn_md_io = iface->funcs->dxp_md_io;
-    saturn_md_set_maxblk = iface->funcs->dxp_md_set_maxblk;
-    saturn_md_get_maxblk = iface->funcs->dxp_md_get_maxblk;
+    saturn_md_set_maxblk = iface->funcs->dxp_md_set_chan_maxblk;
+    saturn_md_get_maxblk = iface->funcs->dxp_md_get_chan_maxblk;
 
     return DXP_SUCCESS;
 }
@@ -532,7 +548,7 @@ static int dxp_read_block(int* ioChan, int* modChan, unsigned short* addr,
     }
 
     /* Retrieve MAXBLK and check if single transfer is needed */
-    maxblk=saturn_md_get_maxblk();
+    maxblk=saturn_md_get_maxblk(ioChan);
     if (maxblk <= 0) maxblk = *length;
 
     /* prepare for the first pass thru loop */
@@ -597,7 +613,7 @@ static int dxp_write_block(int* ioChan, int* modChan, unsigned short* addr,
     }
 
     /* Retrieve MAXBLK and check if single transfer is needed */
-    maxblk=saturn_md_get_maxblk();
+    maxblk=saturn_md_get_maxblk(ioChan);
     if (maxblk <= 0) maxblk = *length;
 
     /* prepare for the first pass thru loop */
@@ -648,13 +664,11 @@ static int dxp_download_fpgaconfig(int* ioChan, int* modChan, char *name, Board*
     *   or all channels of a single DXP module.
     */
     int status;
-    int n_attempts;
-    int k;
 
 
     unsigned short data;
 
-    float xdone_wait      = .001f;
+    Saturn_Wait_t w;
 
     unsigned int i,j,length,xlen,nxfers;
     float wait;
@@ -772,7 +786,7 @@ static int dxp_download_fpgaconfig(int* ioChan, int* modChan, char *name, Board*
     }
 
     /* Retrieve MAXBLK and check if single transfer is needed */
-    maxblk=saturn_md_get_maxblk();
+    maxblk=saturn_md_get_maxblk(ioChan);
     if (maxblk <= 0) maxblk = length;
 
     sprintf(info_string, "maxblk = %u", maxblk);
@@ -808,36 +822,35 @@ static int dxp_download_fpgaconfig(int* ioChan, int* modChan, char *name, Board*
         if (j==(nxfers-1)) xlen=((length-11)%maxblk) + 1;
     } while (j<nxfers);
 
-    /* Wait for XDONE to signal that the FiPPI configured. */
-    n_attempts = (int)ROUND(XDONE_TIMEOUT / xdone_wait);
+    /* Wait for XDONE to signal that the FiPPI configured. The CSR is not
+     * sampled until the last word written has settled.
+     */
+    w.ioChan = ioChan;
+    w.value  = 0.0;
 
-    for (k = 0; k < n_attempts; k++) {
-        status = dxp_read_csr(ioChan, &data);
+    wait = XERXES_WAIT_FPGA_SETTLE;
+    saturn_md_wait(&wait);
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading CSR while checking XDONE for "
-                    "ioChan = %d", *ioChan);
-            dxp_log_error("dxp_download_fpgaconfig", info_string, status);
-            return status;
-        }
+    status = dxp_wait_until(XERXES_WAIT_FPGA, XDONE_TIMEOUT, dxp_xdone_done,
+                            &w, NULL);
 
-        sprintf(info_string, "CSR = %#x", data);
-        dxp_log_debug("dxp_download_fpgaconfig", info_string);
-
-        if ((data & MASK_FIPERR) == 0) {
-            break;
-        }
-
-        saturn_md_wait(&xdone_wait);
-    }
+    sprintf(info_string, "CSR = %#x", (unsigned short)w.value);
+    dxp_log_debug("dxp_download_fpgaconfig", info_string);
 
-    if (k == n_attempts) {
+    if (status == DXP_TIMEOUT) {
         sprintf(info_string, "Timeout waiting (%0.3f seconds) for XDONE to assert "
                 "for ioChan = %d", XDONE_TIMEOUT, *ioChan);
         dxp_log_error("dxp_download_fpgaconfig", info_string, DXP_FPGA_TIMEOUT);
         return DXP_FPGA_TIMEOUT;
     }
 
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading CSR while checking XDONE for "
+                "ioChan = %d", *ioChan);
+        dxp_log_error("dxp_download_fpgaconfig", info_string, status);
+        return status;
+    }
+
     /* After FIPPI is downloaded, end the SLEEP mode */
     if ((*modChan!=ALLCHAN)&&(board->chanstate[*modChan].dspdownloaded==1)) {
         if ((status=dxp_end_control_task(ioChan, modChan, board))!=DXP_SUCCESS) {
@@ -1061,7 +1074,7 @@ static int dxp_download_dspconfig(int* ioChan, int* modChan, Board *board)
     length = dsp->proglen - 2;
 
     /* Retrieve MAXBLK and check if single transfer is needed */
-    maxblk=saturn_md_get_maxblk();
+    maxblk=saturn_md_get_maxblk(ioChan);
     if (maxblk <= 0) maxblk = length;
 
     /* prepare for the first pass thru loop */
@@ -1104,7 +1117,7 @@ static int dxp_download_dspconfig(int* ioChan, int* modChan, Board *board)
     saturn_md_wait(&timeout);
 
     for (i = 0; i < board->nchan; i++) {
-        status = dxp_wait_for_busy(ioChan, (int *)&i, board, 50, 0.0, 0.5);
+        status = dxp_wait_for_busy(ioChan, (int *)&i, board, 25.0, 0.0);
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Error waiting for DSP to boot ioChan = %d", *ioChan);
@@ -1132,39 +1145,35 @@ static int dxp_download_dsp_done(int* ioChan, int* modChan, int* mod,
 /* unsigned short *value;   Input: Value to match for BUSY  */
 /* float *timeout;     Input: How long to wait, in seconds */
 {
-    int status, i;
-    /* The value of the BUSY parameter */
-    double data;
-    /* Number of times to divide up the timeout period */
-    float divisions = 10.;
-    /* Time to wait between checking BUSY */
-    float wait;
+    int status;
+
+    Saturn_Wait_t w;
 
     ASSERT(board->dsp[*modChan] != NULL);
 
-    wait = *timeout/divisions;
+    w.ioChan  = ioChan;
+    w.modChan = modChan;
+    w.board   = board;
+    w.desired = (double)*value;
+    w.value   = 0.0;
 
-    for (i = 0; i < divisions; i++) {
-        /* readout the value of the BUSY parameter */
-        status = dxp_read_dspsymbol(ioChan, modChan, "BUSY", board, &data);
+    status = dxp_wait_until(XERXES_WAIT_BUSY, (double)*timeout, dxp_busy_done,
+                            &w, NULL);
 
-        sprintf(info_string, "BUSY = %0.1f", data);
-        dxp_log_debug("dxp_download_dsp_done", info_string);
+    sprintf(info_string, "BUSY = %0.1f", w.value);
+    dxp_log_debug("dxp_download_dsp_done", info_string);
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string,"Error reading BUSY from module %d channel %d", *mod, *modChan);
-            dxp_log_error("dxp_download_dsp_done",info_string,status);
-            return status;
-        }
-        /* Check if the BUSY parameter matches the requested value
-         * If match then return successful. */
-        if (((unsigned short) data)==(*value)) return DXP_SUCCESS;
-        /* Wait for another period and try again. */
-        saturn_md_wait(&wait);
+    if (status == DXP_SUCCESS) {
+        return DXP_SUCCESS;
+    }
+
+    if (status != DXP_TIMEOUT) {
+        sprintf(info_string,"Error reading BUSY from module %d channel %d", *mod, *modChan);
+        dxp_log_error("dxp_download_dsp_done",info_string,status);
+        return status;
     }
 
     /* If here, then timeout period reached.  Report error. */
-    status = DXP_TIMEOUT;
     sprintf(info_string,"Timeout waiting for DSP BUSY=%hu from module %d "
             "channel %d", *value, *mod, *modChan);
     dxp_log_error("dxp_download_dsp_done",info_string,status);
@@ -3137,7 +3146,6 @@ XERXES_STATIC int dxp_read_external_memory(int *ioChan, int *modChan, Board *boa
                                            unsigned long base, unsigned long offset, unsigned long *data)
 {
     int status;
-    int timeout       = 1000;
     int mem_buf_len   = 0;
     int requested_len = (int)offset;
     int current_len   = 0;
@@ -3148,9 +3156,8 @@ XERXES_STATIC int dxp_read_external_memory(int *ioChan, int *modChan, Board *boa
 
     unsigned long i;
 
-    float wait = 0.0;
-
-    double BUSY = 0.0;
+    double timeout = 1.0;
+    double BUSY    = 0.0;
 
     unsigned long *buf = NULL;
 
@@ -3174,8 +3181,6 @@ XERXES_STATIC int dxp_read_external_memory(int *ioChan, int *modChan, Board *boa
     }
 
     mem_buf_len = info[0];
-    /*  wait = (float)info[1]; */
-    wait = .001f;
 
     for (i = 0; requested_len > 0; requested_len -= mem_buf_len, i++) {
 
@@ -3207,7 +3212,7 @@ XERXES_STATIC int dxp_read_external_memory(int *ioChan, int *modChan, Board *boa
             return status;
         }
 
-        status = dxp_wait_for_busy(ioChan, modChan, board, timeout, BUSY, wait);
+        status = dxp_wait_for_busy(ioChan, modChan, board, timeout, BUSY);
 
         if (status != DXP_SUCCESS) {
             sprintf(info_string, "Error waiting for BUSY: ioChan = %d, modChan %d",
@@ -3271,7 +3276,6 @@ XERXES_STATIC int dxp_write_external_memory(int *ioChan, int *modChan, Board *bo
                                             unsigned long base, unsigned long offset, unsigned long *data)
 {
     int status;
-    int timeout       = 1000;
     int mem_buf_len   = 0;
     int requested_len = (int)offset;
     int current_len   = 0;
@@ -3282,9 +3286,8 @@ XERXES_STATIC int dxp_write_external_memory(int *ioChan, int *modChan, Board *bo
 
     short task = CT_SATURN_WRITE_MEMORY;
 
-    float wait = 0.0;
-
-    double BUSY = 0.0;
+    double timeout = 1.0;
+    double BUSY    = 0.0;
 
     int task_info[4];
 
@@ -3309,8 +3312,6 @@ XERXES_STATIC int dxp_write_external_memory(int *ioChan, int *modChan, Board *bo
 
 
     mem_buf_len = task_info[0];
-    /*  wait = (float)task_info[1]; */
-    wait = .001f;
 
     for (i = 0; requested_len > 0; requested_len -= mem_buf_len, i++) {
 
@@ -3357,7 +3358,7 @@ XERXES_STATIC int dxp_write_external_memory(int *ioChan, int *modChan, Board *bo
             return status;
         }
 
-        status = dxp_wait_for_busy(ioChan, modChan, board, timeout, BUSY, wait);
+        status = dxp_wait_for_busy(ioChan, modChan, board, timeout, BUSY);
 
         if (status != DXP_SUCCESS) {
             saturn_md_free(info);
@@ -3386,15 +3387,14 @@ XERXES_STATIC int dxp_write_external_memory(int *ioChan, int *modChan, Board *bo
 
 
 /*
- * Wait for BUSY to go to a certain value within the number of iterations.
+ * Wait for BUSY to go to a certain value within timeout seconds.
  */
 XERXES_STATIC int dxp_wait_for_busy(int *ioChan, int *modChan, Board *board,
-                                    int n_timeout, double busy, float wait)
+                                    double timeout, double busy)
 {
     int status;
-    int i;
 
-    double BUSY = 0.0;
+    Saturn_Wait_t w;
 
 
 
@@ -3403,31 +3403,78 @@ XERXES_STATIC int dxp_wait_for_busy(int *ioChan, int *modChan, Board *board,
     ASSERT(board != NULL);
 
 
-    for (i = 0; i < n_timeout; i++) {
-        status = dxp_read_dspsymbol(ioChan, modChan, "BUSY", board, &BUSY);
-
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading BUSY: ioChan = %d, modChan = %d",
-                    *ioChan, *modChan);
-            dxp_log_error("dxp_wait_for_busy", info_string, status);
-            return status;
-        }
-
-        if (BUSY == 0.0) {
-            break;
-        }
+    w.ioChan  = ioChan;
+    w.modChan = modChan;
+    w.board   = board;
+    w.desired = busy;
+    w.value   = 0.0;
 
-        saturn_md_wait(&wait);
-    }
+    status = dxp_wait_until(XERXES_WAIT_BUSY, timeout, dxp_busy_done, &w, NULL);
 
-    if (i == n_timeout) {
-        sprintf(info_string, "Timeout (%d iterations, %f s per iteration) waiting "
+    if (status == DXP_TIMEOUT) {
+        sprintf(info_string, "Timeout (%0.3f s) waiting "
                 "for BUSY to go to %u (current = %0.0f)",
-                n_timeout, wait, (unsigned short)busy, BUSY);
+                timeout, (unsigned short)busy, w.value);
         dxp_log_error("dxp_wait_for_busy", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
 
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading BUSY: ioChan = %d, modChan = %d",
+                *ioChan, *modChan);
+        dxp_log_error("dxp_wait_for_busy", info_string, status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: BUSY has reached the desired value.
+ */
+static int dxp_busy_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    Saturn_Wait_t *w = (Saturn_Wait_t *)ctx;
+
+
+    status = dxp_read_dspsymbol(w->ioChan, w->modChan, "BUSY", w->board,
+                                &w->value);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)((unsigned short)w->value == (unsigned short)w->desired);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: XDONE has cleared the FiPPI error bit in the
+ * CSR.
+ */
+static int dxp_xdone_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    unsigned short data;
+
+    Saturn_Wait_t *w = (Saturn_Wait_t *)ctx;
+
+
+    status = dxp_read_csr(w->ioChan, &data);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    w->value = (double)data;
+    *done = (boolean_t)((data & MASK_FIPERR) == 0);
+
     return DXP_SUCCESS;
 }
 
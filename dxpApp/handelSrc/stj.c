@@ -48,6 +48,7 @@
 #include "xerxes_generic.h"
 
 #include "stj.h"
+#include "xerxes_wait.h"
 
 
 typedef int (*FPGA_downloader_func_t)(int ioChan, int modChan, Board *board);
@@ -62,6 +63,18 @@ typedef struct _FPGA_downloader {
 
 } FPGA_downloader_t;
 
+/* State passed to the dxp_wait_until() conditions. */
+typedef struct _Stj_Wait {
+    int ioChan;
+    int modChan;
+    Board *board;
+
+    /* Value to wait for and the last value read from the hardware. */
+    unsigned long desired;
+    unsigned long value;
+
+} Stj_Wait_t;
+
 
 /*
  * Pointer to utility functions
@@ -102,6 +115,10 @@ static int dxp__process_trace_param(int ioChan, int modChan, unsigned int len,
                                     int *info, Board *b);
 static int dxp__do_trace(int ioChan, int modChan, Board *board);
 static int dxp__run_enable_active(int ioChan, int *active);
+static int dxp__busy_done(void *ctx, boolean_t *done);
+static int dxp__cfg_status_done(void *ctx, boolean_t *done);
+static int dxp__dsp_active_done(void *ctx, boolean_t *done);
+static int dxp__apply_done(void *ctx, boolean_t *done);
 
 /* FPGA downloaders */
 static int dxp_download_fippis(int ioChan, int modChan, Board *b);
@@ -1942,12 +1959,16 @@ XERXES_STATIC int dxp_download_fpga(int ioChan, unsigned long target,
 
     unsigned long cfg_status;
     unsigned long j;
-
-
+    unsigned long init_mask  = 0;
+    unsigned long xdone_mask = 0;
 
     float init_timeout  = .003f;
     float xdone_timeout = .001f;
 
+    float settle = XERXES_WAIT_FPGA_SETTLE;
+
+    Stj_Wait_t w;
+
 
     ASSERT(fpga != NULL);
 
@@ -1965,20 +1986,35 @@ XERXES_STATIC int dxp_download_fpga(int ioChan, unsigned long target,
         return status;
     }
 
-    /* The simplest thing to do is to just wait the allowed timeout time,
-     * especially if it is short and then see if the value is correct. Future
-     * optimizations can focus on writing a special timeout loop.
+    for (j = 0; j < STJ_NUM_TARGETS; j++) {
+        if (target & (1 << j)) {
+            init_mask  |= STJ_CFG_STATUS[j][STJ_INIT];
+            xdone_mask |= STJ_CFG_STATUS[j][STJ_XDONE];
+        }
+    }
+
+    /* Poll the Status Register until INIT* is asserted for every target
+     * or the allowed time has passed. A timeout is reported per target by
+     * the check below. The lines are not valid until the Control Register
+     * write has settled, so they are not sampled before that.
      */
-    stj_md_wait(&init_timeout);
+    stj_md_wait(&settle);
 
-    status = dxp_read_global_register(ioChan, STJ_REG_CFG_STATUS, &cfg_status);
+    w.ioChan  = ioChan;
+    w.desired = init_mask;
+    w.value   = 0;
 
-    if (status != DXP_SUCCESS) {
+    status = dxp_wait_until(XERXES_WAIT_FPGA, (double)init_timeout,
+                            dxp__cfg_status_done, &w, NULL);
+
+    if (status != DXP_SUCCESS && status != DXP_TIMEOUT) {
         sprintf(info_string, "Error reading Status Register for channel %d", ioChan);
         dxp_log_error("dxp_download_fpga", info_string, status);
         return status;
     }
 
+    cfg_status = w.value;
+
     /* Since the target could potentially be more then one FPGA, we must check
      * the INIT* line for each FPGA that is targeted.
      */
@@ -2026,16 +2062,30 @@ XERXES_STATIC int dxp_download_fpga(int ioChan, unsigned long target,
         }
     }
 
-    stj_md_wait(&xdone_timeout);
+    w.desired = xdone_mask;
+    w.value   = 0;
 
-    status = dxp_read_global_register(ioChan, STJ_REG_CFG_STATUS, &cfg_status);
+    stj_md_wait(&settle);
 
-    if (status != DXP_SUCCESS) {
+    status = dxp_wait_until(XERXES_WAIT_FPGA, (double)xdone_timeout,
+                            dxp__cfg_status_done, &w, NULL);
+
+    /* INIT* can de-assert on a CRC error after XDONE was first seen, so the
+     * Status Register is read again once the lines have settled.
+     */
+    if (status == DXP_SUCCESS) {
+        stj_md_wait(&settle);
+        status = dxp_read_global_register(ioChan, STJ_REG_CFG_STATUS, &w.value);
+    }
+
+    if (status != DXP_SUCCESS && status != DXP_TIMEOUT) {
         sprintf(info_string, "Error reading Status Register for channel %d", ioChan);
         dxp_log_error("dxp_download_fpga", info_string, status);
         return status;
     }
 
+    cfg_status = w.value;
+
     /* See the comment above (where INIT* is checked). */
     for (j = 0; j < STJ_NUM_TARGETS; j++) {
         if (target & (1 << j)) {
@@ -2201,10 +2251,9 @@ XERXES_STATIC int dxp_boot_dsp(int ioChan, int modChan, Board *b)
 {
     int status;
 
-    unsigned long dsp_active;
+    double elapsed = 0.0;
 
-    float wait = 0.001f;
-    float elapsed = 0.0;
+    Stj_Wait_t w;
 
 
     ASSERT(b != NULL);
@@ -2222,32 +2271,25 @@ XERXES_STATIC int dxp_boot_dsp(int ioChan, int modChan, Board *b)
         return status;
     }
 
-    do {
-        unsigned long csr;
-
-        stj_md_wait(&wait);
-        elapsed += wait;
-
-        status = dxp_read_global_register(ioChan, STJ_REG_CSR, &csr);
+    w.ioChan = ioChan;
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error waiting for DSP to signal that it is "
-                    "active for ioChan = %d.", ioChan);
-            dxp_log_error("dxp_boot_dsp", info_string, status);
-            return status;
-        }
+    status = dxp_wait_until(XERXES_WAIT_DSP_BOOT, STJ_DSP_BOOT_ACTIVE_TIMEOUT,
+                            dxp__dsp_active_done, &w, &elapsed);
 
-        dsp_active = csr & (1 << STJ_CSR_DSP_ACT_BIT);
-
-    } while (!dsp_active && elapsed < STJ_DSP_BOOT_ACTIVE_TIMEOUT);
-
-    if (elapsed >= STJ_DSP_BOOT_ACTIVE_TIMEOUT) {
+    if (status == DXP_TIMEOUT) {
         sprintf(info_string, "Timeout (%0.1f s) waiting for DSP Active bit in "
                 "the CSR to be set for ioChan = %d.", elapsed, ioChan);
         dxp_log_error("dxp_boot_dsp", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
 
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error waiting for DSP to signal that it is "
+                "active for ioChan = %d.", ioChan);
+        dxp_log_error("dxp_boot_dsp", info_string, status);
+        return status;
+    }
+
     /* Once we have established that the DSP is active, it is safe to
      * poll waiting for busy. Extra long wait for the STJ time out
      */
@@ -2414,45 +2456,138 @@ static int dxp_wait_for_busy(int ioChan, int modChan, parameter_t desired,
                              double timeout, Board *board)
 {
     int status;
-    int n_polls = 0;
-    int i;
 
-    float wait = .01f;
+    double elapsed = 0.0;
 
-    double BUSY = 0;
+    Stj_Wait_t w;
 
 
     ASSERT(board != NULL);
 
 
-    n_polls = (int)ROUND(timeout / wait);
+    w.ioChan  = ioChan;
+    w.modChan = modChan;
+    w.board   = board;
+    w.desired = (unsigned long)desired;
+    w.value   = 0;
+
+    status = dxp_wait_until(XERXES_WAIT_BUSY, timeout, dxp__busy_done, &w,
+                            &elapsed);
+
+    if (status == DXP_TIMEOUT) {
+        sprintf(info_string, "Timeout waiting for BUSY to go to %hu (current = "
+                "%lu) on ioChan = %d", desired, w.value, ioChan);
+        dxp_log_error("dxp_wait_for_busy", info_string, DXP_TIMEOUT);
+        return DXP_TIMEOUT;
+    }
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading BUSY while waiting for BUSY to go "
+                "to %hu on ioChan = %d", desired, ioChan);
+        dxp_log_error("dxp_wait_for_busy", info_string, status);
+        return status;
+    }
 
-    sprintf(info_string, "Max. polls for waiting for BUSY = %d", n_polls);
+    sprintf(info_string, "BUSY went to %hu after %0.6f s on ioChan = %d",
+            desired, elapsed, ioChan);
     dxp_log_debug("dxp_wait_for_busy", info_string);
 
-    for (i = 0; i < n_polls; i++) {
+    return DXP_SUCCESS;
+}
 
-        status = dxp_read_dspsymbol(&ioChan, &modChan, "BUSY", board, &BUSY);
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading BUSY during poll iteration %d while "
-                    "waiting for BUSY to go to %hu on ioChan = %d", i, desired,
-                    ioChan);
-            dxp_log_error("dxp_wait_for_busy", info_string, status);
-            return status;
-        }
+/*
+ * dxp_wait_until() condition: BUSY has reached the desired value.
+ */
+static int dxp__busy_done(void *ctx, boolean_t *done)
+{
+    int status;
 
-        if (BUSY == (double)desired) {
-            return DXP_SUCCESS;
-        }
+    double BUSY = 0;
 
-        stj_md_wait(&wait);
+    Stj_Wait_t *w = (Stj_Wait_t *)ctx;
+
+
+    status = dxp_read_dspsymbol(&w->ioChan, &w->modChan, "BUSY", w->board,
+                                &BUSY);
+
+    if (status != DXP_SUCCESS) {
+        return status;
     }
 
-    sprintf(info_string, "Timeout waiting for BUSY to go to %hu (current = "
-            "%0.0f) on ioChan = %d", desired, BUSY, ioChan);
-    dxp_log_error("dxp_wait_for_busy", info_string, DXP_TIMEOUT);
-    return DXP_TIMEOUT;
+    w->value = (unsigned long)BUSY;
+    *done = (boolean_t)(w->value == w->desired);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: all of the desired bits are set in the FPGA
+ * configuration Status Register.
+ */
+static int dxp__cfg_status_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    Stj_Wait_t *w = (Stj_Wait_t *)ctx;
+
+
+    status = dxp_read_global_register(w->ioChan, STJ_REG_CFG_STATUS,
+                                      &w->value);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)((w->value & w->desired) == w->desired);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: the DSP Active bit is set in the CSR.
+ */
+static int dxp__dsp_active_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    Stj_Wait_t *w = (Stj_Wait_t *)ctx;
+
+
+    status = dxp_read_global_register(w->ioChan, STJ_REG_CSR, &w->value);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)((w->value & (1 << STJ_CSR_DSP_ACT_BIT)) != 0);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: the apply run has cleared run enable.
+ */
+static int dxp__apply_done(void *ctx, boolean_t *done)
+{
+    int status;
+    int active;
+
+    Stj_Wait_t *w = (Stj_Wait_t *)ctx;
+
+
+    status = dxp__run_enable_active(w->ioChan, &active);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)(!active);
+
+    return DXP_SUCCESS;
 }
 
 
@@ -2516,13 +2651,11 @@ static int dxp_get_adc_trace(int ioChan, int modChan, unsigned long *data,
 static int dxp_do_apply(int ioChan, int modChan, Board *board)
 {
     int status;
-    int active;
-    int n_polls;
-    int i;
 
     double timeout    = 1.0;
+    double elapsed    = 0.0;
 
-    float poll_interval = 0.1f;
+    Stj_Wait_t w;
 
     ASSERT(board != NULL);
 
@@ -2535,40 +2668,29 @@ static int dxp_do_apply(int ioChan, int modChan, Board *board)
         return status;
     }
 
-    /* We have an approximate timeout here since we don't include the
-     * time it takes to call dxp__run_enable_active() in the calculation.
-     */
-    n_polls = (int)ROUND(timeout / (double)poll_interval);
-
-    sprintf(info_string, "n_polls = %d, timeout = %0.1f, poll_interval = %0.1f",
-            n_polls, (double)timeout, (double)poll_interval);
-    dxp_log_debug("dxp_do_apply", info_string);
-
-    for (i = 0; i < n_polls; i++) {
-        status = dxp__run_enable_active(ioChan, &active);
+    w.ioChan = ioChan;
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading run enable for ioChan = %d", ioChan);
-            dxp_log_error("dxp_do_apply", info_string, status);
-            return status;
-        }
+    status = dxp_wait_until(XERXES_WAIT_APPLY, timeout, dxp__apply_done, &w,
+                            &elapsed);
 
-        if (!active) {
-            /* The apply is complete. */
-            break;
-        }
-
-        stj_md_wait(&poll_interval);
-    }
-
-    if (i == n_polls) {
+    if (status == DXP_TIMEOUT) {
         status = dxp_end_run(&ioChan, &modChan, board);
         sprintf(info_string, "Timeout waiting %0.1f second(s) for the apply run "
-                "to complete on ioChan = %d", (double)timeout, ioChan);
+                "to complete on ioChan = %d", elapsed, ioChan);
         dxp_log_error("dxp_do_apply", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
 
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading run enable for ioChan = %d", ioChan);
+        dxp_log_error("dxp_do_apply", info_string, status);
+        return status;
+    }
+
+    sprintf(info_string, "Apply run completed in %0.6f s on ioChan = %d",
+            elapsed, ioChan);
+    dxp_log_debug("dxp_do_apply", info_string);
+
     return DXP_SUCCESS;
 }
 
@@ -82,10 +82,12 @@ int dxp_usb2_reset_bus(int modChan, Board *board);
 
 int dxp_usb2_reticulate_address(int modChan, byte_t *cmd, unsigned long *addr);
 
-static int dxp__update_version_cache(int modChan, Board *board, Xia_Util_Functions funcs);
-static int dxp__check_status(Board *board, Xia_Util_Functions funcs);
+static int dxp__update_version_cache(int modChan, Board *board);
+static int dxp__check_status(Board *board);
 
 static boolean_t dxp_is_usb(Board *board);
+static int dxp__reserve_buffer(void **buf, unsigned int *len, unsigned int n,
+                               size_t size);
 
 /* Cache for the version number of a given microDXP ioChan. Since we need a way
  * to know if we have actively gathered this informaton or not, 0xFF will mean
@@ -96,20 +98,63 @@ static byte_t VERSION_CACHE[MAXMOD][VERSION_NUMBERS];
 
 #define UDXP_VERSION_NOT_READ 0xFF
 
-#define UDXP_FREE(x)   udxpc_md_free((void *)(x)); \
-                  (x) = NULL
+static char INFO_STRING[INFO_LEN];
 
+/* MD utility routines, filled in once by dxp_init_pic_version_cache(). */
+static Xia_Util_Functions funcs;
 
-static char INFO_STRING[INFO_LEN];
+/* Command and response buffers reused by every dxp_send_command() and
+ * dxp_read_response(). They grow to the largest transfer seen and are never
+ * freed.
+ */
+static byte_t *CMD_BYTES = NULL;
+static unsigned int CMD_BYTES_LEN = 0;
+static unsigned short *IO_WORDS = NULL;
+static unsigned int IO_WORDS_LEN = 0;
 
 /*
  *Reset the state of all ioChans in the variant cache to "unread".
  */
 XERXES_SHARED void dxp_init_pic_version_cache(void)
 {
+    dxp_md_init_util(&funcs, NULL);
+
     memset(VERSION_CACHE, UDXP_VERSION_NOT_READ, sizeof(VERSION_CACHE));
 }
 
+/*
+ * Grows one of the reusable command buffers to at least n elements of
+ * size bytes each.
+ */
+static int dxp__reserve_buffer(void **buf, unsigned int *len, unsigned int n,
+                               size_t size)
+{
+    void *b = NULL;
+
+
+    if (n <= *len) {
+        return DXP_SUCCESS;
+    }
+
+    b = udxpc_md_alloc(n * size);
+
+    if (!b) {
+        sprintf(INFO_STRING, "Out-of-memory allocating %zu bytes for a command "
+                "buffer", n * size);
+        udxpc_log_error("dxp__reserve_buffer", INFO_STRING, DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    if (*buf != NULL) {
+        udxpc_md_free(*buf);
+    }
+
+    *buf = b;
+    *len = n;
+
+    return DXP_SUCCESS;
+}
+
 /*
  * Check if the board is USB2 by testing the string in interface dll name
  */
@@ -190,19 +235,16 @@ XERXES_SHARED int dxp_command(int modChan, Board *board, byte_t cmd,
 
     unsigned long address = 0;
 
-    Xia_Util_Functions funcs;
 
     ASSERT(lenR >= RECV_BASE);
     ASSERT(receive != NULL);
 
-    dxp_md_init_util(&funcs, NULL);
-
     /* This should only be updated once per microDXP. */
     if (VERSION_CACHE[board->ioChan][PIC_VARIANT] == UDXP_VERSION_NOT_READ) {
         sprintf(INFO_STRING, "Initializing variant cache for ioChan %d", board->ioChan);
         udxpc_log_debug("dxp_command", INFO_STRING);
 
-        status = dxp__update_version_cache(modChan, board, funcs);
+        status = dxp__update_version_cache(modChan, board);
 
         if (status != DXP_SUCCESS) {
             sprintf(INFO_STRING, "Error updating the variant cache for ioChan %d",
@@ -270,9 +312,6 @@ XERXES_SHARED int dxp_usb_read_block(int modChan, Board *board,
 
     unsigned long usbaddress = addr | ((unsigned long)modChan) << 16;
 
-    Xia_Util_Functions funcs;
-
-    dxp_md_init_util(&funcs, NULL);
     ASSERT(data != NULL);
 
     if (!dxp_is_usb(board)) {
@@ -314,8 +353,6 @@ XERXES_SHARED int dxp_usb_write_block(int modChan, Board *board,
     unsigned int serial_write = 1;
     unsigned int n_words;
 
-    Xia_Util_Functions funcs;
-
     unsigned long usbaddress = addr | ((unsigned long)modChan) << 16;
 
 #ifdef XIA_ALPHA
@@ -325,8 +362,6 @@ XERXES_SHARED int dxp_usb_write_block(int modChan, Board *board,
     ASSERT(n > 0);
     ASSERT(data);
 
-    dxp_md_init_util(&funcs, NULL);
-
     if (!dxp_is_usb(board)) {
         udxpc_log_error("dxp_usb_write_block", "Direct memory writes are only "
                       "supported in USB mode.", DXP_UNIMPLEMENTED);
@@ -422,13 +457,9 @@ int dxp_usb2_reset_bus(int modChan, Board *board)
     unsigned long a = DXP_A_IO;
 
     unsigned int dummyWordLength = 1;
-    unsigned short *dummyWord = NULL;
-
-    Xia_Util_Functions funcs;
+    unsigned short dummyWord = 0;
 
 
-    dxp_md_init_util(&funcs, NULL);
-
     status = dxp_usb2_set_address_cache(board, usbaddress);
 
     if (status != DXP_SUCCESS) {
@@ -438,11 +469,7 @@ int dxp_usb2_reset_bus(int modChan, Board *board)
         return status;
     }
 
-    dummyWord = (unsigned short *)udxpc_md_alloc(dummyWordLength * sizeof(unsigned short));
-    dummyWord[0] = 0;
-
-    status = dxp_md_io(board, serial_write, a, (void *)dummyWord, dummyWordLength);
-    UDXP_FREE(dummyWord);
+    status = dxp_md_io(board, serial_write, a, (void *)&dummyWord, dummyWordLength);
 
     if (status != DXP_SUCCESS) {
         sprintf(INFO_STRING, "Error writing to ioChan %d to reset bus", board->ioChan);
@@ -468,8 +495,6 @@ int dxp_usb2_reset_fifo(int modChan, Board *board)
     unsigned long retlen = 2;
     unsigned short version[2];
 
-    Xia_Util_Functions funcs;
-    dxp_md_init_util(&funcs, NULL);
 
 
 #ifdef XIA_ALPHA
@@ -510,78 +535,59 @@ int dxp_send_command(Board *board, unsigned long address,
     unsigned int totalCmdLen  = (unsigned int)(lenS + 5);
     unsigned int cmdWords = 0;
 
-    byte_t *byteCmd = NULL;
-    byte_t *byteCmdPtr = NULL;
-    unsigned short *shortCmd = NULL;
-
-    Xia_Util_Functions funcs;
+    boolean_t isUSB = dxp_is_usb(board);
 
 
     if (lenS > 0) {
         ASSERT(send != NULL);
     }
 
-    dxp_md_init_util(&funcs, NULL);
+    /* The MD layer requires the data array to be of size unsigned short */
+    if (isUSB) {
+        cmdWords = (totalCmdLen + 1) / 2;
+    } else {
+        cmdWords = totalCmdLen;
+    }
 
-    /* Build the command string to pass to the board. */
-    byteCmd = (byte_t *)udxpc_md_alloc(totalCmdLen * sizeof(byte_t));
+    status = dxp__reserve_buffer((void **)&CMD_BYTES, &CMD_BYTES_LEN,
+                                 totalCmdLen + 1, sizeof(byte_t));
 
-    if (!byteCmd) {
-        sprintf(INFO_STRING, "Out-of-memory allocating %u bytes for 'byteCmd'",
-                totalCmdLen);
-        udxpc_log_error("dxp_send_command", INFO_STRING, DXP_NOMEM);
-        return DXP_NOMEM;
+    if (status == DXP_SUCCESS) {
+        status = dxp__reserve_buffer((void **)&IO_WORDS, &IO_WORDS_LEN,
+                                     cmdWords, sizeof(unsigned short));
     }
 
-    status = dxp_build_cmdstr(cmd, (unsigned short)lenS, send, byteCmd);
-
     if (status != DXP_SUCCESS) {
-        UDXP_FREE(byteCmd);
-        sprintf(INFO_STRING, "Error building command: cmd = %u", cmd);
+        sprintf(INFO_STRING, "Error allocating buffers for a %u byte command",
+                totalCmdLen);
         udxpc_log_error("dxp_send_command", INFO_STRING, status);
         return status;
     }
 
-    /* The MD layer requires the data array to be of size unsigned short */
-    if (dxp_is_usb(board)) {
-        cmdWords = (unsigned int) (((float) totalCmdLen + 1.) / 2.);
-    } else {
-        cmdWords = totalCmdLen;
-    }
+    /* Build the command string to pass to the board. */
+    status = dxp_build_cmdstr(cmd, (unsigned short)lenS, send, CMD_BYTES);
 
-    shortCmd = (unsigned short *)udxpc_md_alloc(cmdWords *
-                                                sizeof(unsigned short));
-    if (!shortCmd) {
-        UDXP_FREE(byteCmd);
-        status = DXP_NOMEM;
-        sprintf(INFO_STRING, "Out-of-memory allocating %zu bytes for 'shortCmd'",
-                cmdWords * sizeof(unsigned short));
-        udxpc_log_error("dxp_send_command", INFO_STRING, DXP_NOMEM);
-        return DXP_NOMEM;
+    if (status != DXP_SUCCESS) {
+        sprintf(INFO_STRING, "Error building command: cmd = %u", cmd);
+        udxpc_log_error("dxp_send_command", INFO_STRING, status);
+        return status;
     }
 
-    if (dxp_is_usb(board)) {
-        memcpy(shortCmd, byteCmd, totalCmdLen);
-        /* Pad the last byte of shortCmd if sending an odd number of bytes */
-        if (totalCmdLen < cmdWords * 2) {
-            byteCmdPtr = (byte_t *)shortCmd;
-            byteCmdPtr[totalCmdLen] = 0;
-        }
+    if (isUSB) {
+        /* Pad the last byte of the words if sending an odd number of bytes */
+        CMD_BYTES[totalCmdLen] = 0;
+        memcpy(IO_WORDS, CMD_BYTES, cmdWords * 2);
     } else {
         for (i = 0; i < totalCmdLen; i++) {
-            shortCmd[i] = (unsigned short)byteCmd[i];
+            IO_WORDS[i] = (unsigned short)CMD_BYTES[i];
         }
     }
 
-    UDXP_FREE(byteCmd);
-
-
     /* set address cache for USB2 */
-    if (dxp_is_usb(board)) {
+    if (isUSB) {
         status = dxp_usb2_set_address_cache(board, address);
 
         if (status != DXP_SUCCESS) {
-            UDXP_FREE(shortCmd);
             sprintf(INFO_STRING, "Error setting address cache for ioChan %d", board->ioChan);
             udxpc_log_error("dxp_send_command", INFO_STRING, status);
             return status;
@@ -589,18 +595,15 @@ int dxp_send_command(Board *board, unsigned long address,
     }
 
     /* Send the command */
-    status = dxp_md_io(board, serial_write, a, (void *)shortCmd, cmdWords);
+    status = dxp_md_io(board, serial_write, a, (void *)IO_WORDS, cmdWords);
 
     if (status != DXP_SUCCESS) {
-        UDXP_FREE(shortCmd);
         sprintf(INFO_STRING, "Error sending command %#x to ioChan %d",
                 cmd, board->ioChan);
         udxpc_log_error("dxp_send_command", INFO_STRING, status);
         return status;
     }
 
-    UDXP_FREE(shortCmd);
-
     return DXP_SUCCESS;
 }
 
@@ -622,12 +625,8 @@ int dxp_read_response(Board *board, unsigned long address,
     unsigned long WAIT_IN_MS = 10000;
     unsigned long a;
 
-    unsigned short *shortRet = NULL;
     float linux_read_wait = (float) LINUX_WAIT_BEFORE_READ;
 
-    Xia_Util_Functions funcs;
-
-    dxp_md_init_util(&funcs, NULL);
 
     if (lenR > 0) {
         ASSERT(receive != NULL);
@@ -644,14 +643,14 @@ int dxp_read_response(Board *board, unsigned long address,
         a = WAIT_IN_MS;
     }
 
-    shortRet = (unsigned short *)udxpc_md_alloc(retWords * sizeof(unsigned short));
+    status = dxp__reserve_buffer((void **)&IO_WORDS, &IO_WORDS_LEN, retWords,
+                                 sizeof(unsigned short));
 
-    if (!shortRet) {
-        status = DXP_NOMEM;
-        sprintf(INFO_STRING, "Out-of-memory allocating %zu bytes for 'shortRet'",
-                lenR * sizeof(unsigned short));
-        udxpc_log_error("dxp_read_response", INFO_STRING, DXP_NOMEM);
-        return DXP_NOMEM;
+    if (status != DXP_SUCCESS) {
+        sprintf(INFO_STRING, "Error allocating the buffer for a %u byte response",
+                lenR);
+        udxpc_log_error("dxp_read_response", INFO_STRING, status);
+        return status;
     }
 
     /* Set address cache for USB2 */
@@ -659,7 +658,6 @@ int dxp_read_response(Board *board, unsigned long address,
         status = dxp_usb2_set_address_cache(board, address);
 
         if (status != DXP_SUCCESS) {
-            UDXP_FREE(shortRet);
             sprintf(INFO_STRING, "Error setting address cahche for ioChan %d", board->ioChan);
             udxpc_log_error("dxp_read_response", INFO_STRING, status);
             return status;
@@ -677,10 +675,9 @@ int dxp_read_response(Board *board, unsigned long address,
     }
 
     /* Receive the response */
-    status = dxp_md_io(board, serial_read, a, (void *)shortRet, retWords);
+    status = dxp_md_io(board, serial_read, a, (void *)IO_WORDS, retWords);
 
     if (status != DXP_SUCCESS) {
-        UDXP_FREE(shortRet);
         sprintf(INFO_STRING, "Error reading response from ioChan %d", board->ioChan);
         udxpc_log_error("dxp_read_response", INFO_STRING, status);
         return status;
@@ -688,17 +685,15 @@ int dxp_read_response(Board *board, unsigned long address,
 
     /* Unpack from ushort for USB2 */
     if (dxp_is_usb(board)) {
-        memcpy(receive, shortRet, lenR);
+        memcpy(receive, IO_WORDS, lenR);
     } else {
 
         for (i = 0; i < lenR; i++) {
-            receive[i] = (byte_t)(shortRet[i] & 0xFF);
+            receive[i] = (byte_t)(IO_WORDS[i] & 0xFF);
         }
 
     }
 
-    UDXP_FREE(shortRet);
-
     return DXP_SUCCESS;
 }
 
@@ -722,9 +717,6 @@ int dxp_verify_response(byte_t cmd, unsigned int lenS, byte_t *send,
     byte_t retChksm     = 0x00;
     byte_t calcChksm    = 0x00;
 
-    Xia_Util_Functions funcs;
-
-    dxp_md_init_util(&funcs, NULL);
 
     if (lenS > 0) { ASSERT(send != NULL); }
     if (lenR > 0) { ASSERT(receive != NULL); }
@@ -811,14 +803,6 @@ int dxp_usb2_set_address_cache(Board *board, unsigned long address)
 
     unsigned long a;
 
-    Xia_Util_Functions funcs;
-
-    /* Initialize our function pointers
-     * so that we can allocate memory
-     * safely.
-     */
-    dxp_md_init_util(&funcs, NULL);
-
 
     /* Write the address to the cache. */
     a   = DXP_A_ADDR;
@@ -864,7 +848,7 @@ XERXES_SHARED int dxp_byte_to_string(unsigned char *bytes, unsigned int len, cha
  * Read the board information and store the variant information in the
  * cache.
  */
-static int dxp__update_version_cache(int modChan, Board *board, Xia_Util_Functions funcs)
+static int dxp__update_version_cache(int modChan, Board *board)
 {
     int status;
 
@@ -900,7 +884,7 @@ static int dxp__update_version_cache(int modChan, Board *board, Xia_Util_Functio
     }
 
     /* Another initialization routine to check status of board */
-    status = dxp__check_status(board, funcs);
+    status = dxp__check_status(board);
 
     if (status != DXP_SUCCESS) {
         sprintf(INFO_STRING, "Error checking board status for ioChan %d", board->ioChan);
@@ -957,7 +941,7 @@ static int dxp__update_version_cache(int modChan, Board *board, Xia_Util_Functio
 /*
  * Read the board status and print in log for debugging.
  */
-static int dxp__check_status(Board *board, Xia_Util_Functions funcs)
+static int dxp__check_status(Board *board)
 {
     int status;
     unsigned long addr = 0;
@@ -87,6 +87,10 @@ static unsigned short ALPHA_NEXT_N_EVENTS[2];
 static unsigned long ALPHA_EVENT_COUNT[2];
 #endif /* XIA_ALPHA */
 
+/* Receive buffer reused by pslGetMcaCmd(). */
+static byte_t *mcaReceive = NULL;
+static unsigned int mcaReceiveLen = 0;
+
 /* Prototypes */
 
 /* Exports */
@@ -3552,10 +3556,12 @@ PSL_STATIC int pslGetMcaCmd(int detChan, byte_t cmd,
     unsigned int dataLen;
     unsigned int lenS = 5;
     unsigned int lenR = 0;
+    unsigned int nBins;
 
     byte_t send[5];
 
     byte_t *receive = NULL;
+    byte_t *bins = NULL;
 
     unsigned long *data = (unsigned long *)value;
 
@@ -3593,30 +3599,62 @@ PSL_STATIC int pslGetMcaCmd(int detChan, byte_t cmd,
     send[3] = HI_BYTE((unsigned short)numMCAChans);
     send[4] = (byte_t)bytesPerBin;
 
-    receive = (byte_t *)utils->funcs->dxp_md_alloc(lenR * sizeof(byte_t));
+    /* The receive buffer is kept between calls, since spectra are read
+     * repeatedly during a run.
+     */
+    if (lenR > mcaReceiveLen) {
+        receive = (byte_t *)utils->funcs->dxp_md_alloc(lenR * sizeof(byte_t));
 
-    if (receive == NULL) {
-        pslLogError("pslGetMcaCmd", "Out-of-memory trying to create "
-                    "receive array", XIA_NOMEM);
-        return XIA_NOMEM;
+        if (receive == NULL) {
+            pslLogError("pslGetMcaCmd", "Out-of-memory trying to create "
+                        "receive array", XIA_NOMEM);
+            return XIA_NOMEM;
+        }
+
+        if (mcaReceive != NULL) {
+            utils->funcs->dxp_md_free((void *)mcaReceive);
+        }
+
+        mcaReceive    = receive;
+        mcaReceiveLen = lenR;
     }
 
+    receive = mcaReceive;
+
     status = dxp_cmd(&detChan, &cmd, &lenS, send, &lenR, receive);
 
     if (status != DXP_SUCCESS) {
-        utils->funcs->dxp_md_free((void *)receive);
         sprintf(info_string, "Error getting MCA data from detChan %d", detChan);
         pslLogError("pslGetMcaCmd", info_string, status);
         return status;
     }
 
     /* Transfer the spectra to the user's array. */
-    for (i = 0; i < numMCAChans; i++) {
-        data[i] = pslUlFromBytesOffset(receive, (int)bytesPerBin,
-                            RECV_BASE + i * (int)bytesPerBin);
+    bins = receive + RECV_BASE;
+    nBins = (unsigned int)numMCAChans;
+
+    switch ((int)bytesPerBin) {
+    case 2:
+        for (i = 0; i < nBins; i++, bins += 2) {
+            data[i] = (unsigned long)bins[0] | ((unsigned long)bins[1] << 8);
+        }
+        break;
+
+    case 3:
+        for (i = 0; i < nBins; i++, bins += 3) {
+            data[i] = (unsigned long)bins[0] | ((unsigned long)bins[1] << 8) |
+                ((unsigned long)bins[2] << 16);
+        }
+        break;
+
+    default:
+        for (i = 0; i < nBins; i++) {
+            data[i] = pslUlFromBytesOffset(receive, (int)bytesPerBin,
+                                RECV_BASE + i * (int)bytesPerBin);
+        }
+        break;
     }
 
-    utils->funcs->dxp_md_free((void *)receive);
     return XIA_SUCCESS;
 }
 
@@ -56,6 +56,8 @@
 #include "xia_xerxes_structures.h"
 #include "xia_xerxes.h"
 #include "xerxes_errors.h"
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
 
 
 #include "xia_assert.h"
@@ -78,12 +80,17 @@ XERXES_STATIC int dxp_free_binfo(Board_Info *binfo);
 XERXES_STATIC int dxp_add_fippi(char *, Board_Info *, Fippi_Info **);
 XERXES_STATIC int dxp_add_dsp(char *, Board_Info *, Dsp_Info **);
 XERXES_STATIC int dxp_add_iface(char *dllname, char *iolib, Interface **iface);
+XERXES_STATIC void dxp_md_record_time(char *group, char *name, double elapsed,
+                                      double amount);
 XERXES_STATIC int dxp_do_readout(Board *board, int *modchan,
                                  unsigned short params[],
                                  unsigned long baseline[],
                                  unsigned long spectrum[]);
 XERXES_STATIC int dxp_parse_memory_str(char *name, char *type, unsigned long *base, unsigned long *offset);
 XERXES_STATIC int dxp_fipconfig(void);
+XERXES_STATIC unsigned long dxp_firmware_signature(Board *board);
+XERXES_STATIC int dxp_check_warm_restart(void);
+XERXES_STATIC int dxp_write_warm_restart(void);
 
 
 /* Shorthand notation telling routines to act on all channels of the DXP (-1 currently). */
@@ -117,6 +124,17 @@ static Dsp_Info *dsp_head = NULL;
  */
 static Fippi_Info *fippi_head = NULL;
 
+/*
+ * Manifest of the firmware last downloaded to each module. NULL unless
+ * warm restarts were enabled with dxp_set_warm_restart().
+ */
+static char *warm_restart_file = NULL;
+
+/* Spin at the end of each MD wait, set by dxp_set_md_wait_spin(). Negative
+ * leaves the MD layer's own default.
+ */
+static double md_wait_spin = -1.0;
+
 /*
  * Define global static variables to hold the information
  * used to assign new board information.
@@ -622,6 +640,7 @@ int dxp_add_board_item(char *ltoken, char **values)
         working_board->btype   = working_btype;
         working_board->iface   = working_iface;
         working_board->is_full_reboot = FALSE_;
+        working_board->is_warm        = FALSE_;
 
         memset(working_board->state, 0, sizeof(working_board->state));
 
@@ -1505,6 +1524,17 @@ static int XERXES_API dxp_add_fippi(char* filename, Board_Info* board,
  * Routine to Load a new DLL library and return a pointer to the proper
  * Libs structure
  */
+/*
+ * Records a transfer timed by the MD layer, which gets this routine through
+ * Xia_Io_Functions rather than linking against the statistics directly.
+ */
+XERXES_STATIC void dxp_md_record_time(char *group, char *name, double elapsed,
+                                      double amount)
+{
+    dxp_stats_record(group, name, elapsed, amount, FALSE_);
+}
+
+
 static int XERXES_API dxp_add_iface(char* dllname, char* iolib, Interface** iface)
 /* char *dllname;					Input: filename of the interface DLL		*/
 /* char *iolib;						Input: name of lib to talk to the board	*/
@@ -1549,9 +1579,17 @@ static int XERXES_API dxp_add_iface(char* dllname, char* iolib, Interface** ifac
 
     /* Allocate memory for the function structure */
     current->funcs = (Xia_Io_Functions *) xerxes_md_alloc(sizeof(Xia_Io_Functions));
+    /* Pass the timing hooks to the MD layer */
+    current->funcs->dxp_md_record_time = dxp_md_record_time;
+    current->funcs->dxp_md_record_wait = dxp_wait_account;
+    current->funcs->dxp_md_set_wait_spin = NULL;
     /* Retrieve the function pointers from the MD appropriate MD routine */
     dxp_md_init_io(current->funcs, current->dllname);
 
+    if (md_wait_spin >= 0.0 && current->funcs->dxp_md_set_wait_spin != NULL) {
+        current->funcs->dxp_md_set_wait_spin(&md_wait_spin);
+    }
+
     /* Now initialize the library */
     if ((status =
                 current->funcs->dxp_md_initialize(&maxMod,
@@ -1577,18 +1615,33 @@ XERXES_EXPORT int XERXES_API dxp_user_setup(void)
 {
 
     int status;
+    int previous;
+
+    double start;
 
     Board *current = system_head;
 
 
+    status = dxp_check_warm_restart();
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_user_setup", "Error checking the firmware running "
+                      "on the modules", status);
+        return status;
+    }
+
     while (current != NULL) {
-        current->is_full_reboot = TRUE_;
+        current->is_full_reboot = (boolean_t)!current->is_warm;
         current = current->next;
     }
 
     dxp_log_info("dxp_user_setup", "Preparing to download FPGAs");
 
+    start = dxp_wait_now();
+    previous = dxp_wait_set_subsystem(XERXES_WAIT_SUB_FPGA_DOWNLOAD);
     status = dxp_fipconfig();
+    dxp_wait_set_subsystem(previous);
+    dxp_stats_since("startup", "fpga_download", start, 0.0);
 
     if (status != DXP_SUCCESS) {
         dxp_log_error("dxp_user_setup", "Error downloading FPGAs", status);
@@ -1597,7 +1650,11 @@ XERXES_EXPORT int XERXES_API dxp_user_setup(void)
 
     dxp_log_info("dxp_user_setup", "Preparing to download DSP code");
 
+    start = dxp_wait_now();
+    previous = dxp_wait_set_subsystem(XERXES_WAIT_SUB_DSP_DOWNLOAD);
     status = dxp_dspconfig();
+    dxp_wait_set_subsystem(previous);
+    dxp_stats_since("startup", "dsp_download", start, 0.0);
 
     if (status != DXP_SUCCESS) {
         dxp_log_error("dxp_user_setup", "Error downloading DSP code", status);
@@ -1615,6 +1672,8 @@ XERXES_EXPORT int XERXES_API dxp_user_setup(void)
         current = current->next;
     }
 
+    dxp_write_warm_restart();
+
     return status;
 }
 
@@ -1640,6 +1699,11 @@ XERXES_STATIC int dxp_fipconfig(void)
 
 
     while (current != NULL) {
+        if (current->is_warm) {
+            current = current->next;
+            continue;
+        }
+
         status = current->btype->funcs->dxp_download_fpgaconfig(&(current->ioChan),
                                                                 &allChan, "all",
                                                                 current);
@@ -1724,6 +1788,8 @@ int XERXES_API dxp_replace_fpgaconfig(int* detChan, char *name, char* filename)
         return status;
     }
 
+    dxp_write_warm_restart();
+
     return DXP_SUCCESS;
 }
 
@@ -1742,6 +1808,11 @@ XERXES_EXPORT int XERXES_API dxp_dspconfig(void)
     dxp_log_debug("dxp_dspconfig", "Preapring to call dxp_download_dspconfig");
 
     while (current != NULL) {
+        if (current->is_warm) {
+            current = current->next;
+            continue;
+        }
+
         ioChan = current->ioChan;
 
         status = current->btype->funcs->dxp_download_dspconfig(&ioChan, &allChan,
@@ -1813,6 +1884,274 @@ int XERXES_API dxp_replace_dspconfig(int* detChan, char* filename)
     /* DSP is downloaded for this channel, set its state */
     chosen->chanstate[modChan].dspdownloaded = 1;
 
+    dxp_write_warm_restart();
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Folds len bytes of data into a 32-bit FNV-1a hash. A new hash starts
+ * from DXP_HASH_INIT.
+ */
+XERXES_EXPORT unsigned long XERXES_API dxp_hash_bytes(unsigned long hash,
+                                                      const void *data,
+                                                      unsigned long len)
+{
+    unsigned long i;
+
+    const unsigned char *p = (const unsigned char *)data;
+
+
+    if (data == NULL) {
+        return hash;
+    }
+
+    for (i = 0; i < len; i++) {
+        hash = ((hash ^ p[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+    return hash;
+}
+
+
+/*
+ * Hashes the FPGA and DSP images assigned to a board. Two boards with the
+ * same signature were configured from the same firmware files.
+ */
+XERXES_STATIC unsigned long dxp_firmware_signature(Board *board)
+{
+    unsigned int i;
+
+    unsigned long hash = DXP_HASH_INIT;
+
+    Fippi_Info *fpgas[4];
+
+
+    ASSERT(board != NULL);
+
+
+    fpgas[0] = board->system_fpga;
+    fpgas[1] = board->fippi_a;
+    fpgas[2] = board->system_fippi;
+    fpgas[3] = board->mmu;
+
+    for (i = 0; i < 4; i++) {
+        if (fpgas[i] != NULL) {
+            hash = dxp_hash_bytes(hash, fpgas[i]->data,
+                                  fpgas[i]->proglen * sizeof(unsigned short));
+        }
+    }
+
+    if (board->system_dsp != NULL) {
+        hash = dxp_hash_bytes(hash, board->system_dsp->data,
+                              board->system_dsp->proglen * sizeof(unsigned short));
+    }
+
+    for (i = 0; i < board->nchan; i++) {
+        if (board->fippi[i] != NULL) {
+            hash = dxp_hash_bytes(hash, board->fippi[i]->data,
+                                  board->fippi[i]->proglen * sizeof(unsigned short));
+        }
+
+        if (board->dsp[i] != NULL) {
+            hash = dxp_hash_bytes(hash, board->dsp[i]->data,
+                                  board->dsp[i]->proglen * sizeof(unsigned short));
+        }
+    }
+
+    return hash;
+}
+
+
+/*
+ * Marks the boards that can skip the firmware download in dxp_user_setup().
+ * A board is warm if the manifest written after the last download lists the
+ * same firmware images it is about to be given and the device driver reads
+ * back the same firmware identity from the running module. Only the xMAP and
+ * Mercury drivers report their firmware identity, including the FiPPI
+ * decimation; boards of the other products are always downloaded.
+ */
+XERXES_STATIC int dxp_check_warm_restart(void)
+{
+    int status;
+    int mod;
+    int i;
+    int n;
+
+    unsigned long sig;
+    unsigned long expected[DXP_FIRMWARE_ID_LEN];
+    unsigned long id[DXP_FIRMWARE_ID_LEN];
+
+    boolean_t loaded;
+    boolean_t same;
+
+    char line[256];
+    char *p;
+
+    FILE *fp = NULL;
+
+    Board *current = system_head;
+
+
+    while (current != NULL) {
+        current->is_warm = FALSE_;
+        current = current->next;
+    }
+
+    if (warm_restart_file == NULL) {
+        return DXP_SUCCESS;
+    }
+
+    fp = xia_file_open(warm_restart_file, "r");
+
+    if (fp == NULL) {
+        sprintf(info_string, "No firmware manifest '%s', downloading the "
+                "firmware to all modules", warm_restart_file);
+        dxp_log_info("dxp_check_warm_restart", info_string);
+        return DXP_SUCCESS;
+    }
+
+    /* Each line is the module, the firmware signature and the
+     * DXP_FIRMWARE_ID_LEN words of the identity. Lines in any other format,
+     * such as those written by a release with a shorter identity, are
+     * ignored, so those modules are downloaded.
+     */
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "%d %lx%n", &mod, &sig, &n) != 2) {
+            continue;
+        }
+
+        p = line + n;
+
+        for (i = 0; i < DXP_FIRMWARE_ID_LEN; i++) {
+            if (sscanf(p, "%lx%n", &expected[i], &n) != 1) {
+                break;
+            }
+
+            p += n;
+        }
+
+        if (i < DXP_FIRMWARE_ID_LEN) {
+            continue;
+        }
+
+        for (current = system_head; current != NULL; current = current->next) {
+            if (current->mod == mod) {
+                break;
+            }
+        }
+
+        if (current == NULL ||
+            current->btype->funcs->dxp_get_firmware_id == NULL) {
+            continue;
+        }
+
+        if (sig != dxp_firmware_signature(current)) {
+            sprintf(info_string, "Firmware for module %d has changed since "
+                    "the last download", mod);
+            dxp_log_info("dxp_check_warm_restart", info_string);
+            continue;
+        }
+
+        status = current->btype->funcs->dxp_get_firmware_id(&(current->ioChan),
+                                                            current, &loaded,
+                                                            id);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Unable to read the firmware identity of "
+                    "module %d", mod);
+            dxp_log_warning("dxp_check_warm_restart", info_string);
+            continue;
+        }
+
+        same = loaded;
+
+        for (i = 0; i < DXP_FIRMWARE_ID_LEN; i++) {
+            if (id[i] != expected[i]) {
+                same = FALSE_;
+            }
+        }
+
+        if (!same) {
+            sprintf(info_string, "Module %d is not running the firmware in "
+                    "the manifest", mod);
+            dxp_log_info("dxp_check_warm_restart", info_string);
+            continue;
+        }
+
+        sprintf(info_string, "Module %d is running the expected firmware, "
+                "skipping the download", mod);
+        dxp_log_info("dxp_check_warm_restart", info_string);
+
+        current->is_warm = TRUE_;
+    }
+
+    xia_file_close(fp);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Records the firmware now running on each board in the warm restart
+ * manifest. Failing to write the manifest only costs a full download on the
+ * next restart, so errors are logged and otherwise ignored.
+ */
+XERXES_STATIC int dxp_write_warm_restart(void)
+{
+    int status;
+    int i;
+
+    unsigned long id[DXP_FIRMWARE_ID_LEN];
+
+    boolean_t loaded;
+
+    FILE *fp = NULL;
+
+    Board *current = system_head;
+
+
+    if (warm_restart_file == NULL) {
+        return DXP_SUCCESS;
+    }
+
+    fp = xia_file_open(warm_restart_file, "w");
+
+    if (fp == NULL) {
+        sprintf(info_string, "Unable to open firmware manifest '%s' for "
+                "writing", warm_restart_file);
+        dxp_log_warning("dxp_write_warm_restart", info_string);
+        return DXP_OPEN_FILE;
+    }
+
+    while (current != NULL) {
+        if (current->btype->funcs->dxp_get_firmware_id != NULL) {
+            status = current->btype->funcs->dxp_get_firmware_id(&(current->ioChan),
+                                                                current, &loaded,
+                                                                id);
+
+            if (status == DXP_SUCCESS && loaded) {
+                fprintf(fp, "%d %08lx", current->mod,
+                        dxp_firmware_signature(current));
+
+                for (i = 0; i < DXP_FIRMWARE_ID_LEN; i++) {
+                    fprintf(fp, " %lx", id[i]);
+                }
+
+                fprintf(fp, "\n");
+            } else {
+                sprintf(info_string, "Firmware identity of module %d is not "
+                        "available, it will be downloaded on the next restart",
+                        current->mod);
+                dxp_log_warning("dxp_write_warm_restart", info_string);
+            }
+        }
+
+        current = current->next;
+    }
+
+    xia_file_close(fp);
 
     return DXP_SUCCESS;
 }
@@ -3224,6 +3563,197 @@ XERXES_EXPORT int XERXES_API dxp_set_io_priority(int *priority)
 }
 
 
+/*
+ * Sets how the device libraries poll the hardware while waiting for a
+ * control task: the time to spin before sleeping and the initial and
+ * maximum sleep between polls, all in seconds.
+ */
+XERXES_EXPORT int XERXES_API dxp_set_wait_strategy(double *spin,
+                                                   double *initial,
+                                                   double *maximum)
+{
+    int status;
+
+
+    if (spin == NULL || initial == NULL || maximum == NULL) {
+        dxp_log_error("dxp_set_wait_strategy", "Wait times may not be NULL",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    status = dxp_wait_set_strategy(*spin, *initial, *maximum);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Invalid wait strategy: spin = %f, initial = %f, "
+                "maximum = %f", *spin, *initial, *maximum);
+        dxp_log_error("dxp_set_wait_strategy", info_string, status);
+        return status;
+    }
+
+    sprintf(info_string, "Wait strategy: spin = %f, initial = %f, maximum = %f",
+            *spin, *initial, *maximum);
+    dxp_log_info("dxp_set_wait_strategy", info_string);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Sets how many seconds at the end of each MD wait are spun rather than
+ * slept, for the interfaces that are open now and those opened later. 0
+ * always sleeps.
+ */
+XERXES_EXPORT int XERXES_API dxp_set_md_wait_spin(double *spin)
+{
+    int status;
+
+    Interface *current = iface_head;
+
+
+    if (spin == NULL) {
+        dxp_log_error("dxp_set_md_wait_spin", "Spin time may not be NULL",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    if (*spin < 0.0) {
+        sprintf(info_string, "Invalid MD wait spin = %f", *spin);
+        dxp_log_error("dxp_set_md_wait_spin", info_string, DXP_BAD_WAIT);
+        return DXP_BAD_WAIT;
+    }
+
+    md_wait_spin = *spin;
+
+    for (; current != NULL; current = current->next) {
+        if (current->funcs->dxp_md_set_wait_spin == NULL) {
+            continue;
+        }
+
+        status = current->funcs->dxp_md_set_wait_spin(spin);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error setting the wait spin of interface %s",
+                    PRINT_NON_NULL(current->dllname));
+            dxp_log_error("dxp_set_md_wait_spin", info_string, status);
+            return status;
+        }
+    }
+
+    sprintf(info_string, "MD wait spin = %f", *spin);
+    dxp_log_info("dxp_set_md_wait_spin", info_string);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Overrides the timeout, in seconds, of a wait operation ("busy", "apply",
+ * "fpga" or "dsp_boot"). A timeout of 0 restores the device default.
+ */
+XERXES_EXPORT int XERXES_API dxp_set_wait_timeout(char *op, double *timeout)
+{
+    int status;
+
+
+    if (op == NULL || timeout == NULL) {
+        dxp_log_error("dxp_set_wait_timeout", "Arguments may not be NULL",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    status = dxp_wait_set_timeout(dxp_wait_op_index(op), *timeout);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Invalid timeout %f for wait operation '%s'",
+                *timeout, op);
+        dxp_log_error("dxp_set_wait_timeout", info_string, status);
+        return status;
+    }
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Returns the timing statistics of the point for group and name, e.g. "wait"
+ * and "busy" or "xiaGetRunData" and "mca". stats must have room for
+ * XERXES_NUM_STATS values. Returns DXP_UNKNOWN_POINT, without logging an
+ * error, if nothing has been recorded for the point.
+ */
+XERXES_EXPORT int XERXES_API dxp_get_stats(char *group, char *name,
+                                           double *stats)
+{
+    if (group == NULL || name == NULL || stats == NULL) {
+        dxp_log_error("dxp_get_stats", "Arguments may not be NULL", DXP_NULL);
+        return DXP_NULL;
+    }
+
+    return dxp_stats_find(group, name, stats);
+}
+
+
+/*
+ * Returns the group and name of a timing statistics point and its
+ * statistics. Points are numbered from 0, DXP_UNKNOWN_POINT is returned
+ * after the last one. group and name must have room for
+ * XERXES_STATS_NAME_LEN characters and stats for XERXES_NUM_STATS values.
+ */
+XERXES_EXPORT int XERXES_API dxp_get_stats_point(int *point, char *group,
+                                                 char *name, double *stats)
+{
+    if (point == NULL || group == NULL || name == NULL || stats == NULL) {
+        dxp_log_error("dxp_get_stats_point", "Arguments may not be NULL",
+                      DXP_NULL);
+        return DXP_NULL;
+    }
+
+    return dxp_stats_get(*point, group, name, stats);
+}
+
+
+/*
+ * Clears the timing statistics of group, or of all groups if group is NULL
+ * or "".
+ */
+XERXES_EXPORT int XERXES_API dxp_reset_stats(char *group)
+{
+    dxp_stats_reset(group);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Enables warm restarts: dxp_user_setup() skips the firmware download for
+ * modules that are still running the firmware recorded in the manifest
+ * file. Passing NULL or an empty string disables warm restarts.
+ */
+XERXES_EXPORT int XERXES_API dxp_set_warm_restart(char *file)
+{
+    if (warm_restart_file != NULL) {
+        xerxes_md_free(warm_restart_file);
+        warm_restart_file = NULL;
+    }
+
+    if (file == NULL || file[0] == '\0') {
+        return DXP_SUCCESS;
+    }
+
+    warm_restart_file = (char *)xerxes_md_alloc(strlen(file) + 1);
+
+    if (warm_restart_file == NULL) {
+        sprintf(info_string, "Error allocating %d bytes for the firmware "
+                "manifest name", (int)(strlen(file) + 1));
+        dxp_log_error("dxp_set_warm_restart", info_string, DXP_NOMEM);
+        return DXP_NOMEM;
+    }
+
+    strcpy(warm_restart_file, file);
+
+    return DXP_SUCCESS;
+}
+
+
 /*
  * Calls the appropriate exit handler for the specified
  * board type.
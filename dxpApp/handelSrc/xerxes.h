@@ -119,6 +119,20 @@ XERXES_IMPORT int XERXES_API dxp_exit(int *detChan);
 
 XERXES_IMPORT int XERXES_API dxp_set_io_priority(int *priority);
 
+XERXES_IMPORT int XERXES_API dxp_set_wait_strategy(double *spin, double *initial,
+                                                   double *maximum);
+XERXES_IMPORT int XERXES_API dxp_set_wait_timeout(char *op, double *timeout);
+XERXES_IMPORT int XERXES_API dxp_set_md_wait_spin(double *spin);
+XERXES_IMPORT int XERXES_API dxp_get_stats(char *group, char *name,
+                                           double *stats);
+XERXES_IMPORT int XERXES_API dxp_get_stats_point(int *point, char *group,
+                                                 char *name, double *stats);
+XERXES_IMPORT int XERXES_API dxp_reset_stats(char *group);
+XERXES_IMPORT int XERXES_API dxp_set_warm_restart(char *file);
+XERXES_IMPORT unsigned long XERXES_API dxp_hash_bytes(unsigned long hash,
+                                                      const void *data,
+                                                      unsigned long len);
+
 
 #else									/* Begin old style C prototypes */
 /*
@@ -176,6 +190,15 @@ XERXES_IMPORT int XERXES_API dxp_cmd();
 
 XERXES_IMPORT int XERXES_API dxp_exit();
 
+XERXES_IMPORT int XERXES_API dxp_set_wait_strategy();
+XERXES_IMPORT int XERXES_API dxp_set_wait_timeout();
+XERXES_IMPORT int XERXES_API dxp_set_md_wait_spin();
+XERXES_IMPORT int XERXES_API dxp_get_stats();
+XERXES_IMPORT int XERXES_API dxp_get_stats_point();
+XERXES_IMPORT int XERXES_API dxp_reset_stats();
+XERXES_IMPORT int XERXES_API dxp_set_warm_restart();
+XERXES_IMPORT unsigned long XERXES_API dxp_hash_bytes();
+
 
 #endif                                  /*   end if _XERXES_PROTO_ */
 
@@ -117,6 +117,8 @@
 #define DXP_NULL             4310 /* Parameter cannot be NULL */
 #define DXP_MALFORMED_FILE   4311 /* Malformed firmware file */
 #define DXP_UNKNOWN_CT       4312 /* Unknown control task */
+#define DXP_BAD_WAIT         4313 /* Invalid wait strategy or operation */
+#define DXP_UNKNOWN_POINT    4314 /* Unknown timing statistics point */
 
 /* Host machine error codes 4401-4500 */
 #define DXP_NOMEM            4401 /* Error allocating memory */
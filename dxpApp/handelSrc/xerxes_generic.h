@@ -49,5 +49,26 @@
 #define MAXBOARDNAME_LEN	 20
 #define MAX_DSP_PARAM_NAME_LEN 30
 
+/* Initial value of a dxp_hash_bytes() hash */
+#define DXP_HASH_INIT       2166136261UL
+
+/* Timing statistics returned by dxp_get_stats() and xiaGetTimingStatistics().
+ * XERXES_STAT_BINS is the first of XERXES_STATS_NUM_BINS histogram bins, bin 0
+ * counts times shorter than 2 us and bin N times from 2^N to 2^(N+1) us. The
+ * last bin counts all longer times.
+ */
+#define XERXES_STATS_NAME_LEN  32
+#define XERXES_STATS_NUM_BINS  24
+
+#define XERXES_STAT_COUNT      0
+#define XERXES_STAT_ERRORS     1
+#define XERXES_STAT_TOTAL      2
+#define XERXES_STAT_MIN        3
+#define XERXES_STAT_MAX        4
+#define XERXES_STAT_LAST       5
+#define XERXES_STAT_AMOUNT     6
+#define XERXES_STAT_BINS       7
+#define XERXES_NUM_STATS       (XERXES_STAT_BINS + XERXES_STATS_NUM_BINS)
+
 
 #endif						/* Endif for XERXES_GENERIC_H */
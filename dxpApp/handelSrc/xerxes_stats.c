@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2017 XIA LLC
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided
+ * that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above
+ *     copyright notice, this list of conditions and the
+ *     following disclaimer.
+ *   * Redistributions in binary form must reproduce the
+ *     above copyright notice, this list of conditions and the
+ *     following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *   * Neither the name of XIA LLC
+ *     nor the names of its contributors may be used to endorse
+ *     or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+
+#include "xerxesdef.h"
+#include "xerxes_errors.h"
+
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
+
+
+/*
+ * This library keeps the timing statistics of Xerxes and Handel. Each point
+ * is keyed by a group and a name:
+ *
+ *   "wait"     the polled waits of dxp_wait_until(), by operation. The amount
+ *              is the number of polls and the errors are the timeouts.
+ *   "md_wait"  the time each dxp_md_wait() took longer than requested, by
+ *              subsystem. The amount is the time requested.
+ *   "startup"  the phases of starting the system, by phase.
+ *   otherwise  the Handel call or MD transfer named by the group, e.g.
+ *              "xiaGetRunData" or "md_usb2", by run data name or direction.
+ *              The amount is the number of bytes transferred.
+ *
+ * Every point has a histogram of the times as well as their count, total,
+ * minimum, maximum and last value. Points are added the first time they are
+ * recorded. Like the rest of Handel this is not thread safe, the caller must
+ * serialize the calls.
+ */
+
+typedef struct _Stats_Point {
+    char group[XERXES_STATS_NAME_LEN];
+    char name[XERXES_STATS_NAME_LEN];
+    unsigned long count;
+    unsigned long errors;
+    double total;
+    double min;
+    double max;
+    double last;
+    double amount;
+    unsigned long bins[XERXES_STATS_NUM_BINS];
+} Stats_Point;
+
+
+static Stats_Point STATS_POINTS[XERXES_STATS_MAX_POINTS];
+static int STATS_NUM_POINTS = 0;
+
+/* Counts the records that found the table full. It is returned after the
+ * other points once it has been used, and is named when it is first used.
+ */
+static Stats_Point STATS_DROPPED;
+
+
+static Stats_Point *dxp_stats_point(char *group, char *name, boolean_t add);
+static void dxp_stats_copy(Stats_Point *p, char *group, char *name,
+                           double *stats);
+
+
+/*
+ * Adds a time in seconds to the point for group and name. name may be NULL.
+ * amount is added to the amount of the point and error to its error count.
+ */
+XERXES_SHARED void dxp_stats_record(char *group, char *name, double elapsed,
+                                    double amount, boolean_t error)
+{
+    int bin = 0;
+
+    double us;
+
+    Stats_Point *p = NULL;
+
+
+    p = dxp_stats_point(group, name, TRUE_);
+
+    if (p == NULL) {
+        p = &STATS_DROPPED;
+
+        if (p->count == 0) {
+            strcpy(p->group, "stats");
+            strcpy(p->name, "dropped");
+        }
+    }
+
+    if (p->count == 0 || elapsed < p->min) {
+        p->min = elapsed;
+    }
+
+    if (elapsed > p->max) {
+        p->max = elapsed;
+    }
+
+    p->count++;
+    p->total  += elapsed;
+    p->last    = elapsed;
+    p->amount += amount;
+
+    if (error) {
+        p->errors++;
+    }
+
+    for (us = elapsed * 1.0e6; us >= 2.0 && bin < XERXES_STATS_NUM_BINS - 1; us /= 2.0) {
+        bin++;
+    }
+
+    p->bins[bin]++;
+}
+
+
+/*
+ * Adds the time since start, as returned by dxp_wait_now(), to the point for
+ * group and name.
+ */
+XERXES_SHARED void dxp_stats_since(char *group, char *name, double start,
+                                   double amount)
+{
+    dxp_stats_record(group, name, dxp_wait_now() - start, amount, FALSE_);
+}
+
+
+/*
+ * Copies the statistics of the point for group and name into stats, which
+ * must have room for XERXES_NUM_STATS values. Times are in seconds. Returns
+ * DXP_UNKNOWN_POINT if nothing has been recorded for the point.
+ */
+XERXES_SHARED int dxp_stats_find(char *group, char *name, double *stats)
+{
+    Stats_Point *p = NULL;
+
+
+    p = dxp_stats_point(group, name, FALSE_);
+
+    if (p == NULL) {
+        return DXP_UNKNOWN_POINT;
+    }
+
+    dxp_stats_copy(p, NULL, NULL, stats);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Copies the group and name of point into group and name, which must have
+ * room for XERXES_STATS_NAME_LEN characters, and its statistics into stats.
+ * Points are numbered from 0 in the order they were first recorded, and
+ * DXP_UNKNOWN_POINT is returned after the last one.
+ */
+XERXES_SHARED int dxp_stats_get(int point, char *group, char *name,
+                                double *stats)
+{
+    if (point >= 0 && point < STATS_NUM_POINTS) {
+        dxp_stats_copy(&STATS_POINTS[point], group, name, stats);
+        return DXP_SUCCESS;
+    }
+
+    if (point == STATS_NUM_POINTS && STATS_DROPPED.count > 0) {
+        dxp_stats_copy(&STATS_DROPPED, group, name, stats);
+        return DXP_SUCCESS;
+    }
+
+    return DXP_UNKNOWN_POINT;
+}
+
+
+/*
+ * Removes the points of group, or all points if group is NULL or "". The
+ * order of the remaining points is kept.
+ */
+XERXES_SHARED void dxp_stats_reset(char *group)
+{
+    int i;
+    int n = 0;
+
+    boolean_t all = (boolean_t)(group == NULL || group[0] == '\0');
+
+
+    for (i = 0; i < STATS_NUM_POINTS; i++) {
+        if (!all && !STREQ(STATS_POINTS[i].group, group)) {
+            if (n != i) {
+                STATS_POINTS[n] = STATS_POINTS[i];
+            }
+            n++;
+        }
+    }
+
+    memset(&STATS_POINTS[n], 0, (STATS_NUM_POINTS - n) * sizeof(Stats_Point));
+    STATS_NUM_POINTS = n;
+
+    if (all || STREQ(group, "stats")) {
+        memset(&STATS_DROPPED, 0, sizeof(STATS_DROPPED));
+    }
+}
+
+
+/*
+ * Returns the point for group and name. If there is none it is added when add
+ * is TRUE_, otherwise NULL is returned. Also returns NULL if the table is full.
+ */
+static Stats_Point *dxp_stats_point(char *group, char *name, boolean_t add)
+{
+    int i;
+
+    Stats_Point *p = NULL;
+
+
+    if (name == NULL) {
+        name = "";
+    }
+
+    for (i = 0; i < STATS_NUM_POINTS; i++) {
+        p = &STATS_POINTS[i];
+
+        if (strncmp(p->name, name, XERXES_STATS_NAME_LEN - 1) == 0 &&
+            strncmp(p->group, group, XERXES_STATS_NAME_LEN - 1) == 0) {
+            return p;
+        }
+    }
+
+    if (!add || STATS_NUM_POINTS == XERXES_STATS_MAX_POINTS) {
+        return NULL;
+    }
+
+    p = &STATS_POINTS[STATS_NUM_POINTS++];
+
+    strncpy(p->group, group, XERXES_STATS_NAME_LEN - 1);
+    strncpy(p->name, name, XERXES_STATS_NAME_LEN - 1);
+
+    return p;
+}
+
+
+static void dxp_stats_copy(Stats_Point *p, char *group, char *name,
+                           double *stats)
+{
+    int i;
+
+
+    if (group != NULL) {
+        strcpy(group, p->group);
+    }
+
+    if (name != NULL) {
+        strcpy(name, p->name);
+    }
+
+    stats[XERXES_STAT_COUNT]  = (double)p->count;
+    stats[XERXES_STAT_ERRORS] = (double)p->errors;
+    stats[XERXES_STAT_TOTAL]  = p->total;
+    stats[XERXES_STAT_MIN]    = p->min;
+    stats[XERXES_STAT_MAX]    = p->max;
+    stats[XERXES_STAT_LAST]   = p->last;
+    stats[XERXES_STAT_AMOUNT] = p->amount;
+
+    for (i = 0; i < XERXES_STATS_NUM_BINS; i++) {
+        stats[XERXES_STAT_BINS + i] = (double)p->bins[i];
+    }
+}
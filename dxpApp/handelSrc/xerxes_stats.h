@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2017 XIA LLC
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided
+ * that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above
+ *     copyright notice, this list of conditions and the
+ *     following disclaimer.
+ *   * Redistributions in binary form must reproduce the
+ *     above copyright notice, this list of conditions and the
+ *     following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *   * Neither the name of XIA LLC
+ *     nor the names of its contributors may be used to endorse
+ *     or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XERXES_STATS_H__
+#define __XERXES_STATS_H__
+
+
+#include "xerxesdef.h"
+#include "xerxes_generic.h"
+#include "xia_common.h"
+
+
+/* Maximum number of distinct group/name pairs that are timed. Records that
+ * find the table full are counted by the "stats" "dropped" point.
+ */
+#define XERXES_STATS_MAX_POINTS  128
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+XERXES_SHARED void dxp_stats_record(char *group, char *name, double elapsed,
+                                    double amount, boolean_t error);
+XERXES_SHARED void dxp_stats_since(char *group, char *name, double start,
+                                   double amount);
+XERXES_SHARED int dxp_stats_find(char *group, char *name, double *stats);
+XERXES_SHARED int dxp_stats_get(int point, char *group, char *name,
+                                double *stats);
+XERXES_SHARED void dxp_stats_reset(char *group);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XERXES_STATS_H__ */
@@ -53,7 +53,15 @@ typedef int (*DXP_MD_INITIALIZE)(unsigned int *, char *);
 typedef int (*DXP_MD_OPEN)(char *, int *);
 typedef int (*DXP_MD_GET_MAXBLK)(void);
 typedef int (*DXP_MD_SET_MAXBLK)(unsigned int *);
+typedef int (*DXP_MD_GET_CHAN_MAXBLK)(int *);
+typedef int (*DXP_MD_SET_CHAN_MAXBLK)(int *, unsigned int *);
 typedef int (*DXP_MD_CLOSE)(int *);
+typedef int (*DXP_MD_SET_WAIT_SPIN)(double *);
+/* Filled in by Xerxes before dxp_md_init_io() so that the MD layer can record
+ * its transfer and wait times without calling into Xerxes.
+ */
+typedef void (*DXP_MD_RECORD_TIME)(char *, char *, double, double);
+typedef void (*DXP_MD_RECORD_WAIT)(double, double);
 
 struct Xia_Io_Functions {
 	DXP_MD_IO dxp_md_io;
@@ -61,7 +69,12 @@ struct Xia_Io_Functions {
 	DXP_MD_OPEN dxp_md_open;
 	DXP_MD_GET_MAXBLK dxp_md_get_maxblk;
 	DXP_MD_SET_MAXBLK dxp_md_set_maxblk;
+	DXP_MD_GET_CHAN_MAXBLK dxp_md_get_chan_maxblk;
+	DXP_MD_SET_CHAN_MAXBLK dxp_md_set_chan_maxblk;
   DXP_MD_CLOSE dxp_md_close;
+  DXP_MD_SET_WAIT_SPIN dxp_md_set_wait_spin;
+  DXP_MD_RECORD_TIME dxp_md_record_time;
+  DXP_MD_RECORD_WAIT dxp_md_record_wait;
 };
 typedef struct Xia_Io_Functions Xia_Io_Functions;
 
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2017 XIA LLC
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided
+ * that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above
+ *     copyright notice, this list of conditions and the
+ *     following disclaimer.
+ *   * Redistributions in binary form must reproduce the
+ *     above copyright notice, this list of conditions and the
+ *     following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *   * Neither the name of XIA LLC
+ *     nor the names of its contributors may be used to endorse
+ *     or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif /* _WIN32 */
+
+
+#include "xia_mddef.h"
+#include "xia_assert.h"
+
+#include "md_generic.h"
+
+#include "xerxesdef.h"
+#include "xerxes_errors.h"
+#include "xerxes_structures.h"
+
+#include "xerxes_wait.h"
+#include "xerxes_stats.h"
+
+/* Import the necessary MD routine here */
+XIA_MD_IMPORT int XIA_MD_API dxp_md_init_util(Xia_Util_Functions *funcs, char *type);
+
+
+/*
+ * This library provides a common way for device libraries to wait on a
+ * hardware condition (BUSY, run enable, FPGA INIT/DONE, DSP active, ...).
+ *
+ * A wait starts with a spin phase where the condition is polled back to
+ * back; most control tasks complete in a few hundred microseconds and the
+ * I/O needed to poll the condition is already slower than that. After the
+ * spin phase the interval between polls starts at the initial interval and
+ * doubles up to the maximum interval, so long operations do not load the
+ * bus. The timeout passed by the device library may be overridden per
+ * operation.
+ *
+ * The time taken by each operation is recorded in the "wait" group of the
+ * timing statistics so that the real cost of the control tasks can be
+ * reported.
+ *
+ * The MD layer also reports every dxp_md_wait() here, and the time it took
+ * longer than requested is recorded in the "md_wait" group under the
+ * subsystem that is current when the wait is made. The subsystem is set
+ * around the Handel and Xerxes operations that wait on the hardware;
+ * anything else is accounted to "other". Like the rest of Handel this is not
+ * thread safe.
+ */
+
+static char *WAIT_OP_NAMES[XERXES_WAIT_NUM_OPS] = {
+    "busy",
+    "apply",
+    "fpga",
+    "dsp_boot",
+};
+
+static char *WAIT_SUBSYSTEM_NAMES[XERXES_WAIT_NUM_SUBSYSTEMS] = {
+    "busy",
+    "apply",
+    "fpga",
+    "dsp_boot",
+    "fpga_download",
+    "dsp_download",
+    "setup",
+    "run_data",
+    "acquisition_values",
+    "board_operation",
+    "other",
+};
+
+/* Defaults: spin for 0.5 ms then back off from 0.1 ms to 10 ms. The
+ * maximum interval is the fixed poll interval the device libraries used
+ * previously.
+ */
+static double WAIT_SPIN     = 0.0005;
+static double WAIT_INITIAL  = 0.0001;
+static double WAIT_MAXIMUM  = 0.01;
+
+/* A timeout of 0.0 means use the value supplied by the device library. */
+static double WAIT_TIMEOUT[XERXES_WAIT_NUM_OPS] = { 0.0, 0.0, 0.0, 0.0 };
+
+static int WAIT_SUBSYSTEM = XERXES_WAIT_SUB_OTHER;
+
+
+/*
+ * Returns a monotonic time in seconds. Only differences between two calls
+ * are meaningful.
+ */
+XERXES_SHARED double dxp_wait_now(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+#endif /* _WIN32 */
+}
+
+
+/*
+ * Polls cond until it reports done or the timeout (in seconds) expires.
+ *
+ * op selects the per-operation timeout override and statistics bucket.
+ * Returns DXP_TIMEOUT if the condition was not met in time, otherwise the
+ * status of the last call to cond. If elapsed is not NULL it is set to the
+ * time spent waiting.
+ */
+XERXES_SHARED int dxp_wait_until(int op, double timeout,
+                                 DXP_WAIT_CONDITION cond, void *ctx,
+                                 double *elapsed)
+{
+    int status;
+
+    unsigned long polls = 0;
+
+    double start;
+    double t = 0.0;
+    double interval = WAIT_INITIAL;
+
+    boolean_t done = FALSE_;
+
+    int previous;
+
+    Xia_Util_Functions funcs;
+
+
+    ASSERT(cond != NULL);
+    ASSERT(op >= 0 && op < XERXES_WAIT_NUM_OPS);
+
+
+    dxp_md_init_util(&funcs, NULL);
+
+    previous = dxp_wait_set_subsystem(op);
+
+    if (WAIT_TIMEOUT[op] > 0.0) {
+        timeout = WAIT_TIMEOUT[op];
+    }
+
+    start = dxp_wait_now();
+
+    for (;;) {
+        status = cond(ctx, &done);
+        polls++;
+
+        t = dxp_wait_now() - start;
+
+        if (status != DXP_SUCCESS) {
+            break;
+        }
+
+        if (done) {
+            break;
+        }
+
+        if (t >= timeout) {
+            status = DXP_TIMEOUT;
+            break;
+        }
+
+        if (t >= WAIT_SPIN) {
+            float wait = (float)interval;
+
+            if (t + interval > timeout) {
+                wait = (float)(timeout - t);
+            }
+
+            funcs.dxp_md_wait(&wait);
+
+            interval *= 2.0;
+
+            if (interval > WAIT_MAXIMUM) {
+                interval = WAIT_MAXIMUM;
+            }
+        }
+    }
+
+    dxp_wait_set_subsystem(previous);
+
+    dxp_stats_record("wait", WAIT_OP_NAMES[op], t, (double)polls,
+                     (boolean_t)(status == DXP_TIMEOUT));
+
+    if (elapsed != NULL) {
+        *elapsed = t;
+    }
+
+    return status;
+}
+
+
+/*
+ * Sets the spin time and the initial and maximum back-off intervals, all
+ * in seconds.
+ */
+XERXES_SHARED int dxp_wait_set_strategy(double spin, double initial,
+                                        double maximum)
+{
+    if (spin < 0.0 || initial <= 0.0 || maximum < initial) {
+        return DXP_BAD_WAIT;
+    }
+
+    WAIT_SPIN    = spin;
+    WAIT_INITIAL = initial;
+    WAIT_MAXIMUM = maximum;
+
+    return DXP_SUCCESS;
+}
+
+
+XERXES_SHARED void dxp_wait_get_strategy(double *spin, double *initial,
+                                         double *maximum)
+{
+    ASSERT(spin != NULL);
+    ASSERT(initial != NULL);
+    ASSERT(maximum != NULL);
+
+    *spin    = WAIT_SPIN;
+    *initial = WAIT_INITIAL;
+    *maximum = WAIT_MAXIMUM;
+}
+
+
+/*
+ * Overrides the timeout for an operation. A timeout of 0.0 restores the
+ * device library default.
+ */
+XERXES_SHARED int dxp_wait_set_timeout(int op, double timeout)
+{
+    if (op < 0 || op >= XERXES_WAIT_NUM_OPS || timeout < 0.0) {
+        return DXP_BAD_WAIT;
+    }
+
+    WAIT_TIMEOUT[op] = timeout;
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * Makes subsystem the one that dxp_md_wait() time is accounted to and
+ * returns the previous one, which the caller restores when it is done.
+ */
+XERXES_SHARED int dxp_wait_set_subsystem(int subsystem)
+{
+    int previous = WAIT_SUBSYSTEM;
+
+
+    ASSERT(subsystem >= 0 && subsystem < XERXES_WAIT_NUM_SUBSYSTEMS);
+
+
+    WAIT_SUBSYSTEM = subsystem;
+
+    return previous;
+}
+
+
+/*
+ * Called by the MD layer for each wait. requested is the time asked for and
+ * actual the time spent, both in seconds.
+ */
+XERXES_SHARED void dxp_wait_account(double requested, double actual)
+{
+    dxp_stats_record("md_wait", WAIT_SUBSYSTEM_NAMES[WAIT_SUBSYSTEM],
+                     actual - requested, requested, FALSE_);
+}
+
+
+/*
+ * Converts an operation name ("busy", "apply", "fpga" or "dsp_boot") to
+ * its index. Returns -1 if the name is unknown.
+ */
+XERXES_SHARED int dxp_wait_op_index(const char *name)
+{
+    int i;
+
+
+    if (name == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < XERXES_WAIT_NUM_OPS; i++) {
+        if (STREQ(name, WAIT_OP_NAMES[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
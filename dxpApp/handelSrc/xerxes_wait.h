@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017 XIA LLC
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided
+ * that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above
+ *     copyright notice, this list of conditions and the
+ *     following disclaimer.
+ *   * Redistributions in binary form must reproduce the
+ *     above copyright notice, this list of conditions and the
+ *     following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *   * Neither the name of XIA LLC
+ *     nor the names of its contributors may be used to endorse
+ *     or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __XERXES_WAIT_H__
+#define __XERXES_WAIT_H__
+
+
+#include "xerxesdef.h"
+#include "xia_common.h"
+
+
+/* Control operations that are timed separately by dxp_wait_until(). */
+#define XERXES_WAIT_BUSY      0
+#define XERXES_WAIT_APPLY     1
+#define XERXES_WAIT_FPGA      2
+#define XERXES_WAIT_DSP_BOOT  3
+#define XERXES_WAIT_NUM_OPS   4
+
+/* Time in seconds that the FPGA configuration lines are left to settle after
+ * the Control Register is written and after the last configuration byte,
+ * before they are first sampled.
+ */
+#define XERXES_WAIT_FPGA_SETTLE  0.001f
+
+/* Subsystems that the time spent in dxp_md_wait() is accounted to. The
+ * first XERXES_WAIT_NUM_OPS are the waits in dxp_wait_until() for each
+ * operation above.
+ */
+#define XERXES_WAIT_SUB_FPGA_DOWNLOAD  4
+#define XERXES_WAIT_SUB_DSP_DOWNLOAD   5
+#define XERXES_WAIT_SUB_SETUP          6
+#define XERXES_WAIT_SUB_RUN_DATA       7
+#define XERXES_WAIT_SUB_ACQ_VALUES     8
+#define XERXES_WAIT_SUB_BOARD_OP       9
+#define XERXES_WAIT_SUB_OTHER          10
+#define XERXES_WAIT_NUM_SUBSYSTEMS     11
+
+/*
+ * Condition polled by dxp_wait_until(). Sets done to TRUE_ once the
+ * operation has completed. Any return value other than DXP_SUCCESS aborts
+ * the wait and is passed back to the caller.
+ */
+typedef int (*DXP_WAIT_CONDITION)(void *ctx, boolean_t *done);
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+XERXES_SHARED int dxp_wait_until(int op, double timeout,
+                                 DXP_WAIT_CONDITION cond, void *ctx,
+                                 double *elapsed);
+XERXES_SHARED int dxp_wait_set_strategy(double spin, double initial,
+                                        double maximum);
+XERXES_SHARED void dxp_wait_get_strategy(double *spin, double *initial,
+                                         double *maximum);
+XERXES_SHARED int dxp_wait_set_timeout(int op, double timeout);
+XERXES_SHARED int dxp_wait_op_index(const char *name);
+XERXES_SHARED double dxp_wait_now(void);
+XERXES_SHARED int dxp_wait_set_subsystem(int subsystem);
+XERXES_SHARED void dxp_wait_account(double requested, double actual);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XERXES_WAIT_H__ */
@@ -65,7 +65,9 @@ static void DlPortWritePortUchar(ULONG port, UCHAR databyte);
 static UCHAR DlPortReadPortUchar(ULONG port);
 static void DlPortReadPortBufferUshort(ULONG port, PUSHORT buffer, ULONG count);
 static void DlPortReadPortBufferUlong(ULONG port, PULONG buffer, ULONG count);
+static void DlPortReadPortBufferUlongUshort(ULONG port, PUSHORT buffer, ULONG count);
 static void DlPortWritePortBufferUshort(ULONG port, PUSHORT buffer, ULONG count);
+static void DlPortCheckIO(void);
 
 
 #define CSR  0x8000
@@ -90,6 +92,12 @@ static int lastID = -1;
 #define _inp DlPortReadPortUchar
 #define _outp DlPortWritePortUchar
 
+/* The EPP port handshakes each cycle in hardware, so the block transfers can use
+ * the x86 string port instructions rather than pausing after every word. */
+#if defined(__i386__) || defined(__x86_64__)
+#define EPP_STRING_IO 1
+#endif
+
 
 /*
  * This sets the PORT address only.  Used to allow bypassing of the InitEPP()
@@ -386,6 +394,60 @@ XIA_EXPORT int XIA_API DxpReadBlocklong(unsigned short addr,unsigned long *data,
 }
 
 
+/*
+ * Reads len 24-bit program memory words, each as a pair of unsigned shorts with
+ * the low word first. This is the order Handel uses, so the data go straight into
+ * the caller's buffer without an intermediate unsigned long array.
+ */
+XIA_EXPORT int XIA_API DxpReadBlocklongUshort(unsigned short addr,unsigned short *data,int len) {
+    /*
+     *    return code
+     *   0   OK
+     *  -1   address>=0x4000
+     *  -2   error writing address
+     */
+    if(addr>=0x4000) {
+
+        return -1;
+    }
+    if((status=set_addr(addr))!=0) {
+
+        return -2;
+    }
+
+    DlPortReadPortBufferUlongUshort(DPORT,data,len);
+
+    return 0;
+}
+
+
+/*
+ * Writes len 24-bit program memory words from pairs of unsigned shorts in the
+ * order Handel uses, high word first. The port takes the words in the same order
+ * so no conversion is needed.
+ */
+XIA_EXPORT int XIA_API DxpWriteBlocklongUshort(unsigned short addr,unsigned short *data,int len)   {
+    /*
+     *    return code
+     *   0   OK
+     *  -1   address>=0x4000
+     *  -2   error writing address
+     */
+    if(addr>=0x4000) {
+
+        return -1;
+    }
+    if((status=set_addr(addr))!=0) {
+
+        return -2;
+    }
+
+    DlPortWritePortBufferUshort(DPORT,data,2*len);
+
+    return 0;
+}
+
+
 XIA_EXPORT int XIA_API DxpReadBlockd(unsigned short addr,double *data,int len)   {
     /*
      *    return code
@@ -509,9 +571,11 @@ static UCHAR DlPortReadPortUchar(ULONG port)
     return(value);
 }
 
-static void DlPortReadPortBufferUshort(ULONG port, PUSHORT buffer, ULONG count)
+/*
+ * Gets I/O privilege on the first access to the port.
+ */
+static void DlPortCheckIO(void)
 {
-    int				i;
     int status;
 
 
@@ -525,52 +589,77 @@ static void DlPortReadPortBufferUshort(ULONG port, PUSHORT buffer, ULONG count)
 
         first_io = 0;
     }
+}
+
+static void DlPortReadPortBufferUshort(ULONG port, PUSHORT buffer, ULONG count)
+{
+#ifndef EPP_STRING_IO
+    ULONG i;
+#endif
+
 
+    DlPortCheckIO();
+
+#ifdef EPP_STRING_IO
+    insw((unsigned short int)port, buffer, count);
+#else
     for (i = 0; i < count; i++) {
         buffer[i] = inw_p((unsigned short int)port);
     }
+#endif
 }
 
 static void DlPortReadPortBufferUlong(ULONG port, PULONG buffer, ULONG count)
 {
-    int				i;
-    int status;
-
-
-    if (first_io) {
-        errno = 0;
-        status = iopl(3);
+    ULONG i;
 
-        if (status == -1) {
-            ASSERT(errno != EPERM);
-        }
 
-        first_io = 0;
-    }
+    DlPortCheckIO();
 
     for (i = 0; i < count; i++) {
         buffer[i] = inl_p((unsigned short int)port);
     }
 }
 
-static void DlPortWritePortBufferUshort(ULONG port, PUSHORT buffer, ULONG count)
+/*
+ * Reads count longwords into 2 * count unsigned shorts, low word first.
+ */
+static void DlPortReadPortBufferUlongUshort(ULONG port, PUSHORT buffer, ULONG count)
 {
-    int				i;
-    int status;
+#ifndef EPP_STRING_IO
+    ULONG i;
+    unsigned int value;
+#endif
 
 
-    if (first_io) {
-        errno = 0;
-        status = iopl(3);
+    DlPortCheckIO();
 
-        if (status == -1) {
-            ASSERT(errno != EPERM);
-        }
-
-        first_io = 0;
+#ifdef EPP_STRING_IO
+    /* x86 is little endian so each longword lands low word first */
+    insl((unsigned short int)port, buffer, count);
+#else
+    for (i = 0; i < count; i++) {
+        value = inl_p((unsigned short int)port);
+        buffer[2*i] = (USHORT)(value & 0xFFFF);
+        buffer[2*i+1] = (USHORT)((value >> 16) & 0xFFFF);
     }
+#endif
+}
+
+static void DlPortWritePortBufferUshort(ULONG port, PUSHORT buffer, ULONG count)
+{
+#ifndef EPP_STRING_IO
+    ULONG i;
+#endif
+
+
+    DlPortCheckIO();
 
+#ifdef EPP_STRING_IO
+    outsw((unsigned short int)port, buffer, count);
+#else
     for (i = 0; i < count; i++) {
         outw_p(buffer[i], (unsigned short int)port);
     }
+#endif
 }
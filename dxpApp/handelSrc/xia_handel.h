@@ -135,6 +135,18 @@ HANDEL_EXPORT int HANDEL_API xiaExit(void);
 
 HANDEL_EXPORT int HANDEL_API xiaSetIOPriority(int pri);
 
+HANDEL_EXPORT int HANDEL_API xiaSetWaitStrategy(double spin, double initial,
+                                                double maximum);
+HANDEL_EXPORT int HANDEL_API xiaSetWaitTimeout(char *op, double timeout);
+HANDEL_EXPORT int HANDEL_API xiaSetMdWaitSpin(double spin);
+HANDEL_EXPORT int HANDEL_API xiaGetTimingStatistics(char *group, char *name,
+                                                    double *stats);
+HANDEL_EXPORT int HANDEL_API xiaGetTimingPoint(int point, char *group,
+                                               char *name, double *stats);
+HANDEL_EXPORT int HANDEL_API xiaResetTimingStatistics(char *group);
+HANDEL_EXPORT int HANDEL_API xiaSetLazySetup(char *file);
+HANDEL_EXPORT int HANDEL_API xiaSetWarmRestart(char *file);
+
 HANDEL_EXPORT void HANDEL_API xiaGetVersionInfo(int *rel, int *min, int *maj,
 												  char *pretty);
 HANDEL_EXPORT const char* HANDEL_API xiaGetErrorText(int errorcode);
@@ -217,6 +229,15 @@ HANDEL_EXPORT int HANDEL_API xiaExit();
 
 HANDEL_EXPORT int HANDEL_API xiaSetIOPriority();
 
+HANDEL_EXPORT int HANDEL_API xiaSetWaitStrategy();
+HANDEL_EXPORT int HANDEL_API xiaSetWaitTimeout();
+HANDEL_EXPORT int HANDEL_API xiaSetMdWaitSpin();
+HANDEL_EXPORT int HANDEL_API xiaGetTimingStatistics();
+HANDEL_EXPORT int HANDEL_API xiaGetTimingPoint();
+HANDEL_EXPORT int HANDEL_API xiaResetTimingStatistics();
+HANDEL_EXPORT int HANDEL_API xiaSetLazySetup();
+HANDEL_EXPORT int HANDEL_API xiaSetWarmRestart();
+
 HANDEL_EXPORT void HANDEL_API xiaGetVersionInfo();
 HANDEL_EXPORT const char* HANDEL_API xiaGetErrorText();
 
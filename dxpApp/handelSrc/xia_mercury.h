@@ -117,6 +117,8 @@ XERXES_STATIC int dxp_get_symbol_by_index(int modChan, unsigned short index,
                                           Board *board, char *name);
 XERXES_STATIC int dxp_get_num_params(int modChan, Board *b,
                                      unsigned short *n_params);
+XERXES_STATIC int dxp_get_firmware_id(int *ioChan, Board *board,
+                                      boolean_t *loaded, unsigned long *id);
 
 /* Logging macro wrappers */
 #define dxp_log_error(x, y, z)  \
@@ -129,8 +131,8 @@ XERXES_STATIC int dxp_get_num_params(int modChan, Board *b,
 	mercury_md_log(MD_DEBUG, (x), (y), 0, __FILE__, __LINE__)
 
 static DXP_MD_IO         mercury_md_io;
-static DXP_MD_SET_MAXBLK mercury_md_set_maxblk;
-static DXP_MD_GET_MAXBLK mercury_md_get_maxblk;
+static DXP_MD_SET_CHAN_MAXBLK mercury_md_set_maxblk;
+static DXP_MD_GET_CHAN_MAXBLK mercury_md_get_maxblk;
 static DXP_MD_LOG        mercury_md_log;
 static DXP_MD_ALLOC      mercury_md_alloc;
 static DXP_MD_FREE       mercury_md_free;
@@ -265,6 +267,21 @@ static unsigned long MERCURY_CFG_STATUS[MERCURY_NUM_TARGETS][2] = {
 #define MERCURY_MEMORY_BLOCK_SIZE  256
 #define MERCURY_MEMORY_32_MAX_ADDR 0x100000
 
+/* Block sizes, in 16-bit words, that are timed when tuning the maximum USB
+ * transfer size. The last one is also the length of the test read from the
+ * external memory, so it stands for not splitting the transfer at all.
+ */
+static unsigned int MERCURY_MAXBLK_SIZES[] = {
+  512,
+  2048,
+  8192,
+  32768,
+  131072,
+};
+
+/* Number of times each block size is timed. The fastest one counts. */
+#define MERCURY_MAXBLK_TUNE_REPEAT 3
+
 
 /* These are relative offsets for each channel in the external memory
  * statistics block.
@@ -45,6 +45,9 @@
 
 #ifdef _WIN32
 #include "xia_timing_helpers_w32.h"
+#else
+/* Any platform with clock_gettime(CLOCK_MONOTONIC) */
+#include "xia_timing_helpers_linux.h"
 #endif /* _WIN32 */
 
 #else /* XIA_ENABLE_TIMING_HELPERS */
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2017 XIA LLC
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided
+ * that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above
+ *     copyright notice, this list of conditions and the
+ *     following disclaimer.
+ *   * Redistributions in binary form must reproduce the
+ *     above copyright notice, this list of conditions and the
+ *     following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *   * Neither the name of XIA LLC
+ *     nor the names of its contributors may be used to endorse
+ *     or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __XIA_TIMING_HELPERS_LINUX_H__
+#define __XIA_TIMING_HELPERS_LINUX_H__
+
+#include <stdio.h>
+#include <time.h>
+
+#define INIT_TIMER_VARS   \
+  struct timespec start;  \
+  struct timespec stop;   \
+  FILE *timer_log_fp = NULL
+
+/* CLOCK_MONOTONIC counts in nanoseconds, so there is no frequency to read. */
+#define INIT_TIMER_FREQ
+
+#define INIT_TIMER_LOG(log)       \
+  timer_log_fp = fopen((log), "a")
+
+#define START_TIMER \
+  clock_gettime(CLOCK_MONOTONIC, &start)
+
+#define STOP_TIMER \
+  clock_gettime(CLOCK_MONOTONIC, &stop)
+
+#define CALCULATE_TIME                            \
+  ((double)(stop.tv_sec - start.tv_sec) +         \
+   (double)(stop.tv_nsec - start.tv_nsec) * 1.0e-9)
+
+#define LOG_TIME(msg, time)                                         \
+  do {                                                              \
+    if (timer_log_fp != NULL) {                                     \
+      fprintf(timer_log_fp, "%s : %0.6f seconds\n", (msg), (time)); \
+    }                                                               \
+  } while(0)
+
+#define DESTROY_TIMER           \
+  do {                          \
+    if (timer_log_fp != NULL) { \
+      fclose(timer_log_fp);     \
+    }                           \
+  } while(0)
+
+#endif /* __XIA_TIMING_HELPERS_LINUX_H__ */
@@ -121,6 +121,17 @@ extern "C"
 
   XERXES_EXPORT int XERXES_API dxp_set_io_priority(int *priority);
 
+  XERXES_EXPORT int XERXES_API dxp_set_wait_strategy(double *spin, double *initial,
+                 double *maximum);
+  XERXES_EXPORT int XERXES_API dxp_set_wait_timeout(char *op, double *timeout);
+  XERXES_EXPORT int XERXES_API dxp_set_md_wait_spin(double *spin);
+  XERXES_EXPORT int XERXES_API dxp_get_stats(char *group, char *name,
+                 double *stats);
+  XERXES_EXPORT int XERXES_API dxp_get_stats_point(int *point, char *group,
+                 char *name, double *stats);
+  XERXES_EXPORT int XERXES_API dxp_reset_stats(char *group);
+  XERXES_EXPORT int XERXES_API dxp_set_warm_restart(char *file);
+
 
 
 #ifndef EXCLUDE_SATURN
@@ -203,6 +214,14 @@ extern "C"
 
   XERXES_EXPORT int XERXES_API dxp_set_io_priority();
 
+  XERXES_EXPORT int XERXES_API dxp_set_wait_strategy();
+  XERXES_EXPORT int XERXES_API dxp_set_wait_timeout();
+  XERXES_EXPORT int XERXES_API dxp_set_md_wait_spin();
+  XERXES_EXPORT int XERXES_API dxp_get_stats();
+  XERXES_EXPORT int XERXES_API dxp_get_stats_point();
+  XERXES_EXPORT int XERXES_API dxp_reset_stats();
+  XERXES_EXPORT int XERXES_API dxp_set_warm_restart();
+
 
 
 
@@ -201,6 +201,10 @@ struct Board {
   struct Board_Info *btype;
 
   boolean_t is_full_reboot;
+  /* Set when the module is already running the expected firmware and
+   * dxp_user_setup() can skip the download (see dxp_set_warm_restart()).
+   */
+  boolean_t is_warm;
 
   /* Pointer to next board in the linked list */
   struct Board *next;
@@ -270,6 +274,15 @@ typedef int (*DXP_GET_SYMBOL_BY_INDEX)(int modChan, unsigned short index,
 typedef int (*DXP_GET_NUM_PARAMS)(int modChan, Board *board,
 								  unsigned short *n_params);
 
+/* Number of words of firmware identity returned by DXP_GET_FIRMWARE_ID:
+ * the CODEREV and CODEVAR of the DSP code, the DECIMATION of the running
+ * FiPPI and the System FPGA version register.
+ */
+#define DXP_FIRMWARE_ID_LEN 4
+
+typedef int (*DXP_GET_FIRMWARE_ID)(int *ioChan, Board *board,
+								   boolean_t *loaded, unsigned long *id);
+
 struct Functions {
   DXP_INIT_DRIVER dxp_init_driver;
   DXP_INIT_UTILS dxp_init_utils;
@@ -321,6 +334,9 @@ struct Functions {
 
   DXP_GET_SYMBOL_BY_INDEX dxp_get_symbol_by_index;
   DXP_GET_NUM_PARAMS dxp_get_num_params;
+
+  /* Optional: leave NULL if the hardware cannot report its firmware. */
+  DXP_GET_FIRMWARE_ID dxp_get_firmware_id;
 };
 typedef struct Functions Functions;
 
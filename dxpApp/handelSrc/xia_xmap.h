@@ -134,6 +134,8 @@ XERXES_STATIC int dxp_get_symbol_by_index(int modChan, unsigned short index,
                                           Board *board, char *name);
 XERXES_STATIC int dxp_get_num_params(int modChan, Board *b,
                                      unsigned short *n_params);
+XERXES_STATIC int dxp_get_firmware_id(int *ioChan, Board *board,
+                                      boolean_t *loaded, unsigned long *id);
 
 /* Logging macro wrappers */
 #define dxp_log_error(x, y, z)  xmap_md_log(MD_ERROR, (x), (y), (z), __FILE__, __LINE__)
@@ -48,6 +48,7 @@
 #include "xerxes_generic.h"
 
 #include "xmap.h"
+#include "xerxes_wait.h"
 
 
 typedef int (*FPGA_downloader_func_t)(int ioChan, int modChan, Board *board);
@@ -62,6 +63,18 @@ typedef struct _FPGA_downloader {
 
 } FPGA_downloader_t;
 
+/* State passed to the dxp_wait_until() conditions. */
+typedef struct _Xmap_Wait {
+    int ioChan;
+    int modChan;
+    Board *board;
+
+    /* Value to wait for and the last value read from the hardware. */
+    unsigned long desired;
+    unsigned long value;
+
+} Xmap_Wait_t;
+
 
 /*
  * Pointer to utility functions
@@ -96,6 +109,9 @@ static int dxp__burst_read_block(int ioChan, int modChan, unsigned long addr,
                                  unsigned int len, unsigned long *data);
 static int dxp__burst_read_buffer(int ioChan, int modChan, unsigned long addr,
                                   unsigned int len, unsigned long *data);
+static int dxp__burst_read_packed_buffer(int ioChan, int modChan,
+                                         unsigned long addr, unsigned int len,
+                                         unsigned long *data);
 static int dxp__read_block(int ioChan, unsigned long addr, unsigned int len,
                            unsigned long *data);
 static int dxp__process_trace_wait(int ioChan, int modChan, unsigned int len,
@@ -106,6 +122,10 @@ static int dxp__do_trace(int ioChan, int modChan, parameter_t type, Board *board
 static int dxp__put_dsp_to_sleep(int ioChan, int modChan, Board *b);
 static int dxp__wake_dsp_up(int ioChan, int modChan, Board *b);
 static int dxp__run_enable_active(int ioChan, int *active);
+static int dxp__busy_done(void *ctx, boolean_t *done);
+static int dxp__cfg_status_done(void *ctx, boolean_t *done);
+static int dxp__dsp_active_done(void *ctx, boolean_t *done);
+static int dxp__apply_done(void *ctx, boolean_t *done);
 
 /* FPGA downloaders */
 static int dxp_download_fippis(int ioChan, int modChan, Board *b);
@@ -253,6 +273,7 @@ XERXES_EXPORT int dxp_init_xmap(Functions* funcs)
 
     funcs->dxp_get_symbol_by_index = dxp_get_symbol_by_index;
     funcs->dxp_get_num_params = dxp_get_num_params;
+    funcs->dxp_get_firmware_id = dxp_get_firmware_id;
 
     return DXP_SUCCESS;
 }
@@ -1865,6 +1886,17 @@ XERXES_STATIC int dxp_read_mem(int *ioChan, int *modChan, Board *board,
             return status;
         }
 
+    } else if (STREQ(name, "burst_map_packed")) {
+        status = dxp__burst_read_packed_buffer(*ioChan, *modChan, *base,
+                                               (unsigned int)(*offset), data);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error reading packed mapping buffer for "
+                    "ioChan = %d", *ioChan);
+            dxp_log_error("dxp_read_mem", info_string, status);
+            return status;
+        }
+
     } else if (STREQ(name, "data")) {
 
         status = dxp__read_data_memory(*ioChan, *base, *offset, data);
@@ -2079,12 +2111,16 @@ XERXES_STATIC int dxp_download_fpga(int ioChan, unsigned long target,
 
     unsigned long cfg_status;
     unsigned long j;
-
-
+    unsigned long init_mask  = 0;
+    unsigned long xdone_mask = 0;
 
     float init_timeout  = .001f;
     float xdone_timeout = .001f;
 
+    float settle = XERXES_WAIT_FPGA_SETTLE;
+
+    Xmap_Wait_t w;
+
 
     ASSERT(fpga != NULL);
 
@@ -2102,20 +2138,35 @@ XERXES_STATIC int dxp_download_fpga(int ioChan, unsigned long target,
         return status;
     }
 
-    /* The simplest thing to do is to just wait the allowed timeout time,
-     * especially if it is short and then see if the value is correct. Future
-     * optimizations can focus on writing a special timeout loop.
+    for (j = 0; j < XMAP_NUM_TARGETS; j++) {
+        if (target & (1 << j)) {
+            init_mask  |= XMAP_CFG_STATUS[j][XMAP_INIT];
+            xdone_mask |= XMAP_CFG_STATUS[j][XMAP_XDONE];
+        }
+    }
+
+    /* Poll the Status Register until INIT* is asserted for every target
+     * or the allowed time has passed. A timeout is reported per target by
+     * the check below. The lines are not valid until the Control Register
+     * write has settled, so they are not sampled before that.
      */
-    xmap_md_wait(&init_timeout);
+    xmap_md_wait(&settle);
 
-    status = dxp_read_global_register(ioChan, XMAP_REG_CFG_STATUS, &cfg_status);
+    w.ioChan  = ioChan;
+    w.desired = init_mask;
+    w.value   = 0;
 
-    if (status != DXP_SUCCESS) {
+    status = dxp_wait_until(XERXES_WAIT_FPGA, (double)init_timeout,
+                            dxp__cfg_status_done, &w, NULL);
+
+    if (status != DXP_SUCCESS && status != DXP_TIMEOUT) {
         sprintf(info_string, "Error reading Status Register for channel %d", ioChan);
         dxp_log_error("dxp_download_fpga", info_string, status);
         return status;
     }
 
+    cfg_status = w.value;
+
     /* Since the target could potentially be more then one FPGA, we must check
      * the INIT* line for each FPGA that is targeted.
      */
@@ -2161,16 +2212,30 @@ XERXES_STATIC int dxp_download_fpga(int ioChan, unsigned long target,
         }
     }
 
-    xmap_md_wait(&xdone_timeout);
+    w.desired = xdone_mask;
+    w.value   = 0;
 
-    status = dxp_read_global_register(ioChan, XMAP_REG_CFG_STATUS, &cfg_status);
+    xmap_md_wait(&settle);
 
-    if (status != DXP_SUCCESS) {
+    status = dxp_wait_until(XERXES_WAIT_FPGA, (double)xdone_timeout,
+                            dxp__cfg_status_done, &w, NULL);
+
+    /* INIT* can de-assert on a CRC error after XDONE was first seen, so the
+     * Status Register is read again once the lines have settled.
+     */
+    if (status == DXP_SUCCESS) {
+        xmap_md_wait(&settle);
+        status = dxp_read_global_register(ioChan, XMAP_REG_CFG_STATUS, &w.value);
+    }
+
+    if (status != DXP_SUCCESS && status != DXP_TIMEOUT) {
         sprintf(info_string, "Error reading Status Register for channel %d", ioChan);
         dxp_log_error("dxp_download_fpga", info_string, status);
         return status;
     }
 
+    cfg_status = w.value;
+
     /* See the comment above (where INIT* is checked). */
     for (j = 0; j < XMAP_NUM_TARGETS; j++) {
         if (target & (1 << j)) {
@@ -2335,10 +2400,9 @@ XERXES_STATIC int dxp_boot_dsp(int ioChan, int modChan, Board *b)
 {
     int status;
 
-    unsigned long dsp_active;
+    double elapsed = 0.0;
 
-    float wait = 0.001f;
-    float elapsed = 0.0;
+    Xmap_Wait_t w;
 
 
     ASSERT(b != NULL);
@@ -2356,32 +2420,25 @@ XERXES_STATIC int dxp_boot_dsp(int ioChan, int modChan, Board *b)
         return status;
     }
 
-    do {
-        unsigned long csr;
+    w.ioChan = ioChan;
 
-        xmap_md_wait(&wait);
-        elapsed += wait;
+    status = dxp_wait_until(XERXES_WAIT_DSP_BOOT, XMAP_DSP_BOOT_ACTIVE_TIMEOUT,
+                            dxp__dsp_active_done, &w, &elapsed);
 
-        status = dxp_read_global_register(ioChan, XMAP_REG_CSR, &csr);
-
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error waiting for DSP to signal that it is "
-                    "active for ioChan = %d.", ioChan);
-            dxp_log_error("dxp_boot_dsp", info_string, status);
-            return status;
-        }
-
-        dsp_active = csr & (1 << XMAP_CSR_DSP_ACT_BIT);
-
-    } while (!dsp_active && elapsed < XMAP_DSP_BOOT_ACTIVE_TIMEOUT);
-
-    if (elapsed >= XMAP_DSP_BOOT_ACTIVE_TIMEOUT) {
+    if (status == DXP_TIMEOUT) {
         sprintf(info_string, "Timeout (%0.1f s) waiting for DSP Active bit in "
                 "the CSR to be set for ioChan = %d.", elapsed, ioChan);
         dxp_log_error("dxp_boot_dsp", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
 
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error waiting for DSP to signal that it is "
+                "active for ioChan = %d.", ioChan);
+        dxp_log_error("dxp_boot_dsp", info_string, status);
+        return status;
+    }
+
     /* Once we have established that the DSP is active, it is safe to
      * poll waiting for busy.
      */
@@ -2551,45 +2608,138 @@ static int dxp_wait_for_busy(int ioChan, int modChan, parameter_t desired,
                              double timeout, Board *board)
 {
     int status;
-    int n_polls = 0;
-    int i;
 
-    float wait = .01f;
+    double elapsed = 0.0;
 
-    double BUSY = 0;
+    Xmap_Wait_t w;
 
 
     ASSERT(board != NULL);
 
 
-    n_polls = (int)ROUND(timeout / wait);
+    w.ioChan  = ioChan;
+    w.modChan = modChan;
+    w.board   = board;
+    w.desired = (unsigned long)desired;
+    w.value   = 0;
 
-    sprintf(info_string, "Max. polls for waiting for BUSY = %d", n_polls);
+    status = dxp_wait_until(XERXES_WAIT_BUSY, timeout, dxp__busy_done, &w,
+                            &elapsed);
+
+    if (status == DXP_TIMEOUT) {
+        sprintf(info_string, "Timeout waiting for BUSY to go to %hu (current = "
+                "%lu) on ioChan = %d", desired, w.value, ioChan);
+        dxp_log_error("dxp_wait_for_busy", info_string, DXP_TIMEOUT);
+        return DXP_TIMEOUT;
+    }
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading BUSY while waiting for BUSY to go "
+                "to %hu on ioChan = %d", desired, ioChan);
+        dxp_log_error("dxp_wait_for_busy", info_string, status);
+        return status;
+    }
+
+    sprintf(info_string, "BUSY went to %hu after %0.6f s on ioChan = %d",
+            desired, elapsed, ioChan);
     dxp_log_debug("dxp_wait_for_busy", info_string);
 
-    for (i = 0; i < n_polls; i++) {
+    return DXP_SUCCESS;
+}
 
-        status = dxp_read_dspsymbol(&ioChan, &modChan, "BUSY", board, &BUSY);
 
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading BUSY during poll iteration %d while "
-                    "waiting for BUSY to go to %hu on ioChan = %d", i, desired,
-                    ioChan);
-            dxp_log_error("dxp_wait_for_busy", info_string, status);
-            return status;
-        }
+/*
+ * dxp_wait_until() condition: BUSY has reached the desired value.
+ */
+static int dxp__busy_done(void *ctx, boolean_t *done)
+{
+    int status;
 
-        if (BUSY == (double)desired) {
-            return DXP_SUCCESS;
-        }
+    double BUSY = 0;
+
+    Xmap_Wait_t *w = (Xmap_Wait_t *)ctx;
+
+
+    status = dxp_read_dspsymbol(&w->ioChan, &w->modChan, "BUSY", w->board,
+                                &BUSY);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    w->value = (unsigned long)BUSY;
+    *done = (boolean_t)(w->value == w->desired);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: all of the desired bits are set in the FPGA
+ * configuration Status Register.
+ */
+static int dxp__cfg_status_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    Xmap_Wait_t *w = (Xmap_Wait_t *)ctx;
+
+
+    status = dxp_read_global_register(w->ioChan, XMAP_REG_CFG_STATUS,
+                                      &w->value);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)((w->value & w->desired) == w->desired);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: the DSP Active bit is set in the CSR.
+ */
+static int dxp__dsp_active_done(void *ctx, boolean_t *done)
+{
+    int status;
+
+    Xmap_Wait_t *w = (Xmap_Wait_t *)ctx;
+
+
+    status = dxp_read_global_register(w->ioChan, XMAP_REG_CSR, &w->value);
+
+    if (status != DXP_SUCCESS) {
+        return status;
+    }
+
+    *done = (boolean_t)((w->value & (1 << XMAP_CSR_DSP_ACT_BIT)) != 0);
+
+    return DXP_SUCCESS;
+}
+
+
+/*
+ * dxp_wait_until() condition: the apply run has cleared run enable.
+ */
+static int dxp__apply_done(void *ctx, boolean_t *done)
+{
+    int status;
+    int active;
+
+    Xmap_Wait_t *w = (Xmap_Wait_t *)ctx;
+
+
+    status = dxp__run_enable_active(w->ioChan, &active);
 
-        xmap_md_wait(&wait);
+    if (status != DXP_SUCCESS) {
+        return status;
     }
 
-    sprintf(info_string, "Timeout waiting for BUSY to go to %hu (current = "
-            "%0.0f) on ioChan = %d", desired, BUSY, ioChan);
-    dxp_log_error("dxp_wait_for_busy", info_string, DXP_TIMEOUT);
-    return DXP_TIMEOUT;
+    *done = (boolean_t)(!active);
+
+    return DXP_SUCCESS;
 }
 
 
@@ -2667,10 +2817,7 @@ static int dxp_get_adc_trace(int ioChan, int modChan, unsigned long *data,
 static int dxp_do_apply(int ioChan, int modChan, Board *board)
 {
     int status;
-    int active;
     int id = 0;
-    int n_polls;
-    int i;
 
     unsigned short ignored = 0;
 
@@ -2684,8 +2831,9 @@ static int dxp_do_apply(int ioChan, int modChan, Board *board)
     double specialrun = 0.0;
     double errinfo    = 0.0;
     double timeout    = 1.0;
+    double elapsed    = 0.0;
 
-    float poll_interval = 0.1f;
+    Xmap_Wait_t w;
 
 
     ASSERT(board != NULL);
@@ -2752,40 +2900,29 @@ static int dxp_do_apply(int ioChan, int modChan, Board *board)
     sprintf(info_string, "Started run id = %d on ioChan = %d", id, ioChan);
     dxp_log_debug("dxp_do_apply", info_string);
 
-    /* We have an approximate timeout here since we don't include the
-     * time it takes to call dxp__run_enable_active() in the calculation.
-     */
-    n_polls = (int)ROUND(timeout / (double)poll_interval);
-
-    sprintf(info_string, "n_polls = %d, timeout = %0.1f, poll_interval = %0.1f",
-            n_polls, (double)timeout, (double)poll_interval);
-    dxp_log_debug("dxp_do_apply", info_string);
-
-    for (i = 0; i < n_polls; i++) {
-        status = dxp__run_enable_active(ioChan, &active);
-
-        if (status != DXP_SUCCESS) {
-            sprintf(info_string, "Error reading run enable for ioChan = %d", ioChan);
-            dxp_log_error("dxp_do_apply", info_string, status);
-            return status;
-        }
-
-        if (!active) {
-            /* The apply is complete. */
-            break;
-        }
+    w.ioChan = ioChan;
 
-        xmap_md_wait(&poll_interval);
-    }
+    status = dxp_wait_until(XERXES_WAIT_APPLY, timeout, dxp__apply_done, &w,
+                            &elapsed);
 
-    if (i == n_polls) {
+    if (status == DXP_TIMEOUT) {
         status = dxp_end_run(&ioChan, &modChan, board);
         sprintf(info_string, "Timeout waiting %0.1f second(s) for the apply run "
-                "to complete on ioChan = %d", (double)timeout, ioChan);
+                "to complete on ioChan = %d", elapsed, ioChan);
         dxp_log_error("dxp_do_apply", info_string, DXP_TIMEOUT);
         return DXP_TIMEOUT;
     }
 
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading run enable for ioChan = %d", ioChan);
+        dxp_log_error("dxp_do_apply", info_string, status);
+        return status;
+    }
+
+    sprintf(info_string, "Apply run completed in %0.6f s on ioChan = %d",
+            elapsed, ioChan);
+    dxp_log_debug("dxp_do_apply", info_string);
+
     status = dxp_read_dspsymbol(&ioChan, &modChan, "ERRINFO", board, &errinfo);
 
     if (status != DXP_SUCCESS) {
@@ -3004,6 +3141,114 @@ static int dxp_get_num_params(int modChan, Board *b, unsigned short *n_params)
 }
 
 
+/*
+ * Reports if the module is still configured from a previous session: XDONE
+ * is set for all three FPGAs, the DSP is active and no run is in progress.
+ * The FiPPI images cannot be read back, so the FiPPI is identified by the
+ * DECIMATION the DSP reads from it. The identity returned in id is the
+ * CODEREV and CODEVAR of the running DSP code, DECIMATION and the SVR.
+ */
+XERXES_STATIC int dxp_get_firmware_id(int *ioChan, Board *board,
+                                      boolean_t *loaded, unsigned long *id)
+{
+    int status;
+    int i;
+    int modChan = 0;
+
+    unsigned long cfg = 0;
+    unsigned long csr = 0;
+
+    double value = 0.0;
+
+
+    ASSERT(ioChan != NULL);
+    ASSERT(board != NULL);
+    ASSERT(loaded != NULL);
+    ASSERT(id != NULL);
+
+
+    *loaded = FALSE_;
+
+    for (i = 0; i < DXP_FIRMWARE_ID_LEN; i++) {
+        id[i] = 0;
+    }
+
+    status = dxp_read_global_register(*ioChan, XMAP_REG_CFG_STATUS, &cfg);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading the CFG "
+                      "status register", status);
+        return status;
+    }
+
+    for (i = 0; i < XMAP_NUM_TARGETS; i++) {
+        if (!(cfg & XMAP_CFG_STATUS[i][XMAP_XDONE])) {
+            sprintf(info_string, "The %s is not configured on module %d",
+                    XMAP_FPGA_NAMES[i], board->mod);
+            dxp_log_debug("dxp_get_firmware_id", info_string);
+            return DXP_SUCCESS;
+        }
+    }
+
+    status = dxp_read_global_register(*ioChan, XMAP_REG_CSR, &csr);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading the CSR", status);
+        return status;
+    }
+
+    if (!(csr & (1 << XMAP_CSR_DSP_ACT_BIT)) ||
+        (csr & (1 << XMAP_CSR_RUN_ACT_BIT))) {
+        sprintf(info_string, "The DSP on module %d is not idle (CSR = %#lx)",
+                board->mod, csr);
+        dxp_log_debug("dxp_get_firmware_id", info_string);
+        return DXP_SUCCESS;
+    }
+
+    if (board->system_dsp == NULL) {
+        return DXP_SUCCESS;
+    }
+
+    status = dxp_read_dspsymbol(ioChan, &modChan, "CODEREV", board, &value);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading CODEREV", status);
+        return status;
+    }
+
+    id[0] = (unsigned long)value;
+
+    status = dxp_read_dspsymbol(ioChan, &modChan, "CODEVAR", board, &value);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading CODEVAR", status);
+        return status;
+    }
+
+    id[1] = (unsigned long)value;
+
+    status = dxp_read_dspsymbol(ioChan, &modChan, "DECIMATION", board, &value);
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading DECIMATION", status);
+        return status;
+    }
+
+    id[2] = (unsigned long)value;
+
+    status = dxp_read_reg(ioChan, &modChan, "SVR", &(id[3]));
+
+    if (status != DXP_SUCCESS) {
+        dxp_log_error("dxp_get_firmware_id", "Error reading the SVR", status);
+        return status;
+    }
+
+    *loaded = TRUE_;
+
+    return DXP_SUCCESS;
+}
+
+
 /*
  * Read a block of data
  *
@@ -3885,6 +4130,55 @@ static int dxp__burst_read_buffer(int ioChan, int modChan, unsigned long addr,
 }
 
 
+/*
+ * Reads a mapping buffer through one of the packed windows and unpacks it.
+ *
+ * len is the number of 16-bit buffer words. Each 32-bit transfer carries
+ * two of them, the first in the low half, so only half as many transfers
+ * are needed. On return data holds one buffer word per element, the same
+ * as dxp__burst_read_buffer().
+ */
+static int dxp__burst_read_packed_buffer(int ioChan, int modChan,
+                                         unsigned long addr, unsigned int len,
+                                         unsigned long *data)
+{
+    int status;
+
+    unsigned int i;
+    unsigned int n_packed = (len + 1) / 2;
+
+    unsigned long packed;
+
+
+    ASSERT(data != NULL);
+
+
+    status = dxp__burst_read_buffer(ioChan, modChan, addr, n_packed, data);
+
+    if (status != DXP_SUCCESS) {
+        sprintf(info_string, "Error reading packed buffer (addr = %#lx, "
+                "len = %u) for ioChan = %d", addr, len, ioChan);
+        dxp_log_error("dxp__burst_read_packed_buffer", info_string, status);
+        return status;
+    }
+
+    /* Unpack in place from the end, so that no packed word is overwritten
+     * before it has been unpacked.
+     */
+    for (i = n_packed; i-- > 0; ) {
+        packed = data[i];
+
+        if ((2 * i + 1) < len) {
+            data[2 * i + 1] = (packed >> 16) & 0xFFFF;
+        }
+
+        data[2 * i] = packed & 0xFFFF;
+    }
+
+    return DXP_SUCCESS;
+}
+
+
 /*
  * Download a system fpga to the hardware.
  */
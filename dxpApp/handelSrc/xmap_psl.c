@@ -184,6 +184,12 @@ PSL_STATIC int psl__GetBaselineLength(int detChan, void *value,
                                       XiaDefaults *defs, Module *m);
 PSL_STATIC int psl__GetBaseline(int detChan, void *value, XiaDefaults *defs,
                                 Module *m);
+PSL_STATIC int psl__GetModuleBaseline(int detChan, void *value,
+                                      XiaDefaults *defs, Module *m);
+PSL_STATIC int psl__GetModuleBaselineLength(int detChan, void *value,
+                                            XiaDefaults *defs, Module *m);
+PSL_STATIC int psl__GetModuleBaselineLayout(Module *m,
+                                            Baseline_Layout **layout);
 PSL_STATIC int psl__GetRealtime(int detChan, void *value, XiaDefaults *defs,
                                 Module *m);
 PSL_STATIC int psl__GetTotalEvents(int detChan, void *value, XiaDefaults *defs,
@@ -396,6 +402,10 @@ PSL_STATIC int psl__SetBufferClearSize(int detChan, int modChan, char *name,
                                        void *value, char *detType,
                                        XiaDefaults *defs, Module *m,
                                        Detector *det, FirmwareSet *fs);
+PSL_STATIC int psl__SetWordPacking(int detChan, int modChan, char *name,
+                                   void *value, char *detType,
+                                   XiaDefaults *defs, Module *m,
+                                   Detector *det, FirmwareSet *fs);
 
 PSL_STATIC int psl__SetMaster(int detChan, enum master type, XiaDefaults *defs);
 PSL_STATIC int psl__ClearMaster(int detChan, enum master type,
@@ -404,6 +414,18 @@ PSL_STATIC int psl__CurrentMaster(int detChan);
 
 
 
+/* The baseline histogram layout of each module. It is read once after each
+ * apply or DSP download, which increment BASELINE_GENERATION, rather than
+ * on every "module_baseline" read. Modules beyond the size of the table
+ * share its entries, and read their layout again when they have been
+ * replaced.
+ */
+#define NUM_BASELINE_LAYOUTS 32
+
+static Baseline_Layout BASELINE_LAYOUTS[NUM_BASELINE_LAYOUTS];
+static unsigned long BASELINE_GENERATION = 1;
+static unsigned int BASELINE_NEXT_LAYOUT = 0;
+
 /* These are the DSP parameter data types for pslGetParamData(). */
 static ParamData_t PARAM_DATA[] =
 {
@@ -486,6 +508,8 @@ static RunData runData[] =
     { "livetime",             psl__GetELivetime},
     { "module_statistics",    psl__GetModuleStatistics},
     { "module_mca",           psl__GetModuleMCA},
+    { "module_baseline",      psl__GetModuleBaseline},
+    { "module_baseline_length", psl__GetModuleBaselineLength},
     { "energy_livetime",      psl__GetELivetime},
     { "module_statistics_2",  psl__GetModuleStatistics2},
     { "triggers",             psl__GetTriggers},
@@ -674,6 +698,10 @@ static AcquisitionValue_t ACQ_VALUES[] =
 
     {   "buffer_clear_size", TRUE_, FALSE_, XMAP_UPDATE_MAPPING, 0.0,
         psl__SetBufferClearSize, NULL, NULL
+    },
+
+    {   "word_packing",      TRUE_, FALSE_, XMAP_UPDATE_NEVER, 0.0,
+        psl__SetWordPacking,     NULL, NULL
     }
 };
 
@@ -1849,6 +1877,9 @@ PSL_STATIC int pslApply(int detChan, char *name, XiaDefaults *defs, void *value)
     UNUSED(value);
 
 
+    /* The DSP may move the baseline histograms when it applies. */
+    BASELINE_GENERATION++;
+
     status = dxp_start_control_task(&detChan, &task, NULL, NULL);
 
     if (status != DXP_SUCCESS) {
@@ -2726,6 +2757,258 @@ PSL_STATIC int psl__GetBaseline(int detChan, void *value, XiaDefaults *defs,
 }
 
 
+/*
+ * Returns the baseline histogram layout of module m, reading BASESTART and
+ * BASELEN of every channel if it has not been read since the last apply or
+ * DSP download.
+ */
+PSL_STATIC int psl__GetModuleBaselineLayout(Module *m,
+                                            Baseline_Layout **layout)
+{
+    int status;
+
+    unsigned int i;
+
+    Baseline_Layout *l = NULL;
+
+
+    ASSERT(m != NULL);
+    ASSERT(layout != NULL);
+    ASSERT(m->number_of_channels <= 4);
+
+
+    for (i = 0; i < NUM_BASELINE_LAYOUTS; i++) {
+        if (BASELINE_LAYOUTS[i].m == m) {
+            l = &BASELINE_LAYOUTS[i];
+
+            if (l->generation == BASELINE_GENERATION) {
+                *layout = l;
+                return XIA_SUCCESS;
+            }
+
+            break;
+        }
+    }
+
+    if (l == NULL) {
+        l = &BASELINE_LAYOUTS[BASELINE_NEXT_LAYOUT];
+        BASELINE_NEXT_LAYOUT = (BASELINE_NEXT_LAYOUT + 1) % NUM_BASELINE_LAYOUTS;
+    }
+
+    l->m            = m;
+    l->generation   = 0;
+    l->isContiguous = TRUE_;
+
+    for (i = 0; i < m->number_of_channels; i++) {
+        l->BASESTART[i] = 0;
+        l->BASELEN[i]   = 0;
+
+        if (m->channels[i] == -1) {
+            l->isContiguous = FALSE_;
+            continue;
+        }
+
+        status = pslGetParameter(m->channels[i], "BASESTART", &(l->BASESTART[i]));
+
+        if (status != XIA_SUCCESS) {
+            sprintf(info_string, "Error reading BASESTART for detChan %d",
+                    m->channels[i]);
+            pslLogError("psl__GetModuleBaselineLayout", info_string, status);
+            return status;
+        }
+
+        status = pslGetParameter(m->channels[i], "BASELEN", &(l->BASELEN[i]));
+
+        if (status != XIA_SUCCESS) {
+            sprintf(info_string, "Error reading BASELEN for detChan %d",
+                    m->channels[i]);
+            pslLogError("psl__GetModuleBaselineLayout", info_string, status);
+            return status;
+        }
+
+        if (i > 0 &&
+            (l->BASELEN[i] != l->BASELEN[0] ||
+             l->BASESTART[i] != l->BASESTART[0] + i * l->BASELEN[0])) {
+            l->isContiguous = FALSE_;
+        }
+    }
+
+    l->len = l->BASELEN[0];
+
+    for (i = 1; i < m->number_of_channels; i++) {
+        if (l->BASELEN[i] > l->len) {
+            l->len = l->BASELEN[i];
+        }
+    }
+
+    l->generation = BASELINE_GENERATION;
+    *layout = l;
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Returns the length of each channel's histogram in a "module_baseline"
+ * read of the module that detChan is located in. This is the longest
+ * BASELEN of the channels in the module, so a "module_baseline" read
+ * returns (number of channels * module_baseline_length) words.
+ */
+PSL_STATIC int psl__GetModuleBaselineLength(int detChan, void *value,
+                                            XiaDefaults *defs, Module *m)
+{
+    int status;
+
+    Baseline_Layout *layout = NULL;
+
+    UNUSED(defs);
+
+
+    ASSERT(value != NULL);
+
+
+    status = psl__GetModuleBaselineLayout(m, &layout);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting the module baseline length for "
+                "detChan %d", detChan);
+        pslLogError("psl__GetModuleBaselineLength", info_string, status);
+        return status;
+    }
+
+    *((unsigned long *)value) = layout->len;
+
+    return XIA_SUCCESS;
+}
+
+
+/*
+ * Reads out the baseline histograms for all of the channels in the
+ * module that detChan is located in. value is expected to be an
+ * unsigned long array of (number of channels * module_baseline_length)
+ * elements, stored as [ch0_baseline, ch1_baseline, ...]. Channels with
+ * a shorter histogram are padded with zeros, and disabled channels are
+ * returned as zeros.
+ *
+ * The histograms are read with a single data memory request. When they
+ * are back-to-back in DSP data memory, which is the normal case, they are
+ * read straight into value. Otherwise the span from the first to the end
+ * of the last histogram is read and each channel is copied out of it.
+ */
+PSL_STATIC int psl__GetModuleBaseline(int detChan, void *value,
+                                      XiaDefaults *defs, Module *m)
+{
+    int status;
+
+    unsigned int i;
+    unsigned long j;
+
+    unsigned long first = 0;
+    unsigned long end   = 0;
+    unsigned long nWords;
+
+    Baseline_Layout *layout = NULL;
+
+    unsigned long *base = (unsigned long *)value;
+    unsigned long *span = NULL;
+
+    char memStr[36];
+
+    UNUSED(defs);
+
+
+    ASSERT(value != NULL);
+    ASSERT(m != NULL);
+
+
+    status = psl__GetModuleBaselineLayout(m, &layout);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting the baseline layout of the module "
+                "containing detChan %d", detChan);
+        pslLogError("psl__GetModuleBaseline", info_string, status);
+        return status;
+    }
+
+    if (layout->isContiguous) {
+        nWords = layout->len * m->number_of_channels;
+
+        sprintf(memStr, "data:%#lx:%lu", (unsigned long)layout->BASESTART[0],
+                nWords);
+
+        status = dxp_read_memory(&detChan, memStr, base);
+
+        if (status != DXP_SUCCESS) {
+            sprintf(info_string, "Error reading baseline histograms for the module "
+                    "containing detChan %d", detChan);
+            pslLogError("psl__GetModuleBaseline", info_string, status);
+            return status;
+        }
+
+        return XIA_SUCCESS;
+    }
+
+    for (i = 0; i < m->number_of_channels; i++) {
+        if (m->channels[i] == -1 || layout->BASELEN[i] == 0) {
+            continue;
+        }
+
+        if (end == 0 || layout->BASESTART[i] < first) {
+            first = layout->BASESTART[i];
+        }
+
+        if ((unsigned long)(layout->BASESTART[i] + layout->BASELEN[i]) > end) {
+            end = layout->BASESTART[i] + layout->BASELEN[i];
+        }
+    }
+
+    for (j = 0; j < layout->len * m->number_of_channels; j++) {
+        base[j] = 0;
+    }
+
+    if (end == 0) {
+        return XIA_SUCCESS;
+    }
+
+    nWords = end - first;
+    span   = (unsigned long *)xmap_psl_md_alloc(nWords * sizeof(unsigned long));
+
+    if (span == NULL) {
+        sprintf(info_string, "Unable to allocate %lu bytes for the baseline "
+                "histograms of the module containing detChan %d",
+                nWords * (unsigned long)sizeof(unsigned long), detChan);
+        pslLogError("psl__GetModuleBaseline", info_string, XIA_NOMEM);
+        return XIA_NOMEM;
+    }
+
+    sprintf(memStr, "data:%#lx:%lu", first, nWords);
+
+    status = dxp_read_memory(&detChan, memStr, span);
+
+    if (status != DXP_SUCCESS) {
+        xmap_psl_md_free(span);
+        sprintf(info_string, "Error reading baseline histograms for the module "
+                "containing detChan %d", detChan);
+        pslLogError("psl__GetModuleBaseline", info_string, status);
+        return status;
+    }
+
+    for (i = 0; i < m->number_of_channels; i++) {
+        if (m->channels[i] == -1 || layout->BASELEN[i] == 0) {
+            continue;
+        }
+
+        for (j = 0; j < layout->BASELEN[i]; j++) {
+            base[i * layout->len + j] = span[layout->BASESTART[i] - first + j];
+        }
+    }
+
+    xmap_psl_md_free(span);
+
+    return XIA_SUCCESS;
+}
+
+
 /*
  * Set the preamplifier gain
  *
@@ -5634,6 +5917,8 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long *data,
     unsigned long len  = 0;
     unsigned long base = 0;
 
+    double wordPacking = 0.0;
+
     boolean_t isMCAOrSCA;
     boolean_t isList;
 
@@ -5668,16 +5953,25 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long *data,
         return XIA_NO_MAPPING;
     }
 
-    /* Use "no word packing". Once packing support is included, we can update
-     * the memory base here.
+    status = pslGetDefault("word_packing", (void *)&wordPacking, defs);
+
+    if (status != XIA_SUCCESS) {
+        sprintf(info_string, "Error getting word packing setting for detChan %d",
+                detChan);
+        pslLogError("psl__GetBuffer", info_string, status);
+        return status;
+    }
+
+    /* With word packing the buffer is read through the packed window, which
+     * returns two 16-bit words in every 32-bit transfer.
      */
     switch (buf) {
     case 'a':
-        base = 0x4000000;
+        base = (wordPacking == 1.0) ? XMAP_BUF_A_PACKED_MEMORY : XMAP_BUF_A_MEMORY;
         break;
 
     case 'b':
-        base = 0x6000000;
+        base = (wordPacking == 1.0) ? XMAP_BUF_B_PACKED_MEMORY : XMAP_BUF_B_MEMORY;
         break;
 
     default:
@@ -5712,7 +6006,8 @@ PSL_STATIC int psl__GetBuffer(int detChan, char buf, unsigned long *data,
         FAIL();
     }
 
-    sprintf(memoryStr, "burst_map:%#lx:%lu", base, len);
+    sprintf(memoryStr, "%s:%#lx:%lu",
+            (wordPacking == 1.0) ? "burst_map_packed" : "burst_map", base, len);
 
     status = dxp_read_memory(&detChan, memoryStr, data);
 
@@ -8287,6 +8582,8 @@ PSL_STATIC int psl__DownloadFiPPIADSPNoWake(int detChan, char *file,
         return XIA_SUCCESS;
     }
 
+    BASELINE_GENERATION++;
+
     status = dxp_replace_fpgaconfig(&detChan, "a_and_b_dsp_no_wake", file);
 
     if (status != DXP_SUCCESS) {
@@ -8347,6 +8644,8 @@ PSL_STATIC int psl__DownloadDSP(int detChan, char *file, char *rawFile,
         return XIA_SUCCESS;
     }
 
+    BASELINE_GENERATION++;
+
     status = dxp_replace_dspconfig(&detChan, file);
 
     if (status != DXP_SUCCESS) {
@@ -9303,3 +9602,41 @@ PSL_STATIC int psl__SetBufferClearSize(int detChan, int modChan, char *name,
 
     return XIA_SUCCESS;
 }
+
+
+/*
+ * Selects whether the mapping buffers are read with word packing, i.e.
+ * two 16-bit buffer words per 32-bit transfer instead of one. This only
+ * changes how the host reads the buffers, so nothing is written to the
+ * hardware here.
+ */
+PSL_STATIC int psl__SetWordPacking(int detChan, int modChan, char *name,
+                                   void *value, char *detType,
+                                   XiaDefaults *defs, Module *m,
+                                   Detector *det, FirmwareSet *fs)
+{
+    double packing;
+
+    UNUSED(modChan);
+    UNUSED(name);
+    UNUSED(detType);
+    UNUSED(defs);
+    UNUSED(m);
+    UNUSED(det);
+    UNUSED(fs);
+
+
+    ASSERT(value);
+
+
+    packing = *((double *)value);
+
+    if (packing != 0.0 && packing != 1.0) {
+        sprintf(info_string, "Word packing must be 0 or 1, not %0.1f, for "
+                "detChan %d.", packing, detChan);
+        pslLogError("psl__SetWordPacking", info_string, XIA_BAD_VALUE);
+        return XIA_BAD_VALUE;
+    }
+
+    return XIA_SUCCESS;
+}
@@ -12,6 +12,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 /* EPICS includes */
 #include <epicsString.h>
@@ -19,6 +25,7 @@
 #include <epicsThread.h>
 #include <epicsEvent.h>
 #include <epicsMutex.h>
+#include <epicsMessageQueue.h>
 #include <epicsExit.h>
 #include <envDefs.h>
 #include <iocsh.h>
@@ -46,6 +53,7 @@
 #define MAX_MCA_BINS           16384
 #define MCA_BIN_RES              256
 #define DXP_MAX_SCAS              64
+#define DXP_MAX_ROIS             256
 #define LEN_SCA_NAME              10
 #define MAPPING_CLOCK_PERIOD     320e-9
 
@@ -58,6 +66,15 @@
 #define MAPPING_BUFFER_WORDS 1048576
 #define MEGABYTE             1048576
 
+/** < Seconds to wait for a module to report its buffer full after buffer_switch before warning */
+#define BUFFER_SWITCH_TIMEOUT 1.0
+/** < Seconds after buffer_switch at which a module that has not reported its buffer full is given up on */
+#define BUFFER_SWITCH_MAX_WAIT 10.0
+/** < Maximum number of sets of mapping buffers that can be assembled at the same time */
+#define MAX_MAPPING_SETS      8
+/** < Number of bins in the mapping buffer read time histogram, bin N counts reads of 2^N to 2^(N+1) us */
+#define NUM_READ_TIME_BINS    24
+
 #define CALLHANDEL( handel_call, msg ) { \
     xiastatus = handel_call; \
     status = this->xia_checkError( pasynUser, xiastatus, msg ); \
@@ -86,6 +103,11 @@ typedef enum {
     NDDxpListModeClock
 } NDDxpListMode_t;
 
+typedef enum {
+    NDDxpReadoutSynchronized,
+    NDDxpReadoutIndependent
+} NDDxpMappingReadout_t;
+
 typedef enum {
     NDDxpPresetModeNone,
     NDDxpPresetModeReal,
@@ -153,6 +175,192 @@ typedef struct moduleStatistics {
     double overflows;
 } moduleStatistics;
 
+/* Cached copy of the statistics for all channels of one module.
+ * All channels of a module are always updated from the same read, so they are coherent. */
+typedef struct moduleStatisticsCache {
+    moduleStatistics stats[MAX_CHANNELS_PER_CARD];
+    epicsUInt32 generation;     /* Incremented each time the statistics are read, 0=never read */
+    epicsTimeStamp timeStamp;   /* Time the statistics were read */
+    epicsUInt32 cycle;          /* Statistics cycle in which the module was last read */
+    asynStatus status;          /* Status of the read in that cycle */
+} moduleStatisticsCache;
+
+/* State of the mapping buffer readout of one module */
+typedef enum {
+    NDDxpBufferFilling,     /* Waiting for the current buffer to fill */
+    NDDxpBufferSwitching,   /* buffer_switch was issued, waiting for the buffer to be reported full */
+    NDDxpBufferStaged       /* Buffer was read and released, waiting for the other modules */
+} NDDxpBufferState_t;
+
+/* Mapping buffer readout of one module. Each module switches between its A and B buffers
+ * independently, so the state is tracked per module. */
+typedef struct moduleMappingBuffer {
+    NDDxpBufferState_t state;
+    int buf;                    /* Current buffer, 0=A, 1=B */
+    epicsUInt32 bufferNumber;   /* Sequence number from the header of the last buffer read */
+    epicsUInt32 firstPixel;     /* Starting pixel from the header of the last buffer read */
+    epicsUInt32 setKey;         /* Key of the set that the last buffer read was copied into */
+    epicsTimeStamp switchTime;  /* Time buffer_switch was issued */
+    double warnAfter;           /* Seconds after switchTime at which to warn next */
+    int numBuffers;             /* Number of buffers read since the run started */
+    int justRead;               /* Buffer was read on the current pass of pollMappingMode */
+    epicsTimeStamp notFullTime; /* Time of the last poll that found the current buffer not full */
+    epicsTimeStamp readTime;    /* Time the last buffer was read out */
+    unsigned short overrun;     /* Last value of the buffer_overrun flag */
+} moduleMappingBuffer;
+
+/* The buffers that cover the same pixels on all modules, assembled into one NDArray.
+ * In the pixel mapping modes every buffer holds the same number of pixels, so the buffers are
+ * matched by their starting pixel. In list mapping mode buffers end whenever they are switched,
+ * so they are matched by their sequence number.
+ * Modules can read out their buffers at different times, so several sets can be in progress. */
+typedef struct mappingBufferSet {
+    int inUse;
+    epicsUInt32 key;            /* Starting pixel, or sequence number in list mapping mode */
+    epicsUInt32 bufferNumber;   /* Sequence number from the header of the first buffer read */
+    epicsUInt32 firstPixel;     /* Starting pixel from the header of the first buffer read */
+    int numRead;                /* Number of modules whose buffer has been copied into the set */
+    NDArray *pArray;            /* Array being assembled, NULL if array callbacks are disabled */
+    NDArray *pRoiArray;         /* [ROI][channel][pixel] ROI counts, NULL if no ROIs are defined */
+    epicsTimeStamp timeStamp;   /* Time the first buffer was read */
+} mappingBufferSet;
+
+/* Raw mapping stream. The data file is written in blocks of STREAM_BLOCK_SIZE bytes so that
+ * it can be opened with O_DIRECT on Linux, and is preallocated STREAM_EXTENT_BLOCKS at a time. */
+#define STREAM_BLOCK_SIZE      4096
+#define STREAM_EXTENT_BLOCKS   65536
+#define STREAM_QUEUE_SIZE      16
+
+/* One entry in the stream index file, written for each buffer in the data file */
+typedef struct streamIndexEntry {
+    epicsUInt32 module;
+    epicsUInt32 bufferNumber;   /* Sequence number from the buffer header */
+    epicsUInt32 firstPixel;     /* Starting pixel from the buffer header */
+    epicsUInt32 numWords;       /* Number of 16-bit words in the buffer */
+    epicsUInt32 offset;         /* Offset of the buffer in the data file in units of STREAM_BLOCK_SIZE */
+    epicsUInt32 secPastEpoch;   /* Time the buffer was read */
+    epicsUInt32 nsec;
+} streamIndexEntry;
+
+/* A buffer waiting in the queue for the stream writer thread */
+typedef struct streamQueueEntry {
+    streamIndexEntry index;
+    epicsUInt16 *pData;         /* Aligned to STREAM_BLOCK_SIZE */
+} streamQueueEntry;
+
+/* The stream data file */
+typedef struct streamFile {
+#ifdef __linux__
+    int fd;
+#else
+    FILE *fp;
+#endif
+    epicsUInt32 blocks;         /* Blocks written */
+    epicsUInt32 allocated;      /* Blocks preallocated */
+    int failed;                 /* A failed write could not be undone, nothing more is written */
+} streamFile;
+
+static size_t streamBufferSize()
+{
+    size_t size = MAPPING_BUFFER_WORDS * sizeof(epicsUInt16);
+    return ((size + STREAM_BLOCK_SIZE - 1) / STREAM_BLOCK_SIZE) * STREAM_BLOCK_SIZE;
+}
+
+static epicsUInt16 *streamAllocBuffer()
+{
+#ifdef __linux__
+    void *p;
+    if (posix_memalign(&p, STREAM_BLOCK_SIZE, streamBufferSize()) != 0) return NULL;
+    return (epicsUInt16 *)p;
+#else
+    return (epicsUInt16 *)malloc(streamBufferSize());
+#endif
+}
+
+static int streamFileOpen(streamFile *pFile, const char *fileName)
+{
+    memset(pFile, 0, sizeof(*pFile));
+#ifdef __linux__
+    pFile->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    /* Some file systems, e.g. tmpfs, do not support O_DIRECT */
+    if ((pFile->fd < 0) && (errno == EINVAL))
+        pFile->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return (pFile->fd < 0) ? -1 : 0;
+#else
+    pFile->fp = fopen(fileName, "wb");
+    return (pFile->fp == NULL) ? -1 : 0;
+#endif
+}
+
+/* Appends nBlocks blocks to the data file. If the write fails the file position is moved back
+ * to the end of the last complete block, so that the next write stays block aligned. */
+static int streamFileWrite(streamFile *pFile, const void *pData, epicsUInt32 nBlocks)
+{
+    size_t nBytes = (size_t)nBlocks * STREAM_BLOCK_SIZE;
+#ifdef __linux__
+    const char *p = (const char *)pData;
+    ssize_t n;
+
+    if (pFile->failed) return -1;
+    if (pFile->blocks + nBlocks > pFile->allocated) {
+        /* Failure to preallocate is not fatal, the file will just be more fragmented */
+        if (posix_fallocate(pFile->fd, (off_t)pFile->allocated * STREAM_BLOCK_SIZE,
+                            (off_t)STREAM_EXTENT_BLOCKS * STREAM_BLOCK_SIZE) == 0)
+            pFile->allocated += STREAM_EXTENT_BLOCKS;
+    }
+    while (nBytes > 0) {
+        n = write(pFile->fd, p, nBytes);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (lseek(pFile->fd, (off_t)pFile->blocks * STREAM_BLOCK_SIZE, SEEK_SET) == (off_t)-1)
+                pFile->failed = 1;
+            return -1;
+        }
+        p += n;
+        nBytes -= n;
+    }
+#else
+    if (pFile->failed) return -1;
+    if (fwrite(pData, 1, nBytes, pFile->fp) != nBytes) {
+        if (fseek(pFile->fp, (long)pFile->blocks * STREAM_BLOCK_SIZE, SEEK_SET) != 0)
+            pFile->failed = 1;
+        return -1;
+    }
+#endif
+    pFile->blocks += nBlocks;
+    return 0;
+}
+
+/* Closes the data file, returns the errno if the unused preallocated space could not be removed */
+static int streamFileClose(streamFile *pFile)
+{
+    int status = 0;
+#ifdef __linux__
+    if (pFile->fd < 0) return 0;
+    /* Remove the part of the last extent that was not used, and anything after a failed write */
+    if (ftruncate(pFile->fd, (off_t)pFile->blocks * STREAM_BLOCK_SIZE) != 0) status = errno;
+    close(pFile->fd);
+    pFile->fd = -1;
+#else
+    if (pFile->fp == NULL) return 0;
+    fclose(pFile->fp);
+    pFile->fp = NULL;
+#endif
+    return status;
+}
+
+/* Steps of the NDDxp constructor that are timed for the startup report */
+typedef enum {
+    NDDxpStartupLLParams,
+    NDDxpStartupParams,
+    NDDxpStartupStatistics,
+    NDDxpStartupNumSteps
+} NDDxpStartupStep_t;
+
+static const char *NDDxpStartupStepNames[NDDxpStartupNumSteps] = {"getLLDxpParams",
+                                                                 "getDxpParams",
+                                                                 "getAcquisitionStatistics"};
+
 /* Mapping mode parameters */
 #define NDDxpCollectModeString              "DxpCollectMode"
 #define NDDxpListModeString                 "DxpListMode"
@@ -167,6 +375,8 @@ typedef struct moduleStatistics {
 #define NDDxpReadRateString                 "DxpReadRate"
 #define NDDxpIgnoreGateString               "DxpIgnoreGate"
 #define NDDxpSyncCountString                "DxpSyncCount"
+#define NDDxpMappingReadoutString           "DxpMappingReadout"
+#define NDDxpWordPackingString              "DxpWordPacking"
 #define NDDxpInputLogicPolarityString       "DxpInputLogicPolarity"
 
 /* Internal asyn driver parameters */
@@ -174,6 +384,8 @@ typedef struct moduleStatistics {
 #define NDDxpAcquiringString                "NDDxpAcquiring"  /* Internal use only !!! */
 #define NDDxpBufferCounterString            "DxpBufferCounter"
 #define NDDxpPollTimeString                 "DxpPollTime"
+#define NDDxpMaxUpdateRateString            "DxpMaxUpdateRate"
+#define NDDxpContinuousReadoutPeriodString  "DxpContinuousReadoutPeriod"
 #define NDDxpForceReadString                "DxpForceRead"
 #define NDDxpApplyString                    "DxpApply"
 #define NDDxpAutoApplyString                "DxpAutoApply"
@@ -184,9 +396,11 @@ typedef struct moduleStatistics {
 #define NDDxpNewTraceTimeString             "DxpNewTraceTime" /* Internal use only !!! */
 #define NDDxpTraceDataString                "DxpTraceData"
 #define NDDxpTraceTimeArrayString           "DxpTraceTimeArray"
+#define NDDxpReadTracesString               "DxpReadTraces"
 #define NDDxpBaselineHistogramString        "DxpBaselineHistogram"
 #define NDDxpBaselineEnergyString           "DxpBaselineEnergy" /* Internal use only !!! */
 #define NDDxpBaselineEnergyArrayString      "DxpBaselineEnergyArray"
+#define NDDxpReadBaselineHistogramsString   "DxpReadBaselineHistograms"
 
 /* Runtime statistics */
 #define NDDxpTriggerLiveTimeString          "DxpTriggerLiveTime"
@@ -228,6 +442,27 @@ typedef struct moduleStatistics {
 #define NDDxpTriggerOutputString            "DxpTriggerOutput"
 #define NDDxpLiveTimeOutputString           "DxpLiveTimeOutput"
 
+/* Sum spectrum parameters */
+#define NDDxpSumIncludeString               "DxpSumInclude"
+#define NDDxpSumGainString                  "DxpSumGain"
+#define NDDxpSumOffsetString                "DxpSumOffset"
+#define NDDxpSumDeadTimeCorrectString       "DxpSumDeadTimeCorrect"
+#define NDDxpSumSpectrumString              "DxpSumSpectrum"
+#define NDDxpSumArrayCallbacksString        "DxpSumArrayCallbacks"
+
+/* Trace and baseline NDArray parameters */
+#define NDDxpTraceArrayCallbacksString      "DxpTraceArrayCallbacks"
+#define NDDxpBaselineArrayCallbacksString   "DxpBaselineArrayCallbacks"
+
+/* Software ROI parameters */
+#define NDDxpNumROIsString                  "DxpNumROIs"
+#define NDDxpROIArrayCallbacksString        "DxpROIArrayCallbacks"
+/* For each ROI there are 3 parameters
+  * DxpROI$(N)Low
+  * DxpROI$(N)High
+  * DxpROI$(N)Counts
+*/
+
 /* SCA parameters */
 #define NDDxpNumSCAsString                  "DxpNumSCAs"
 #define NDDxpMaxSCAsString                  "DxpMaxSCAs"
@@ -241,6 +476,39 @@ typedef struct moduleStatistics {
 #define NDDxpSaveSystemFileString           "DxpSaveSystemFile"
 #define NDDxpSaveSystemString               "DxpSaveSystem"
 
+/* Raw mapping stream parameters */
+#define NDDxpStreamFileNameString           "DxpStreamFileName"
+#define NDDxpStreamEnableString             "DxpStreamEnable"
+#define NDDxpStreamQueuedString             "DxpStreamQueued"
+#define NDDxpStreamDroppedString            "DxpStreamDropped"
+#define NDDxpStreamMBytesString             "DxpStreamMBytes"
+
+/* Startup timing parameters */
+#define NDDxpStartupInitTimeString          "DxpStartupInitTime"
+#define NDDxpStartupSystemTimeString        "DxpStartupSystemTime"
+#define NDDxpStartupFirmwareTimeString      "DxpStartupFirmwareTime"
+#define NDDxpStartupSetupTimeString         "DxpStartupSetupTime"
+#define NDDxpStartupConfigTimeString        "DxpStartupConfigTime"
+
+/* Readout performance parameters */
+#define NDDxpPerfAverageTimeString          "DxpPerfAverageTime"
+#define NDDxpPerfResetString                "DxpPerfReset"
+#define NDDxpReadRateAvgString              "DxpReadRateAvg"
+#define NDDxpThroughputString               "DxpThroughput"
+#define NDDxpPollPeriodString               "DxpPollPeriod"
+#define NDDxpPollPeriodMaxString            "DxpPollPeriodMax"
+#define NDDxpPollJitterString               "DxpPollJitter"
+#define NDDxpLockTimeString                 "DxpLockTime"
+#define NDDxpLockTimeMaxString              "DxpLockTimeMax"
+#define NDDxpOverrunsString                 "DxpOverruns"
+#define NDDxpSwitchTimeoutsString           "DxpSwitchTimeouts"
+#define NDDxpPixelMismatchesString          "DxpPixelMismatches"
+#define NDDxpReadTimeHistogramString        "DxpReadTimeHistogram"
+#define NDDxpReadTimeString                 "DxpReadTime"
+#define NDDxpReadTimeMaxString              "DxpReadTimeMax"
+#define NDDxpFullToReadTimeString           "DxpFullToReadTime"
+#define NDDxpReadLoadString                 "DxpReadLoad"
+
 /* Low-level DXP parameters */
 #define NDDxpNumLLParamsString              "DxpNumLLParams"
 #define NDDxpReadLLParamsString             "DxpReadLLParams"
@@ -264,7 +532,22 @@ public:
     void shutdown();
 
     void acquisitionTask();
+    void flushParamCallbacks(int force);
     asynStatus pollMappingMode();
+    asynStatus readMappingBuffer(int module);
+    mappingBufferSet *getMappingSet(epicsUInt32 key, epicsUInt32 bufferNumber);
+    void releaseMappingSet(mappingBufferSet *pSet);
+    void resetMappingBuffers();
+    void discardPendingMappingSets();
+    void resetPerformance();
+    void updatePollStatistics(epicsTimeStamp *pStart, double lockTime);
+    void updateReadStatistics(int module, double readoutTime, double mBytes, epicsTimeStamp *pTime);
+    asynStatus openStream();
+    void closeStream();
+    void closeStreamFiles();
+    void queueStreamBuffer(int module, epicsUInt32 bufferNumber, epicsUInt32 firstPixel,
+                           epicsUInt16 *pData, int numWords, epicsTimeStamp *pTime);
+    void streamTask();
     int getChannel(asynUser *pasynUser, int *addr);
     int getModuleType();
     asynStatus apply(int channel, int forceApply=0);
@@ -278,13 +561,32 @@ public:
     asynStatus getSCAData(asynUser *pasynUser, int addr);
     asynStatus getAcquisitionStatus(asynUser *pasynUser, int addr);
     asynStatus getModuleStatistics(asynUser *pasynUser, int addr, moduleStatistics *stats);
+    asynStatus updateModuleStatistics(asynUser *pasynUser, int card);
+    asynStatus startStatisticsCycle(asynUser *pasynUser);
+    asynStatus getCachedStatistics(asynUser *pasynUser, int channel, moduleStatistics **stats);
     asynStatus getAcquisitionStatistics(asynUser *pasynUser, int addr);
+    void getStartupTimes();
     asynStatus getMcaData(asynUser *pasynUser, int addr);
+    int snapshotReadout();
+    asynStatus readSnapshot(asynUser *pasynUser);
     asynStatus getMappingData();
     asynStatus getTrace(asynUser* pasynUser, int addr,
                         epicsInt32* data, size_t maxLen, size_t *actualLen);
+    asynStatus getTraceAll(asynUser* pasynUser,
+                        epicsInt32* data, size_t maxLen, size_t *actualLen);
     asynStatus getBaselineHistogram(asynUser* pasynUser, int addr,
                         epicsInt32* data, size_t maxLen, size_t *actualLen);
+    asynStatus getBaselineHistogramAll(asynUser* pasynUser,
+                        epicsInt32* data, size_t maxLen, size_t *actualLen);
+    asynStatus getBaselineEnergy(asynUser* pasynUser, int channel);
+    void doChannelArrayCallbacks(epicsInt32 *pData, int length, const char *arrayType, epicsTimeStamp *pNow,
+                                 int addStatistics=0);
+    void doMcaArrayCallbacks(epicsTimeStamp *pNow);
+    void computeSumSpectrum(epicsTimeStamp *pNow);
+    void setROIs(int addr, int function, int value);
+    void computeROIs(epicsTimeStamp *pNow);
+    void computeMappingROIs(int module, mappingBufferSet *pSet, int arraySize);
+    void doMappingROICallbacks(mappingBufferSet *pSet);
     asynStatus configureCollectMode();
     asynStatus setNumChannels(asynUser *pasynUser, epicsInt32 newsize, epicsInt32 *rbValue);
     asynStatus startAcquiring(asynUser *pasynUser);
@@ -306,6 +608,8 @@ protected:
     int NDDxpReadRate;
     int NDDxpIgnoreGate;
     int NDDxpSyncCount;
+    int NDDxpMappingReadout;                /** < Mapping mode only: 0=publish when all modules are full, 1=read each module as soon as it is full */
+    int NDDxpWordPacking;                   /** < xMAP and Mercury mapping mode only: read the buffers with two 16-bit words per 32-bit transfer (0=No, 1=Yes) */
     int NDDxpInputLogicPolarity;
 
     /* Internal asyn driver parameters */
@@ -313,6 +617,8 @@ protected:
     int NDDxpAcquiring;            /** < Internal acquiring flag, not exposed via drvUser */
     int NDDxpBufferCounter;        /** < Count how many buffers have been collected (read) mapping mode */
     int NDDxpPollTime;             /** < Status/data polling time in seconds */
+    int NDDxpMaxUpdateRate;        /** < Maximum rate of parameter callbacks per channel from the polling task in Hz, 0=no limit */
+    int NDDxpContinuousReadoutPeriod; /** < MicroDXP MCA mode: time between snapshots of the spectra and statistics while acquiring in seconds, 0=disabled */
     int NDDxpForceRead;            /** < Force reading MCA spectra - used for mcaData when addr=ALL */
     int NDDxpApply;                /** < Force apply */
     int NDDxpAutoApply;            /** < Auto-apply */
@@ -323,9 +629,11 @@ protected:
     int NDDxpNewTraceTime;         /** < Flag indicating trace time changed */
     int NDDxpTraceData;            /** < The trace array data (read) */
     int NDDxpTraceTimeArray;       /** < The trace timebase array (read) */
+    int NDDxpReadTraces;           /** < Read the traces of all channels in one pass (write) addr: all */
     int NDDxpBaselineHistogram;    /** < The baseline histogram array data (read) */
     int NDDxpBaselineEnergy;       /** < The baseline histogram energy per bin (read) */
     int NDDxpBaselineEnergyArray;  /** < The baseline histogram energy array (read) */
+    int NDDxpReadBaselineHistograms; /** < Read the baseline histograms of all channels in one pass (write) addr: all */
 
     /* Runtime statistics */
     int NDDxpTriggerLiveTime;           /** < live time in seconds (double) */
@@ -367,6 +675,24 @@ protected:
     int NDDxpTriggerOutput;
     int NDDxpLiveTimeOutput;
 
+    /* Sum spectrum parameters */
+    int NDDxpSumInclude;           /** < Include this channel in the sum spectrum (0=No, 1=Yes) */
+    int NDDxpSumGain;              /** < Sum spectrum bin of channel bin N is SumOffset + SumGain*N */
+    int NDDxpSumOffset;            /** < Offset in bins of this channel in the sum spectrum */
+    int NDDxpSumDeadTimeCorrect;   /** < Scale each channel by ICR/OCR before summing (0=No, 1=Yes) */
+    int NDDxpSumSpectrum;          /** < The sum spectrum (read, ALL address) */
+    int NDDxpSumArrayCallbacks;    /** < Send the sum spectrum as an NDArray on the ALL address (0=No, 1=Yes) */
+
+    /* Trace and baseline NDArray parameters */
+    int NDDxpTraceArrayCallbacks;  /** < Send the traces as an NDArray on the ALL address (0=No, 1=Yes) */
+    int NDDxpBaselineArrayCallbacks; /** < Send the baseline histograms as an NDArray on the ALL address (0=No, 1=Yes) */
+
+    /* Software ROI parameters */
+    int NDDxpNumROIs;              /** < Number of software ROIs computed for this channel */
+    int NDDxpROIArrayCallbacks;    /** < Send the ROIs as an NDArray on the ALL address (0=No, 1=Yes) */
+    int NDDxpROILow[DXP_MAX_ROIS];
+    int NDDxpROIHigh[DXP_MAX_ROIS];
+    int NDDxpROICounts[DXP_MAX_ROIS];
     /* SCA parameters */
     int NDDxpMaxSCAs;
     int NDDxpNumSCAs;
@@ -378,6 +704,39 @@ protected:
     int NDDxpSaveSystemFile;
     int NDDxpSaveSystem;
 
+    /* Raw mapping stream parameters */
+    int NDDxpStreamFileName;       /** < File the mapping buffers are streamed to, the index is written to this name plus .idx */
+    int NDDxpStreamEnable;         /** < Stream the mapping buffers to the file (0=No, 1=Yes) */
+    int NDDxpStreamQueued;         /** < Number of buffers waiting to be written */
+    int NDDxpStreamDropped;        /** < Number of buffers dropped because the queue was full or the write failed */
+    int NDDxpStreamMBytes;         /** < MBytes written to the stream file */
+
+    /* Startup timing parameters */
+    int NDDxpStartupInitTime;      /** < Time taken by xiaInit in seconds */
+    int NDDxpStartupSystemTime;    /** < Time taken by xiaStartSystem in seconds */
+    int NDDxpStartupFirmwareTime;  /** < Time taken to download the FPGA and DSP code in seconds */
+    int NDDxpStartupSetupTime;     /** < Time taken by the channel and module setup in seconds */
+    int NDDxpStartupConfigTime;    /** < Time taken by the initial reads in NDDxpConfig in seconds */
+
+    /* Readout performance parameters */
+    int NDDxpPerfAverageTime;      /** < Time constant of the moving averages in seconds, 0=no averaging */
+    int NDDxpPerfReset;            /** < Reset the performance statistics (write) */
+    int NDDxpReadRateAvg;          /** < Moving average of the mapping buffer read rate in MB/s */
+    int NDDxpThroughput;           /** < Moving average of the MBytes read per second of elapsed time */
+    int NDDxpPollPeriod;           /** < Moving average of the period of the polling loop in seconds */
+    int NDDxpPollPeriodMax;        /** < Maximum period of the polling loop in seconds */
+    int NDDxpPollJitter;           /** < Moving standard deviation of the period of the polling loop in seconds */
+    int NDDxpLockTime;             /** < Moving average of the time the polling loop holds the port lock per pass in seconds */
+    int NDDxpLockTimeMax;          /** < Maximum time the polling loop held the port lock in one pass in seconds */
+    int NDDxpOverruns;             /** < Number of modules that reported a mapping buffer overrun */
+    int NDDxpSwitchTimeouts;       /** < Number of times a module did not report its buffer full after buffer_switch */
+    int NDDxpPixelMismatches;      /** < Number of buffers whose sequence number did not match the other modules for the same pixels */
+    int NDDxpReadTimeHistogram;    /** < Histogram of the mapping buffer read times (read) */
+    int NDDxpReadTime;             /** < Time to read the last mapping buffer of the module in seconds, addr: first channel of module */
+    int NDDxpReadTimeMax;          /** < Maximum time to read a mapping buffer of the module in seconds */
+    int NDDxpFullToReadTime;       /** < Time from the last poll that found the buffer not full to the end of its read in seconds */
+    int NDDxpReadLoad;             /** < FullToReadTime as a fraction of the time to fill a buffer, overruns occur above 1 */
+
     /* Commands from MCA interface */
     int mcaData;                   /* int32Array, write/read */
     int mcaStartAcquire;           /* int32, write */
@@ -428,16 +787,55 @@ private:
     epicsEvent *cmdStopEvent;
     epicsEvent *stoppedEvent;
 
-    epicsUInt32 *currentBuf;
+    moduleMappingBuffer *mappingBuffers;
+    mappingBufferSet mappingSets[MAX_MAPPING_SETS];
+
+    /* Raw mapping stream */
+    int streamActive;
+    streamFile streamDataFile;
+    FILE *streamIndexFile;
+    streamQueueEntry streamQueue[STREAM_QUEUE_SIZE];
+    epicsMessageQueue *streamFreeQueue;   /* Indices of free entries in streamQueue */
+    epicsMessageQueue *streamFullQueue;   /* Indices of entries to be written, -1 stops the writer thread */
+    epicsEvent *streamDoneEvent;
     int traceLength;
     int baselineLength;
     unsigned long *traceBuffer;
     epicsFloat64 *traceTimeBuffer;
+    epicsInt32 *traceAllBuffer;
+    epicsInt32 *mcaAllBuffer;
+    epicsFloat64 *sumSpectrumBuffer;
+    int *mcaRawFresh;              /* [channel] set when the ALL read has just read the spectrum into pMcaRaw */
+    int *numROIs;                  /* [channel] copy of the NumROIs parameters */
+    int *roiLow;                   /* [channel][DXP_MAX_ROIS] copy of the ROI low bin parameters */
+    int *roiHigh;                  /* [channel][DXP_MAX_ROIS] copy of the ROI high bin parameters */
+    epicsFloat64 *roiPrefixBuffer;
+    epicsFloat64 *roiAllBuffer;    /* [channel+1][DXP_MAX_ROIS], the last row is the sum of the channels */
     unsigned long *baselineBuffer;
+    unsigned long *moduleBaselineBuffer;
+    unsigned long moduleBaselineLength;
+    epicsInt32 *baselineAllBuffer;
     epicsFloat64 *baselineEnergyBuffer;
     epicsFloat64 *spectrumXAxisBuffer;
     
-    moduleStatistics moduleStats[MAX_CHANNELS_PER_CARD];
+    moduleStatisticsCache *moduleStatsCache;
+    epicsUInt32 statsCycle;        /* Current statistics cycle, 0=none started */
+    epicsTimeStamp *lastCallbackTime;
+    double startupTime[NDDxpStartupNumSteps];
+    int snapshotValid;
+    epicsTimeStamp lastSnapshotTime;
+
+    /* Readout performance */
+    int pollStatsValid;            /* 0=no pass yet, 1=one pass, 2=the averages have been started */
+    epicsTimeStamp lastPollStart;
+    double pollPeriodVar;          /* Moving average of the squared deviation of the poll period */
+    double perfMBytes;             /* MBytes read since the last pass of the polling loop */
+    int perfNumReads;              /* Mapping buffers read since the statistics were reset */
+    epicsTimeStamp lastReadTime;
+    int perfOverruns;
+    int perfSwitchTimeouts;
+    int perfPixelMismatches;
+    epicsInt32 readTimeHistogram[NUM_READ_TIME_BINS];
 
     char polling;
 
@@ -456,6 +854,12 @@ static void acquisitionTaskC(void *drvPvt)
     pNDDxp->acquisitionTask();
 }
 
+static void streamTaskC(void *drvPvt)
+{
+    NDDxp *pNDDxp = (NDDxp *)drvPvt;
+    pNDDxp->streamTask();
+}
+
 static int paramCompare(const void *p1, const void *p2)
 {
     int ip1 = *(int *)p1;
@@ -480,13 +884,15 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
 {
     int status = asynSuccess;
     int i, ch;
-    int sca;
+    int sca, roi;
     char tmpStr[MAX_DSP_PARAM_NAME_LEN + 10];
     int xiastatus = 0;
     unsigned short runTasks;
     unsigned long ulongTmp;
+    epicsTimeStamp configStart, stepStart, stepEnd;
     const char *functionName = "NDDxp";
 
+    epicsTimeGetCurrent(&configStart);
     this->nChannels = nChannels;
 
     /* Mapping mode parameters */
@@ -503,6 +909,8 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     createParam(NDDxpReadRateString,               asynParamFloat64, &NDDxpReadRate);
     createParam(NDDxpIgnoreGateString,             asynParamInt32,   &NDDxpIgnoreGate);
     createParam(NDDxpSyncCountString,              asynParamInt32,   &NDDxpSyncCount);
+    createParam(NDDxpMappingReadoutString,         asynParamInt32,   &NDDxpMappingReadout);
+    createParam(NDDxpWordPackingString,            asynParamInt32,   &NDDxpWordPacking);
     createParam(NDDxpInputLogicPolarityString,     asynParamInt32,   &NDDxpInputLogicPolarity);
 
     /* Internal asyn driver parameters */
@@ -510,6 +918,8 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     createParam(NDDxpAcquiringString,              asynParamInt32,   &NDDxpAcquiring);
     createParam(NDDxpBufferCounterString,          asynParamInt32,   &NDDxpBufferCounter);
     createParam(NDDxpPollTimeString,               asynParamFloat64, &NDDxpPollTime);
+    createParam(NDDxpMaxUpdateRateString,          asynParamFloat64, &NDDxpMaxUpdateRate);
+    createParam(NDDxpContinuousReadoutPeriodString, asynParamFloat64, &NDDxpContinuousReadoutPeriod);
     createParam(NDDxpForceReadString,              asynParamInt32,   &NDDxpForceRead);
     createParam(NDDxpApplyString,                  asynParamInt32,   &NDDxpApply);
     createParam(NDDxpAutoApplyString,              asynParamInt32,   &NDDxpAutoApply);
@@ -520,9 +930,11 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     createParam(NDDxpNewTraceTimeString,           asynParamInt32,   &NDDxpNewTraceTime);
     createParam(NDDxpTraceDataString,              asynParamInt32Array, &NDDxpTraceData);
     createParam(NDDxpTraceTimeArrayString,         asynParamFloat64Array, &NDDxpTraceTimeArray);
+    createParam(NDDxpReadTracesString,             asynParamInt32,   &NDDxpReadTraces);
     createParam(NDDxpBaselineHistogramString,      asynParamInt32Array, &NDDxpBaselineHistogram);
     createParam(NDDxpBaselineEnergyString,         asynParamFloat64, &NDDxpBaselineEnergy);
     createParam(NDDxpBaselineEnergyArrayString,    asynParamFloat64Array, &NDDxpBaselineEnergyArray);
+    createParam(NDDxpReadBaselineHistogramsString, asynParamInt32,   &NDDxpReadBaselineHistograms);
 
     /* Runtime statistics */
     createParam(NDDxpTriggerLiveTimeString,        asynParamFloat64, &NDDxpTriggerLiveTime);
@@ -564,6 +976,30 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     createParam(NDDxpTriggerOutputString,          asynParamInt32,   &NDDxpTriggerOutput);
     createParam(NDDxpLiveTimeOutputString,         asynParamInt32,   &NDDxpLiveTimeOutput);
 
+    /* Sum spectrum parameters */
+    createParam(NDDxpSumIncludeString,             asynParamInt32,   &NDDxpSumInclude);
+    createParam(NDDxpSumGainString,                asynParamFloat64, &NDDxpSumGain);
+    createParam(NDDxpSumOffsetString,              asynParamFloat64, &NDDxpSumOffset);
+    createParam(NDDxpSumDeadTimeCorrectString,     asynParamInt32,   &NDDxpSumDeadTimeCorrect);
+    createParam(NDDxpSumSpectrumString,            asynParamFloat64Array, &NDDxpSumSpectrum);
+    createParam(NDDxpSumArrayCallbacksString,      asynParamInt32,   &NDDxpSumArrayCallbacks);
+
+    /* Trace and baseline NDArray parameters */
+    createParam(NDDxpTraceArrayCallbacksString,    asynParamInt32,   &NDDxpTraceArrayCallbacks);
+    createParam(NDDxpBaselineArrayCallbacksString, asynParamInt32,   &NDDxpBaselineArrayCallbacks);
+
+    /* Software ROI parameters */
+    createParam(NDDxpNumROIsString,                asynParamInt32,   &NDDxpNumROIs);
+    createParam(NDDxpROIArrayCallbacksString,      asynParamInt32,   &NDDxpROIArrayCallbacks);
+    for (roi=0; roi<DXP_MAX_ROIS; roi++) {
+        sprintf(tmpStr, "DxpROI%dLow", roi);
+        createParam(tmpStr,                        asynParamInt32,   &NDDxpROILow[roi]);
+        sprintf(tmpStr, "DxpROI%dHigh", roi);
+        createParam(tmpStr,                        asynParamInt32,   &NDDxpROIHigh[roi]);
+        sprintf(tmpStr, "DxpROI%dCounts", roi);
+        createParam(tmpStr,                        asynParamFloat64, &NDDxpROICounts[roi]);
+    }
+
     /* SCA parameters */
     createParam(NDDxpNumSCAsString,                asynParamInt32,   &NDDxpNumSCAs);
     createParam(NDDxpMaxSCAsString,                asynParamInt32,   &NDDxpMaxSCAs);
@@ -584,6 +1020,39 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     createParam(NDDxpSaveSystemFileString,         asynParamOctet,   &NDDxpSaveSystemFile);
     createParam(NDDxpSaveSystemString,             asynParamInt32,   &NDDxpSaveSystem);
 
+    /* Raw mapping stream parameters */
+    createParam(NDDxpStreamFileNameString,         asynParamOctet,   &NDDxpStreamFileName);
+    createParam(NDDxpStreamEnableString,           asynParamInt32,   &NDDxpStreamEnable);
+    createParam(NDDxpStreamQueuedString,           asynParamInt32,   &NDDxpStreamQueued);
+    createParam(NDDxpStreamDroppedString,          asynParamInt32,   &NDDxpStreamDropped);
+    createParam(NDDxpStreamMBytesString,           asynParamFloat64, &NDDxpStreamMBytes);
+
+    /* Startup timing parameters */
+    createParam(NDDxpStartupInitTimeString,        asynParamFloat64, &NDDxpStartupInitTime);
+    createParam(NDDxpStartupSystemTimeString,      asynParamFloat64, &NDDxpStartupSystemTime);
+    createParam(NDDxpStartupFirmwareTimeString,    asynParamFloat64, &NDDxpStartupFirmwareTime);
+    createParam(NDDxpStartupSetupTimeString,       asynParamFloat64, &NDDxpStartupSetupTime);
+    createParam(NDDxpStartupConfigTimeString,      asynParamFloat64, &NDDxpStartupConfigTime);
+
+    /* Readout performance parameters */
+    createParam(NDDxpPerfAverageTimeString,        asynParamFloat64, &NDDxpPerfAverageTime);
+    createParam(NDDxpPerfResetString,              asynParamInt32,   &NDDxpPerfReset);
+    createParam(NDDxpReadRateAvgString,            asynParamFloat64, &NDDxpReadRateAvg);
+    createParam(NDDxpThroughputString,             asynParamFloat64, &NDDxpThroughput);
+    createParam(NDDxpPollPeriodString,             asynParamFloat64, &NDDxpPollPeriod);
+    createParam(NDDxpPollPeriodMaxString,          asynParamFloat64, &NDDxpPollPeriodMax);
+    createParam(NDDxpPollJitterString,             asynParamFloat64, &NDDxpPollJitter);
+    createParam(NDDxpLockTimeString,               asynParamFloat64, &NDDxpLockTime);
+    createParam(NDDxpLockTimeMaxString,            asynParamFloat64, &NDDxpLockTimeMax);
+    createParam(NDDxpOverrunsString,               asynParamInt32,   &NDDxpOverruns);
+    createParam(NDDxpSwitchTimeoutsString,         asynParamInt32,   &NDDxpSwitchTimeouts);
+    createParam(NDDxpPixelMismatchesString,        asynParamInt32,   &NDDxpPixelMismatches);
+    createParam(NDDxpReadTimeHistogramString,      asynParamInt32Array, &NDDxpReadTimeHistogram);
+    createParam(NDDxpReadTimeString,               asynParamFloat64, &NDDxpReadTime);
+    createParam(NDDxpReadTimeMaxString,            asynParamFloat64, &NDDxpReadTimeMax);
+    createParam(NDDxpFullToReadTimeString,         asynParamFloat64, &NDDxpFullToReadTime);
+    createParam(NDDxpReadLoadString,               asynParamFloat64, &NDDxpReadLoad);
+
     /* Commands from MCA interface */
     createParam(mcaDataString,                     asynParamInt32Array, &mcaData);
     createParam(mcaStartAcquireString,             asynParamInt32,   &mcaStartAcquire);
@@ -669,6 +1138,13 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
 
     /* Set the parameters in param lib */
     status |= setIntegerParam(NDDxpCollectMode, 0);
+    status |= setIntegerParam(NDDxpMappingReadout, NDDxpReadoutSynchronized);
+    status |= setIntegerParam(NDDxpWordPacking, 0);
+    status |= setStringParam(NDDxpStreamFileName, "");
+    status |= setIntegerParam(NDDxpStreamEnable, 0);
+    status |= setIntegerParam(NDDxpStreamQueued, 0);
+    status |= setIntegerParam(NDDxpStreamDropped, 0);
+    status |= setDoubleParam(NDDxpStreamMBytes, 0.);
     /* Clear the acquiring flag, must do this or things don't work right because acquisitionTask does not set till 
      * acquire first starts */
     for (i=0; i<=this->nChannels; i++) setIntegerParam(i, mcaAcquiring, 0);
@@ -687,7 +1163,16 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     }
     
     this->tmpStats = (epicsFloat64*)calloc(28, sizeof(epicsFloat64));
-    this->currentBuf = (epicsUInt32*)calloc(this->nChannels, sizeof(epicsUInt32));
+    this->moduleStatsCache = (moduleStatisticsCache*)calloc(this->nCards, sizeof(moduleStatisticsCache));
+    this->lastCallbackTime = (epicsTimeStamp*)calloc(this->nChannels+1, sizeof(epicsTimeStamp));
+    this->mappingBuffers = (moduleMappingBuffer*)calloc(this->nCards, sizeof(moduleMappingBuffer));
+    memset(this->mappingSets, 0, sizeof(this->mappingSets));
+    memset(this->streamQueue, 0, sizeof(this->streamQueue));
+    this->streamActive = 0;
+    this->streamIndexFile = NULL;
+    this->streamFreeQueue = NULL;
+    this->streamFullQueue = NULL;
+    this->streamDoneEvent = NULL;
 
     xiastatus = xiaGetSpecialRunData(0, "adc_trace_length",  &(this->traceLength));
     if (xiastatus != XIA_SUCCESS) printf("Error calling xiaGetSpecialRunData for adc_trace_length");
@@ -698,6 +1183,12 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     /* Allocate a buffer for the trace time array */
     this->traceTimeBuffer = (epicsFloat64 *)malloc(this->traceLength * sizeof(epicsFloat64));
 
+    /* Allocate a buffer for the traces of all channels, [channel][sample] */
+    this->traceAllBuffer = (epicsInt32 *)calloc(this->nChannels * this->traceLength, sizeof(epicsInt32));
+
+    /* Allocate a buffer for the spectra of all channels, [channel][bin] */
+    this->mcaAllBuffer = (epicsInt32 *)calloc(this->nChannels * MAX_MCA_BINS, sizeof(epicsInt32));
+
     xiastatus = xiaGetRunData(0, "baseline_length", &ulongTmp);
     this->baselineLength = ulongTmp;
     if (xiastatus != XIA_SUCCESS) printf("Error calling xiaGetRunData for baseline_length");
@@ -705,6 +1196,11 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     /* Allocate a buffer for the baseline histogram data */
     this->baselineBuffer = (unsigned long *)malloc(this->baselineLength * sizeof(unsigned long));
 
+    /* Allocate buffers for the baseline histograms of a whole module and of all channels, [channel][bin] */
+    this->moduleBaselineLength = this->baselineLength;
+    this->moduleBaselineBuffer = (unsigned long *)calloc(this->channelsPerCard * this->moduleBaselineLength, sizeof(unsigned long));
+    this->baselineAllBuffer = (epicsInt32 *)calloc(this->nChannels * this->baselineLength, sizeof(epicsInt32));
+
     /* Allocate a buffer for the baseline energy array */
     this->baselineEnergyBuffer = (epicsFloat64 *)malloc(this->baselineLength * sizeof(epicsFloat64));
 
@@ -714,6 +1210,13 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     
     /* Allocate an internal buffer long enough to hold all the energy values in a spectrum */
     this->spectrumXAxisBuffer = (epicsFloat64*)calloc(MAX_MCA_BINS, sizeof(epicsFloat64));
+    this->sumSpectrumBuffer = (epicsFloat64*)calloc(MAX_MCA_BINS, sizeof(epicsFloat64));
+    this->mcaRawFresh = (int *)calloc(this->nChannels, sizeof(int));
+    this->numROIs = (int *)calloc(this->nChannels, sizeof(int));
+    this->roiLow = (int *)calloc(this->nChannels * DXP_MAX_ROIS, sizeof(int));
+    this->roiHigh = (int *)calloc(this->nChannels * DXP_MAX_ROIS, sizeof(int));
+    this->roiPrefixBuffer = (epicsFloat64*)calloc(MAX_MCA_BINS+1, sizeof(epicsFloat64));
+    this->roiAllBuffer = (epicsFloat64*)calloc((this->nChannels+1) * DXP_MAX_ROIS, sizeof(epicsFloat64));
 
     /* On the Saturn enable special timing mode in RUNTASKS so we can use ROI pulse output
      * Hardcoding this here should be TEMPORARY until low-level parameters can be controlled by EPICS? */
@@ -741,6 +1244,12 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
 
     /* Start up acquisition thread */
     setDoubleParam(NDDxpPollTime, 0.001);
+    setDoubleParam(NDDxpMaxUpdateRate, 10.);
+    setDoubleParam(NDDxpContinuousReadoutPeriod, 0.);
+    setDoubleParam(NDDxpPerfAverageTime, 10.);
+    this->resetPerformance();
+    this->snapshotValid = 0;
+    this->statsCycle = 0;
     this->polling = 1;
     status = (epicsThreadCreate("acquisitionTask",
                 epicsThreadPriorityMedium,
@@ -755,7 +1264,10 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
 
     /* Read actual values of all parameters from Handel.  
      * Reading low-level parameters also reads high-level parameters */
+    epicsTimeGetCurrent(&stepStart);
     getLLDxpParams(this->pasynUserSelf, DXP_ALL);
+    epicsTimeGetCurrent(&stepEnd);
+    this->startupTime[NDDxpStartupLLParams] = epicsTimeDiffInSeconds(&stepEnd, &stepStart);
 
     /* Set default values for parameters that cannot be read from Handel */
     for (i=0; i<=this->nChannels; i++) {
@@ -767,6 +1279,20 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
         setIntegerParam(i, NDDxpPresetEvents, 0);
         setIntegerParam(i, NDDxpPresetTriggers, 0);
         setIntegerParam(i, NDDxpForceRead, 0);
+        setIntegerParam(i, NDDxpSumInclude, 1);
+        setDoubleParam (i, NDDxpSumGain, 1.0);
+        setDoubleParam (i, NDDxpSumOffset, 0.0);
+        setIntegerParam(i, NDDxpSumDeadTimeCorrect, 1);
+        setIntegerParam(i, NDDxpSumArrayCallbacks, 0);
+        setIntegerParam(i, NDDxpTraceArrayCallbacks, 0);
+        setIntegerParam(i, NDDxpBaselineArrayCallbacks, 0);
+        setIntegerParam(i, NDDxpNumROIs, 0);
+        setIntegerParam(i, NDDxpROIArrayCallbacks, 0);
+        for (roi=0; roi<DXP_MAX_ROIS; roi++) {
+            setIntegerParam(i, NDDxpROILow[roi], 0);
+            setIntegerParam(i, NDDxpROIHigh[roi], 0);
+            setDoubleParam (i, NDDxpROICounts[roi], 0.0);
+        }
         setDoubleParam (i, mcaPresetCounts, 0.0);
         setDoubleParam (i, mcaElapsedCounts, 0.0);
         setDoubleParam (i, mcaPresetRealTime, 0.0);
@@ -779,15 +1305,51 @@ NDDxp::NDDxp(const char *portName, int nChannels, int maxBuffers, size_t maxMemo
     }
 
     /* Read the MCA and DXP parameters once */
+    epicsTimeGetCurrent(&stepStart);
     this->getDxpParams(this->pasynUserSelf, DXP_ALL);
+    epicsTimeGetCurrent(&stepEnd);
+    this->startupTime[NDDxpStartupParams] = epicsTimeDiffInSeconds(&stepEnd, &stepStart);
     this->getAcquisitionStatus(this->pasynUserSelf, DXP_ALL);
+    epicsTimeGetCurrent(&stepStart);
     this->getAcquisitionStatistics(this->pasynUserSelf, DXP_ALL);
+    epicsTimeGetCurrent(&stepEnd);
+    this->startupTime[NDDxpStartupStatistics] = epicsTimeDiffInSeconds(&stepEnd, &stepStart);
     
     // Enable array callbacks by default
     setIntegerParam(NDArrayCallbacks, 1);
 
     // Disable auto-apply
     setIntegerParam(NDDxpAutoApply, 0);
+
+    setDoubleParam(NDDxpStartupConfigTime, epicsTimeDiffInSeconds(&stepEnd, &configStart));
+    this->getStartupTimes();
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+        "%s:%s: configuration took %f s\n",
+        driverName, functionName, epicsTimeDiffInSeconds(&stepEnd, &configStart));
+}
+
+/* Copies the time taken by the Handel startup phases into the startup timing parameters.
+ * The channel and module setup are run once per channel or module, so their total is used. */
+void NDDxp::getStartupTimes()
+{
+    double stats[XERXES_NUM_STATS];
+    double firmware = 0., setup = 0.;
+    char *startup = (char *)"startup";
+
+    if (xiaGetTimingStatistics(startup, (char *)"init", stats) == XIA_SUCCESS)
+        setDoubleParam(NDDxpStartupInitTime, stats[XERXES_STAT_LAST]);
+    if (xiaGetTimingStatistics(startup, (char *)"start_system", stats) == XIA_SUCCESS)
+        setDoubleParam(NDDxpStartupSystemTime, stats[XERXES_STAT_LAST]);
+    if (xiaGetTimingStatistics(startup, (char *)"fpga_download", stats) == XIA_SUCCESS)
+        firmware += stats[XERXES_STAT_LAST];
+    if (xiaGetTimingStatistics(startup, (char *)"dsp_download", stats) == XIA_SUCCESS)
+        firmware += stats[XERXES_STAT_LAST];
+    setDoubleParam(NDDxpStartupFirmwareTime, firmware);
+    if (xiaGetTimingStatistics(startup, (char *)"channel_setup", stats) == XIA_SUCCESS)
+        setup += stats[XERXES_STAT_TOTAL];
+    if (xiaGetTimingStatistics(startup, (char *)"module_setup", stats) == XIA_SUCCESS)
+        setup += stats[XERXES_STAT_TOTAL];
+    setDoubleParam(NDDxpStartupSetupTime, setup);
 }
 
 /* virtual methods to override from ADDriver */
@@ -816,6 +1378,7 @@ asynStatus NDDxp::writeInt32( asynUser *pasynUser, epicsInt32 value)
         (function == NDDxpPixelsPerBuffer)     ||
         (function == NDDxpAutoPixelsPerBuffer) ||
         (function == NDDxpSyncCount)           ||
+        (function == NDDxpWordPacking)         ||
         (function == NDDxpIgnoreGate)          ||
         (function == NDDxpPixelAdvanceMode)    ||
         (function == NDDxpInputLogicPolarity))
@@ -830,10 +1393,24 @@ asynStatus NDDxp::writeInt32( asynUser *pasynUser, epicsInt32 value)
         }
         setIntegerParam(addr, function, 0);
     }
+    else if (function == NDDxpStreamEnable)
+    {
+        if (value) {
+            status = this->openStream();
+            if (status) setIntegerParam(addr, function, 0);
+        } else {
+            this->closeStream();
+        }
+    }
     else if (function == NDDxpApply)
     {
         if (value) this->apply(DXP_ALL, 1);
     }
+    else if (function == NDDxpPerfReset)
+    {
+        if (value) this->resetPerformance();
+        setIntegerParam(addr, function, 0);
+    }
     else if (function == mcaErase) 
     {
         getIntegerParam(addr, mcaNumChannels, &numChans);
@@ -900,6 +1477,22 @@ asynStatus NDDxp::writeInt32( asynUser *pasynUser, epicsInt32 value)
     {
         this->getLLDxpParams(pasynUser, addr);
     } 
+    else if (function == NDDxpReadTraces) 
+    {
+        if (value) {
+            status = this->getTraceAll(pasynUser, NULL, 0, NULL);
+            /* Set the read command back to 0 */
+            setIntegerParam(addr, NDDxpReadTraces, 0);
+        }
+    } 
+    else if (function == NDDxpReadBaselineHistograms) 
+    {
+        if (value) {
+            status = this->getBaselineHistogramAll(pasynUser, NULL, 0, NULL);
+            /* Set the read command back to 0 */
+            setIntegerParam(addr, NDDxpReadBaselineHistograms, 0);
+        }
+    } 
     else if ((function == NDDxpDetectorPolarity) ||
              (function == NDDxpEnableBaselineCut)||
              (function == NDDxpBaselineAverage)  ||
@@ -914,6 +1507,12 @@ asynStatus NDDxp::writeInt32( asynUser *pasynUser, epicsInt32 value)
     {
         this->setSCAs(pasynUser, addr);
     }
+    else if ((function == NDDxpNumROIs)    ||
+             ((function >= NDDxpROILow[0]) &&
+              (function <= NDDxpROIHigh[DXP_MAX_ROIS-1]))) 
+    {
+        this->setROIs(addr, function, value);
+    }
     else if ((function >= NDDxpLLParamVals[0]) &&
              (function <= NDDxpLLParamVals[numLLParams-1])) 
     {
@@ -1012,6 +1611,7 @@ asynStatus NDDxp::readInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t
     int nBins, acquiring,mode;
     int ch;
     int i;
+    int fresh;
     const char *functionName = "readInt32Array";
 
     channel = this->getChannel(pasynUser, &addr);
@@ -1027,14 +1627,38 @@ asynStatus NDDxp::readInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t
     {
         status = this->getBaselineHistogram(pasynUser, channel, value, nElements, nIn);
     } 
+    else if (function == NDDxpReadTimeHistogram)
+    {
+        *nIn = (nElements < NUM_READ_TIME_BINS) ? nElements : NUM_READ_TIME_BINS;
+        memcpy(value, this->readTimeHistogram, *nIn * sizeof(epicsInt32));
+    }
     else if (function == mcaData) 
     {
         if (channel == DXP_ALL)
         {
-            // if the MCA ALL channel is being read - force reading of all individual
-            // channels using the NDDxpForceRead command.
+            // The MCA ALL channel returns the sum spectrum of all channels.
+            // The NDArrays are only sent at the end of a point or on a snapshot, not on each read.
+            getIntegerParam(mcaNumChannels, &nBins);
+            if (nBins > (int)nElements) nBins = (int)nElements;
+            getIntegerParam(NDDxpCollectMode, &mode);
+            getIntegerParam(addr, NDDxpAcquiring, &acquiring);
+            fresh = 0;
+            if (acquiring && (mode == NDDxpModeMCA) && !this->snapshotReadout())
+            {
+                this->getAcquisitionStatistics(pasynUser, DXP_ALL);
+                fresh = (this->getMcaData(pasynUser, DXP_ALL) == asynSuccess);
+            }
+            this->computeSumSpectrum(NULL);
+            this->computeROIs(NULL);
+            for (i=0; i<nBins; i++) {
+                value[i] = (epicsInt32)(this->sumSpectrumBuffer[i] + 0.5);
+            }
+            *nIn = nBins;
+            // Force reading of all individual channels using the NDDxpForceRead command.
+            // The spectra were just read, so the channel reads use pMcaRaw rather than reading them again.
             for (ch=0; ch<this->nChannels; ch++)
             {
+                this->mcaRawFresh[ch] = fresh;
                 setIntegerParam(ch, NDDxpForceRead, 1);
                 callParamCallbacks(ch, ch);
                 setIntegerParam(ch, NDDxpForceRead, 0);
@@ -1058,14 +1682,16 @@ asynStatus NDDxp::readInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t
         {
             if (mode == NDDxpModeMCA)
             {
-                /* While acquiring we'll force reading the data from the HW */
-                this->getMcaData(pasynUser, addr);
+                /* While acquiring we'll force reading the data from the HW,
+                 * unless the polling task is reading snapshots or the ALL read has just read it */
+                if (!this->snapshotReadout() && !this->mcaRawFresh[addr]) this->getMcaData(pasynUser, addr);
             } else if ((mode == NDDxpModeSpectraMapping) || (mode == NDDxpModeSCAMapping))
             {
                 /*  Nothing needed here, the last data read from the mapping buffer has already been
                  *  copied to the buffer pointed to by pMcaRaw. */
             }
         }
+        this->mcaRawFresh[addr] = 0;
         for (i=0; i<nBins; i++) {
             value[i] = pMcaRaw[addr][i];
         }
@@ -1671,6 +2297,7 @@ asynStatus NDDxp::configureCollectMode()
     int syncCount;
     int ignoreGate;
     int inputLogicPolarity;
+    int wordPacking;
     NDDxpPixelAdvanceMode_t pixelAdvanceMode;
     const char* functionName = "configureCollectMode";
 
@@ -1741,6 +2368,7 @@ asynStatus NDDxp::configureCollectMode()
         if (syncCount < 1) syncCount = 1;
         getIntegerParam(NDDxpIgnoreGate, &ignoreGate);
         getIntegerParam(NDDxpInputLogicPolarity, &inputLogicPolarity);
+        getIntegerParam(NDDxpWordPacking, &wordPacking);
         setIntegerParam(NDDataType, NDUInt16);
             
         if (collectMode == NDDxpModeListMapping) {
@@ -1799,6 +2427,17 @@ asynStatus NDDxp::configureCollectMode()
                 driverName, functionName, firstCh, dTmp);
             xiastatus = xiaSetAcquisitionValues(firstCh, "input_logic_polarity", &dTmp);
             status = this->xia_checkError(pasynUserSelf, xiastatus, "input_logic_polarity");
+
+            /* Word packing is only supported on the xMAP and Mercury */
+            if ((this->deviceType == NDDxpModelXMAP) ||
+                (this->deviceType == NDDxpModelMercury)) {
+                dTmp = wordPacking ? 1. : 0.;
+                asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
+                    "%s::%s [%d] setting word_packing = %f\n", 
+                    driverName, functionName, firstCh, dTmp);
+                xiastatus = xiaSetAcquisitionValues(firstCh, "word_packing", &dTmp);
+                status = this->xia_checkError(pasynUserSelf, xiastatus, "word_packing");
+            }
             
             /* Apply the values */
             this->apply(firstCh);
@@ -1879,7 +2518,10 @@ asynStatus NDDxp::getModuleStatistics(asynUser *pasynUser, int addr, moduleStati
     asynPrint(pasynUser, ASYN_TRACE_FLOW, 
         "%s:%s: enter addr=%d\n",
         driverName, functionName, addr);
-    status = xiaGetRunData(addr, "module_statistics_2", (double *)stats);
+    if (this->snapshotReadout())
+        status = xiaGetRunData(addr, "snapshot_statistics", (double *)stats);
+    else
+        status = xiaGetRunData(addr, "module_statistics_2", (double *)stats);
     /* It appears that the xMAP sometimes returns 0 energy live time when it should not.
      * Fix this here */
     for (i=0; i<this->channelsPerCard; i++) {
@@ -1897,6 +2539,70 @@ asynStatus NDDxp::getModuleStatistics(asynUser *pasynUser, int addr, moduleStati
 }     
      
 
+/* Read the statistics for all channels of a module into the module statistics cache.
+ * The statistics are read into a temporary copy, so on error the cache is left as it was
+ * and is not marked as updated. */
+asynStatus NDDxp::updateModuleStatistics(asynUser *pasynUser, int card)
+{
+    moduleStatisticsCache *pCache = &this->moduleStatsCache[card];
+    moduleStatistics newStats[MAX_CHANNELS_PER_CARD];
+    moduleStatistics *stats;
+    asynStatus status;
+    int i;
+
+    status = getModuleStatistics(pasynUser, card*this->channelsPerCard, newStats);
+    if (status) return asynError;
+    /* There is a bug in the Saturn firmware.  It does not correctly compute the energy live time
+     * because it ignores overflow and underflow events.  It does correctly include the overflow
+     * and underflow events in OCR, so we compute energy live time here. */
+    if (this->deviceType == NDDxpModelSaturn) {
+        for (i=0; i<this->channelsPerCard; i++) {
+            stats = &newStats[i];
+            stats->energyLiveTime = stats->realTime * stats->ocr / stats->icr;
+        }
+    }
+    memcpy(pCache->stats, newStats, this->channelsPerCard * sizeof(moduleStatistics));
+    epicsTimeGetCurrent(&pCache->timeStamp);
+    pCache->generation++;
+    if (pCache->generation == 0) pCache->generation = 1;
+    return asynSuccess;
+}
+
+/* Start a new statistics cycle, reading the statistics of every module once.
+ * The result of each read, including a failure, is recorded for the cycle, so the channels
+ * that ask for their statistics during the cycle never read the module again. */
+asynStatus NDDxp::startStatisticsCycle(asynUser *pasynUser)
+{
+    moduleStatisticsCache *pCache;
+    asynStatus status = asynSuccess;
+    int card;
+
+    this->statsCycle++;
+    if (this->statsCycle == 0) this->statsCycle = 1;
+    for (card=0; card<this->nCards; card++) {
+        pCache = &this->moduleStatsCache[card];
+        pCache->status = this->updateModuleStatistics(pasynUser, card);
+        pCache->cycle = this->statsCycle;
+        if (pCache->status != asynSuccess) status = asynError;
+    }
+    return status;
+}
+
+/* Return the statistics for a channel from the module statistics cache. This never reads the
+ * module: the statistics are those of the current cycle, or the last ones read if the module
+ * was not read in it. Returns asynError, and does not set *stats, if the read of the module
+ * in the current cycle failed or the module has never been read. */
+asynStatus NDDxp::getCachedStatistics(asynUser *pasynUser, int channel, moduleStatistics **stats)
+{
+    int card = channel / this->channelsPerCard;
+    moduleStatisticsCache *pCache = &this->moduleStatsCache[card];
+
+    if ((pCache->cycle == this->statsCycle) && (pCache->status != asynSuccess)) return asynError;
+    if (pCache->generation == 0) return asynError;
+    *stats = &pCache->stats[channel % this->channelsPerCard];
+    return asynSuccess;
+}
+
 asynStatus NDDxp::getAcquisitionStatistics(asynUser *pasynUser, int addr)
 {
     double dvalue, triggerLiveTime=0, energyLiveTime=0, realTime=0, icr=0, ocr=0;
@@ -1906,6 +2612,7 @@ asynStatus NDDxp::getAcquisitionStatistics(asynUser *pasynUser, int addr)
     int channel=addr;
     int erased;
     int i;
+    asynStatus status = asynSuccess;
     const char *functionName = "getAcquisitionStatistics";
 
     if (addr == this->nChannels) channel = DXP_ALL;
@@ -1917,9 +2624,14 @@ asynStatus NDDxp::getAcquisitionStatistics(asynUser *pasynUser, int addr)
             "%s::%s start DXP_ALL\n", 
             driverName, functionName);
         addr = this->nChannels;
+        /* Read each module once, the channels below then all use these statistics */
+        getIntegerParam(addr, NDDxpErased, &erased);
+        if (!erased) {
+            if (this->startStatisticsCycle(pasynUser) != asynSuccess) status = asynError;
+        }
         for (i=0; i<this->nChannels; i++) {
             /* Call ourselves recursively but with a specific channel */
-            this->getAcquisitionStatistics(pasynUser, i);
+            if (this->getAcquisitionStatistics(pasynUser, i) != asynSuccess) status = asynError;
             getDoubleParam(i, mcaElapsedLiveTime, &dvalue);
             energyLiveTime = MAX(energyLiveTime, dvalue);
             getDoubleParam(i, NDDxpTriggerLiveTime, &dvalue);
@@ -1967,15 +2679,14 @@ asynStatus NDDxp::getAcquisitionStatistics(asynUser *pasynUser, int addr)
             setIntegerParam(addr, NDDxpTriggers, 0);
             setDoubleParam(addr, NDDxpTriggerLiveTime, 0);
         } else {
-            /* We only read the module statistics data if this is the first channel in a module.
-             * This assumes we are reading in numerical order, else we may get stale data! */
-            if ((channel % this->channelsPerCard) == 0) getModuleStatistics(pasynUser, channel, &moduleStats[0]);
-            stats = &moduleStats[channel % this->channelsPerCard];
-            /* There is a bug in the Saturn firmware.  It does not correctly compute the energy live time
-             * because it ignores overflow and underflow events.  It does correctly include the overflow
-             * and underflow events in OCR, so we compute energy live time here. */
-            if (this->deviceType == NDDxpModelSaturn) {
-                stats->energyLiveTime = stats->realTime * stats->ocr / stats->icr;
+            /* Use the module statistics of the current cycle, the module is not read here */
+            status = this->getCachedStatistics(pasynUser, channel, &stats);
+            if (status != asynSuccess) {
+                /* Leave the last published statistics unchanged rather than publish stale ones */
+                asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                    "%s::%s error reading statistics for channel %d\n",
+                    driverName, functionName, addr);
+                return status;
             }
             setIntegerParam(addr, NDDxpTriggers, (int)stats->triggers);
             setIntegerParam(addr, NDDxpEvents, (int)stats->events);
@@ -2013,7 +2724,7 @@ asynStatus NDDxp::getAcquisitionStatistics(asynUser *pasynUser, int addr)
     asynPrint(pasynUser, ASYN_TRACE_FLOW, 
         "%s:%s: exit\n",
         driverName, functionName);
-    return(asynSuccess);
+    return(status);
 }
 
 asynStatus NDDxp::getDxpParams(asynUser *pasynUser, int addr)
@@ -2047,6 +2758,9 @@ asynStatus NDDxp::getDxpParams(asynUser *pasynUser, int addr)
             this->getDxpParams(pasynUser, i);
         }
     } else {
+        /* Force the baseline histogram energy axis to be recomputed on the next read */
+        setDoubleParam(channel, NDDxpBaselineEnergy, 0.);
+
         xiaGetAcquisitionValues(channel, "energy_threshold", &dvalue);
         /* Convert energy threshold from eV to keV */
         dvalue /= 1000.;
@@ -2343,7 +3057,6 @@ asynStatus NDDxp::getMcaData(asynUser *pasynUser, int addr)
     int nChannels;
     int channel=addr;
     int i;
-    //NDArray *pArray;
     NDDataType_t dataType;
     epicsTimeStamp now;
     const char* functionName = "getMcaData";
@@ -2368,22 +3081,16 @@ asynStatus NDDxp::getMcaData(asynUser *pasynUser, int addr)
         /* Read the MCA spectrum from Handel.
         * For most devices this means getting 1 channel spectrum here.
         * For the XMAP we get all 4 channels on the board in one go here */
-        CALLHANDEL( xiaGetRunData(addr, "mca", this->pMcaRaw[addr]),"xiaGetRunData")
+        if (this->snapshotReadout()) {
+            CALLHANDEL( xiaGetRunData(addr, "snapshot_mca", this->pMcaRaw[addr]),"xiaGetRunData")
+        } else {
+            CALLHANDEL( xiaGetRunData(addr, "mca", this->pMcaRaw[addr]),"xiaGetRunData")
+        }
         asynPrintIO(pasynUser, ASYN_TRACEIO_DRIVER, (const char *)pMcaRaw[addr], nChannels*sizeof(pMcaRaw[0][0]),
             "%s::%s Got MCA spectrum channel:%d ptr:%p\n",
             driverName, functionName, channel, pMcaRaw[addr]);
-
-// In the future we may want to do array callbacks with the MCA data.  For now we are not doing this.
-//        if (arrayCallbacks)
-//       {
-//            /* Allocate a buffer for callback */
-//            pArray = this->pNDArrayPool->alloc(1, &nChannels, dataType, 0, NULL);
-//            pArray->timeStamp = now.secPastEpoch + now.nsec / 1.e9;
-//            pArray->uniqueId = spectrumCounter;
-//            /* TODO: Need to copy the data here */
-//            doCallbacksGenericPointer(pArray, NDArrayData, addr);
-//            pArray->release();
-//       }
+        /* The NDArray callbacks with the spectra of all channels are done by doMcaArrayCallbacks
+         * when the acquisition completes */
     }
     asynPrint(pasynUser, ASYN_TRACE_FLOW, 
         "%s:%s: exit\n",
@@ -2391,266 +3098,1402 @@ asynStatus NDDxp::getMcaData(asynUser *pasynUser, int addr)
     return status;
 }
 
-/** Reads the mapping data for all of the modules in the system */
-asynStatus NDDxp::getMappingData()
+/* Returns 1 if the spectra and statistics of an MCA mode acquisition are read from the last
+ * snapshot rather than from the live data. This is the MicroDXP continuous readout mode. */
+int NDDxp::snapshotReadout()
+{
+    int mode, acquiring;
+    double period;
+
+    if (this->deviceType != NDDxpModelMicroDXP) return 0;
+    if (!this->snapshotValid) return 0;
+    getDoubleParam(NDDxpContinuousReadoutPeriod, &period);
+    getIntegerParam(NDDxpCollectMode, &mode);
+    getIntegerParam(this->nChannels, NDDxpAcquiring, &acquiring);
+    return ((period > 0.) && (mode == NDDxpModeMCA) && acquiring);
+}
+
+/* Takes a snapshot of the spectra and statistics of all channels without stopping the run,
+ * then reads the statistics and spectra back to back and tells the mca records to read them. */
+asynStatus NDDxp::readSnapshot(asynUser *pasynUser)
+{
+    int xiastatus;
+    int ch;
+    double clearSpectrum = 0.;
+    const char* functionName = "readSnapshot";
+
+    for (ch=0; ch<this->nChannels; ch++) {
+        xiastatus = xiaDoSpecialRun(ch, (char *)"snapshot", &clearSpectrum);
+        if (xiastatus != XIA_SUCCESS) {
+            asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s::%s error taking snapshot on channel %d, status=%d, disabling continuous readout\n",
+                driverName, functionName, ch, xiastatus);
+            setDoubleParam(NDDxpContinuousReadoutPeriod, 0.);
+            this->snapshotValid = 0;
+            return asynError;
+        }
+    }
+    this->snapshotValid = 1;
+    epicsTimeGetCurrent(&this->lastSnapshotTime);
+
+    this->getAcquisitionStatistics(pasynUser, DXP_ALL);
+    this->getMcaData(pasynUser, DXP_ALL);
+    this->computeSumSpectrum(&this->lastSnapshotTime);
+    this->computeROIs(&this->lastSnapshotTime);
+    for (ch=0; ch<this->nChannels; ch++) {
+        setIntegerParam(ch, NDDxpForceRead, 1);
+        callParamCallbacks(ch, ch);
+        setIntegerParam(ch, NDDxpForceRead, 0);
+        callParamCallbacks(ch, ch);
+    }
+    return asynSuccess;
+}
+
+/** Reads out the current mapping buffer of one module and releases it to the hardware.
+  * The data are copied into the NDArray that is published once all modules have been read. */
+asynStatus NDDxp::readMappingBuffer(int module)
 {
     asynStatus status = asynSuccess;
     int xiastatus;
     int arrayCallbacks;
     NDDataType_t dataType;
-    int buf = 0, channel, i, k, l;
-    NDArray *pArray=NULL;
-    epicsUInt16 *pOut=0;
+    int buf, channel, i, k, l;
     epicsUInt16 *pStats;
     int mappingMode, pixelOffset, dataOffset, events, triggers, nChans;
     double realTime, triggerLiveTime, energyLiveTime, icr, ocr;
     size_t dims[2];
-    int bufferCounter, arraySize;
+    int arraySize;
+    unsigned short overrun;
     epicsTimeStamp now, after;
     double mBytesRead;
     double readoutTime, readoutBurstRate, MBbufSize;
-    const char* functionName = "getMappingData";
-
-    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW, 
-        "%s:%s: enter\n",
-        driverName, functionName);
+    epicsUInt32 bufferNumber;
+    NDDxpMappingReadout_t readout;
+    moduleMappingBuffer *pMod = &this->mappingBuffers[module];
+    mappingBufferSet *pSet;
+    const char* functionName = "readMappingBuffer";
 
     getIntegerParam(NDDataType, (int *)&dataType);
-    getIntegerParam(NDDxpBufferCounter, &bufferCounter);
-    bufferCounter++;
-    setIntegerParam(NDDxpBufferCounter, bufferCounter);
+    getIntegerParam(NDDxpMappingReadout, (int *)&readout);
     getIntegerParam(NDArraySize, &arraySize);
     getDoubleParam(NDDxpMBytesRead, &mBytesRead);
     getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
     MBbufSize = (double)((arraySize)*sizeof(epicsUInt16)) / (double)MEGABYTE;
 
-    /* First read and reset the buffers, do this as quickly as possible */
-    for (channel=0; channel<this->nChannels; channel+=this->channelsPerCard)
-    {
-        buf = this->currentBuf[channel];
+    channel = module * this->channelsPerCard;
+    buf = pMod->buf;
 
-        /* The buffer is full so read it out */
-        epicsTimeGetCurrent(&now);
-        xiastatus = xiaGetRunData(channel, NDDxpBufferString[buf], this->pMapTemp);
-        status = xia_checkError(this->pasynUserSelf, xiastatus, "GetRunData mapping");
-        epicsTimeGetCurrent(&after);
-        readoutTime = epicsTimeDiffInSeconds(&after, &now);
-        readoutBurstRate = MBbufSize / readoutTime;
-        mBytesRead += MBbufSize;
-        setDoubleParam(NDDxpMBytesRead, mBytesRead);
-        setDoubleParam(NDDxpReadRate, readoutBurstRate);
-        /* Notify system that we read out the buffer */
-        xiastatus = xiaBoardOperation(channel, "buffer_done", NDDxpBufferCharString[buf]);
-        status = xia_checkError(this->pasynUserSelf, xiastatus, "buffer_done");
-        if (buf == 0) this->currentBuf[channel] = 1;
-        else this->currentBuf[channel] = 0;
-        callParamCallbacks();
-        /* xisGetRunData requires an unsigned long buffer, but the data are actually only 16 bits.
-         * Convert to 16-bit data here */
-        for (i=0; i<arraySize; i++) {
-            pMapRaw[i] = (epicsUInt16) pMapTemp[i];
-        }
-    
-        asynPrint(this->pasynUserSelf, ASYN_TRACEIO_DRIVER, 
-            "%s::%s Got data! size=%.3fMB (%d) dt=%.3fs speed=%.3fMB/s\n",
-            driverName, functionName, MBbufSize, arraySize, readoutTime, readoutBurstRate);
-        asynPrint(this->pasynUserSelf, ASYN_TRACEIO_DRIVER, 
-            "%s::%s channel=%d, tag0=0x%x, tag1=0x%x, headerSize=%d, mappingMode=%d, runNumber=%d, bufferNumber=%d, bufferID=%d, numPixels=%d, firstPixel=%d\n",
-            driverName, functionName, channel, pMapRaw[0], pMapRaw[1], pMapRaw[2], pMapRaw[3], pMapRaw[4], pMapRaw[5], pMapRaw[7], pMapRaw[8], pMapRaw[9]);
-    
-        /* If this is MCA mapping mode then copy the spectral data for the first pixel
-         * in this buffer to the mcaRaw buffers.
-         * This provides an update of the spectra and statistics while mapping is in progress
-         * if the user sets the MCA spectra to periodically read. */
-        mappingMode = pMapRaw[3];
-        if (mappingMode == NDDxpModeSpectraMapping) {
-            pixelOffset = 256;
-            dataOffset = pixelOffset + 256;
-            for (i=0; i<this->channelsPerCard; i++) {
-                k = channel + i;
-                nChans = pMapRaw[pixelOffset + 8 + i];
-                for (l=0; l<nChans; l++) {
-                    pMcaRaw[k][l] = pMapRaw[dataOffset + l];
-                }
-                dataOffset += nChans;
-                pStats = &pMapRaw[pixelOffset + 32 + i*8];
-                realTime        = (pStats[0] + (pStats[1]<<16)) * MAPPING_CLOCK_PERIOD;
-                triggerLiveTime = (pStats[2] + (pStats[3]<<16)) * MAPPING_CLOCK_PERIOD;
-                triggers        =  pStats[4] + (pStats[5]<<16);
-                events          =  pStats[6] + (pStats[7]<<16);
-                if (triggers > 0.) 
-                    energyLiveTime = (triggerLiveTime * events) / triggers;
-                else
-                    energyLiveTime = triggerLiveTime;
-                if (triggerLiveTime > 0.)
-                    icr = triggers / triggerLiveTime;
-                else
-                    icr = 0.;
-                if (realTime > 0.)
-                    ocr = events / realTime;
-                else
-                    ocr = 0.;
-                setDoubleParam(k, mcaElapsedRealTime, realTime);
-                setDoubleParam(k, mcaElapsedLiveTime, energyLiveTime);
-                setDoubleParam(k, NDDxpTriggerLiveTime, triggerLiveTime);
-                setIntegerParam(k,NDDxpEvents, events);
-                setIntegerParam(k, NDDxpTriggers, triggers);
-                setDoubleParam(k, NDDxpInputCountRate, icr);
-                setDoubleParam(k, NDDxpOutputCountRate, ocr);
-                callParamCallbacks(k, k);
+    /* The buffer is full so read it out */
+    epicsTimeGetCurrent(&now);
+    xiastatus = xiaGetRunData(channel, NDDxpBufferString[buf], this->pMapTemp);
+    status = xia_checkError(this->pasynUserSelf, xiastatus, "GetRunData mapping");
+    epicsTimeGetCurrent(&after);
+    readoutTime = epicsTimeDiffInSeconds(&after, &now);
+    readoutBurstRate = MBbufSize / readoutTime;
+    mBytesRead += MBbufSize;
+    setDoubleParam(NDDxpMBytesRead, mBytesRead);
+    setDoubleParam(NDDxpReadRate, readoutBurstRate);
+    this->updateReadStatistics(module, readoutTime, MBbufSize, &after);
+    /* The overrun flag stays set for the rest of the run, so only count the first time it is seen */
+    xiastatus = xiaGetRunData(channel, "buffer_overrun", &overrun);
+    if ((xiastatus == XIA_SUCCESS) && overrun && !pMod->overrun) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s module %d reported a mapping buffer overrun, data were lost\n",
+            driverName, functionName, module);
+        this->perfOverruns++;
+        setIntegerParam(NDDxpOverruns, this->perfOverruns);
+        setIntegerParam(channel, NDDxpBufferOverrun, 1);
+        pMod->overrun = overrun;
+    }
+    /* Notify system that we read out the buffer */
+    xiastatus = xiaBoardOperation(channel, "buffer_done", NDDxpBufferCharString[buf]);
+    status = xia_checkError(this->pasynUserSelf, xiastatus, "buffer_done");
+    pMod->buf = (buf == 0) ? 1 : 0;
+    /* In independent readout the module goes straight back to filling, otherwise it waits
+     * until the buffers of all modules have been published */
+    pMod->state = (readout == NDDxpReadoutIndependent) ? NDDxpBufferFilling : NDDxpBufferStaged;
+    /* xisGetRunData requires an unsigned long buffer, but the data are actually only 16 bits.
+     * Convert to 16-bit data here */
+    for (i=0; i<arraySize; i++) {
+        pMapRaw[i] = (epicsUInt16) pMapTemp[i];
+    }
+    bufferNumber     = pMapRaw[5] | (pMapRaw[6] << 16);
+    pMod->firstPixel = pMapRaw[9] | (pMapRaw[10] << 16);
+
+    asynPrint(this->pasynUserSelf, ASYN_TRACEIO_DRIVER, 
+        "%s::%s Got data! size=%.3fMB (%d) dt=%.3fs speed=%.3fMB/s\n",
+        driverName, functionName, MBbufSize, arraySize, readoutTime, readoutBurstRate);
+    asynPrint(this->pasynUserSelf, ASYN_TRACEIO_DRIVER, 
+        "%s::%s channel=%d, tag0=0x%x, tag1=0x%x, headerSize=%d, mappingMode=%d, runNumber=%d, bufferNumber=%u, bufferID=%d, numPixels=%d, firstPixel=%u\n",
+        driverName, functionName, channel, pMapRaw[0], pMapRaw[1], pMapRaw[2], pMapRaw[3], pMapRaw[4], 
+        bufferNumber, pMapRaw[7], pMapRaw[8], pMod->firstPixel);
+
+    /* A module that repeats a buffer number would be counted twice in its set */
+    if ((pMod->numBuffers > 0) && (bufferNumber <= pMod->bufferNumber)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s module %d read buffer number %u after %u, discarding it\n",
+            driverName, functionName, module, bufferNumber, pMod->bufferNumber);
+        pMod->state = NDDxpBufferFilling;
+        return asynError;
+    }
+    pMod->bufferNumber = bufferNumber;
+    pMod->numBuffers++;
+
+    this->queueStreamBuffer(module, bufferNumber, pMod->firstPixel, pMapRaw, arraySize, &now);
+
+    /* If this is MCA mapping mode then copy the spectral data for the first pixel
+     * in this buffer to the mcaRaw buffers.
+     * This provides an update of the spectra and statistics while mapping is in progress
+     * if the user sets the MCA spectra to periodically read. */
+    mappingMode = pMapRaw[3];
+    if (mappingMode == NDDxpModeSpectraMapping) {
+        pixelOffset = 256;
+        dataOffset = pixelOffset + 256;
+        for (i=0; i<this->channelsPerCard; i++) {
+            k = channel + i;
+            nChans = pMapRaw[pixelOffset + 8 + i];
+            for (l=0; l<nChans; l++) {
+                pMcaRaw[k][l] = pMapRaw[dataOffset + l];
             }
+            dataOffset += nChans;
+            pStats = &pMapRaw[pixelOffset + 32 + i*8];
+            realTime        = (pStats[0] + (pStats[1]<<16)) * MAPPING_CLOCK_PERIOD;
+            triggerLiveTime = (pStats[2] + (pStats[3]<<16)) * MAPPING_CLOCK_PERIOD;
+            triggers        =  pStats[4] + (pStats[5]<<16);
+            events          =  pStats[6] + (pStats[7]<<16);
+            if (triggers > 0.) 
+                energyLiveTime = (triggerLiveTime * events) / triggers;
+            else
+                energyLiveTime = triggerLiveTime;
+            if (triggerLiveTime > 0.)
+                icr = triggers / triggerLiveTime;
+            else
+                icr = 0.;
+            if (realTime > 0.)
+                ocr = events / realTime;
+            else
+                ocr = 0.;
+            setDoubleParam(k, mcaElapsedRealTime, realTime);
+            setDoubleParam(k, mcaElapsedLiveTime, energyLiveTime);
+            setDoubleParam(k, NDDxpTriggerLiveTime, triggerLiveTime);
+            setIntegerParam(k,NDDxpEvents, events);
+            setIntegerParam(k, NDDxpTriggers, triggers);
+            setDoubleParam(k, NDDxpInputCountRate, icr);
+            setDoubleParam(k, NDDxpOutputCountRate, ocr);
         }
-            
-        if (arrayCallbacks)
-        {
-            /* Now rearrange the data and do the callbacks */
-            /* If this is the first module then allocate an NDArray for the callback */
-            if (channel == 0) {
-               dims[0] = arraySize;
-               dims[1] = this->nCards;
-               pArray = this->pNDArrayPool->alloc(2, dims, dataType, 0, NULL );
-               pOut = (epicsUInt16 *)pArray->pData;
-            }
-            
-            memcpy(pOut, pMapRaw, arraySize * sizeof(epicsUInt16));
-            pOut += arraySize;
+    }
+
+    /* Copy the buffer into the set for the same pixels. The first module read for 
+     * the set allocates the NDArray for the callback. */
+    pMod->setKey = (mappingMode == NDDxpModeListMapping) ? bufferNumber : pMod->firstPixel;
+    pSet = this->getMappingSet(pMod->setKey, bufferNumber);
+    if (pSet->numRead == 0) {
+        pSet->firstPixel = pMod->firstPixel;
+        pSet->timeStamp = now;
+        if (arrayCallbacks) {
+           dims[0] = arraySize;
+           dims[1] = this->nCards;
+           pSet->pArray = this->pNDArrayPool->alloc(2, dims, dataType, 0, NULL );
         }
+    } 
+    else if (pSet->bufferNumber != bufferNumber) {
+        /* The module skipped or repeated a buffer. Its pixels still line up with the set, 
+         * but the other modules number this buffer differently. */
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s module %d buffer number %u starts at pixel %u, the other modules number it %u\n",
+            driverName, functionName, module, bufferNumber, pMod->firstPixel, pSet->bufferNumber);
+        this->perfPixelMismatches++;
+        setIntegerParam(NDDxpPixelMismatches, this->perfPixelMismatches);
     }
-    if (arrayCallbacks) 
-    {
-        pArray->timeStamp = now.secPastEpoch + now.nsec / 1.e9;
-        pArray->uniqueId = bufferCounter;
-        doCallbacksGenericPointer(pArray, NDArrayData, 0);
-        pArray->release();
+    if (pSet->pArray) {
+        memcpy((epicsUInt16 *)pSet->pArray->pData + module*arraySize, pMapRaw, 
+               arraySize * sizeof(epicsUInt16));
     }
+    if (mappingMode == NDDxpModeSpectraMapping) this->computeMappingROIs(module, pSet, arraySize);
+    pSet->numRead++;
     asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, 
-        "%s::%s Done reading! Ch=%d bufchar=%s\n",
-        driverName, functionName, channel, NDDxpBufferCharString[buf]);
+        "%s::%s Done reading! module=%d bufchar=%s\n",
+        driverName, functionName, module, NDDxpBufferCharString[buf]);
 
     return status;
 }
 
-/* Get trace data */
-asynStatus NDDxp::getTrace(asynUser* pasynUser, int addr,
-                           epicsInt32* data, size_t maxLen, size_t *actualLen)
+/** Returns the set that collects the buffers with this key, starting a new set if needed.
+  * If all sets are in use the oldest incomplete set is discarded. */
+mappingBufferSet *NDDxp::getMappingSet(epicsUInt32 key, epicsUInt32 bufferNumber)
 {
-    asynStatus status = asynSuccess;
-    int xiastatus, channel=addr;
-    int i, j;
-    int newTraceTime;
-    double info[2];
-    double traceTime;
-    int traceMode;
-    const char *functionName = "getTrace";
-
-    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
-        "%s:%s: enter addr=%d\n",
-        driverName, functionName, addr);
-    if (addr == this->nChannels) channel = DXP_ALL;
-    if (channel == DXP_ALL) {  /* All channels */
-        for (i=0; i<this->nChannels; i++) {
-            /* Call ourselves recursively but with a specific channel */
-            this->getTrace(pasynUser, i, data, maxLen, actualLen);
+    int i;
+    mappingBufferSet *pSet, *pFree=NULL, *pOldest=NULL;
+    const char* functionName = "getMappingSet";
+
+    for (i=0; i<MAX_MAPPING_SETS; i++) {
+        pSet = &this->mappingSets[i];
+        if (!pSet->inUse) {
+            if (!pFree) pFree = pSet;
+            continue;
         }
-    } else {
-        getDoubleParam(channel, NDDxpTraceTime, &traceTime);
-        getIntegerParam(channel, NDDxpNewTraceTime, &newTraceTime);
-        getIntegerParam(channel, NDDxpTraceMode, &traceMode);
-        info[0] = 0.;
-        /* Convert from us to ns */
-        info[1] = traceTime * 1000.;
+        if (pSet->key == key) return pSet;
+        if (!pOldest || (pSet->key < pOldest->key)) pOldest = pSet;
+    }
+    if (!pFree) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s too many buffers in progress, discarding buffer number %u read by %d modules\n",
+            driverName, functionName, pOldest->bufferNumber, pOldest->numRead);
+        this->releaseMappingSet(pOldest);
+        pFree = pOldest;
+    }
+    pFree->inUse = 1;
+    pFree->key = key;
+    pFree->bufferNumber = bufferNumber;
+    return pFree;
+}
 
-        xiastatus = xiaDoSpecialRun(channel, (char *)NDDxpTraceCommands[traceMode], info);
-        status = this->xia_checkError(pasynUser, xiastatus, NDDxpTraceCommands[traceMode]);
-        // Don't return error, read it out or we get stuck permanently with module busy
-        // if (status == asynError) return asynError;
+void NDDxp::releaseMappingSet(mappingBufferSet *pSet)
+{
+    if (pSet->pArray) pSet->pArray->release();
+    if (pSet->pRoiArray) pSet->pRoiArray->release();
+    memset(pSet, 0, sizeof(*pSet));
+}
 
-        *actualLen = this->traceLength;
-        if (maxLen < *actualLen) *actualLen = maxLen;
+/** Publishes the sets of mapping buffers that have been read out by every module */
+asynStatus NDDxp::getMappingData()
+{
+    asynStatus status = asynSuccess;
+    int i, module, allStaged=1;
+    int bufferCounter;
+    epicsUInt32 key = 0;
+    moduleMappingBuffer *pMod;
+    mappingBufferSet *pSet, *pComplete;
+    const char* functionName = "getMappingData";
 
-        xiastatus = xiaGetSpecialRunData(channel, "adc_trace", this->traceBuffer);
-        status = this->xia_checkError( pasynUser, xiastatus, "adc_trace" );
-        if (status == asynError) return status;
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW, 
+        "%s:%s: enter\n",
+        driverName, functionName);
 
-        // Copy from traceBuffer (unsigned long) to data (epicsInt32)
-        for (j=0; j<(int)*actualLen; j++) data[j] = this->traceBuffer[j];
-        
-        if (newTraceTime) {
-            setIntegerParam(channel, NDDxpNewTraceTime, 0);  /* Clear flag */
-            for (j=0; j<this->traceLength; j++) this->traceTimeBuffer[j] = j*traceTime;
-            doCallbacksFloat64Array(this->traceTimeBuffer, this->traceLength, NDDxpTraceTimeArray, channel);
+    /* Publish the complete sets in the order of their pixels */
+    while (1) {
+        pComplete = NULL;
+        for (i=0; i<MAX_MAPPING_SETS; i++) {
+            pSet = &this->mappingSets[i];
+            if (!pSet->inUse || (pSet->numRead < this->nCards)) continue;
+            if (!pComplete || (pSet->key < pComplete->key)) pComplete = pSet;
+        }
+        if (!pComplete) break;
+
+        /* Sets older than a complete set will never complete, a module skipped that buffer */
+        for (i=0; i<MAX_MAPPING_SETS; i++) {
+            pSet = &this->mappingSets[i];
+            if (!pSet->inUse || (pSet->key >= pComplete->key)) continue;
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+                "%s::%s buffer number %u was only read by %d modules, discarding it\n",
+                driverName, functionName, pSet->bufferNumber, pSet->numRead);
+            this->releaseMappingSet(pSet);
+            status = asynError;
+        }
+
+        getIntegerParam(NDDxpBufferCounter, &bufferCounter);
+        bufferCounter++;
+        setIntegerParam(NDDxpBufferCounter, bufferCounter);
+        if (pComplete->pArray) {
+            pComplete->pArray->timeStamp = pComplete->timeStamp.secPastEpoch + pComplete->timeStamp.nsec / 1.e9;
+            pComplete->pArray->uniqueId = bufferCounter;
+            doCallbacksGenericPointer(pComplete->pArray, NDArrayData, 0);
+        }
+        if (pComplete->pRoiArray) {
+            pComplete->pRoiArray->uniqueId = bufferCounter;
+            this->doMappingROICallbacks(pComplete);
+        }
+        key = pComplete->key;
+        this->releaseMappingSet(pComplete);
+
+        /* Modules waiting for this set to be published can read their next buffer */
+        for (module=0; module<this->nCards; module++) {
+            pMod = &this->mappingBuffers[module];
+            if ((pMod->state == NDDxpBufferStaged) && (pMod->setKey <= key))
+                pMod->state = NDDxpBufferFilling;
         }
     }
-    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
-        "%s:%s: exit\n",
-        driverName, functionName);
+
+    /* If every module is waiting but no set is complete then the modules disagree on the pixels,
+     * i.e. a module has skipped a buffer. Discard the stale buffers and let those modules
+     * catch up with the newest one, which keeps the pixels aligned from then on. */
+    for (module=0; module<this->nCards; module++) {
+        pMod = &this->mappingBuffers[module];
+        if (pMod->state != NDDxpBufferStaged) allStaged = 0;
+        else if (pMod->setKey > key) key = pMod->setKey;
+    }
+    if (!allStaged) return status;
+    for (module=0; module<this->nCards; module++) {
+        pMod = &this->mappingBuffers[module];
+        if (pMod->setKey == key) continue;
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s module %d read buffer number %u starting at pixel %u, behind the other modules, discarding it\n",
+            driverName, functionName, module, pMod->bufferNumber, pMod->firstPixel);
+        pMod->state = NDDxpBufferFilling;
+        status = asynError;
+    }
+    for (i=0; i<MAX_MAPPING_SETS; i++) {
+        pSet = &this->mappingSets[i];
+        if (pSet->inUse && (pSet->key < key)) this->releaseMappingSet(pSet);
+    }
+
     return status;
 }
 
-/* Get trace data */
-asynStatus NDDxp::getBaselineHistogram(asynUser* pasynUser, int addr,
-                                       epicsInt32* data, size_t maxLen, size_t *actualLen)
+/** Opens the raw mapping stream file and its index and starts the stream writer thread */
+asynStatus NDDxp::openStream()
 {
-    asynStatus status = asynSuccess;
-    int i, j;
-    int xiastatus, channel=addr;
-    double dynamicRange, keVPerBin, eVPerBin, energyPerBin, offset;
-    unsigned short baseBinning, slowLen, baseLen;
-    double calibrationEnergy, ADCPercentRule;
-    const char *functionName = "getBaselineHistogram";
+    int i;
+    char fileName[MAX_FILENAME_LEN];
+    char indexName[MAX_FILENAME_LEN+4];
+    const char *functionName = "openStream";
 
-    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
-        "%s:%s: enter addr=%d\n",
-        driverName, functionName, addr);
-    if (addr == this->nChannels) channel = DXP_ALL;
-    if (channel == DXP_ALL) {  /* All channels */
-        for (i=0; i<this->nChannels; i++) {
-            /* Call ourselves recursively but with a specific channel */
-            this->getTrace(pasynUser, i, data, maxLen, actualLen);
-        }
-    } else {
-        *actualLen = this->baselineLength;
-        if (maxLen < *actualLen) *actualLen = maxLen;
+    if (this->streamActive) return asynSuccess;
 
-        xiastatus = xiaGetRunData(channel, "baseline", this->baselineBuffer);
-        status = this->xia_checkError(pasynUser, xiastatus, "baseline" );
-        if (status == asynError) return status;
+    getStringParam(NDDxpStreamFileName, sizeof(fileName), fileName);
+    if (strlen(fileName) == 0) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s no stream file name\n",
+            driverName, functionName);
+        return asynError;
+    }
 
-        // Copy from baselineBuffer (unsigned long) to data (epicsInt32)
-        for (j=0; j<(int)*actualLen; j++) data[j] = this->baselineBuffer[j];
-        
-        /* Compute the energy increment per bin */
-        if ((this->deviceType == NDDxpModelXMAP) ||
-            (this->deviceType == NDDxpModelMercury)) {
-            xiaGetAcquisitionValues(channel, "dynamic_range", &dynamicRange);
-            keVPerBin = dynamicRange/1024/1000.;
+    /* The queue is allocated the first time the stream is opened */
+    if (this->streamFreeQueue == NULL) {
+        for (i=0; i<STREAM_QUEUE_SIZE; i++) {
+            this->streamQueue[i].pData = streamAllocBuffer();
+            if (this->streamQueue[i].pData == NULL) {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+                    "%s::%s error allocating stream queue\n",
+                    driverName, functionName);
+                return asynError;
+            }
+        }
+        this->streamFreeQueue = new epicsMessageQueue(STREAM_QUEUE_SIZE, sizeof(int));
+        this->streamFullQueue = new epicsMessageQueue(STREAM_QUEUE_SIZE+1, sizeof(int));
+        this->streamDoneEvent = new epicsEvent();
+    }
+
+    if (streamFileOpen(&this->streamDataFile, fileName)) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s error opening stream file %s\n",
+            driverName, functionName, fileName);
+        return asynError;
+    }
+    sprintf(indexName, "%s.idx", fileName);
+    this->streamIndexFile = fopen(indexName, "wb");
+    if (this->streamIndexFile == NULL) {
+        streamFileClose(&this->streamDataFile);
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s error opening stream index file %s\n",
+            driverName, functionName, indexName);
+        return asynError;
+    }
+
+    for (i=0; i<STREAM_QUEUE_SIZE; i++) this->streamFreeQueue->send(&i, sizeof(i));
+    setIntegerParam(NDDxpStreamQueued, 0);
+    setIntegerParam(NDDxpStreamDropped, 0);
+    setDoubleParam(NDDxpStreamMBytes, 0.);
+
+    if (epicsThreadCreate("NDDxpStream",
+                epicsThreadPriorityMedium,
+                epicsThreadGetStackSize(epicsThreadStackMedium),
+                (EPICSTHREADFUNC)streamTaskC, this) == NULL) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s epicsThreadCreate failure for stream task\n",
+            driverName, functionName);
+        this->closeStreamFiles();
+        return asynError;
+    }
+    this->streamActive = 1;
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW, 
+        "%s::%s streaming mapping buffers to %s\n",
+        driverName, functionName, fileName);
+    return asynSuccess;
+}
+
+/** Stops queueing buffers, waits for the stream writer thread to write the ones already queued,
+  * and closes the files. Must be called with the lock held. */
+void NDDxp::closeStream()
+{
+    int stop = -1;
+
+    if (!this->streamActive) return;
+    this->streamActive = 0;
+    this->streamFullQueue->send(&stop, sizeof(stop));
+    /* The writer thread takes the lock to update the counters */
+    this->unlock();
+    this->streamDoneEvent->wait();
+    this->lock();
+    this->closeStreamFiles();
+}
+
+void NDDxp::closeStreamFiles()
+{
+    int i, status;
+    const char *functionName = "closeStreamFiles";
+
+    status = streamFileClose(&this->streamDataFile);
+    if (status != 0) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s error truncating the stream data file: %s\n",
+            driverName, functionName, strerror(status));
+    }
+    if (this->streamIndexFile) fclose(this->streamIndexFile);
+    this->streamIndexFile = NULL;
+    while (this->streamFreeQueue->tryReceive(&i, sizeof(i)) != -1);
+}
+
+/** Copies a mapping buffer into the stream queue. If the writer thread has fallen behind and the queue
+  * is full the buffer is dropped, so a slow disk never delays the readout of the hardware. */
+void NDDxp::queueStreamBuffer(int module, epicsUInt32 bufferNumber, epicsUInt32 firstPixel,
+                              epicsUInt16 *pData, int numWords, epicsTimeStamp *pTime)
+{
+    int i, dropped;
+    size_t nBytes = numWords * sizeof(epicsUInt16);
+    streamQueueEntry *pEntry;
+    const char *functionName = "queueStreamBuffer";
+
+    if (!this->streamActive) return;
+
+    if (this->streamFreeQueue->tryReceive(&i, sizeof(i)) == -1) {
+        getIntegerParam(NDDxpStreamDropped, &dropped);
+        setIntegerParam(NDDxpStreamDropped, dropped+1);
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s stream queue full, dropping buffer number %u from module %d\n",
+            driverName, functionName, bufferNumber, module);
+        return;
+    }
+    pEntry = &this->streamQueue[i];
+    memcpy(pEntry->pData, pData, nBytes);
+    /* Pad to a whole number of blocks */
+    memset((char *)pEntry->pData + nBytes, 0, 
+           (STREAM_BLOCK_SIZE - nBytes % STREAM_BLOCK_SIZE) % STREAM_BLOCK_SIZE);
+    pEntry->index.module       = module;
+    pEntry->index.bufferNumber = bufferNumber;
+    pEntry->index.firstPixel   = firstPixel;
+    pEntry->index.numWords     = numWords;
+    pEntry->index.offset       = 0;
+    pEntry->index.secPastEpoch = pTime->secPastEpoch;
+    pEntry->index.nsec         = pTime->nsec;
+    this->streamFullQueue->send(&i, sizeof(i));
+    setIntegerParam(NDDxpStreamQueued, this->streamFullQueue->pending());
+}
+
+/** Writes the queued mapping buffers to the stream file. This runs without the lock, which is only 
+  * taken to update the counters. */
+void NDDxp::streamTask()
+{
+    int i, status, dropped;
+    epicsUInt32 nBlocks;
+    double mBytes;
+    streamQueueEntry *pEntry;
+    const char *functionName = "streamTask";
+
+    while (1) {
+        this->streamFullQueue->receive(&i, sizeof(i));
+        if (i < 0) break;
+        pEntry = &this->streamQueue[i];
+        nBlocks = (pEntry->index.numWords * sizeof(epicsUInt16) + STREAM_BLOCK_SIZE - 1) / STREAM_BLOCK_SIZE;
+        pEntry->index.offset = this->streamDataFile.blocks;
+        status = streamFileWrite(&this->streamDataFile, pEntry->pData, nBlocks);
+        if (status == 0) 
+            status = (fwrite(&pEntry->index, sizeof(pEntry->index), 1, this->streamIndexFile) == 1) ? 0 : -1;
+        this->lock();
+        if (status) {
+            getIntegerParam(NDDxpStreamDropped, &dropped);
+            setIntegerParam(NDDxpStreamDropped, dropped+1);
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+                "%s::%s error writing buffer number %u from module %d\n",
+                driverName, functionName, pEntry->index.bufferNumber, pEntry->index.module);
         } else {
-            xiaGetParameter(channel, "BASEBINNING", &baseBinning);
-            xiaGetParameter(channel, "SLOWLEN", &slowLen);
-            xiaGetParameter(channel, "BASELEN", &baseLen);
-            xiaGetAcquisitionValues(channel, "calibration_energy", &calibrationEnergy);
-            xiaGetAcquisitionValues(channel, "adc_percent_rule", &ADCPercentRule);
-            eVPerBin = ((2 << (baseBinning - 1)) * (calibrationEnergy /
-                       (4 * slowLen * baseLen))) / (ADCPercentRule / 100.);
-            asynPrint(pasynUser, ASYN_TRACEIO_DRIVER,
-                "%s:%s: evPerBin=%f, baseBinning=%d, slowLen=%d, baseLen=%d, calibrationEnergy=%f, adc_percent_rule=%f\n",
-                driverName, functionName, eVPerBin, baseBinning, slowLen, baseLen, calibrationEnergy, ADCPercentRule);
-            keVPerBin = eVPerBin/1000.;
-        }
-        getDoubleParam(channel, NDDxpBaselineEnergy, &energyPerBin);
-        if (keVPerBin != energyPerBin) {
-            setDoubleParam(channel, NDDxpBaselineEnergy, keVPerBin);
-            offset = -this->baselineLength * keVPerBin/2.;
-            for (j=0; j<this->baselineLength; j++) this->baselineEnergyBuffer[j] = offset + j*keVPerBin;
-            doCallbacksFloat64Array(this->baselineEnergyBuffer, this->baselineLength, NDDxpBaselineEnergyArray, channel);
+            getDoubleParam(NDDxpStreamMBytes, &mBytes);
+            setDoubleParam(NDDxpStreamMBytes, mBytes + (double)nBlocks * STREAM_BLOCK_SIZE / MEGABYTE);
+        }
+        this->streamFreeQueue->send(&i, sizeof(i));
+        setIntegerParam(NDDxpStreamQueued, this->streamFullQueue->pending());
+        callParamCallbacks();
+        this->unlock();
+    }
+    this->streamDoneEvent->signal();
+}
+
+/** Starts all modules on buffer A and discards any buffers that were not published */
+void NDDxp::resetMappingBuffers()
+{
+    int i, module;
+    epicsTimeStamp now;
+
+    epicsTimeGetCurrent(&now);
+    for (module=0; module<this->nCards; module++) {
+        this->mappingBuffers[module].state = NDDxpBufferFilling;
+        this->mappingBuffers[module].buf = 0;
+        this->mappingBuffers[module].numBuffers = 0;
+        this->mappingBuffers[module].notFullTime = now;
+        this->mappingBuffers[module].overrun = 0;
+    }
+    for (i=0; i<MAX_MAPPING_SETS; i++) {
+        this->releaseMappingSet(&this->mappingSets[i]);
+    }
+}
+
+/** Discards the sets of mapping buffers that not every module has read, and lets the modules
+ * that were waiting on them, or on a buffer_switch, go back to filling. The sets
+ * are realigned by getMappingData once every module has read a buffer again. */
+void NDDxp::discardPendingMappingSets()
+{
+    int i, module;
+    mappingBufferSet *pSet;
+    moduleMappingBuffer *pMod;
+
+    for (i=0; i<MAX_MAPPING_SETS; i++) {
+        pSet = &this->mappingSets[i];
+        if (pSet->inUse && (pSet->numRead < this->nCards)) this->releaseMappingSet(pSet);
+    }
+    for (module=0; module<this->nCards; module++) {
+        pMod = &this->mappingBuffers[module];
+        pMod->state = NDDxpBufferFilling;
+    }
+}
+
+/* Exponentially weighted moving average with time constant tau of a new value dt seconds after the last one */
+static double movingAverage(double average, double value, double dt, double tau)
+{
+    if (tau <= 0.) return value;
+    return average + (1. - exp(-dt/tau)) * (value - average);
+}
+
+/** Clears the readout performance statistics. Called when a run starts and on DxpPerfReset. */
+void NDDxp::resetPerformance()
+{
+    int module, ch;
+
+    this->pollStatsValid = 0;
+    this->pollPeriodVar = 0.;
+    this->perfMBytes = 0.;
+    this->perfNumReads = 0;
+    this->perfOverruns = 0;
+    this->perfSwitchTimeouts = 0;
+    this->perfPixelMismatches = 0;
+    memset(this->readTimeHistogram, 0, sizeof(this->readTimeHistogram));
+    setDoubleParam(NDDxpReadRateAvg, 0.);
+    setDoubleParam(NDDxpThroughput, 0.);
+    setDoubleParam(NDDxpPollPeriod, 0.);
+    setDoubleParam(NDDxpPollPeriodMax, 0.);
+    setDoubleParam(NDDxpPollJitter, 0.);
+    setDoubleParam(NDDxpLockTime, 0.);
+    setDoubleParam(NDDxpLockTimeMax, 0.);
+    setIntegerParam(NDDxpOverruns, 0);
+    setIntegerParam(NDDxpSwitchTimeouts, 0);
+    setIntegerParam(NDDxpPixelMismatches, 0);
+    for (module=0; module<this->nCards; module++) {
+        ch = module * this->channelsPerCard;
+        setDoubleParam(ch, NDDxpReadTime, 0.);
+        setDoubleParam(ch, NDDxpReadTimeMax, 0.);
+        setDoubleParam(ch, NDDxpFullToReadTime, 0.);
+        setDoubleParam(ch, NDDxpReadLoad, 0.);
+        setIntegerParam(ch, NDDxpBufferOverrun, 0);
+    }
+    doCallbacksInt32Array(this->readTimeHistogram, NUM_READ_TIME_BINS, NDDxpReadTimeHistogram, 0);
+}
+
+/** Updates the statistics of the polling loop at the end of each pass.
+  * \param[in] pStart Time the pass started
+  * \param[in] lockTime Time the port lock has been held during the pass in seconds */
+void NDDxp::updatePollStatistics(epicsTimeStamp *pStart, double lockTime)
+{
+    double tau, period, average, deviation, maxValue;
+
+    getDoubleParam(NDDxpPerfAverageTime, &tau);
+    getDoubleParam(NDDxpLockTimeMax, &maxValue);
+    if (lockTime > maxValue) setDoubleParam(NDDxpLockTimeMax, lockTime);
+    if (!this->pollStatsValid) {
+        /* First pass since acquisition started, there is no period yet */
+        setDoubleParam(NDDxpLockTime, lockTime);
+        this->lastPollStart = *pStart;
+        this->perfMBytes = 0.;
+        this->pollStatsValid = 1;
+        return;
+    }
+    period = epicsTimeDiffInSeconds(pStart, &this->lastPollStart);
+    this->lastPollStart = *pStart;
+    getDoubleParam(NDDxpLockTime, &average);
+    setDoubleParam(NDDxpLockTime, movingAverage(average, lockTime, period, tau));
+    getDoubleParam(NDDxpPollPeriodMax, &maxValue);
+    if (period > maxValue) setDoubleParam(NDDxpPollPeriodMax, period);
+
+    /* The first period starts the averages */
+    if (this->pollStatsValid == 1) {
+        tau = 0.;
+        this->pollPeriodVar = 0.;
+        this->pollStatsValid = 2;
+    }
+    getDoubleParam(NDDxpPollPeriod, &average);
+    average = movingAverage(average, period, period, tau);
+    deviation = period - average;
+    this->pollPeriodVar = movingAverage(this->pollPeriodVar, deviation*deviation, period, tau);
+    setDoubleParam(NDDxpPollPeriod, average);
+    setDoubleParam(NDDxpPollJitter, sqrt(this->pollPeriodVar));
+    if (period > 0.) {
+        getDoubleParam(NDDxpThroughput, &average);
+        setDoubleParam(NDDxpThroughput, movingAverage(average, this->perfMBytes/period, period, tau));
+    }
+    this->perfMBytes = 0.;
+}
+
+/** Updates the readout statistics after a mapping buffer of a module has been read.
+  * \param[in] module Module that was read
+  * \param[in] readoutTime Time taken by xiaGetRunData in seconds
+  * \param[in] mBytes MBytes read
+  * \param[in] pTime Time the read finished */
+void NDDxp::updateReadStatistics(int module, double readoutTime, double mBytes, epicsTimeStamp *pTime)
+{
+    int ch = module * this->channelsPerCard;
+    int bin;
+    double tau, average, maxValue, fullToRead, fillTime, us;
+    moduleMappingBuffer *pMod = &this->mappingBuffers[module];
+
+    getDoubleParam(NDDxpPerfAverageTime, &tau);
+    setDoubleParam(ch, NDDxpReadTime, readoutTime);
+    getDoubleParam(ch, NDDxpReadTimeMax, &maxValue);
+    if (readoutTime > maxValue) setDoubleParam(ch, NDDxpReadTimeMax, readoutTime);
+
+    /* The buffer filled some time after the last poll that found it not full, 
+     * so this is an upper limit on the time from the buffer filling to the end of the read */
+    fullToRead = epicsTimeDiffInSeconds(pTime, &pMod->notFullTime);
+    setDoubleParam(ch, NDDxpFullToReadTime, fullToRead);
+    if (pMod->numBuffers > 0) {
+        fillTime = epicsTimeDiffInSeconds(pTime, &pMod->readTime);
+        if (fillTime > 0.) setDoubleParam(ch, NDDxpReadLoad, fullToRead / fillTime);
+    }
+    pMod->readTime = *pTime;
+
+    if (readoutTime > 0.) {
+        getDoubleParam(NDDxpReadRateAvg, &average);
+        if (this->perfNumReads == 0) tau = 0.;
+        setDoubleParam(NDDxpReadRateAvg, movingAverage(average, mBytes/readoutTime,
+                       epicsTimeDiffInSeconds(pTime, &this->lastReadTime), tau));
+    }
+    this->lastReadTime = *pTime;
+    this->perfNumReads++;
+    this->perfMBytes += mBytes;
+
+    for (bin=0, us=readoutTime*1.e6; (us >= 2.) && (bin < NUM_READ_TIME_BINS-1); us /= 2.) bin++;
+    this->readTimeHistogram[bin]++;
+    doCallbacksInt32Array(this->readTimeHistogram, NUM_READ_TIME_BINS, NDDxpReadTimeHistogram, 0);
+}
+
+/* Get trace data */
+asynStatus NDDxp::getTrace(asynUser* pasynUser, int addr,
+                           epicsInt32* data, size_t maxLen, size_t *actualLen)
+{
+    asynStatus status = asynSuccess;
+    int xiastatus, channel=addr;
+    int j;
+    int newTraceTime;
+    double info[2];
+    double traceTime;
+    int traceMode;
+    const char *functionName = "getTrace";
+
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: enter addr=%d\n",
+        driverName, functionName, addr);
+    if (addr == this->nChannels) channel = DXP_ALL;
+    if (channel == DXP_ALL) {  /* All channels */
+        status = this->getTraceAll(pasynUser, data, maxLen, actualLen);
+    } else {
+        getDoubleParam(channel, NDDxpTraceTime, &traceTime);
+        getIntegerParam(channel, NDDxpNewTraceTime, &newTraceTime);
+        getIntegerParam(channel, NDDxpTraceMode, &traceMode);
+        info[0] = 0.;
+        /* Convert from us to ns */
+        info[1] = traceTime * 1000.;
+
+        xiastatus = xiaDoSpecialRun(channel, (char *)NDDxpTraceCommands[traceMode], info);
+        status = this->xia_checkError(pasynUser, xiastatus, NDDxpTraceCommands[traceMode]);
+        // Don't return error, read it out or we get stuck permanently with module busy
+        // if (status == asynError) return asynError;
+
+        *actualLen = this->traceLength;
+        if (maxLen < *actualLen) *actualLen = maxLen;
+
+        xiastatus = xiaGetSpecialRunData(channel, "adc_trace", this->traceBuffer);
+        status = this->xia_checkError( pasynUser, xiastatus, "adc_trace" );
+        if (status == asynError) return status;
+
+        // Copy from traceBuffer (unsigned long) to data (epicsInt32)
+        for (j=0; j<(int)*actualLen; j++) data[j] = this->traceBuffer[j];
+        
+        if (newTraceTime) {
+            setIntegerParam(channel, NDDxpNewTraceTime, 0);  /* Clear flag */
+            for (j=0; j<this->traceLength; j++) this->traceTimeBuffer[j] = j*traceTime;
+            doCallbacksFloat64Array(this->traceTimeBuffer, this->traceLength, NDDxpTraceTimeArray, channel);
+        }
+    }
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: exit\n",
+        driverName, functionName);
+    return status;
+}
+
+/* Get the trace data for all channels.
+ * xiaDoSpecialRun waits for the trace to complete, so the channels are traced one
+ * after the other. The traces are returned in data as [channel][sample], and are
+ * also sent to the per-channel TraceData callbacks, and as a single NDArray on the
+ * ALL address if TraceArrayCallbacks is set. */
+asynStatus NDDxp::getTraceAll(asynUser* pasynUser,
+                              epicsInt32* data, size_t maxLen, size_t *actualLen)
+{
+    asynStatus status = asynSuccess;
+    int xiastatus;
+    int channel, j;
+    int newTraceTime;
+    double info[2];
+    double traceTime;
+    int traceMode;
+    int traceArrays;
+    epicsInt32 *pTrace;
+    epicsTimeStamp now;
+    size_t nCopy;
+    const char *functionName = "getTraceAll";
+
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: enter\n",
+        driverName, functionName);
+
+    for (channel=0; channel<this->nChannels; channel++) {
+        getDoubleParam(channel, NDDxpTraceTime, &traceTime);
+        getIntegerParam(channel, NDDxpTraceMode, &traceMode);
+        info[0] = 0.;
+        /* Convert from us to ns */
+        info[1] = traceTime * 1000.;
+        xiastatus = xiaDoSpecialRun(channel, (char *)NDDxpTraceCommands[traceMode], info);
+        this->xia_checkError(pasynUser, xiastatus, NDDxpTraceCommands[traceMode]);
+
+        /* Don't stop on errors, each channel must be read out
+         * or we get stuck permanently with the module busy */
+        pTrace = this->traceAllBuffer + channel*this->traceLength;
+        xiastatus = xiaGetSpecialRunData(channel, "adc_trace", this->traceBuffer);
+        if (this->xia_checkError(pasynUser, xiastatus, "adc_trace") == asynError) {
+            status = asynError;
+            continue;
+        }
+        // Copy from traceBuffer (unsigned long) to the channel trace (epicsInt32)
+        for (j=0; j<this->traceLength; j++) pTrace[j] = this->traceBuffer[j];
+    }
+    epicsTimeGetCurrent(&now);
+
+    for (channel=0; channel<this->nChannels; channel++) {
+        pTrace = this->traceAllBuffer + channel*this->traceLength;
+        doCallbacksInt32Array(pTrace, this->traceLength, NDDxpTraceData, channel);
+        getIntegerParam(channel, NDDxpNewTraceTime, &newTraceTime);
+        if (newTraceTime) {
+            getDoubleParam(channel, NDDxpTraceTime, &traceTime);
+            setIntegerParam(channel, NDDxpNewTraceTime, 0);  /* Clear flag */
+            for (j=0; j<this->traceLength; j++) this->traceTimeBuffer[j] = j*traceTime;
+            doCallbacksFloat64Array(this->traceTimeBuffer, this->traceLength, NDDxpTraceTimeArray, channel);
+        }
+    }
+
+    if (data) {
+        nCopy = this->nChannels * this->traceLength;
+        if (maxLen < nCopy) nCopy = maxLen;
+        memcpy(data, this->traceAllBuffer, nCopy * sizeof(epicsInt32));
+        *actualLen = nCopy;
+    }
+
+    getIntegerParam(this->nChannels, NDDxpTraceArrayCallbacks, &traceArrays);
+    if (traceArrays)
+        this->doChannelArrayCallbacks(this->traceAllBuffer, this->traceLength, "Trace", &now);
+
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: exit\n",
+        driverName, functionName);
+    return status;
+}
+
+/* Get baseline histogram data */
+asynStatus NDDxp::getBaselineHistogram(asynUser* pasynUser, int addr,
+                                       epicsInt32* data, size_t maxLen, size_t *actualLen)
+{
+    asynStatus status = asynSuccess;
+    int j;
+    int xiastatus, channel=addr;
+    const char *functionName = "getBaselineHistogram";
+
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: enter addr=%d\n",
+        driverName, functionName, addr);
+    if (addr == this->nChannels) channel = DXP_ALL;
+    if (channel == DXP_ALL) {  /* All channels */
+        status = this->getBaselineHistogramAll(pasynUser, data, maxLen, actualLen);
+    } else {
+        *actualLen = this->baselineLength;
+        if (maxLen < *actualLen) *actualLen = maxLen;
+
+        xiastatus = xiaGetRunData(channel, "baseline", this->baselineBuffer);
+        status = this->xia_checkError(pasynUser, xiastatus, "baseline" );
+        if (status == asynError) return status;
+
+        // Copy from baselineBuffer (unsigned long) to data (epicsInt32)
+        for (j=0; j<(int)*actualLen; j++) data[j] = this->baselineBuffer[j];
+        
+        this->getBaselineEnergy(pasynUser, channel);
+    }
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: exit\n",
+        driverName, functionName);
+    return status;
+}
+
+/* Get the baseline histograms for all channels.
+ * On the xMAP the histograms for all channels of a module are read with a single
+ * module_baseline request; other models are read channel by channel.
+ * The channel stride of a module_baseline read is the longest BASELEN in the module,
+ * which Handel reports as module_baseline_length, so it is queried for each module
+ * rather than assumed to be the baseline_length read at startup.
+ * The histograms are returned in data as [channel][bin], and are also sent to the
+ * per-channel BaselineHistogram callbacks, and as a single NDArray on the ALL address
+ * if BaselineArrayCallbacks is set. */
+asynStatus NDDxp::getBaselineHistogramAll(asynUser* pasynUser,
+                                          epicsInt32* data, size_t maxLen, size_t *actualLen)
+{
+    asynStatus status = asynSuccess;
+    int xiastatus;
+    int card, slot, channel, j;
+    int nBins;
+    int baselineArrays;
+    unsigned long stride;
+    unsigned long *pRaw;
+    epicsInt32 *pBaseline;
+    epicsTimeStamp now;
+    size_t nCopy;
+    const char *functionName = "getBaselineHistogramAll";
+
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: enter\n",
+        driverName, functionName);
+
+    if (this->deviceType == NDDxpModelXMAP) {
+        for (card=0; card<this->nCards; card++) {
+            channel = card*this->channelsPerCard;
+            xiastatus = xiaGetRunData(channel, "module_baseline_length", &stride);
+            if (this->xia_checkError(pasynUser, xiastatus, "module_baseline_length") == asynError) {
+                status = asynError;
+                continue;
+            }
+            if (stride > this->moduleBaselineLength) {
+                free(this->moduleBaselineBuffer);
+                this->moduleBaselineBuffer = (unsigned long *)calloc(this->channelsPerCard * stride, sizeof(unsigned long));
+                this->moduleBaselineLength = this->moduleBaselineBuffer ? stride : 0;
+                if (!this->moduleBaselineBuffer) {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                        "%s:%s: error allocating %lu baseline words for module %d\n",
+                        driverName, functionName, this->channelsPerCard * stride, card);
+                    status = asynError;
+                    break;
+                }
+            }
+            xiastatus = xiaGetRunData(channel, "module_baseline", this->moduleBaselineBuffer);
+            if (this->xia_checkError(pasynUser, xiastatus, "module_baseline") == asynError) {
+                status = asynError;
+                continue;
+            }
+            /* Copy at most baselineLength bins per channel, and zero any bins the module
+             * did not return */
+            nBins = (int)stride;
+            if (nBins > this->baselineLength) nBins = this->baselineLength;
+            for (slot=0; slot<this->channelsPerCard; slot++, channel++) {
+                if (channel >= this->nChannels) break;
+                pRaw = this->moduleBaselineBuffer + slot*stride;
+                pBaseline = this->baselineAllBuffer + channel*this->baselineLength;
+                for (j=0; j<nBins; j++) pBaseline[j] = pRaw[j];
+                for (; j<this->baselineLength; j++) pBaseline[j] = 0;
+            }
+        }
+    } else {
+        for (channel=0; channel<this->nChannels; channel++) {
+            xiastatus = xiaGetRunData(channel, "baseline", this->baselineBuffer);
+            if (this->xia_checkError(pasynUser, xiastatus, "baseline") == asynError) {
+                status = asynError;
+                continue;
+            }
+            pBaseline = this->baselineAllBuffer + channel*this->baselineLength;
+            for (j=0; j<this->baselineLength; j++) pBaseline[j] = this->baselineBuffer[j];
         }
     }
+    epicsTimeGetCurrent(&now);
+
+    for (channel=0; channel<this->nChannels; channel++) {
+        pBaseline = this->baselineAllBuffer + channel*this->baselineLength;
+        doCallbacksInt32Array(pBaseline, this->baselineLength, NDDxpBaselineHistogram, channel);
+        this->getBaselineEnergy(pasynUser, channel);
+    }
+
+    if (data) {
+        nCopy = this->nChannels * this->baselineLength;
+        if (maxLen < nCopy) nCopy = maxLen;
+        memcpy(data, this->baselineAllBuffer, nCopy * sizeof(epicsInt32));
+        *actualLen = nCopy;
+    }
+
+    getIntegerParam(this->nChannels, NDDxpBaselineArrayCallbacks, &baselineArrays);
+    if (baselineArrays)
+        this->doChannelArrayCallbacks(this->baselineAllBuffer, this->baselineLength, "BaselineHistogram", &now);
+
     asynPrint(pasynUser, ASYN_TRACE_FLOW, 
         "%s:%s: exit\n",
         driverName, functionName);
     return status;
 }
 
+/* Compute the baseline histogram energy per bin and energy array for a channel.
+ * The value is cached in NDDxpBaselineEnergy; getDxpParams() clears it whenever
+ * the parameters it depends on may have changed, so normally this does no I/O. */
+asynStatus NDDxp::getBaselineEnergy(asynUser* pasynUser, int channel)
+{
+    int j;
+    double dynamicRange, keVPerBin, eVPerBin, energyPerBin, offset;
+    unsigned short baseBinning, slowLen, baseLen;
+    double calibrationEnergy, ADCPercentRule;
+    const char *functionName = "getBaselineEnergy";
+
+    getDoubleParam(channel, NDDxpBaselineEnergy, &energyPerBin);
+    if (energyPerBin != 0.) return asynSuccess;
+
+    /* Compute the energy increment per bin */
+    if ((this->deviceType == NDDxpModelXMAP) ||
+        (this->deviceType == NDDxpModelMercury)) {
+        xiaGetAcquisitionValues(channel, "dynamic_range", &dynamicRange);
+        keVPerBin = dynamicRange/1024/1000.;
+    } else {
+        xiaGetParameter(channel, "BASEBINNING", &baseBinning);
+        xiaGetParameter(channel, "SLOWLEN", &slowLen);
+        xiaGetParameter(channel, "BASELEN", &baseLen);
+        xiaGetAcquisitionValues(channel, "calibration_energy", &calibrationEnergy);
+        xiaGetAcquisitionValues(channel, "adc_percent_rule", &ADCPercentRule);
+        eVPerBin = ((2 << (baseBinning - 1)) * (calibrationEnergy /
+                   (4 * slowLen * baseLen))) / (ADCPercentRule / 100.);
+        asynPrint(pasynUser, ASYN_TRACEIO_DRIVER,
+            "%s:%s: evPerBin=%f, baseBinning=%d, slowLen=%d, baseLen=%d, calibrationEnergy=%f, adc_percent_rule=%f\n",
+            driverName, functionName, eVPerBin, baseBinning, slowLen, baseLen, calibrationEnergy, ADCPercentRule);
+        keVPerBin = eVPerBin/1000.;
+    }
+    setDoubleParam(channel, NDDxpBaselineEnergy, keVPerBin);
+    offset = -this->baselineLength * keVPerBin/2.;
+    for (j=0; j<this->baselineLength; j++) this->baselineEnergyBuffer[j] = offset + j*keVPerBin;
+    doCallbacksFloat64Array(this->baselineEnergyBuffer, this->baselineLength, NDDxpBaselineEnergyArray, channel);
+    return asynSuccess;
+}
+
+/* Send the spectra of all channels as one [channel][bin] NDArray on the ALL address. 
+ * This is done once per acquisition in MCA mode, so that file plugins can record each point of a scan
+ * without reading each channel's mca record. */
+void NDDxp::doMcaArrayCallbacks(epicsTimeStamp *pNow)
+{
+    int arrayCallbacks, nBins;
+    int channel, bin;
+    epicsInt32 *pOut;
+    unsigned long *pIn;
+
+    getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+    if (!arrayCallbacks) return;
+
+    getIntegerParam(mcaNumChannels, &nBins);
+    if (nBins > MAX_MCA_BINS) nBins = MAX_MCA_BINS;
+    pOut = this->mcaAllBuffer;
+    for (channel=0; channel<this->nChannels; channel++) {
+        pIn = this->pMcaRaw[channel];
+        for (bin=0; bin<nBins; bin++) *pOut++ = (epicsInt32)pIn[bin];
+    }
+    this->doChannelArrayCallbacks(this->mcaAllBuffer, nBins, "MCA", pNow, 1);
+}
+
+/* Add the counts of one channel, scaled by scale, to the sum spectrum */
+static void addSumSpectrum(epicsFloat64 *pSum, const unsigned long *pIn, double scale, int nBins)
+{
+    int bin;
+
+    for (bin=0; bin<nBins; bin++) pSum[bin] += scale * pIn[bin];
+}
+
+/* Add the counts of one channel, scaled by scale, to the sum spectrum with bin N of the channel
+ * placed at offset + gain*N. The counts in each bin are split between the 2 nearest sum bins
+ * in proportion to the overlap, so the total counts are preserved except at the ends. */
+static void addSumSpectrumRebinned(epicsFloat64 *pSum, const unsigned long *pIn, double scale,
+                                   double gain, double offset, int nBins)
+{
+    int bin, lo;
+    double x, frac, counts;
+
+    for (bin=0; bin<nBins; bin++) {
+        if (pIn[bin] == 0) continue;
+        x = offset + gain*bin;
+        lo = (int)floor(x);
+        if ((lo < -1) || (lo >= nBins)) continue;
+        frac = x - lo;
+        counts = scale * pIn[bin];
+        if (lo >= 0) pSum[lo] += counts * (1. - frac);
+        if (lo+1 < nBins) pSum[lo+1] += counts * frac;
+    }
+}
+
+/* Compute the sum spectrum of the channels with SumInclude set from the last spectra read into pMcaRaw.
+ * If SumDeadTimeCorrect is set each channel is scaled by its InputCountRate/OutputCountRate, and
+ * channels with SumGain!=1 or SumOffset!=0 are rebinned onto the sum energy scale.
+ * The sum is sent to the SumSpectrum waveform. Unless pNow is NULL it is also sent as a 1-D NDArray
+ * on the ALL address if SumArrayCallbacks is set, so it is not mixed with the MCA arrays by default. */
+void NDDxp::computeSumSpectrum(epicsTimeStamp *pNow)
+{
+    int nBins, channel, include, correct;
+    int arrayCallbacks, sumArrays, arrayCounter;
+    double gain, offset, icr, ocr, scale;
+    NDArray *pArray;
+    size_t dims[1];
+    const char *functionName = "computeSumSpectrum";
+
+    getIntegerParam(mcaNumChannels, &nBins);
+    if (nBins > MAX_MCA_BINS) nBins = MAX_MCA_BINS;
+    getIntegerParam(this->nChannels, NDDxpSumDeadTimeCorrect, &correct);
+    memset(this->sumSpectrumBuffer, 0, nBins * sizeof(epicsFloat64));
+    for (channel=0; channel<this->nChannels; channel++) {
+        getIntegerParam(channel, NDDxpSumInclude, &include);
+        if (!include) continue;
+        scale = 1.0;
+        if (correct) {
+            getDoubleParam(channel, NDDxpInputCountRate, &icr);
+            getDoubleParam(channel, NDDxpOutputCountRate, &ocr);
+            if ((ocr > 0.) && (icr > ocr)) scale = icr / ocr;
+        }
+        getDoubleParam(channel, NDDxpSumGain, &gain);
+        getDoubleParam(channel, NDDxpSumOffset, &offset);
+        if ((gain == 1.0) && (offset == 0.0))
+            addSumSpectrum(this->sumSpectrumBuffer, this->pMcaRaw[channel], scale, nBins);
+        else
+            addSumSpectrumRebinned(this->sumSpectrumBuffer, this->pMcaRaw[channel], scale, gain, offset, nBins);
+    }
+    doCallbacksFloat64Array(this->sumSpectrumBuffer, nBins, NDDxpSumSpectrum, this->nChannels);
+
+    if (!pNow) return;
+    getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+    getIntegerParam(this->nChannels, NDDxpSumArrayCallbacks, &sumArrays);
+    if (!arrayCallbacks || !sumArrays) return;
+    dims[0] = nBins;
+    pArray = this->pNDArrayPool->alloc(1, dims, NDFloat64, 0, NULL);
+    if (!pArray) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s:%s: error allocating NDArray\n",
+            driverName, functionName);
+        return;
+    }
+    memcpy(pArray->pData, this->sumSpectrumBuffer, nBins * sizeof(epicsFloat64));
+    getIntegerParam(this->nChannels, NDArrayCounter, &arrayCounter);
+    arrayCounter++;
+    setIntegerParam(this->nChannels, NDArrayCounter, arrayCounter);
+    pArray->timeStamp = pNow->secPastEpoch + pNow->nsec / 1.e9;
+    pArray->uniqueId = arrayCounter;
+    pArray->pAttributeList->add("DxpArrayType", "Diagnostic array type", NDAttrString, (void *)"SumSpectrum");
+    doCallbacksGenericPointer(pArray, NDArrayData, this->nChannels);
+    pArray->release();
+}
+
+/* Prefix sum of a spectrum for the ROI engine, pPrefix[N] is the sum of bins 0 to N-1 */
+static void roiPrefixSum(const unsigned long *pIn, int nBins, epicsFloat64 *pPrefix)
+{
+    int bin;
+    epicsFloat64 sum=0.;
+
+    pPrefix[0] = 0.;
+    for (bin=0; bin<nBins; bin++) {
+        sum += pIn[bin];
+        pPrefix[bin+1] = sum;
+    }
+}
+
+static void roiPrefixSum(const epicsUInt16 *pIn, int nBins, epicsFloat64 *pPrefix)
+{
+    int bin;
+    epicsFloat64 sum=0.;
+
+    pPrefix[0] = 0.;
+    for (bin=0; bin<nBins; bin++) {
+        sum += pIn[bin];
+        pPrefix[bin+1] = sum;
+    }
+}
+
+/* Counts in each ROI of a channel from the prefix sum of its spectrum. 
+ * The limits are inclusive bin numbers and are clipped to the spectrum. */
+static void roiCounts(const epicsFloat64 *pPrefix, int nBins, int numROIs, const int *pLow, const int *pHigh,
+                      epicsFloat64 *pCounts)
+{
+    int roi, low, high;
+
+    for (roi=0; roi<numROIs; roi++) {
+        low  = (pLow[roi] < 0) ? 0 : pLow[roi];
+        high = (pHigh[roi] >= nBins) ? nBins-1 : pHigh[roi];
+        pCounts[roi] = (high >= low) ? pPrefix[high+1] - pPrefix[low] : 0.;
+    }
+}
+
+/* Keep the copy of the ROI definitions used by the ROI engine in sync with the parameters.
+ * Writing the ALL address sets the parameter on every channel. */
+void NDDxp::setROIs(int addr, int function, int value)
+{
+    int channel, first=addr, last=addr;
+    int roi;
+
+    if (function == NDDxpNumROIs) {
+        if (value < 0) value = 0;
+        if (value > DXP_MAX_ROIS) value = DXP_MAX_ROIS;
+        setIntegerParam(addr, function, value);
+    }
+    if (addr == this->nChannels) {
+        first = 0;
+        last = this->nChannels-1;
+    }
+    for (channel=first; channel<=last; channel++) {
+        if (addr == this->nChannels) {
+            setIntegerParam(channel, function, value);
+            callParamCallbacks(channel, channel);
+        }
+        if (function == NDDxpNumROIs) {
+            this->numROIs[channel] = value;
+            continue;
+        }
+        for (roi=0; roi<DXP_MAX_ROIS; roi++) {
+            if (function == NDDxpROILow[roi]) this->roiLow[channel*DXP_MAX_ROIS + roi] = value;
+            if (function == NDDxpROIHigh[roi]) this->roiHigh[channel*DXP_MAX_ROIS + roi] = value;
+        }
+    }
+}
+
+/* Compute the software ROIs of each channel from the last spectra read into pMcaRaw.
+ * Building the prefix sum of a spectrum costs one pass over it, after which each ROI is
+ * a single subtraction, so hundreds of ROIs per channel cost little more than one.
+ * The counts on the ALL address are the sums over the channels with SumInclude set.
+ * The parameters are sent by the polling task at MaxUpdateRate.
+ * Unless pNow is NULL the ROIs are also sent as a [ROI][channel] NDArray on the ALL address if
+ * ROIArrayCallbacks is set, the last row being the sum. */
+void NDDxp::computeROIs(epicsTimeStamp *pNow)
+{
+    int nBins, channel, roi, include, maxROIs=0;
+    int arrayCallbacks, roiArrays, arrayCounter;
+    epicsFloat64 *pCounts;
+    epicsFloat64 *pSum = this->roiAllBuffer + this->nChannels*DXP_MAX_ROIS;
+    NDArray *pArray;
+    size_t dims[2];
+    const char *functionName = "computeROIs";
+
+    getIntegerParam(mcaNumChannels, &nBins);
+    if (nBins > MAX_MCA_BINS) nBins = MAX_MCA_BINS;
+    memset(this->roiAllBuffer, 0, (this->nChannels+1) * DXP_MAX_ROIS * sizeof(epicsFloat64));
+    for (channel=0; channel<this->nChannels; channel++) {
+        if (this->numROIs[channel] == 0) continue;
+        if (this->numROIs[channel] > maxROIs) maxROIs = this->numROIs[channel];
+        pCounts = this->roiAllBuffer + channel*DXP_MAX_ROIS;
+        roiPrefixSum(this->pMcaRaw[channel], nBins, this->roiPrefixBuffer);
+        roiCounts(this->roiPrefixBuffer, nBins, this->numROIs[channel], this->roiLow + channel*DXP_MAX_ROIS,
+                  this->roiHigh + channel*DXP_MAX_ROIS, pCounts);
+        getIntegerParam(channel, NDDxpSumInclude, &include);
+        for (roi=0; roi<this->numROIs[channel]; roi++) {
+            setDoubleParam(channel, NDDxpROICounts[roi], pCounts[roi]);
+            if (include) pSum[roi] += pCounts[roi];
+        }
+    }
+    if (maxROIs == 0) return;
+    for (roi=0; roi<maxROIs; roi++) setDoubleParam(this->nChannels, NDDxpROICounts[roi], pSum[roi]);
+
+    if (!pNow) return;
+    getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+    getIntegerParam(this->nChannels, NDDxpROIArrayCallbacks, &roiArrays);
+    if (!arrayCallbacks || !roiArrays) return;
+    dims[0] = maxROIs;
+    dims[1] = this->nChannels + 1;
+    pArray = this->pNDArrayPool->alloc(2, dims, NDFloat64, 0, NULL);
+    if (!pArray) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s:%s: error allocating NDArray\n",
+            driverName, functionName);
+        return;
+    }
+    for (channel=0; channel<=this->nChannels; channel++) {
+        memcpy((epicsFloat64 *)pArray->pData + channel*maxROIs, this->roiAllBuffer + channel*DXP_MAX_ROIS,
+               maxROIs * sizeof(epicsFloat64));
+    }
+    getIntegerParam(this->nChannels, NDArrayCounter, &arrayCounter);
+    arrayCounter++;
+    setIntegerParam(this->nChannels, NDArrayCounter, arrayCounter);
+    pArray->timeStamp = pNow->secPastEpoch + pNow->nsec / 1.e9;
+    pArray->uniqueId = arrayCounter;
+    pArray->pAttributeList->add("DxpArrayType", "Diagnostic array type", NDAttrString, (void *)"ROI");
+    doCallbacksGenericPointer(pArray, NDArrayData, this->nChannels);
+    pArray->release();
+}
+
+/* Compute the software ROIs of every pixel in the MCA mapping buffer of a module in pMapRaw.
+ * The counts go into the [ROI][channel][pixel] array of the buffer set, which is allocated by the
+ * first module read for the set. The sum row is filled in by doMappingROICallbacks. */
+void NDDxp::computeMappingROIs(int module, mappingBufferSet *pSet, int arraySize)
+{
+    int channel, i, k, numPixels, pixel, pixelOffset, dataOffset, blockSize, nChans;
+    int maxROIs=0, numROIs, nRows=this->nChannels+1;
+    size_t dims[3];
+    epicsFloat64 *pOut;
+    const char *functionName = "computeMappingROIs";
+
+    numPixels = pMapRaw[8];
+    if (pSet->numRead == 0) {
+        for (channel=0; channel<this->nChannels; channel++) {
+            if (this->numROIs[channel] > maxROIs) maxROIs = this->numROIs[channel];
+        }
+        if ((maxROIs == 0) || (numPixels == 0)) return;
+        dims[0] = maxROIs;
+        dims[1] = nRows;
+        dims[2] = numPixels;
+        pSet->pRoiArray = this->pNDArrayPool->alloc(3, dims, NDFloat64, 0, NULL);
+        if (!pSet->pRoiArray) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: error allocating NDArray\n",
+                driverName, functionName);
+            return;
+        }
+        memset(pSet->pRoiArray->pData, 0, maxROIs * nRows * numPixels * sizeof(epicsFloat64));
+    }
+    if (!pSet->pRoiArray) return;
+    maxROIs = (int)pSet->pRoiArray->dims[0].size;
+    if (numPixels > (int)pSet->pRoiArray->dims[2].size) numPixels = (int)pSet->pRoiArray->dims[2].size;
+
+    channel = module * this->channelsPerCard;
+    pixelOffset = 256;
+    for (pixel=0; pixel<numPixels; pixel++) {
+        blockSize = pMapRaw[pixelOffset + 6] | (pMapRaw[pixelOffset + 7] << 16);
+        if ((blockSize <= 0) || (pixelOffset + blockSize > arraySize)) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: module %d pixel %d has bad block size %d\n",
+                driverName, functionName, module, pixel, blockSize);
+            break;
+        }
+        dataOffset = pixelOffset + 256;
+        for (i=0; i<this->channelsPerCard; i++) {
+            k = channel + i;
+            nChans = pMapRaw[pixelOffset + 8 + i];
+            if (nChans > MAX_MCA_BINS) nChans = MAX_MCA_BINS;
+            numROIs = (k < this->nChannels) ? this->numROIs[k] : 0;
+            if (numROIs > maxROIs) numROIs = maxROIs;
+            if (numROIs > 0) {
+                pOut = (epicsFloat64 *)pSet->pRoiArray->pData + (pixel*nRows + k)*maxROIs;
+                roiPrefixSum(&pMapRaw[dataOffset], nChans, this->roiPrefixBuffer);
+                roiCounts(this->roiPrefixBuffer, nChans, numROIs, this->roiLow + k*DXP_MAX_ROIS,
+                          this->roiHigh + k*DXP_MAX_ROIS, pOut);
+            }
+            dataOffset += nChans;
+        }
+        pixelOffset += blockSize;
+    }
+}
+
+/* Fill in the sum over the channels with SumInclude set for each pixel of a complete buffer set,
+ * set the ROI parameters to the first pixel and send the ROI array on the ALL address if ROIArrayCallbacks is set */
+void NDDxp::doMappingROICallbacks(mappingBufferSet *pSet)
+{
+    NDArray *pArray = pSet->pRoiArray;
+    int maxROIs = (int)pArray->dims[0].size;
+    int nRows = this->nChannels + 1;
+    int numPixels = (int)pArray->dims[2].size;
+    int channel, roi, pixel, include, arrayCallbacks, roiArrays;
+    epicsFloat64 *pPixel, *pSum;
+
+    for (pixel=0; pixel<numPixels; pixel++) {
+        pPixel = (epicsFloat64 *)pArray->pData + pixel*nRows*maxROIs;
+        pSum = pPixel + this->nChannels*maxROIs;
+        for (channel=0; channel<this->nChannels; channel++) {
+            getIntegerParam(channel, NDDxpSumInclude, &include);
+            if (!include) continue;
+            for (roi=0; roi<maxROIs; roi++) pSum[roi] += pPixel[channel*maxROIs + roi];
+        }
+    }
+    pPixel = (epicsFloat64 *)pArray->pData;
+    for (channel=0; channel<=this->nChannels; channel++) {
+        for (roi=0; roi<maxROIs; roi++) setDoubleParam(channel, NDDxpROICounts[roi], pPixel[channel*maxROIs + roi]);
+    }
+
+    getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+    getIntegerParam(this->nChannels, NDDxpROIArrayCallbacks, &roiArrays);
+    if (!arrayCallbacks || !roiArrays) return;
+    pArray->timeStamp = pSet->timeStamp.secPastEpoch + pSet->timeStamp.nsec / 1.e9;
+    pArray->pAttributeList->add("DxpArrayType", "Diagnostic array type", NDAttrString, (void *)"ROI");
+    pArray->pAttributeList->add("FirstPixel", "First pixel in the array", NDAttrUInt32, &pSet->firstPixel);
+    doCallbacksGenericPointer(pArray, NDArrayData, this->nChannels);
+}
+
+/* Send a [channel][element] diagnostic array for all channels as an NDArray on the ALL address.
+ * The DxpArrayType attribute tells plugins which kind of array it is.
+ * If addStatistics is set the run statistics of each channel are added as attributes. */
+void NDDxp::doChannelArrayCallbacks(epicsInt32 *pData, int length, const char *arrayType, epicsTimeStamp *pNow,
+                                    int addStatistics)
+{
+    int arrayCallbacks, arrayCounter;
+    int channel, ivalue;
+    double dvalue;
+    char name[40], description[40];
+    NDArray *pArray;
+    size_t dims[2];
+    const char *functionName = "doChannelArrayCallbacks";
+
+    getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+    if (!arrayCallbacks) return;
+
+    dims[0] = length;
+    dims[1] = this->nChannels;
+    pArray = this->pNDArrayPool->alloc(2, dims, NDInt32, 0, NULL);
+    if (!pArray) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s:%s: error allocating NDArray for %s\n",
+            driverName, functionName, arrayType);
+        return;
+    }
+    memcpy(pArray->pData, pData, this->nChannels * length * sizeof(epicsInt32));
+    getIntegerParam(this->nChannels, NDArrayCounter, &arrayCounter);
+    arrayCounter++;
+    setIntegerParam(this->nChannels, NDArrayCounter, arrayCounter);
+    pArray->timeStamp = pNow->secPastEpoch + pNow->nsec / 1.e9;
+    pArray->uniqueId = arrayCounter;
+    pArray->pAttributeList->add("DxpArrayType", "Diagnostic array type", NDAttrString, (void *)arrayType);
+    for (channel=0; addStatistics && (channel<this->nChannels); channel++) {
+        getDoubleParam(channel, mcaElapsedRealTime, &dvalue);
+        sprintf(name, "RealTime%d", channel);
+        sprintf(description, "Real time channel %d", channel);
+        pArray->pAttributeList->add(name, description, NDAttrFloat64, &dvalue);
+        getDoubleParam(channel, mcaElapsedLiveTime, &dvalue);
+        sprintf(name, "LiveTime%d", channel);
+        sprintf(description, "Energy live time channel %d", channel);
+        pArray->pAttributeList->add(name, description, NDAttrFloat64, &dvalue);
+        getDoubleParam(channel, NDDxpTriggerLiveTime, &dvalue);
+        sprintf(name, "TriggerLiveTime%d", channel);
+        sprintf(description, "Trigger live time channel %d", channel);
+        pArray->pAttributeList->add(name, description, NDAttrFloat64, &dvalue);
+        getIntegerParam(channel, NDDxpTriggers, &ivalue);
+        sprintf(name, "Triggers%d", channel);
+        sprintf(description, "Triggers channel %d", channel);
+        pArray->pAttributeList->add(name, description, NDAttrInt32, &ivalue);
+        getIntegerParam(channel, NDDxpEvents, &ivalue);
+        sprintf(name, "Events%d", channel);
+        sprintf(description, "Events channel %d", channel);
+        pArray->pAttributeList->add(name, description, NDAttrInt32, &ivalue);
+        getDoubleParam(channel, NDDxpInputCountRate, &dvalue);
+        sprintf(name, "InputCountRate%d", channel);
+        sprintf(description, "Input count rate channel %d", channel);
+        pArray->pAttributeList->add(name, description, NDAttrFloat64, &dvalue);
+        getDoubleParam(channel, NDDxpOutputCountRate, &dvalue);
+        sprintf(name, "OutputCountRate%d", channel);
+        sprintf(description, "Output count rate channel %d", channel);
+        pArray->pAttributeList->add(name, description, NDAttrFloat64, &dvalue);
+    }
+    doCallbacksGenericPointer(pArray, NDArrayData, this->nChannels);
+    pArray->release();
+}
 
 
 asynStatus NDDxp::startAcquiring(asynUser *pasynUser)
@@ -2659,7 +4502,6 @@ asynStatus NDDxp::startAcquiring(asynUser *pasynUser)
     int xiastatus;
     int channel, addr, i;
     int acquiring, erased, resume=1;
-    int firstCh;
     const char *functionName = "startAcquire";
 
     channel = this->getChannel(pasynUser, &addr);
@@ -2674,7 +4516,8 @@ asynStatus NDDxp::startAcquiring(asynUser *pasynUser)
     if (acquiring) return status;
 
     /* make sure we use buffer A to start with */
-    for (firstCh=0; firstCh<this->nChannels; firstCh+=this->channelsPerCard) this->currentBuf[firstCh] = 0;
+    this->resetMappingBuffers();
+    this->resetPerformance();
 
     // do xiaStart command
     CALLHANDEL( xiaStartRun(channel, resume), "xiaStartRun()" )
@@ -2710,7 +4553,8 @@ void NDDxp::acquisitionTask()
     int i;
     int mode;
     int acquiring = 0;
-    epicsFloat64 pollTime, sleeptime, dtmp;
+    int mcaAcq, acquiringChanged;
+    epicsFloat64 pollTime, sleeptime, dtmp, readoutPeriod;
     epicsTimeStamp now, start;
     const char* functionName = "acquisitionTask";
 
@@ -2740,6 +4584,9 @@ void NDDxp::acquisitionTask()
             asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
                 "%s::%s [%s]: started! (mode=%d)\n", 
                 driverName, functionName, this->portName, mode);
+            /* The first snapshot of a run is taken on the first pass below */
+            this->snapshotValid = 0;
+            this->pollStatsValid = 0;
         }
         epicsTimeGetCurrent(&start);
 
@@ -2763,6 +4610,10 @@ void NDDxp::acquisitionTask()
                     driverName, functionName);
                 this->getMcaData(this->pasynUserSelf, DXP_ALL);
                 this->getSCAData(this->pasynUserSelf, DXP_ALL);
+                epicsTimeGetCurrent(&now);
+                this->doMcaArrayCallbacks(&now);
+                this->computeSumSpectrum(&now);
+                this->computeROIs(&now);
             }
             else {
                 /* In mapping modes need to make an extra call to pollMappingMode because there could be
@@ -2773,23 +4624,54 @@ void NDDxp::acquisitionTask()
                  this->pollMappingMode();
             }
         } 
+        else if (mode == NDDxpModeMCA)
+        {
+            if (!this->snapshotReadout()) {
+                /* Read the statistics of each module once per poll, for the channels that
+                 * ask for them with mcaReadStatus until the next poll */
+                this->startStatisticsCycle(this->pasynUserSelf);
+            }
+            if (this->deviceType == NDDxpModelMicroDXP) {
+                /* Continuous readout: snapshot the spectra and statistics every
+                 * DxpContinuousReadoutPeriod seconds while the run continues */
+                getDoubleParam(NDDxpContinuousReadoutPeriod, &readoutPeriod);
+                if ((readoutPeriod > 0.) &&
+                    (!this->snapshotValid ||
+                     (epicsTimeDiffInSeconds(&start, &this->lastSnapshotTime) >= readoutPeriod))) {
+                    this->readSnapshot(this->pasynUserSelf);
+                }
+            }
+        }
         if (mode != NDDxpModeMCA)
         {
             this->pollMappingMode();
         }
 
-        /* Do callbacks for all channels for everything except mcaAcquiring*/
-        for (i=0; i<=this->nChannels; i++) callParamCallbacks(i, i);
-        /* Copy internal acquiring flag to mcaAcquiring */
+        /* See if the acquiring state changed on any channel */
+        acquiringChanged = 0;
         for (i=0; i<=this->nChannels; i++) {
             getIntegerParam(i, NDDxpAcquiring, &acquiring);
-            setIntegerParam(i, mcaAcquiring, acquiring);
-            callParamCallbacks(i, i);
+            getIntegerParam(i, mcaAcquiring, &mcaAcq);
+            if (acquiring != mcaAcq) acquiringChanged = 1;
+        }
+        /* Do callbacks for all channels for everything except mcaAcquiring.
+         * These are rate limited unless the acquiring state changed, so the final values
+         * are always sent before mcaAcquiring */
+        this->flushParamCallbacks(acquiringChanged);
+        if (acquiringChanged) {
+            /* Copy internal acquiring flag to mcaAcquiring */
+            for (i=0; i<=this->nChannels; i++) {
+                getIntegerParam(i, NDDxpAcquiring, &acquiring);
+                setIntegerParam(i, mcaAcquiring, acquiring);
+            }
+            this->flushParamCallbacks(1);
         }
         
         paramStatus |= getDoubleParam(NDDxpPollTime, &pollTime);
         epicsTimeGetCurrent(&now);
         dtmp = epicsTimeDiffInSeconds(&now, &start);
+        /* The lock has been held since start */
+        this->updatePollStatistics(&start, dtmp);
         sleeptime = pollTime - dtmp;
         if (sleeptime > 0.0)
         {
@@ -2803,69 +4685,155 @@ void NDDxp::acquisitionTask()
     }
 }
 
+/* Do the parameter callbacks for all addresses from the polling task.
+ * Parameters that change between calls are coalesced by the parameter library, so each address
+ * is only called back at most DxpMaxUpdateRate times per second, unless force is set. */
+void NDDxp::flushParamCallbacks(int force)
+{
+    int i;
+    double maxUpdateRate;
+    epicsTimeStamp now;
+
+    getDoubleParam(NDDxpMaxUpdateRate, &maxUpdateRate);
+    epicsTimeGetCurrent(&now);
+    for (i=0; i<=this->nChannels; i++) {
+        if (!force && (maxUpdateRate > 0.) &&
+            (epicsTimeDiffInSeconds(&now, &this->lastCallbackTime[i]) < 1./maxUpdateRate)) continue;
+        callParamCallbacks(i, i);
+        this->lastCallbackTime[i] = now;
+    }
+}
+
 /** Check if the current mapping buffer is full in which case it reads out the data */
 asynStatus NDDxp::pollMappingMode()
 {
     asynStatus status = asynSuccess;
+    asynStatus result = asynSuccess;
     asynUser *pasynUser = this->pasynUserSelf;
     int xiastatus;
     int ignored;
-    int ch, buf=0, allFull=1, anyFull=0;
+    int ch, module, anyRead=0, anyFull=0;
     unsigned short isFull;
     unsigned long currentPixel = 0;
+    double elapsed;
+    epicsTimeStamp now;
+    moduleMappingBuffer *pMod;
     const char* functionName = "pollMappingMode";
     NDDxpCollectMode_t mappingMode;
     
     getIntegerParam(NDDxpCollectMode, (int *)&mappingMode);
 
-    for (ch=0; ch<this->nChannels; ch+=this->channelsPerCard)
+    /* Read out each module as soon as its current buffer is full */
+    epicsTimeGetCurrent(&now);
+    for (module=0; module<this->nCards; module++)
     {
-        buf = this->currentBuf[ch];
+        pMod = &this->mappingBuffers[module];
+        ch = module * this->channelsPerCard;
+        pMod->justRead = 0;
 
         if (mappingMode == NDDxpModeListMapping) {
-            CALLHANDEL( xiaGetRunData(ch, NDDxpListBufferLenString[buf], &currentPixel), "NDDxpListBufferLenString[buf]")
+            CALLHANDEL( xiaGetRunData(ch, NDDxpListBufferLenString[pMod->buf], &currentPixel), "NDDxpListBufferLenString[buf]")
         }
         else {
             CALLHANDEL( xiaGetRunData(ch, "current_pixel", &currentPixel) , "current_pixel" )
         }
         setIntegerParam(ch, NDDxpCurrentPixel, (int)currentPixel);
-        callParamCallbacks(ch);
-        CALLHANDEL( xiaGetRunData(ch, NDDxpBufferFullString[buf], &isFull), "NDDxpBufferFullString[buf]" )
+        if (pMod->state == NDDxpBufferStaged) continue;
+        CALLHANDEL( xiaGetRunData(ch, NDDxpBufferFullString[pMod->buf], &isFull), "NDDxpBufferFullString[buf]" )
         asynPrint(pasynUser, ASYN_TRACEIO_DRIVER, 
-            "%s::%s %s isfull=%d\n",
-            driverName, functionName, NDDxpBufferFullString[buf], isFull);
-        if (!isFull) allFull = 0;
-        if (isFull)  anyFull = 1;
+            "%s::%s module=%d %s isfull=%d\n",
+            driverName, functionName, module, NDDxpBufferFullString[pMod->buf], isFull);
+        if (!isFull) {
+            pMod->notFullTime = now;
+            continue;
+        }
+        if (pMod->state == NDDxpBufferFilling) anyFull = 1;
+        if (this->readMappingBuffer(module) != asynSuccess) result = asynError;
+        pMod->justRead = 1;
+        anyRead = 1;
     }
 
-    /* In list mapping mode if any buffer is full then switch buffers on the non-full ones.
-     * Note: this is prone to error because they could have already switched! */
+    /* In list mapping mode if any module filled its buffer then switch buffers on the modules
+     * that are still filling. A module may have filled since it was polled above, so check
+     * again before switching it. */
     if (anyFull && (mappingMode == NDDxpModeListMapping)) {
-        for (ch=0; ch<this->nChannels; ch+=this->channelsPerCard) {
-            CALLHANDEL( xiaGetRunData(ch, NDDxpBufferFullString[buf], &isFull), "NDDxpBufferFullString[buf]" )
-            if (isFull) continue;
+        epicsTimeGetCurrent(&now);
+        for (module=0; module<this->nCards; module++) {
+            pMod = &this->mappingBuffers[module];
+            if ((pMod->state != NDDxpBufferFilling) || pMod->justRead) continue;
+            ch = module * this->channelsPerCard;
+            CALLHANDEL( xiaGetRunData(ch, NDDxpBufferFullString[pMod->buf], &isFull), "NDDxpBufferFullString[buf]" )
+            if (isFull) {
+                if (this->readMappingBuffer(module) != asynSuccess) result = asynError;
+                pMod->justRead = 1;
+                anyRead = 1;
+                continue;
+            }
             CALLHANDEL( xiaBoardOperation(ch, "buffer_switch", &ignored), "buffer_switch" )
+            pMod->state = NDDxpBufferSwitching;
+            pMod->switchTime = now;
+            pMod->notFullTime = now;
+            pMod->warnAfter = BUFFER_SWITCH_TIMEOUT;
         }
-        /* Now wait until all modules report they are full */
-        do {
-            allFull = 1;
-            for (ch=0; ch<this->nChannels; ch+=this->channelsPerCard) {
-                CALLHANDEL( xiaGetRunData(ch, NDDxpBufferFullString[buf], &isFull), "NDDxpBufferFullString[buf]" )
-                if (!isFull) allFull = 0;
-            }
-        } while (allFull != 1);
     }
-    /* If all of the modules have full buffers then read them all out */
-    if (allFull)
+
+    /* Modules that were told to switch are polled again on the next pass rather than waited for here.
+     * Warn if one does not report its buffer full in time, backing off so a stuck module does
+     * not flood the log. If it still has not reported after BUFFER_SWITCH_MAX_WAIT the buffers
+     * waiting for it are discarded, so that the other modules are not left waiting forever. */
+    epicsTimeGetCurrent(&now);
+    for (module=0; module<this->nCards; module++) {
+        pMod = &this->mappingBuffers[module];
+        if (pMod->state != NDDxpBufferSwitching) continue;
+        elapsed = epicsTimeDiffInSeconds(&now, &pMod->switchTime);
+        if (elapsed >= BUFFER_SWITCH_MAX_WAIT) {
+            asynPrint(pasynUser, ASYN_TRACE_ERROR, 
+                "%s::%s module %d did not report %s %.1f seconds after buffer_switch, discarding the buffers waiting for it\n",
+                driverName, functionName, module, NDDxpBufferFullString[pMod->buf], elapsed);
+            this->perfSwitchTimeouts++;
+            setIntegerParam(NDDxpSwitchTimeouts, this->perfSwitchTimeouts);
+            this->discardPendingMappingSets();
+            result = asynError;
+            break;
+        }
+        if (elapsed < pMod->warnAfter) continue;
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, 
+            "%s::%s module %d has not reported %s %.1f seconds after buffer_switch\n",
+            driverName, functionName, module, NDDxpBufferFullString[pMod->buf], elapsed);
+        pMod->warnAfter *= 2.;
+    }
+
+    /* Publish the buffers that have now been read out by all of the modules */
+    if (anyRead)
     {
-        status = this->getMappingData();
+        if (this->getMappingData() != asynSuccess) result = asynError;
     }
+    /* CALLHANDEL overwrites status on every call, so errors from the reads are kept separately */
+    if (result != asynSuccess) return result;
     return status;
 }
 
 
 void NDDxp::report(FILE *fp, int details)
 {
+    int card, i;
+    epicsTimeStamp now;
+
+    if (details > 0) {
+        fprintf(fp, "  Startup times\n");
+        for (i=0; i<NDDxpStartupNumSteps; i++) {
+            fprintf(fp, "    %s: %f s\n", NDDxpStartupStepNames[i], this->startupTime[i]);
+        }
+        epicsTimeGetCurrent(&now);
+        fprintf(fp, "  Module statistics cache\n");
+        for (card=0; card<this->nCards; card++) {
+            fprintf(fp, "    card %d: generation=%u, cycle=%u/%u, age=%f s\n",
+                card, this->moduleStatsCache[card].generation,
+                this->moduleStatsCache[card].cycle, this->statsCycle,
+                this->moduleStatsCache[card].generation ?
+                    epicsTimeDiffInSeconds(&now, &this->moduleStatsCache[card].timeStamp) : 0.);
+        }
+    }
     asynNDArrayDriver::report(fp, details);
 }
 
@@ -2891,6 +4859,9 @@ void NDDxp::shutdown()
         "%s: shutting down in %f seconds\n", driverName, 2*pollTime);
     this->polling = 0;
     epicsThreadSleep(2*pollTime);
+    this->lock();
+    this->closeStream();
+    this->unlock();
     status = xiaExit();
     if (status == XIA_SUCCESS)
     {
@@ -2981,6 +4952,88 @@ static void xiaSaveSystemCallFunc(const iocshArgBuf *args)
     xiaSaveSystem((char *)"handel_ini", args[0].sval);
 }
 
+static const iocshArg xiaSetLazySetupArg0 = { "setup snapshot file",iocshArgString};
+static const iocshArg * const xiaSetLazySetupArgs[1] = {&xiaSetLazySetupArg0};
+static const iocshFuncDef xiaSetLazySetupFuncDef = {"xiaSetLazySetup",1,xiaSetLazySetupArgs};
+static void xiaSetLazySetupCallFunc(const iocshArgBuf *args)
+{
+    xiaSetLazySetup(args[0].sval);
+}
+
+static const iocshArg xiaSetWarmRestartArg0 = { "firmware manifest file",iocshArgString};
+static const iocshArg * const xiaSetWarmRestartArgs[1] = {&xiaSetWarmRestartArg0};
+static const iocshFuncDef xiaSetWarmRestartFuncDef = {"xiaSetWarmRestart",1,xiaSetWarmRestartArgs};
+static void xiaSetWarmRestartCallFunc(const iocshArgBuf *args)
+{
+    xiaSetWarmRestart(args[0].sval);
+}
+
+static const iocshArg xiaSetWaitStrategyArg0 = { "spin time (s)",iocshArgDouble};
+static const iocshArg xiaSetWaitStrategyArg1 = { "initial poll interval (s)",iocshArgDouble};
+static const iocshArg xiaSetWaitStrategyArg2 = { "maximum poll interval (s)",iocshArgDouble};
+static const iocshArg * const xiaSetWaitStrategyArgs[3] = {&xiaSetWaitStrategyArg0,
+                                                           &xiaSetWaitStrategyArg1,
+                                                           &xiaSetWaitStrategyArg2};
+static const iocshFuncDef xiaSetWaitStrategyFuncDef = {"xiaSetWaitStrategy",3,xiaSetWaitStrategyArgs};
+static void xiaSetWaitStrategyCallFunc(const iocshArgBuf *args)
+{
+    xiaSetWaitStrategy(args[0].dval, args[1].dval, args[2].dval);
+}
+
+static const iocshArg xiaSetWaitTimeoutArg0 = { "operation (busy, apply, fpga, dsp_boot)",iocshArgString};
+static const iocshArg xiaSetWaitTimeoutArg1 = { "timeout (s), 0=default",iocshArgDouble};
+static const iocshArg * const xiaSetWaitTimeoutArgs[2] = {&xiaSetWaitTimeoutArg0,
+                                                          &xiaSetWaitTimeoutArg1};
+static const iocshFuncDef xiaSetWaitTimeoutFuncDef = {"xiaSetWaitTimeout",2,xiaSetWaitTimeoutArgs};
+static void xiaSetWaitTimeoutCallFunc(const iocshArgBuf *args)
+{
+    xiaSetWaitTimeout(args[0].sval, args[1].dval);
+}
+
+static const iocshArg xiaSetMdWaitSpinArg0 = { "spin time (s), 0=sleep only",iocshArgDouble};
+static const iocshArg * const xiaSetMdWaitSpinArgs[1] = {&xiaSetMdWaitSpinArg0};
+static const iocshFuncDef xiaSetMdWaitSpinFuncDef = {"xiaSetMdWaitSpin",1,xiaSetMdWaitSpinArgs};
+static void xiaSetMdWaitSpinCallFunc(const iocshArgBuf *args)
+{
+    xiaSetMdWaitSpin(args[0].dval);
+}
+
+static const iocshArg xiaTimingReportArg0 = { "group, empty for all",iocshArgString};
+static const iocshArg xiaTimingReportArg1 = { "reset statistics",iocshArgInt};
+static const iocshArg * const xiaTimingReportArgs[2] = {&xiaTimingReportArg0,
+                                                        &xiaTimingReportArg1};
+static const iocshFuncDef xiaTimingReportFuncDef = {"xiaTimingReport",2,xiaTimingReportArgs};
+static void xiaTimingReportCallFunc(const iocshArgBuf *args)
+{
+    const char *group = args[0].sval ? args[0].sval : "";
+    double stats[XERXES_NUM_STATS];
+    char pointGroup[XERXES_STATS_NAME_LEN], name[XERXES_STATS_NAME_LEN];
+    double mean;
+    int point, bin;
+
+    printf("%-24s %-20s %8s %8s %10s %10s %10s %10s %12s\n",
+           "group", "name", "count", "errors", "mean(ms)", "min(ms)", "max(ms)", "last(ms)", "amount");
+    for (point=0; xiaGetTimingPoint(point, pointGroup, name, stats) == XIA_SUCCESS; point++) {
+        if (group[0] && strcmp(group, pointGroup)) continue;
+        mean = (stats[XERXES_STAT_COUNT] > 0) ? stats[XERXES_STAT_TOTAL]/stats[XERXES_STAT_COUNT] : 0.;
+        printf("%-24s %-20s %8.0f %8.0f %10.3f %10.3f %10.3f %10.3f %12g\n",
+               pointGroup, name, stats[XERXES_STAT_COUNT], stats[XERXES_STAT_ERRORS], mean*1000.,
+               stats[XERXES_STAT_MIN]*1000., stats[XERXES_STAT_MAX]*1000., stats[XERXES_STAT_LAST]*1000.,
+               stats[XERXES_STAT_AMOUNT]);
+        /* Histogram bins are powers of 2 in microseconds, only print the ones in use */
+        printf("    ");
+        for (bin=0; bin<XERXES_STATS_NUM_BINS; bin++) {
+            if (stats[XERXES_STAT_BINS + bin] == 0) continue;
+            if (bin < XERXES_STATS_NUM_BINS-1)
+                printf(" <%gus:%.0f", (double)(2 << bin), stats[XERXES_STAT_BINS + bin]);
+            else
+                printf(" >=%gus:%.0f", (double)(1 << bin), stats[XERXES_STAT_BINS + bin]);
+        }
+        printf("\n");
+    }
+    if (args[1].ival) xiaResetTimingStatistics((char *)group);
+}
+
 
 
 static void NDDxpRegister(void)
@@ -2991,6 +5044,12 @@ static void NDDxpRegister(void)
     iocshRegister(&xiaLogOutputFuncDef,xiaLogOutputCallFunc);
     iocshRegister(&xiaStartSystemFuncDef,xiaStartSystemCallFunc);
     iocshRegister(&xiaSaveSystemFuncDef,xiaSaveSystemCallFunc);
+    iocshRegister(&xiaSetLazySetupFuncDef,xiaSetLazySetupCallFunc);
+    iocshRegister(&xiaSetWarmRestartFuncDef,xiaSetWarmRestartCallFunc);
+    iocshRegister(&xiaSetWaitStrategyFuncDef,xiaSetWaitStrategyCallFunc);
+    iocshRegister(&xiaSetWaitTimeoutFuncDef,xiaSetWaitTimeoutCallFunc);
+    iocshRegister(&xiaSetMdWaitSpinFuncDef,xiaSetMdWaitSpinCallFunc);
+    iocshRegister(&xiaTimingReportFuncDef,xiaTimingReportCallFunc);
 }
 
 extern "C" {
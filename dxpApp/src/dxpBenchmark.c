@@ -0,0 +1,473 @@
+/* dxpBenchmark.c
+ *
+ * Times a standard set of scenarios against the modules described by a Handel
+ * .ini file and prints the results as JSON on stdout, so that runs on
+ * different releases, hosts and interfaces can be compared. Progress messages
+ * go to stderr.
+ *
+ * Usage: dxpBenchmark iniFile [repeats [scenario ...]]
+ *
+ * The scenarios are:
+ *   startup      xiaInit() and xiaStartSystem(), always measured once
+ *   step_point   one MCA step-scan point with no counting time: start, stop,
+ *                statistics and spectra of all channels
+ *   spectrum     reading the MCA spectrum of one channel
+ *   statistics   reading the run statistics of one channel
+ *   mapping      reading one mapping buffer of one module (xMAP, STJ and Mercury)
+ *   set_value    setting an acquisition value on all channels
+ *   apply        applying the acquisition values of one module
+ *
+ * All scenarios are run if none is given. Each scenario is repeated 'repeats'
+ * times (default 10) and reports the mean, minimum and maximum time of one
+ * repetition and, where data is transferred, the throughput in MB/s.
+ * Scenarios that do not apply to the module type are reported as "skipped",
+ * and those that could not be run because startup failed as "not_run".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsTime.h>
+
+#include "handel.h"
+#include "handel_generic.h"
+#include "handel_constants.h"
+#include "handel_errors.h"
+#include "md_generic.h"
+
+#define DEFAULT_REPEATS 10
+#define MAX_VERSION_LEN 200
+/* Largest spectrum of any of the supported products */
+#define MAX_SPECTRUM_LEN 16384
+/* Spectrum bins are 32 bits on the hardware, whatever the size of unsigned long */
+#define BYTES_PER_BIN 4
+
+typedef struct benchmarkResult {
+    const char *name;
+    int selected;
+    int skipped;
+    int notRun;     /* Not run because startup failed */
+    int status;     /* Handel status of the first failure, 0 if none */
+    int count;
+    double total;
+    double min;
+    double max;
+    double bytes;
+} benchmarkResult;
+
+typedef struct benchmarkSystem {
+    char moduleType[MAXITEM_LEN];
+    int numModules;
+    int channelsPerModule;
+    int numChannels;
+    int repeats;
+    unsigned long *data;
+    unsigned long dataLen;
+} benchmarkSystem;
+
+enum {
+    BENCH_STARTUP,
+    BENCH_STEP_POINT,
+    BENCH_SPECTRUM,
+    BENCH_STATISTICS,
+    BENCH_MAPPING,
+    BENCH_SET_VALUE,
+    BENCH_APPLY,
+    NUM_BENCHMARKS
+};
+
+static benchmarkResult results[NUM_BENCHMARKS] = {
+    {"startup"},
+    {"step_point"},
+    {"spectrum"},
+    {"statistics"},
+    {"mapping"},
+    {"set_value"},
+    {"apply"},
+};
+
+/* The run statistics that every product supports as individual run data. */
+static char *statisticsNames[] = {
+    "runtime",
+    "trigger_livetime",
+    "livetime",
+    "input_count_rate",
+    "output_count_rate",
+};
+
+#define NUM_STATISTICS (sizeof(statisticsNames) / sizeof(statisticsNames[0]))
+
+static double elapsedTime(epicsTimeStamp *start)
+{
+    epicsTimeStamp now;
+
+    epicsTimeGetCurrent(&now);
+    return epicsTimeDiffInSeconds(&now, start);
+}
+
+static void addSample(benchmarkResult *r, double seconds, double bytes)
+{
+    if ((r->count == 0) || (seconds < r->min)) r->min = seconds;
+    if ((r->count == 0) || (seconds > r->max)) r->max = seconds;
+    r->count++;
+    r->total += seconds;
+    r->bytes += bytes;
+}
+
+/* Records the first Handel error of a scenario and returns non-zero if there
+ * was one, so the scenario can stop. */
+static int checkStatus(benchmarkResult *r, int status, const char *what)
+{
+    if (status == XIA_SUCCESS) return 0;
+    fprintf(stderr, "%s: error %d from %s\n", r->name, status, what);
+    if (r->status == 0) r->status = status;
+    return 1;
+}
+
+static int isMappingModule(benchmarkSystem *sys)
+{
+    return ((strcmp(sys->moduleType, "xmap") == 0) ||
+            (strcmp(sys->moduleType, "stj") == 0) ||
+            (strcmp(sys->moduleType, "mercury") == 0));
+}
+
+static int readStatistics(benchmarkResult *r, int detChan)
+{
+    int status;
+    unsigned int i;
+    double value;
+
+    for (i = 0; i < NUM_STATISTICS; i++) {
+        status = xiaGetRunData(detChan, statisticsNames[i], &value);
+        if (checkStatus(r, status, statisticsNames[i])) return status;
+    }
+    return XIA_SUCCESS;
+}
+
+static int readSpectrum(benchmarkResult *r, benchmarkSystem *sys, int detChan,
+                        unsigned long *mcaLength)
+{
+    int status;
+
+    status = xiaGetRunData(detChan, "mca_length", mcaLength);
+    if (checkStatus(r, status, "mca_length")) return status;
+    if (*mcaLength > sys->dataLen) {
+        fprintf(stderr, "%s: mca_length %lu exceeds the buffer of %lu words\n",
+                r->name, *mcaLength, sys->dataLen);
+        checkStatus(r, XIA_NOMEM, "mca_length");
+        return XIA_NOMEM;
+    }
+    status = xiaGetRunData(detChan, "mca", sys->data);
+    if (checkStatus(r, status, "mca")) return status;
+    return XIA_SUCCESS;
+}
+
+static void benchStepPoint(benchmarkResult *r, benchmarkSystem *sys)
+{
+    int i, chan;
+    unsigned long mcaLength;
+    double bytes;
+    epicsTimeStamp start;
+
+    for (i = 0; i < sys->repeats; i++) {
+        bytes = 0.;
+        epicsTimeGetCurrent(&start);
+        if (checkStatus(r, xiaStartRun(-1, 0), "xiaStartRun")) return;
+        if (checkStatus(r, xiaStopRun(-1), "xiaStopRun")) return;
+        for (chan = 0; chan < sys->numChannels; chan++) {
+            if (readStatistics(r, chan)) return;
+            if (readSpectrum(r, sys, chan, &mcaLength)) return;
+            bytes += mcaLength * BYTES_PER_BIN;
+        }
+        addSample(r, elapsedTime(&start), bytes);
+    }
+}
+
+static void benchSpectrum(benchmarkResult *r, benchmarkSystem *sys)
+{
+    int i, chan;
+    unsigned long mcaLength;
+    epicsTimeStamp start;
+
+    for (i = 0; i < sys->repeats; i++) {
+        for (chan = 0; chan < sys->numChannels; chan++) {
+            epicsTimeGetCurrent(&start);
+            if (readSpectrum(r, sys, chan, &mcaLength)) return;
+            addSample(r, elapsedTime(&start), mcaLength * BYTES_PER_BIN);
+        }
+    }
+}
+
+static void benchStatistics(benchmarkResult *r, benchmarkSystem *sys)
+{
+    int i, chan;
+    epicsTimeStamp start;
+
+    for (i = 0; i < sys->repeats; i++) {
+        for (chan = 0; chan < sys->numChannels; chan++) {
+            epicsTimeGetCurrent(&start);
+            if (readStatistics(r, chan)) return;
+            addSample(r, elapsedTime(&start), 0.);
+        }
+    }
+}
+
+static int applyAll(benchmarkResult *r, benchmarkSystem *sys)
+{
+    int module;
+    int ignore = 0;
+
+    for (module = 0; module < sys->numModules; module++) {
+        if (checkStatus(r, xiaBoardOperation(module * sys->channelsPerModule,
+                                             "apply", &ignore), "apply"))
+            return 1;
+    }
+    return 0;
+}
+
+/* Reads buffer A of every module with MCA mapping enabled. The buffer does not
+ * need to be full for this, so no run or pixel advance is needed. */
+static void benchMapping(benchmarkResult *r, benchmarkSystem *sys)
+{
+    int i, module;
+    double mappingMode, enabled = 1.;
+    unsigned long bufLen;
+    epicsTimeStamp start;
+
+    if (!isMappingModule(sys)) {
+        r->skipped = 1;
+        return;
+    }
+    if (checkStatus(r, xiaGetAcquisitionValues(0, "mapping_mode", &mappingMode),
+                    "mapping_mode")) return;
+    if (checkStatus(r, xiaSetAcquisitionValues(-1, "mapping_mode", &enabled),
+                    "mapping_mode")) return;
+    if (applyAll(r, sys)) goto restore;
+    if (checkStatus(r, xiaGetRunData(0, "buffer_len", &bufLen), "buffer_len"))
+        goto restore;
+    if (bufLen > sys->dataLen) {
+        free(sys->data);
+        sys->dataLen = bufLen;
+        sys->data = calloc(sys->dataLen, sizeof(unsigned long));
+        if (sys->data == NULL) {
+            sys->dataLen = 0;
+            checkStatus(r, XIA_NOMEM, "buffer_len");
+            goto restore;
+        }
+    }
+
+    for (i = 0; i < sys->repeats; i++) {
+        for (module = 0; module < sys->numModules; module++) {
+            epicsTimeGetCurrent(&start);
+            if (checkStatus(r, xiaGetRunData(module * sys->channelsPerModule,
+                                             "buffer_a", sys->data), "buffer_a"))
+                goto restore;
+            /* The buffers hold 16-bit words on the hardware. */
+            addSample(r, elapsedTime(&start), bufLen * 2.);
+        }
+    }
+
+restore:
+    xiaSetAcquisitionValues(-1, "mapping_mode", &mappingMode);
+    applyAll(r, sys);
+}
+
+/* Sets the number of MCA channels to its current value, which every product
+ * supports and which leaves the configuration unchanged. */
+static void benchSetValue(benchmarkResult *r, benchmarkSystem *sys)
+{
+    int i;
+    double value;
+    epicsTimeStamp start;
+
+    if (checkStatus(r, xiaGetAcquisitionValues(0, "number_mca_channels", &value),
+                    "number_mca_channels")) return;
+    for (i = 0; i < sys->repeats; i++) {
+        epicsTimeGetCurrent(&start);
+        if (checkStatus(r, xiaSetAcquisitionValues(-1, "number_mca_channels",
+                                                   &value), "number_mca_channels"))
+            return;
+        addSample(r, elapsedTime(&start), 0.);
+    }
+}
+
+static void benchApply(benchmarkResult *r, benchmarkSystem *sys)
+{
+    int i, module;
+    int ignore = 0;
+    epicsTimeStamp start;
+
+    /* The Saturn applies acquisition values as they are set. */
+    if (strcmp(sys->moduleType, "dxpx10p") == 0) {
+        r->skipped = 1;
+        return;
+    }
+    for (i = 0; i < sys->repeats; i++) {
+        for (module = 0; module < sys->numModules; module++) {
+            epicsTimeGetCurrent(&start);
+            if (checkStatus(r, xiaBoardOperation(module * sys->channelsPerModule,
+                                                 "apply", &ignore), "apply"))
+                return;
+            addSample(r, elapsedTime(&start), 0.);
+        }
+    }
+}
+
+/* Print a quoted JSON string. Windows paths contain backslashes. */
+static void printJsonString(const char *str)
+{
+    putchar('"');
+    for (; *str; str++) {
+        if ((*str == '"') || (*str == '\\'))
+            printf("\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            printf("\\u%04x", (unsigned char)*str);
+        else
+            putchar(*str);
+    }
+    putchar('"');
+}
+
+static void printResults(const char *iniFile, benchmarkSystem *sys)
+{
+    int i, rel, min, maj;
+    char version[MAX_VERSION_LEN];
+    benchmarkResult *r;
+
+    xiaGetVersionInfo(&rel, &min, &maj, version);
+
+    printf("{\n");
+    printf("  \"program\": \"dxpBenchmark\",\n");
+    printf("  \"handel_version\": \"%d.%d.%d\",\n", maj, min, rel);
+    printf("  \"ini_file\": ");
+    printJsonString(iniFile);
+    printf(",\n  \"module_type\": ");
+    printJsonString(sys->moduleType);
+    printf(",\n");
+    printf("  \"modules\": %d,\n", sys->numModules);
+    printf("  \"channels\": %d,\n", sys->numChannels);
+    printf("  \"repeats\": %d,\n", sys->repeats);
+    printf("  \"results\": [");
+    for (i = 0; i < NUM_BENCHMARKS; i++) {
+        r = &results[i];
+        if (!r->selected) continue;
+        printf("%s\n    {\"scenario\": \"%s\", ", (i == 0) ? "" : ",", r->name);
+        if (r->skipped || r->notRun) {
+            printf("\"result\": \"%s\"}", r->skipped ? "skipped" : "not_run");
+            continue;
+        }
+        printf("\"result\": \"%s\", \"handel_status\": %d, \"count\": %d",
+               r->status ? "error" : "ok", r->status, r->count);
+        if (r->count > 0) {
+            printf(", \"mean_s\": %.6e, \"min_s\": %.6e, \"max_s\": %.6e",
+                   r->total / r->count, r->min, r->max);
+            if ((r->bytes > 0.) && (r->total > 0.))
+                printf(", \"mbytes_per_s\": %.3f", r->bytes / r->total / 1.e6);
+        }
+        printf("}");
+    }
+    printf("\n  ]\n}\n");
+}
+
+/* Marks the selected scenarios after startup as not run, for when startup fails */
+static void markNotRun(void)
+{
+    int i;
+
+    for (i = 1; i < NUM_BENCHMARKS; i++) {
+        results[i].notRun = results[i].selected;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int i, j;
+    int status;
+    unsigned int numModules;
+    char moduleAlias[MAXALIAS_LEN];
+    char *iniFile;
+    benchmarkSystem sys;
+    epicsTimeStamp start;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s iniFile [repeats [scenario ...]]\n", argv[0]);
+        return 1;
+    }
+    iniFile = argv[1];
+    memset(&sys, 0, sizeof(sys));
+    sys.repeats = (argc > 2) ? atoi(argv[2]) : DEFAULT_REPEATS;
+    if (sys.repeats < 1) sys.repeats = 1;
+
+    results[BENCH_STARTUP].selected = 1;
+    for (i = 1; i < NUM_BENCHMARKS; i++) {
+        results[i].selected = (argc <= 3);
+    }
+    for (j = 3; j < argc; j++) {
+        for (i = 1; i < NUM_BENCHMARKS; i++) {
+            if (strcmp(argv[j], results[i].name) == 0) break;
+        }
+        if (i == NUM_BENCHMARKS) {
+            fprintf(stderr, "Unknown scenario %s\n", argv[j]);
+            return 1;
+        }
+        results[i].selected = 1;
+    }
+
+    fprintf(stderr, "Initializing %s ...\n", iniFile);
+    xiaSetLogLevel(MD_ERROR);
+    epicsTimeGetCurrent(&start);
+    status = xiaInit(iniFile);
+    if (status == XIA_SUCCESS) status = xiaStartSystem();
+    if (checkStatus(&results[BENCH_STARTUP], status, "startup")) {
+        markNotRun();
+        printResults(iniFile, &sys);
+        return 1;
+    }
+    addSample(&results[BENCH_STARTUP], elapsedTime(&start), 0.);
+
+    status = xiaGetNumModules(&numModules);
+    if (status == XIA_SUCCESS) status = xiaGetModules_VB(0, moduleAlias);
+    if (status == XIA_SUCCESS)
+        status = xiaGetModuleItem(moduleAlias, "module_type", sys.moduleType);
+    if (status == XIA_SUCCESS)
+        status = xiaGetModuleItem(moduleAlias, "number_of_channels",
+                                  &sys.channelsPerModule);
+    if (checkStatus(&results[BENCH_STARTUP], status, "module information")) {
+        markNotRun();
+        printResults(iniFile, &sys);
+        xiaExit();
+        return 1;
+    }
+    sys.numModules = numModules;
+    sys.numChannels = sys.numModules * sys.channelsPerModule;
+    sys.dataLen = MAX_SPECTRUM_LEN;
+    sys.data = calloc(sys.dataLen, sizeof(unsigned long));
+    if (sys.data == NULL) {
+        fprintf(stderr, "Unable to allocate %lu words\n", sys.dataLen);
+        checkStatus(&results[BENCH_STARTUP], XIA_NOMEM, "allocating the data buffer");
+        markNotRun();
+        printResults(iniFile, &sys);
+        xiaExit();
+        return 1;
+    }
+
+    for (i = 1; i < NUM_BENCHMARKS; i++) {
+        if (!results[i].selected) continue;
+        fprintf(stderr, "Running %s ...\n", results[i].name);
+        switch (i) {
+            case BENCH_STEP_POINT: benchStepPoint(&results[i], &sys); break;
+            case BENCH_SPECTRUM:   benchSpectrum(&results[i], &sys); break;
+            case BENCH_STATISTICS: benchStatistics(&results[i], &sys); break;
+            case BENCH_MAPPING:    benchMapping(&results[i], &sys); break;
+            case BENCH_SET_VALUE:  benchSetValue(&results[i], &sys); break;
+            case BENCH_APPLY:      benchApply(&results[i], &sys); break;
+        }
+    }
+
+    printResults(iniFile, &sys);
+
+    free(sys.data);
+    xiaExit();
+    return 0;
+}
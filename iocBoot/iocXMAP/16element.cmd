@@ -24,6 +24,10 @@ set_pass1_restoreFile("auto_settings16.sav")
 # Set logging level (1=ERROR, 2=WARNING, 3=INFO, 4=DEBUG)
 xiaSetLogLevel(2)
 xiaInit("xmap16.ini")
+# Uncomment to skip the module setup when the DSP parameters are unchanged since the last start
+#xiaSetLazySetup("xmap16.setup")
+# Uncomment to skip the firmware download when the modules are still running the same firmware
+#xiaSetWarmRestart("xmap16.firmware")
 xiaStartSystem
 
 # DXPConfig(serverName, ndetectors, maxBuffers, maxMemory)